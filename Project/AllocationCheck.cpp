@@ -0,0 +1,98 @@
+#include "AllocationCheck.h"
+#include <fstream>
+#include "AllocationCounter.h"
+
+namespace {
+
+// 負の座標でも小さい方へ丸める割り算
+int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+} // namespace
+
+AllocationCheck::AllocationCheck(const MapManager& map)
+    : map_(map) {
+    size_t layers = map_.GetTileSource().Layers().size();
+    for (int i = 0; i < kPhaseCount; ++i) {
+        starts_[i].hits.reserve(layers);
+        ends_[i].hits.reserve(layers);
+    }
+}
+
+void AllocationCheck::Take(Snapshot& snapshot) const {
+    snapshot.allocations = AllocationCount();
+    snapshot.chunkLoads = map_.LoadedChunkCount();
+    snapshot.frames = frames_;
+    snapshot.hits.clear();
+    snapshot.remoteHits = 0;
+    map_.GetTileSource().ForEachLayer([&snapshot](const TileSource& layer) {
+        snapshot.hits.emplace_back(layer.Name(), layer.Hits());
+        if (layer.IsRemote()) snapshot.remoteHits += layer.Hits();
+    });
+}
+
+int AllocationCheck::NextMove(int playerTileX) {
+    ++frames_;
+    if (Finished() || !map_.IsSettled()) return 0;
+    int chunk = FloorDiv(playerTileX, ChunkLoader::kChunkWidth);
+    if (!started_) {
+        started_ = true;
+        lastChunk_ = chunk;
+        Take(starts_[0]);
+    }
+    if (chunk != lastChunk_) {
+        lastChunk_ = chunk;
+        ++crossings_;
+    }
+    // 区間の終わりは、最後に入ったチャンクのまわりを読み終えたところ
+    if (crossings_ >= kPhases[phase_].chunks) {
+        Take(ends_[phase_]);
+        crossings_ = 0;
+        if (++phase_ == kPhaseCount) return 0;
+        Take(starts_[phase_]);
+    }
+    return kPhases[phase_].direction;
+}
+
+bool AllocationCheck::Save(const std::filesystem::path& path) const {
+    bool passed = Finished();
+    nlohmann::json phases = nlohmann::json::array();
+    for (int i = 0; i < phase_; ++i) {
+        const Snapshot& start = starts_[i];
+        const Snapshot& end = ends_[i];
+        uint64_t allocations = end.allocations - start.allocations;
+        uint64_t loads = end.chunkLoads - start.chunkLoads;
+        uint64_t frames = end.frames - start.frames;
+        double perLoad = loads ? static_cast<double>(allocations) / static_cast<double>(loads) : 0.0;
+        // ウォームアップと、通信を伴う取得元が答えた区間（HTTP とシートの解析が確保する）は基準にしない
+        bool gated = i > 0 && end.remoteHits == start.remoteHits;
+        bool ok = !gated || perLoad <= kMaxAllocationsPerLoad;
+        passed = passed && ok;
+        nlohmann::json hits = nlohmann::json::object();
+        for (size_t layer = 0; layer < end.hits.size() && layer < start.hits.size(); ++layer) {
+            hits[end.hits[layer].first] = end.hits[layer].second - start.hits[layer].second;
+        }
+        phases.push_back({
+            { "name", kPhases[i].name },
+            { "chunks", kPhases[i].chunks },
+            { "frames", frames },
+            { "chunk_loads", loads },
+            { "allocations", allocations },
+            { "allocations_per_load", perLoad },
+            { "allocations_per_frame", frames ? static_cast<double>(allocations) / static_cast<double>(frames) : 0.0 },
+            { "hits", hits },
+            { "gated", gated },
+            { "passed", ok },
+        });
+    }
+    nlohmann::json j = {
+        { "max_allocations_per_load", kMaxAllocationsPerLoad },
+        { "finished", Finished() },
+        { "passed", passed },
+        { "phases", phases },
+    };
+    std::ofstream ofs(path);
+    if (ofs) ofs << j.dump(2);
+    return passed;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+#include <vector>
+#include "MapManager.h"
+
+// 起動引数 --alloc-check: プレイヤーを自動で歩かせ、チャンクの読み込みごとの operator new の回数を測る
+// 東へ kWarmupChunks 進んで（プールと使い回すバッファを温める）、さらに kMeasureChunks 進み、同じ道を戻る
+// 区間ごとの回数・読み込んだチャンク数・取得元ごとのヒット数を JSON に書き、
+// 通信を伴う取得元が答えなかった区間で1チャンクあたり kMaxAllocationsPerLoad を超えたら失敗にする
+class AllocationCheck {
+public:
+    static constexpr int kWarmupChunks = 8;
+    static constexpr int kMeasureChunks = 20;
+    static constexpr double kMaxAllocationsPerLoad = 1.0;
+
+    explicit AllocationCheck(const MapManager& map);
+
+    // 毎フレーム呼ぶ。常駐チャンクを読み終えていれば次の一歩（-1, 0, 1）を返し、まだなら 0
+    int NextMove(int playerTileX);
+    bool Finished() const { return phase_ == kPhaseCount; }
+    const char* PhaseName() const { return Finished() ? "done" : kPhases[phase_].name; }
+    // 結果を書き出す。基準を超えた区間があれば false
+    bool Save(const std::filesystem::path& path) const;
+
+private:
+    struct Phase {
+        const char* name;
+        int direction;
+        int chunks;
+    };
+    static constexpr int kPhaseCount = 3;
+    static constexpr std::array<Phase, kPhaseCount> kPhases = { {
+        { "warmup", 1, kWarmupChunks },
+        { "explore", 1, kMeasureChunks },
+        { "revisit", -1, kMeasureChunks },
+    } };
+
+    // 区間の始めと終わりの値（測っている間に確保しないよう、置き場は最初に用意する）
+    struct Snapshot {
+        uint64_t allocations = 0;
+        uint64_t chunkLoads = 0;
+        uint64_t frames = 0;
+        std::vector<std::pair<const char*, uint64_t>> hits; // 取得元ごと（CachedSource::Layers の順）
+        uint64_t remoteHits = 0;
+    };
+    void Take(Snapshot& snapshot) const;
+
+    const MapManager& map_;
+    int phase_ = 0;
+    bool started_ = false;
+    int lastChunk_ = 0;
+    int crossings_ = 0;
+    uint64_t frames_ = 0;
+    // 区間ごとの始めと終わり
+    std::array<Snapshot, kPhaseCount> starts_;
+    std::array<Snapshot, kPhaseCount> ends_;
+};
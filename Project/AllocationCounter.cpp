@@ -0,0 +1,65 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// 置き換えるのは通常の operator new と nothrow 版だけ（アラインメント指定の版は既定の実装のまま数えない）
+// 確保は malloc に任せ、数えるだけにする
+
+namespace {
+
+std::atomic<uint64_t> gAllocations = 0;
+
+void* Allocate(std::size_t size) noexcept {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    // 0 バイトでも別々のアドレスを返す
+    return std::malloc(size ? size : 1);
+}
+
+} // namespace
+
+uint64_t AllocationCount() {
+    return gAllocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    if (void* p = Allocate(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* p = Allocate(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
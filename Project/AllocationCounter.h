@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// 起動してからの operator new の回数（AllocationCounter.cpp が実行ファイル全体の operator new を置き換えて数える）
+// スレッドをまたいで数えるが、他のカウンターとの前後は保証しない
+uint64_t AllocationCount();
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+// ベンチマークの引数（"--名前 値" の組）
+class BenchArgs {
+public:
+    // argv[first] 以降を読む。値のない名前があれば false
+    bool Parse(int argc, char* argv[], int first);
+
+    // 値が数でなければ std::invalid_argument を投げる
+    int Int(const std::string& name, int fallback) const;
+    double Double(const std::string& name, double fallback) const;
+    std::string String(const std::string& name, const std::string& fallback) const;
+
+private:
+    std::unordered_map<std::string, std::string> values_;
+};
+
+// 各ベンチマーク。結果を標準出力に書き、結果の照合に失敗したら 0 以外を返す
+
+// タイルゲートウェイの負荷試験（同じプロセスのモックを上流にし、多数のクライアントが歩き回って取得する）
+int RunGatewayBench(const BenchArgs& args);
+
+// スケジューラの耐久試験（クォータの厳しいモックを上流に歩き続け、書かれたキャッシュを照合する）
+int RunSoakBench(const BenchArgs& args);
+
+// シート全体の一括取り込み（values API の JSON と CSV エクスポートの解析速度、ファイルからの取り込み）
+int RunCsvBench(const BenchArgs& args);
+
+// 当たり判定（CollisionMap::Move と、タイルの int を1つずつ見る方式の比較。参照実装との照合を含む）
+int RunCollisionBench(const BenchArgs& args);
+
+// チャンクキャッシュのエンコード形式（形式ごとのディスク上のバイト数と、読み込み1回の時間）
+int RunCacheBench(const BenchArgs& args);
+
+// 経路探索（A* の参照実装、JPS、HPA* の1問あたりの時間と経路の長さ。チャンクを書き換えた後の探し直し）
+int RunPathBench(const BenchArgs& args);
+
+// 流れ場（全体の計算とチャンクの出入りの差分計算の時間、メモリ、1フレームあたりのエージェントの移動。参照実装との照合を含む）
+int RunFlowBench(const BenchArgs& args);
+
+// 追加レイヤー（レイヤー数ごとの batchGet のリクエスト数・受信バイト数・取得時間と、常駐チャンクに足すメモリ。モックの値との照合を含む）
+int RunLayersBench(const BenchArgs& args);
+
+// タイル編集の書き戻し（1回の書き戻しのセル数・矩形の数・リクエスト数・時間、競合と 503 の再試行。モックのセルとの照合を含む）
+int RunEditsBench(const BenchArgs& args);
+
+// 関心領域の共有（ランダムに歩く多数の観戦者の読み込み数・常駐チャンク数・1フレームの時間。参照数の数え直しとの照合を含む）
+int RunRegionsBench(const BenchArgs& args);
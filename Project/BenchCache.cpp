@@ -0,0 +1,124 @@
+#include "Bench.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+#include "ChunkLoader.h"
+
+// チャンクキャッシュのエンコード形式の比較
+// source のキャッシュ（主レイヤーの chunk_cx_cy.*）を読み、形式ごとに別のディレクトリへ CommitChunk で書き直す
+// 形式ごとに、ディスク上のバイト数と LoadChunkCache 1回の時間（ファイルの検索・読み込み・デコードを含む。reps 回のうち最速）を書く
+// source のディレクトリは書き換えない（コピーを読む）
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct EncodingName {
+    CacheEncoding encoding;
+    const char* name;
+    const char* extension;
+};
+
+constexpr EncodingName kEncodings[] = {
+    { CacheEncoding::Json, "json", ".json" },
+    { CacheEncoding::Cbor, "cbor", ".cbor" },
+    { CacheEncoding::MessagePack, "msgpack", ".msgpack" },
+    { CacheEncoding::BJData, "bjdata", ".bjd" },
+};
+
+// "chunk_cx_cy.拡張子" のチャンク座標（追加レイヤーのファイルは false）
+bool ParseCacheFileName(const std::string& name, int& cx, int& cy) {
+    if (name.rfind("chunk_", 0) != 0) return false;
+    const char* p = name.data() + 6;
+    const char* end = name.data() + name.size();
+    auto first = std::from_chars(p, end, cx);
+    if (first.ec != std::errc() || first.ptr == end || *first.ptr != '_') return false;
+    auto second = std::from_chars(first.ptr + 1, end, cy);
+    return second.ec == std::errc() && second.ptr != end && *second.ptr == '.';
+}
+
+} // namespace
+
+int RunCacheBench(const BenchArgs& args) {
+    std::filesystem::path sourceDir = args.String("source", "cache");
+    int reps = std::max(1, args.Int("reps", 20));
+    std::filesystem::path benchDir = std::filesystem::path(args.String("cache", "bench_cache")) / "encodings";
+    std::error_code ec;
+    std::filesystem::remove_all(benchDir, ec);
+
+    // 元のキャッシュをコピーして読む（ChunkLoader は終了時にマニフェストを書く）
+    std::filesystem::path copyDir = benchDir / "source";
+    std::filesystem::create_directories(copyDir, ec);
+    std::vector<std::pair<int, int>> coords;
+    for (auto it = std::filesystem::directory_iterator(sourceDir, ec); !ec && it != std::filesystem::directory_iterator();
+         it.increment(ec)) {
+        int cx = 0;
+        int cy = 0;
+        std::string name = it->path().filename().string();
+        if (!ParseCacheFileName(name, cx, cy)) continue;
+        std::filesystem::copy_file(it->path(), copyDir / name, std::filesystem::copy_options::overwrite_existing, ec);
+        if (!ec) coords.emplace_back(cx, cy);
+    }
+    std::sort(coords.begin(), coords.end());
+    coords.erase(std::unique(coords.begin(), coords.end()), coords.end());
+    if (coords.empty()) {
+        std::fprintf(stderr, "no chunk cache files in %s\n", sourceDir.string().c_str());
+        return 1;
+    }
+
+    std::vector<ChunkTiles> chunks(coords.size());
+    {
+        ChunkLoader source("bench", "TR1_02", "", copyDir.string());
+        source.Initialize();
+        for (size_t i = 0; i < coords.size(); ++i) {
+            if (!source.LoadChunkCache(coords[i].first, coords[i].second, chunks[i])) {
+                std::fprintf(stderr, "cannot read chunk (%d, %d)\n", coords[i].first, coords[i].second);
+                return 1;
+            }
+        }
+    }
+    std::printf("cache: %zu chunks from %s, best of %d loads each\n", coords.size(), sourceDir.string().c_str(), reps);
+    std::printf("%-8s %10s %12s %12s %10s\n", "encoding", "bytes", "bytes/chunk", "us/chunk", "mismatches");
+
+    size_t bad = 0;
+    for (const EncodingName& encoding : kEncodings) {
+        std::filesystem::path dir = benchDir / encoding.name;
+        {
+            ChunkLoader writer("bench", "TR1_02", "", dir.string());
+            writer.SetCacheEncoding(encoding.encoding);
+            writer.Initialize();
+            for (size_t i = 0; i < coords.size(); ++i) writer.CommitChunk(coords[i].first, coords[i].second, chunks[i]);
+        }
+        uintmax_t bytes = 0;
+        for (const auto& coord : coords) {
+            std::string name = "chunk_" + std::to_string(coord.first) + "_" + std::to_string(coord.second) + encoding.extension;
+            bytes += std::filesystem::file_size(dir / name, ec);
+        }
+
+        // 書いたローダーとは別に開き直し、ディスクの索引から読む
+        ChunkLoader reader("bench", "TR1_02", "", dir.string());
+        reader.SetCacheEncoding(encoding.encoding);
+        reader.Initialize();
+        double best = 1e9;
+        size_t mismatches = 0;
+        ChunkTiles tiles;
+        for (int rep = 0; rep < reps; ++rep) {
+            auto begin = Clock::now();
+            for (const auto& coord : coords) reader.LoadChunkCache(coord.first, coord.second, tiles);
+            best = std::min(best, std::chrono::duration<double>(Clock::now() - begin).count());
+        }
+        for (size_t i = 0; i < coords.size(); ++i) {
+            if (!reader.LoadChunkCache(coords[i].first, coords[i].second, tiles) || tiles.ToTileData() != chunks[i].ToTileData()) {
+                ++mismatches;
+            }
+        }
+        double chunkCount = static_cast<double>(coords.size());
+        std::printf("%-8s %10ju %12.0f %12.2f %10zu\n", encoding.name, bytes, static_cast<double>(bytes) / chunkCount,
+            best * 1e6 / chunkCount, mismatches);
+        bad += mismatches;
+    }
+    return bad == 0 ? 0 : 1;
+}
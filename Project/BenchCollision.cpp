@@ -0,0 +1,249 @@
+#include "Bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "TileCollision.h"
+
+// 当たり判定の比較
+// 多数の矩形を毎フレーム1回ずつ Move し、1フレームあたりの時間を書く
+//   bitset:      CollisionMap::Move（ページ行のビット列）
+//   chunk map:   常駐チャンクのハッシュマップを引いてタイルの int を1つずつ見る（今のゲームの持ち方）
+//   flat vector: 同じ走査を1つの入れ子の vector で
+// 先に、CollisionMap の Move と Overlaps をタイルを1つずつ見る参照実装と照合する（世界の外、整数位置、速い移動を含む）
+
+namespace {
+
+// 参照実装のタイル境界（CollisionMap と同じく、浮動小数点の誤差で隣のタイルに触れないよう少し内側に寄せる）
+constexpr float kEdgeEpsilon = 1.0f / 1024.0f;
+int FirstTile(float edge) { return static_cast<int>(std::floor(edge + kEdgeEpsilon)); }
+int LastTile(float edge) { return static_cast<int>(std::ceil(edge - kEdgeEpsilon)) - 1; }
+
+int FloorDiv(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+// タイルの int を持つ世界（読み込み前のチャンクと世界の外は unloadedSolid に従う）
+struct IntWorld {
+    int width = 0;
+    int height = 0;
+    bool unloadedSolid = false;
+    std::vector<std::vector<int>> grid;
+    std::unordered_map<std::pair<int, int>, ChunkTiles, PairHash> chunks;
+
+    bool SolidChunked(int x, int y) const {
+        int cx = FloorDiv(x, ChunkTiles::kWidth);
+        int cy = FloorDiv(y, ChunkTiles::kHeight);
+        auto found = chunks.find({ cx, cy });
+        if (found == chunks.end()) return unloadedSolid;
+        return found->second.At(x - cx * ChunkTiles::kWidth, y - cy * ChunkTiles::kHeight) != 0;
+    }
+    bool SolidGrid(int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height) return unloadedSolid;
+        return grid[static_cast<size_t>(y)][static_cast<size_t>(x)] != 0;
+    }
+};
+
+// タイルを1つずつ見る Move（X、Y の順。すでに重なっているタイルは無視する）
+template <typename Solid>
+TileMove ReferenceMove(const TileBox& box, float dx, float dy, Solid solid) {
+    TileMove move;
+    move.dx = dx;
+    int y0 = FirstTile(box.y);
+    int y1 = LastTile(box.y + box.height);
+    auto columnHit = [&](int column) {
+        for (int y = y0; y <= y1; ++y) {
+            if (solid(column, y)) return true;
+        }
+        return false;
+    };
+    if (dx > 0.0f) {
+        for (int column = LastTile(box.x + box.width) + 1; column <= LastTile(box.x + box.width + dx); ++column) {
+            if (columnHit(column)) {
+                move.dx = std::max(0.0f, static_cast<float>(column) - (box.x + box.width));
+                break;
+            }
+        }
+    } else if (dx < 0.0f) {
+        for (int column = FirstTile(box.x) - 1; column >= FirstTile(box.x + dx); --column) {
+            if (columnHit(column)) {
+                move.dx = std::min(0.0f, static_cast<float>(column + 1) - box.x);
+                break;
+            }
+        }
+    }
+    move.hitX = move.dx != dx;
+
+    TileBox moved = box;
+    moved.x += move.dx;
+    move.dy = dy;
+    int x0 = FirstTile(moved.x);
+    int x1 = LastTile(moved.x + moved.width);
+    auto rowHit = [&](int row) {
+        for (int x = x0; x <= x1; ++x) {
+            if (solid(x, row)) return true;
+        }
+        return false;
+    };
+    if (dy > 0.0f) {
+        for (int row = LastTile(moved.y + moved.height) + 1; row <= LastTile(moved.y + moved.height + dy); ++row) {
+            if (rowHit(row)) {
+                move.dy = std::max(0.0f, static_cast<float>(row) - (moved.y + moved.height));
+                break;
+            }
+        }
+    } else if (dy < 0.0f) {
+        for (int row = FirstTile(moved.y) - 1; row >= FirstTile(moved.y + dy); --row) {
+            if (rowHit(row)) {
+                move.dy = std::min(0.0f, static_cast<float>(row + 1) - moved.y);
+                break;
+            }
+        }
+    }
+    move.hitY = move.dy != dy;
+    return move;
+}
+
+void BuildWorld(IntWorld& world, CollisionMap& map, double density, std::mt19937& random) {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    world.grid.assign(static_cast<size_t>(world.height), std::vector<int>(static_cast<size_t>(world.width)));
+    for (auto& row : world.grid) {
+        for (int& tile : row) tile = unit(random) < density ? static_cast<int>(random() % 3) + 1 : 0;
+    }
+    world.chunks.clear();
+    map.Clear();
+    TileClassifier classifier;
+    for (int cy = 0; cy * ChunkTiles::kHeight < world.height; ++cy) {
+        for (int cx = 0; cx * ChunkTiles::kWidth < world.width; ++cx) {
+            ChunkTiles tiles;
+            tiles.rowCount = std::min(ChunkTiles::kHeight, world.height - cy * ChunkTiles::kHeight);
+            int rowWidth = std::min(ChunkTiles::kWidth, world.width - cx * ChunkTiles::kWidth);
+            for (int y = 0; y < tiles.rowCount; ++y) {
+                tiles.rowWidths[static_cast<size_t>(y)] = static_cast<uint8_t>(rowWidth);
+                for (int x = 0; x < rowWidth; ++x) {
+                    tiles.cells[static_cast<size_t>(y * ChunkTiles::kWidth + x)] =
+                        world.grid[static_cast<size_t>(cy * ChunkTiles::kHeight + y)][static_cast<size_t>(cx * ChunkTiles::kWidth + x)];
+                }
+            }
+            map.Set(cx, cy, classifier.Build(tiles));
+            world.chunks.emplace(std::make_pair(cx, cy), tiles);
+        }
+    }
+}
+
+// 世界の端をまたぐ矩形を含めて、Move と Overlaps を参照実装と比べる。食い違いの数を返す
+size_t CheckAgainstReference(const IntWorld& world, const CollisionMap& map, int count, std::mt19937& random) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto solid = [&world](int x, int y) { return world.SolidChunked(x, y); };
+    size_t mismatches = 0;
+    for (int i = 0; i < count; ++i) {
+        TileBox box{ unit(random) * static_cast<float>(world.width + 40) - 20.0f,
+            unit(random) * static_cast<float>(world.height + 40) - 20.0f,
+            0.3f + unit(random) * 3.0f, 0.3f + unit(random) * 3.0f };
+        float speed = i % 10 == 0 ? 20.0f : 1.5f;
+        float dx = (unit(random) * 2.0f - 1.0f) * speed;
+        float dy = (unit(random) * 2.0f - 1.0f) * speed;
+        // 3回に1回は整数の位置・大きさ・移動量（タイルの辺にちょうど接する）
+        if (i % 3 == 0) {
+            box = { std::floor(box.x), std::floor(box.y), std::ceil(box.width), std::ceil(box.height) };
+            dx = std::round(dx);
+            dy = std::round(dy);
+        }
+        TileMove actual = map.Move(box, dx, dy, TileClass::Solid);
+        TileMove expected = ReferenceMove(box, dx, dy, solid);
+        bool overlaps = false;
+        for (int y = FirstTile(box.y); y <= LastTile(box.y + box.height) && !overlaps; ++y) {
+            for (int x = FirstTile(box.x); x <= LastTile(box.x + box.width) && !overlaps; ++x) overlaps = solid(x, y);
+        }
+        bool moveDiffers = actual.dx != expected.dx || actual.dy != expected.dy
+            || actual.hitX != expected.hitX || actual.hitY != expected.hitY;
+        if (moveDiffers || map.Overlaps(box, TileClass::Solid) != overlaps) {
+            if (mismatches++ < 5) {
+                std::printf("  mismatch: box (%g, %g, %g, %g) move (%g, %g) -> (%g, %g), reference (%g, %g)\n",
+                    box.x, box.y, box.width, box.height, dx, dy, actual.dx, actual.dy, expected.dx, expected.dy);
+            }
+        }
+    }
+    return mismatches;
+}
+
+} // namespace
+
+int RunCollisionBench(const BenchArgs& args) {
+    int worldSize = args.Int("world", 1000);
+    int entityCount = args.Int("entities", 10000);
+    int frames = std::max(1, args.Int("frames", 200));
+    int checks = args.Int("checks", 2000000);
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    IntWorld world;
+    world.width = worldSize;
+    world.height = worldSize;
+    CollisionMap map;
+
+    std::printf("collision: %dx%d world, %d entities, %d frames\n", worldSize, worldSize, entityCount, frames);
+    size_t bad = 0;
+    BuildWorld(world, map, 0.15, random);
+    for (bool unloadedSolid : { false, true }) {
+        world.unloadedSolid = unloadedSolid;
+        map.SetUnloadedSolid(unloadedSolid);
+        size_t mismatches = CheckAgainstReference(world, map, checks, random);
+        std::printf("reference check (unloaded %s): %d moves, %zu mismatches\n",
+            unloadedSolid ? "solid" : "passable", checks, mismatches);
+        bad += mismatches;
+    }
+    world.unloadedSolid = false;
+    map.SetUnloadedSolid(false);
+
+    std::printf("%-8s %5s %6s %10s %10s %12s\n", "density", "size", "speed", "bitset", "chunk map", "flat vector");
+    for (double density : { 0.15, 0.02 }) {
+        BuildWorld(world, map, density, random);
+        for (float speed : { 1.0f, 16.0f }) {
+            for (float size : { 1.0f, 2.5f, 8.0f }) {
+                std::vector<TileBox> entities(static_cast<size_t>(entityCount));
+                std::vector<float> velocityX(entities.size());
+                std::vector<float> velocityY(entities.size());
+                float span = static_cast<float>(worldSize - 10);
+                for (size_t i = 0; i < entities.size(); ++i) {
+                    entities[i] = { unit(random) * span + 5.0f, unit(random) * span + 5.0f,
+                        size * (0.6f + 0.4f * unit(random)), size * (0.6f + 0.4f * unit(random)) };
+                    velocityX[i] = (unit(random) * 2.0f - 1.0f) * speed;
+                    velocityY[i] = (unit(random) * 2.0f - 1.0f) * speed;
+                }
+                // 同じ初期状態から frames フレーム動かし、1フレームあたりのミリ秒を返す
+                // 3つの方式のぶつかった回数が揃うことも確かめる
+                auto run = [&](auto move, uint64_t& hits) {
+                    std::vector<TileBox> boxes = entities;
+                    hits = 0;
+                    auto begin = std::chrono::steady_clock::now();
+                    for (int frame = 0; frame < frames; ++frame) {
+                        for (size_t i = 0; i < boxes.size(); ++i) {
+                            TileMove result = move(boxes[i], velocityX[i], velocityY[i]);
+                            boxes[i].x += result.dx;
+                            boxes[i].y += result.dy;
+                            hits += static_cast<uint64_t>(result.hitX) + static_cast<uint64_t>(result.hitY);
+                        }
+                    }
+                    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / frames;
+                };
+                uint64_t bitsetHits = 0;
+                uint64_t chunkHits = 0;
+                uint64_t gridHits = 0;
+                double bitsetMs = run([&map](const TileBox& box, float dx, float dy) {
+                    return map.Move(box, dx, dy, TileClass::Solid);
+                }, bitsetHits);
+                double chunkMs = run([&world](const TileBox& box, float dx, float dy) {
+                    return ReferenceMove(box, dx, dy, [&world](int x, int y) { return world.SolidChunked(x, y); });
+                }, chunkHits);
+                double gridMs = run([&world](const TileBox& box, float dx, float dy) {
+                    return ReferenceMove(box, dx, dy, [&world](int x, int y) { return world.SolidGrid(x, y); });
+                }, gridHits);
+                std::printf("%7.0f%% %5.1f %6.0f %7.2f ms %7.2f ms %9.2f ms%s\n", density * 100.0, size, speed,
+                    bitsetMs, chunkMs, gridMs, bitsetHits == chunkHits && chunkHits == gridHits ? "" : "  (hit counts differ)");
+                if (bitsetHits != chunkHits || chunkHits != gridHits) ++bad;
+            }
+        }
+    }
+    return bad == 0 ? 0 : 1;
+}
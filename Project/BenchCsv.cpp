@@ -0,0 +1,191 @@
+#include "Bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "CsvTileParser.h"
+#include "SheetValuesParser.h"
+
+// シート全体の一括取り込みの比較
+// 同じグリッドを values API の JSON（行ごとに解析してチャンクに切り分ける）と CSV エクスポート（CsvTileParser の各実装）で読む
+// 受信と同じく piece バイトずつ渡し、reps 回のうち最速の時間を書く
+// 結果のチャンクは、1チャンクずつ values API で取ったときの形（チャンク内で行末の空セルと末尾の空行を省く）と照合する
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using ChunkMap = std::unordered_map<std::pair<int, int>, TileData, PairHash>;
+
+// セルの文字列（空のセルは ""）
+using Grid = std::vector<std::vector<std::string>>;
+
+Grid MakeGrid(int width, int height, int emptyPercent) {
+    std::mt19937 random(1);
+    Grid grid(static_cast<size_t>(height), std::vector<std::string>(static_cast<size_t>(width)));
+    for (auto& row : grid) {
+        for (auto& cell : row) {
+            uint32_t value = static_cast<uint32_t>(random() % 100);
+            // 0 は空のセルとして数えるので、値は 1〜3（"0" のセルは values API では幅に含まれる）
+            if (value >= static_cast<uint32_t>(emptyPercent)) cell = std::to_string(value % 3 + 1);
+        }
+    }
+    return grid;
+}
+
+std::string ToCsv(const Grid& grid) {
+    std::string csv;
+    for (const auto& row : grid) {
+        for (size_t x = 0; x < row.size(); ++x) {
+            if (x > 0) csv += ',';
+            csv += row[x];
+        }
+        csv += "\r\n";
+    }
+    return csv;
+}
+
+// values API のレスポンス（行末の空セルは省かれる）
+std::string ToValuesJson(const Grid& grid) {
+    json values = json::array();
+    for (const auto& row : grid) {
+        size_t width = row.size();
+        while (width > 0 && row[width - 1].empty()) --width;
+        values.push_back(std::vector<std::string>(row.begin(), row.begin() + static_cast<std::ptrdiff_t>(width)));
+    }
+    return json{ { "range", "TR1_02!A1" }, { "majorDimension", "ROWS" }, { "values", std::move(values) } }.dump(2);
+}
+
+// 行の並び（行末の空セルは省かれている）をチャンクに切り分ける
+ChunkMap SplitRows(const TileData& rows, int width, int height) {
+    ChunkMap chunks;
+    for (int cy = 0; cy * ChunkTiles::kHeight < height; ++cy) {
+        for (int cx = 0; cx * ChunkTiles::kWidth < width; ++cx) {
+            TileData chunk;
+            for (int y = cy * ChunkTiles::kHeight; y < std::min(height, (cy + 1) * ChunkTiles::kHeight); ++y) {
+                const std::vector<int>& row = rows[static_cast<size_t>(y)];
+                std::vector<int> cells;
+                for (int x = cx * ChunkTiles::kWidth; x < std::min(static_cast<int>(row.size()), (cx + 1) * ChunkTiles::kWidth); ++x) {
+                    cells.push_back(row[static_cast<size_t>(x)]);
+                }
+                // 行の途中の空セルが、チャンクの右端では行末になる
+                while (!cells.empty() && cells.back() == 0) cells.pop_back();
+                chunk.push_back(std::move(cells));
+            }
+            while (!chunk.empty() && chunk.back().empty()) chunk.pop_back();
+            chunks[{ cx, cy }] = std::move(chunk);
+        }
+    }
+    return chunks;
+}
+
+ChunkMap ExpectedChunks(const Grid& grid, int width, int height) {
+    TileData rows;
+    for (const auto& row : grid) {
+        std::vector<int> cells;
+        for (const auto& cell : row) cells.push_back(cell.empty() ? 0 : std::stoi(cell));
+        rows.push_back(std::move(cells));
+    }
+    return SplitRows(rows, width, height);
+}
+
+size_t CountMismatches(const ChunkMap& actual, const ChunkMap& expected) {
+    size_t mismatches = 0;
+    for (const auto& kv : expected) {
+        auto found = actual.find(kv.first);
+        if (found == actual.end() || found->second != kv.second) ++mismatches;
+    }
+    return mismatches + (actual.size() > expected.size() ? actual.size() - expected.size() : 0);
+}
+
+void PrintRow(const char* name, size_t bytes, double cells, double seconds, size_t chunks, size_t mismatches) {
+    std::printf("%-12s %8.2f %9.1f %10.1f %8.2f %8zu %10zu\n", name, static_cast<double>(bytes) / 1e6,
+        static_cast<double>(bytes) / 1e6 / seconds, cells / 1e6 / seconds, seconds * 1e3, chunks, mismatches);
+}
+
+} // namespace
+
+int RunCsvBench(const BenchArgs& args) {
+    int width = args.Int("width", 1000);
+    int height = args.Int("height", 1000);
+    int emptyPercent = args.Int("empty-percent", 10);
+    int reps = std::max(1, args.Int("reps", 5));
+    size_t piece = static_cast<size_t>(std::max(1, args.Int("piece", 16 * 1024)));
+    std::filesystem::path cacheDir = std::filesystem::path(args.String("cache", "bench_cache")) / "csv";
+
+    Grid grid = MakeGrid(width, height, emptyPercent);
+    std::string csv = ToCsv(grid);
+    std::string values = ToValuesJson(grid);
+    ChunkMap expected = ExpectedChunks(grid, width, height);
+    double cells = static_cast<double>(width) * static_cast<double>(height);
+    std::printf("csv: %dx%d cells, %d%% empty, fed in %zu-byte pieces, best of %d\n", width, height, emptyPercent, piece, reps);
+    std::printf("%-12s %8s %9s %10s %8s %8s %10s\n", "parser", "MB", "MB/s", "Mcells/s", "ms", "chunks", "mismatches");
+    size_t bad = 0;
+
+    // values API の JSON を行ごとに受け取り、チャンクに切り分ける
+    {
+        double best = 1e9;
+        ChunkMap chunks;
+        for (int rep = 0; rep < reps; ++rep) {
+            auto begin = Clock::now();
+            TileData rows;
+            SheetValuesParser parser([&rows](int, std::vector<int>&& row) { rows.push_back(std::move(row)); });
+            for (size_t i = 0; i < values.size(); i += piece) parser.Feed(values.data() + i, std::min(piece, values.size() - i));
+            chunks = SplitRows(rows, width, height);
+            best = std::min(best, std::chrono::duration<double>(Clock::now() - begin).count());
+        }
+        size_t mismatches = CountMismatches(chunks, expected);
+        PrintRow("json", values.size(), cells, best, chunks.size(), mismatches);
+        bad += mismatches;
+    }
+
+    for (CsvScanner scanner : { CsvScanner::Scalar, CsvScanner::Sse2, CsvScanner::Avx2 }) {
+        double best = 1e9;
+        std::vector<std::pair<std::pair<int, int>, ChunkTiles>> out;
+        std::string name;
+        for (int rep = 0; rep < reps; ++rep) {
+            out.clear();
+            out.reserve(expected.size());
+            auto begin = Clock::now();
+            CsvTileParser parser([&out](int cx, int cy, ChunkTiles&& tiles) {
+                out.emplace_back(std::make_pair(cx, cy), std::move(tiles));
+            }, ',', scanner);
+            for (size_t i = 0; i < csv.size(); i += piece) parser.Feed(csv.data() + i, std::min(piece, csv.size() - i));
+            parser.Finish();
+            best = std::min(best, std::chrono::duration<double>(Clock::now() - begin).count());
+            name = std::string("csv ") + parser.ScannerName();
+        }
+        // CPU が AVX2 に対応していなければ "csv sse2" が2行になる
+        ChunkMap chunks;
+        for (const auto& kv : out) chunks[kv.first] = kv.second.ToTileData();
+        size_t mismatches = CountMismatches(chunks, expected);
+        PrintRow(name.c_str(), csv.size(), cells, best, chunks.size(), mismatches);
+        bad += mismatches;
+    }
+
+    // ファイルからの取り込み（全チャンクのキャッシュとマニフェストの書き込みを含む）
+    std::error_code ec;
+    std::filesystem::remove_all(cacheDir, ec);
+    std::filesystem::create_directories(cacheDir, ec);
+    std::filesystem::path csvPath = cacheDir / "grid.csv";
+    {
+        std::ofstream ofs(csvPath, std::ios::binary);
+        ofs.write(csv.data(), static_cast<std::streamsize>(csv.size()));
+    }
+    ChunkLoader loader("bench", "TR1_02", "", (cacheDir / "cache").string());
+    auto begin = Clock::now();
+    std::optional<size_t> imported = loader.ImportCsvFile(csvPath);
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    size_t mismatches = 0;
+    ChunkTiles tiles;
+    for (const auto& kv : expected) {
+        if (!loader.LoadChunkCache(kv.first.first, kv.first.second, tiles) || tiles.ToTileData() != kv.second) ++mismatches;
+    }
+    std::printf("ImportCsvFile: %zu chunks in %.2f s (cache files written), %zu cache mismatches\n",
+        imported.value_or(0), seconds, mismatches);
+    bad += mismatches + (imported ? 0 : 1);
+    return bad == 0 ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+#include "Bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "MockSheetServer.h"
+#include "TileEditor.h"
+
+// タイル編集の書き戻しのコスト
+// 同じプロセスのモックを上流にし、TileEditor に edits 回の編集を記録してから Flush で1回の書き戻しを送る
+//   random small:  120x120 タイルの範囲にランダムに
+//   random large:  1000x1000 タイルの範囲にランダムに
+//   brushes:       10x10 のブラシを edits / 100 回、1000x1000 の範囲に
+// 各編集は手元のモデルの値を編集前の値とし、同じ値への編集は数えない（ゲームの SetTile と同じ）
+// 書き戻しごとに、送ったセル数・矩形の数・リクエスト数・書き戻しの時間と記録にかかった時間を書き、モックのセルをモデルと照合する
+// 最後に、書き戻しの前にモックの側で3セルを書き換えた競合と、モックが 503 を多く返す場合を試す
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double Ms(Clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+struct Workload {
+    const char* name;
+    int area;  // 0..area-1 の正方形に編集する
+    int brush; // 1 ならセル単位
+};
+
+// モックと、書き込み先をモックに向けた TileEditor
+class EditRig {
+public:
+    EditRig(const MockSheetOptions& options, const std::filesystem::path& cacheDir)
+        : mock_(options), loader_("mock", "TR1_02", "bench-key", cacheDir.string()) {
+        started_ = mock_.Start();
+        loader_.SetApiBaseUrl(mock_.BaseUrl());
+        loader_.SetRevisionUrl(mock_.RevisionUrl());
+        loader_.SetRequestQuota(1e6, 1e6);
+        loader_.Initialize();
+        editor_ = std::make_unique<TileEditor>(loader_, std::filesystem::path());
+    }
+    ~EditRig() {
+        editor_.reset();
+        mock_.Stop();
+    }
+
+    bool Started() const { return started_; }
+    MockSheetServer& Mock() { return mock_; }
+    TileEditor& Editor() { return *editor_; }
+
+    // モデルの値を編集前の値にして記録する。同じ値なら記録しない
+    void Edit(int x, int y, int tile) {
+        auto [it, inserted] = model_.try_emplace({ x, y }, 0);
+        if (inserted) it->second = mock_.Cell(x, y);
+        if (it->second == tile) return;
+        editor_->Record(0, x, y, it->second, tile);
+        it->second = tile;
+    }
+
+    // モデルとモックのセルが違う数
+    size_t Mismatches() const {
+        size_t mismatches = 0;
+        for (const auto& [cell, tile] : model_) {
+            if (mock_.Cell(cell.first, cell.second) != tile) ++mismatches;
+        }
+        return mismatches;
+    }
+
+    const std::unordered_map<std::pair<int, int>, int, PairHash>& Model() const { return model_; }
+
+private:
+    MockSheetServer mock_;
+    ChunkLoader loader_;
+    std::unique_ptr<TileEditor> editor_;
+    std::unordered_map<std::pair<int, int>, int, PairHash> model_;
+    bool started_ = false;
+};
+
+} // namespace
+
+int RunEditsBench(const BenchArgs& args) {
+    int editCount = std::max(100, args.Int("edits", 10000));
+    int latencyMs = args.Int("latency-ms", 0);
+    std::filesystem::path cacheDir = std::filesystem::path(args.String("cache", "bench_cache")) / "edits";
+    std::error_code ec;
+    std::filesystem::remove_all(cacheDir, ec);
+    std::mt19937 random(49);
+    std::uniform_int_distribution<int> tileValue(0, 3);
+
+    std::printf("edits: %d edits per run, mock latency %d ms\n", editCount, latencyMs);
+    std::printf("%-14s %7s %7s %9s %10s %10s %10s\n", "workload", "cells", "rects", "requests", "flush ms", "record ms",
+        "mismatches");
+    MockSheetOptions mockOptions;
+    mockOptions.latencyMs = latencyMs;
+    size_t bad = 0;
+    const Workload workloads[] = {
+        { "random small", 120, 1 },
+        { "random large", 1000, 1 },
+        { "brushes", 1000, 10 },
+    };
+    for (const Workload& workload : workloads) {
+        EditRig rig(mockOptions, cacheDir);
+        if (!rig.Started()) {
+            std::fprintf(stderr, "cannot start the mock upstream\n");
+            return 1;
+        }
+        std::uniform_int_distribution<int> coord(0, workload.area - workload.brush);
+        auto begin = Clock::now();
+        for (int i = 0; i < editCount; i += workload.brush * workload.brush) {
+            int x0 = coord(random);
+            int y0 = coord(random);
+            int tile = tileValue(random);
+            for (int y = 0; y < workload.brush; ++y) {
+                for (int x = 0; x < workload.brush; ++x) rig.Edit(x0 + x, y0 + y, tile);
+            }
+        }
+        double recordMs = Ms(begin);
+        rig.Editor().Flush();
+        bool idle = rig.Editor().WaitIdle(std::chrono::seconds(60));
+        TileEditor::Stats stats = rig.Editor().GetStats();
+        size_t mismatches = idle ? rig.Mismatches() : rig.Model().size();
+        std::printf("%-14s %7llu %7llu %9llu %10.1f %10.2f %10zu\n", workload.name,
+            static_cast<unsigned long long>(stats.cellsWritten), static_cast<unsigned long long>(stats.blocksWritten),
+            static_cast<unsigned long long>(stats.requests), stats.lastFlushMs, recordMs, mismatches);
+        bad += mismatches + stats.failures;
+    }
+
+    // 書き戻しの前に、モックの側で3セルを他の値にする（シートの値が残り、競合として返る）
+    {
+        EditRig rig(mockOptions, cacheDir);
+        if (!rig.Started()) return 1;
+        for (int i = 0; i < 100; ++i) rig.Edit(i, 0, i % 3 + 1);
+        std::vector<std::pair<int, int>> remote = { { 10, 0 }, { 50, 0 }, { 90, 0 } };
+        for (const auto& [x, y] : remote) rig.Mock().SetCell(x, y, 7);
+        rig.Editor().Flush();
+        rig.Editor().WaitIdle(std::chrono::seconds(60));
+        std::vector<TileEditConflict> conflicts = rig.Editor().TakeConflicts();
+        size_t kept = 0;
+        for (const auto& [x, y] : remote) {
+            if (rig.Mock().Cell(x, y) == 7) ++kept;
+        }
+        std::printf("conflicts: %zu reported for 3 remote edits, %zu remote values kept, %llu cells written\n",
+            conflicts.size(), kept, static_cast<unsigned long long>(rig.Editor().GetStats().cellsWritten));
+        if (conflicts.size() != remote.size() || kept != remote.size()) ++bad;
+    }
+
+    // 503 が多い上流（ChunkLoader の再試行と、再試行切れなら kRetryDelay 後の書き戻しで終える）
+    {
+        MockSheetOptions flaky = mockOptions;
+        flaky.errorRate = args.Double("error-rate", 0.6);
+        EditRig rig(flaky, cacheDir);
+        if (!rig.Started()) return 1;
+        constexpr int kRounds = 10;
+        bool idle = true;
+        auto begin = Clock::now();
+        for (int round = 0; round < kRounds && idle; ++round) {
+            for (int i = 0; i < 100; ++i) rig.Edit(i % 10, round * 10 + i / 10, (round + i) % 3 + 1);
+            rig.Editor().Flush();
+            idle = rig.Editor().WaitIdle(std::chrono::seconds(60));
+        }
+        double flushMs = Ms(begin) / kRounds;
+        TileEditor::Stats stats = rig.Editor().GetStats();
+        MockSheetServer::Stats mockStats = rig.Mock().GetStats();
+        size_t mismatches = idle ? rig.Mismatches() : rig.Model().size();
+        std::printf("503 rate %.2f: %d flushes, %llu requests answered, %llu 503s, %llu failed flushes, %.0f ms per flush, "
+            "%zu mismatches\n", flaky.errorRate, kRounds, static_cast<unsigned long long>(mockStats.served),
+            static_cast<unsigned long long>(mockStats.failed), static_cast<unsigned long long>(stats.failures), flushMs,
+            mismatches);
+        bad += mismatches;
+    }
+    return bad == 0 ? 0 : 1;
+}
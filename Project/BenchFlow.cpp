@@ -0,0 +1,214 @@
+#include "Bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+#include "FlowField.h"
+
+// 流れ場の計算時間とメモリ
+// 壁の帯とランダムな壁の世界を CollisionMap に読み込み、目的地を変えたときの全体の計算、
+// チャンク1つ・多数の解放と読み直しの差分計算、1フレームあたりのエージェントの移動（向きを引いて CollisionMap::Move）を測る
+// 各段階の後で、範囲全体のダイクストラ（参照実装）と距離・届くかどうか・向きが最短経路に乗っているかを照合する
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kDiagonalCost = 1.4142135623730951;
+constexpr double kUnreached = std::numeric_limits<double>::infinity();
+// float で積み上げた距離と double の参照実装の差の許容
+constexpr double kDistanceTolerance = 1.0 / 64.0;
+
+double Ms(Clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+bool Wall(int x, int y, double noise, std::mt19937& random, std::uniform_real_distribution<double>& unit) {
+    // 50 タイルごとの壁の帯に、40 タイルごとに 4 タイルの隙間
+    bool band = (y % 50 == 25 && x % 40 >= 4) || (x % 50 == 25 && y % 40 >= 4);
+    return band || unit(random) < noise;
+}
+
+// grid の範囲で、目的地からのダイクストラ（読み込み前のチャンクは通れない）
+std::vector<double> ReferenceField(const PathGrid& grid, int goalX, int goalY) {
+    int width = grid.Width();
+    int height = grid.Height();
+    std::vector<double> distance(static_cast<size_t>(width) * static_cast<size_t>(height), kUnreached);
+    auto index = [width](int x, int y) { return static_cast<size_t>(y) * static_cast<size_t>(width) + static_cast<size_t>(x); };
+    if (grid.Blocked(goalX, goalY)) return distance;
+    using Entry = std::pair<double, size_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    distance[index(goalX, goalY)] = 0.0;
+    open.push({ 0.0, index(goalX, goalY) });
+    while (!open.empty()) {
+        auto [d, current] = open.top();
+        open.pop();
+        if (d > distance[current]) continue;
+        int x = static_cast<int>(current % static_cast<size_t>(width));
+        int y = static_cast<int>(current / static_cast<size_t>(width));
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                int nx = x + dx;
+                int ny = y + dy;
+                if ((dx == 0 && dy == 0) || !grid.Contains(nx, ny) || grid.Blocked(nx, ny)) continue;
+                if (dx != 0 && dy != 0 && (grid.Blocked(x + dx, y) || grid.Blocked(x, y + dy))) continue;
+                double next = d + (dx != 0 && dy != 0 ? kDiagonalCost : 1.0);
+                if (next >= distance[index(nx, ny)]) continue;
+                distance[index(nx, ny)] = next;
+                open.push({ next, index(nx, ny) });
+            }
+        }
+    }
+    return distance;
+}
+
+// 流れ場を参照実装と照合し、食い違ったタイルの数を返す
+size_t CheckField(const FlowField& field, const CollisionMap& map, int size, int goalX, int goalY, double* referenceMs) {
+    PathGrid grid(map, 0, 0, size, size, UnloadedTiles::Blocked);
+    auto begin = Clock::now();
+    std::vector<double> expected = ReferenceField(grid, goalX, goalY);
+    if (referenceMs) *referenceMs = Ms(begin);
+    size_t mismatches = 0;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            double want = expected[static_cast<size_t>(y) * static_cast<size_t>(size) + static_cast<size_t>(x)];
+            double got = field.Distance(x, y);
+            bool bad = std::isinf(want) != std::isinf(got) || (!std::isinf(want) && std::abs(got - want) > kDistanceTolerance);
+            // 向きは1歩の費用の分だけ距離が下がるタイルを指す
+            auto [dx, dy] = field.Direction(x, y);
+            if (!bad && !std::isinf(want) && want > 0.0) {
+                double step = dx != 0 && dy != 0 ? kDiagonalCost : 1.0;
+                bad = (dx == 0 && dy == 0) || std::abs(field.Distance(x + dx, y + dy) + step - got) > kDistanceTolerance;
+            }
+            if (bad) ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+} // namespace
+
+int RunFlowBench(const BenchArgs& args) {
+    int size = args.Int("area", 516);
+    double noise = args.Double("noise", 0.15);
+    int threads = args.Int("threads", 0);
+    int frames = std::max(1, args.Int("frames", 100));
+    std::mt19937 random(45);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    // 世界（範囲の外のチャンクは読み込まない）
+    int chunks = (size + ChunkTiles::kWidth - 1) / ChunkTiles::kWidth;
+    std::vector<ChunkOccupancy> occupancy(static_cast<size_t>(chunks) * static_cast<size_t>(chunks));
+    CollisionMap map;
+    TileClassifier classifier;
+    for (int cy = 0; cy < chunks; ++cy) {
+        for (int cx = 0; cx < chunks; ++cx) {
+            ChunkTiles tiles;
+            tiles.rowCount = ChunkTiles::kHeight;
+            for (int y = 0; y < ChunkTiles::kHeight; ++y) {
+                tiles.rowWidths[static_cast<size_t>(y)] = static_cast<uint8_t>(ChunkTiles::kWidth);
+                for (int x = 0; x < ChunkTiles::kWidth; ++x) {
+                    tiles.cells[static_cast<size_t>(y * ChunkTiles::kWidth + x)] =
+                        Wall(cx * ChunkTiles::kWidth + x, cy * ChunkTiles::kHeight + y, noise, random, unit) ? 1 : 0;
+                }
+            }
+            ChunkOccupancy& chunk = occupancy[static_cast<size_t>(cy) * static_cast<size_t>(chunks) + static_cast<size_t>(cx)];
+            chunk = classifier.Build(tiles);
+            map.Set(cx, cy, chunk);
+        }
+    }
+    auto reload = [&](int cx, int cy) {
+        map.Set(cx, cy, occupancy[static_cast<size_t>(cy) * static_cast<size_t>(chunks) + static_cast<size_t>(cx)]);
+    };
+
+    WorkStealingPool pool(threads);
+    FlowField field(map, pool);
+    field.SetArea(0, 0, size, size);
+    int goalX = size / 2;
+    int goalY = size / 2;
+    while (map.AnyInRect(goalX, goalY, goalX, goalY, TileClass::Solid)) ++goalX;
+
+    std::printf("flow: %dx%d tiles, %.0f%% noise + wall bands, %d threads (Wait() helps), %u hardware threads\n",
+        size, size, noise * 100.0, pool.Concurrency(), std::thread::hardware_concurrency());
+    std::printf("%-28s %9s %11s %12s %10s\n", "step", "ms", "block runs", "tiles reset", "mismatches");
+    size_t bad = 0;
+    auto report = [&](const char* step) {
+        const FlowField::Stats& stats = field.GetStats();
+        size_t mismatches = CheckField(field, map, size, goalX, goalY, nullptr);
+        std::printf("%-28s %9.2f %11zu %12zu %10zu\n", step, stats.updateMs, stats.blockRuns, stats.resetTiles, mismatches);
+        bad += mismatches;
+    };
+
+    field.SetGoal(goalX, goalY);
+    field.Update();
+    report("full build (goal set)");
+    double referenceMs = 0.0;
+    CheckField(field, map, size, goalX, goalY, &referenceMs);
+
+    // 目的地の近くのチャンク1つ
+    int nearX = goalX / ChunkTiles::kWidth + 3;
+    int nearY = goalY / ChunkTiles::kHeight;
+    map.Erase(nearX, nearY);
+    field.OnChunkChanged(nearX, nearY);
+    field.Update();
+    report("1 chunk unloaded");
+    reload(nearX, nearY);
+    field.OnChunkChanged(nearX, nearY);
+    field.Update();
+    report("1 chunk reloaded");
+
+    // 1割のチャンクをまとめて
+    std::vector<std::pair<int, int>> dropped;
+    for (int cy = 0; cy < chunks; ++cy) {
+        for (int cx = 0; cx < chunks; ++cx) {
+            bool goalChunk = cx == goalX / ChunkTiles::kWidth && cy == goalY / ChunkTiles::kHeight;
+            if (!goalChunk && unit(random) < 0.1) dropped.emplace_back(cx, cy);
+        }
+    }
+    for (const auto& [cx, cy] : dropped) {
+        map.Erase(cx, cy);
+        field.OnChunkChanged(cx, cy);
+    }
+    field.Update();
+    char label[64];
+    std::snprintf(label, sizeof(label), "%zu chunks unloaded", dropped.size());
+    report(label);
+    for (const auto& [cx, cy] : dropped) {
+        reload(cx, cy);
+        field.OnChunkChanged(cx, cy);
+    }
+    field.Update();
+    std::snprintf(label, sizeof(label), "%zu chunks reloaded", dropped.size());
+    report(label);
+
+    std::printf("reference Dijkstra over the area (1 thread): %.2f ms\n", referenceMs);
+    std::printf("flow field memory: %.2f MB\n", static_cast<double>(field.GetStats().bytes) / (1024.0 * 1024.0));
+
+    // エージェント: 自分のタイルの向きに進み、壁の手前で止まる
+    std::printf("%-10s %12s\n", "agents", "ms/frame");
+    for (int agentCount : { 1000, 5000, 20000 }) {
+        std::vector<TileBox> agents;
+        std::uniform_int_distribution<int> coord(0, size - 1);
+        while (static_cast<int>(agents.size()) < agentCount) {
+            int x = coord(random);
+            int y = coord(random);
+            if (!std::isinf(field.Distance(x, y))) agents.push_back({ static_cast<float>(x) + 0.2f, static_cast<float>(y) + 0.2f, 0.6f, 0.6f });
+        }
+        auto begin = Clock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            for (TileBox& agent : agents) {
+                auto [dx, dy] = field.Direction(static_cast<int>(agent.x + agent.width * 0.5f), static_cast<int>(agent.y + agent.height * 0.5f));
+                TileMove move = map.Move(agent, static_cast<float>(dx) * 0.25f, static_cast<float>(dy) * 0.25f, TileClass::Solid);
+                agent.x += move.dx;
+                agent.y += move.dy;
+            }
+        }
+        std::printf("%-10d %12.3f\n", agentCount, Ms(begin) / frames);
+    }
+    return bad == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+#include "Bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+#include <curl/curl.h>
+#include "MockSheetServer.h"
+#include "TileGateway.h"
+
+// タイルゲートウェイの負荷試験
+// 各クライアントは keep-alive の接続を1本持ち、area × area チャンクの中を1歩ずつ歩いて、
+// まだ取っていない周り 3x3 のチャンクをゲートウェイから取得する。取得した値はモックの値と照合する
+//   cold:    空のキャッシュから（上流への取得はチャンクごとに1回になるはず）
+//   hot:     同じゲートウェイに同じ歩き方でもう一度（ホットセットだけで答える）
+//   restart: ゲートウェイを作り直し、2倍のクライアントで（前半は cold と同じ歩き方なのでディスクキャッシュで答える）
+
+namespace {
+
+struct PhaseResult {
+    size_t requests = 0;
+    size_t failures = 0;   // 200 以外、または通信エラー
+    size_t mismatches = 0; // 値がモックと違う
+    double seconds = 0.0;
+    std::vector<double> latencies;
+    std::set<std::pair<int, int>> chunks; // 取得したチャンク
+};
+
+size_t AppendBody(void* contents, size_t size, size_t nmemb, void* userp) {
+    static_cast<std::string*>(userp)->append(static_cast<const char*>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+// レスポンスの values をモックの値と比べる（空のセルは 0）
+bool MatchesMock(const std::string& body, int cx, int cy) {
+    json j = json::parse(body, nullptr, false);
+    if (!j.is_object()) return false;
+    TileData rows;
+    if (j.contains("values")) {
+        for (const json& row : j["values"]) {
+            std::vector<int> cells;
+            for (const json& cell : row) {
+                if (!cell.is_string()) return false;
+                const std::string& text = cell.get_ref<const std::string&>();
+                cells.push_back(text.empty() ? 0 : std::stoi(text));
+            }
+            rows.push_back(std::move(cells));
+        }
+    }
+    return rows == MockSheetServer::ExpectedChunk(cx, cy);
+}
+
+void RunClient(const std::string& urlPrefix, int seed, int steps, int area, PhaseResult& result) {
+    CURL* easy = curl_easy_init();
+    std::string body;
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, AppendBody);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &body);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_NODELAY, 1L);
+    std::mt19937 random(static_cast<uint32_t>(seed));
+    std::uniform_int_distribution<int> start(0, area - 1);
+    std::uniform_int_distribution<int> step(-1, 1);
+    int x = start(random);
+    int y = start(random);
+    for (int s = 0; s < steps; ++s) {
+        x = std::clamp(x + step(random), 0, area - 1);
+        y = std::clamp(y + step(random), 0, area - 1);
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                int cx = x + dx;
+                int cy = y + dy;
+                if (cx < 0 || cy < 0 || !result.chunks.insert({ cx, cy }).second) continue;
+                std::string range = "TR1_02!" + ChunkLoader::ColIndexToName(cx * ChunkLoader::kChunkWidth)
+                    + std::to_string(cy * ChunkLoader::kChunkHeight + 1) + ":"
+                    + ChunkLoader::ColIndexToName(cx * ChunkLoader::kChunkWidth + ChunkLoader::kChunkWidth - 1)
+                    + std::to_string(cy * ChunkLoader::kChunkHeight + ChunkLoader::kChunkHeight);
+                std::string url = urlPrefix + range;
+                curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+                body.clear();
+                auto begin = std::chrono::steady_clock::now();
+                CURLcode code = curl_easy_perform(easy);
+                result.latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+                ++result.requests;
+                long status = 0;
+                curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+                if (code != CURLE_OK || status != 200) ++result.failures;
+                else if (!MatchesMock(body, cx, cy)) ++result.mismatches;
+            }
+        }
+    }
+    curl_easy_cleanup(easy);
+}
+
+PhaseResult RunClients(uint16_t port, int clients, int seedBase, int steps, int area) {
+    std::string urlPrefix = "http://127.0.0.1:" + std::to_string(port) + "/v4/spreadsheets/mock/values/";
+    std::vector<PhaseResult> results(static_cast<size_t>(clients));
+    std::vector<std::thread> threads;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < clients; ++i) {
+        threads.emplace_back([&, i]() { RunClient(urlPrefix, seedBase + i, steps, area, results[static_cast<size_t>(i)]); });
+    }
+    for (std::thread& thread : threads) thread.join();
+    PhaseResult total;
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    for (PhaseResult& result : results) {
+        total.requests += result.requests;
+        total.failures += result.failures;
+        total.mismatches += result.mismatches;
+        total.latencies.insert(total.latencies.end(), result.latencies.begin(), result.latencies.end());
+        total.chunks.insert(result.chunks.begin(), result.chunks.end());
+    }
+    std::sort(total.latencies.begin(), total.latencies.end());
+    return total;
+}
+
+double Percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size())));
+    return sorted[index];
+}
+
+struct GatewayRun {
+    int clients = 0;
+    int seedBase = 0;
+    int repeats = 1; // 同じゲートウェイで続けて走らせる回数（2回目以降はホットセット）
+};
+
+// ゲートウェイを立ててクライアントを走らせ、フェーズごとに1行書く。fetched はこれまでに取得したチャンク
+// new は今回初めて取得したチャンクの数。上流への取得はチャンクごとに1回なので upstream と同じになるはず（503 は取得の中で再試行する）
+size_t RunGateway(const char* const* names, const GatewayRun& run, const std::string& cacheDir, MockSheetServer& mock,
+    double upstreamRate, int steps, int area, std::set<std::pair<int, int>>& fetched) {
+    ChunkLoader loader("mock", "TR1_02", "bench-key", cacheDir);
+    loader.SetApiBaseUrl(mock.BaseUrl());
+    loader.SetRevisionUrl(mock.RevisionUrl());
+    loader.SetRequestQuota(upstreamRate, upstreamRate);
+    loader.Initialize();
+    TileGatewayOptions options;
+    options.port = 0;
+    options.maxConnections = std::max(1024, run.clients * 2);
+    options.revisionCheckIntervalSec = 3600;
+    TileGateway gateway(loader, options);
+    if (!gateway.Start()) {
+        std::fprintf(stderr, "cannot start the gateway\n");
+        return 1;
+    }
+    size_t bad = 0;
+    for (int repeat = 0; repeat < run.repeats; ++repeat) {
+        MockSheetServer::Stats before = mock.GetStats();
+        uint64_t loadsBefore = gateway.StatsJson()["upstream_loads"].get<uint64_t>();
+        PhaseResult result = RunClients(gateway.Port(), run.clients, run.seedBase, steps, area);
+        MockSheetServer::Stats after = mock.GetStats();
+        uint64_t loads = gateway.StatsJson()["upstream_loads"].get<uint64_t>() - loadsBefore;
+        size_t fresh = 0;
+        for (const auto& chunk : result.chunks) fresh += fetched.insert(chunk).second ? 1 : 0;
+        std::printf("%-8s %7d %9zu %6zu %8llu %7llu %8.2f %8.2f %8.2f %9.2f %8zu %10zu\n",
+            names[repeat], run.clients, result.requests, fresh,
+            static_cast<unsigned long long>(loads),
+            static_cast<unsigned long long>(after.failed - before.failed),
+            result.seconds, Percentile(result.latencies, 0.5), Percentile(result.latencies, 0.99),
+            result.latencies.empty() ? 0.0 : result.latencies.back(), result.failures, result.mismatches);
+        bad += result.failures + result.mismatches;
+    }
+    // クォータ待ちの取得を打ち切ってから接続を閉じる
+    loader.Shutdown();
+    gateway.Stop();
+    return bad;
+}
+
+} // namespace
+
+int RunGatewayBench(const BenchArgs& args) {
+    int clients = args.Int("clients", 400);
+    int steps = args.Int("steps", 60);
+    int area = args.Int("area", 40);
+    double upstreamRate = args.Double("upstream-rate", 1000.0);
+    MockSheetOptions mockOptions;
+    mockOptions.errorRate = args.Double("error-rate", 0.05);
+    mockOptions.latencyMs = args.Int("upstream-latency-ms", 0);
+    std::filesystem::path cacheDir = std::filesystem::path(args.String("cache", "bench_cache")) / "gateway";
+    std::error_code ec;
+    std::filesystem::remove_all(cacheDir, ec);
+
+    MockSheetServer mock(mockOptions);
+    if (!mock.Start()) {
+        std::fprintf(stderr, "cannot start the mock upstream\n");
+        return 1;
+    }
+    std::printf("gateway: %d clients, %d steps, %dx%d chunks, mock 503 rate %.2f, upstream quota %.0f/s\n",
+        clients, steps, area, area, mockOptions.errorRate, upstreamRate);
+    std::printf("%-8s %7s %9s %6s %8s %7s %8s %8s %8s %9s %8s %10s\n",
+        "phase", "clients", "requests", "new", "upstream", "mock503", "seconds", "p50 ms", "p99 ms", "max ms", "failures", "mismatches");
+    const char* const firstRun[] = { "cold", "hot" };
+    const char* const secondRun[] = { "restart" };
+    std::set<std::pair<int, int>> fetched;
+    size_t bad = RunGateway(firstRun, { clients, 0, 2 }, cacheDir.string(), mock, upstreamRate, steps, area, fetched);
+    // 作り直したゲートウェイはホットセットが空なので、前半のクライアントの分はディスクキャッシュから答える
+    bad += RunGateway(secondRun, { clients * 2, 0, 1 }, cacheDir.string(), mock, upstreamRate, steps, area, fetched);
+    mock.Stop();
+    return bad == 0 ? 0 : 1;
+}
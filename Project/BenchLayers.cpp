@@ -0,0 +1,110 @@
+#include "Bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "MockSheetServer.h"
+
+// 追加レイヤーの取得コストとメモリ
+// 同じプロセスのモックを上流にし、レイヤー数を 1〜layers に変えて同じチャンクを順に LoadLayersFromSheet で取得する
+// 追加レイヤーは主レイヤーから列をずらした範囲に置く（モックは1回の batchGet を1リクエストとして数える）
+// レイヤー数ごとに、リクエスト数、1チャンクあたりの受信バイト数、取得時間の p50/p95、追加レイヤーが常駐チャンクに足すバイト数を書く
+// 取得した全レイヤーをモックの値と照合する
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 追加レイヤー i の、主レイヤーからの列のずれ
+constexpr int kLayerColumnStride = 1000;
+
+double Percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    size_t index = std::min(samples.size() - 1, static_cast<size_t>(p * static_cast<double>(samples.size())));
+    std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(index), samples.end());
+    return samples[index];
+}
+
+} // namespace
+
+int RunLayersBench(const BenchArgs& args) {
+    int maxLayers = std::max(1, args.Int("layers", 4));
+    int chunkCount = std::max(1, args.Int("chunks", 200));
+    int latencyMs = args.Int("latency-ms", 0);
+    std::filesystem::path cacheDir = std::filesystem::path(args.String("cache", "bench_cache")) / "layers";
+
+    MockSheetOptions mockOptions;
+    mockOptions.latencyMs = latencyMs;
+    MockSheetServer mock(mockOptions);
+    if (!mock.Start()) {
+        std::fprintf(stderr, "cannot start the mock upstream\n");
+        return 1;
+    }
+    std::printf("layers: %d chunks per run, mock latency %d ms, extra layer i offset by %d columns\n",
+        chunkCount, latencyMs, kLayerColumnStride);
+    std::printf("%-7s %9s %12s %9s %9s %14s %10s\n", "layers", "requests", "bytes/chunk", "p50 ms", "p95 ms",
+        "overlay bytes", "mismatches");
+
+    size_t bad = 0;
+    for (int layerCount = 1; layerCount <= maxLayers; ++layerCount) {
+        std::error_code ec;
+        std::filesystem::remove_all(cacheDir, ec);
+        std::vector<SheetLayer> layers;
+        for (int i = 1; i < layerCount; ++i) layers.push_back({ "", i * kLayerColumnStride, 0 });
+
+        MockSheetServer::Stats before = mock.GetStats();
+        std::vector<double> latencies;
+        size_t mismatches = 0;
+        size_t overlayBytes = 0;
+        uint64_t bytesReceived = 0;
+        {
+            ChunkLoader loader("mock", "TR1_02", "bench-key", cacheDir.string());
+            loader.SetApiBaseUrl(mock.BaseUrl());
+            loader.SetRevisionUrl(mock.RevisionUrl());
+            // クォータとヘッジで待ち時間と重複が入らないようにする
+            loader.SetRequestQuota(1e6, 1e6);
+            loader.SetHedgingEnabled(false);
+            loader.SetLayers(layers);
+            loader.Initialize();
+
+            auto ticket = std::make_shared<LoadTicket>();
+            for (int i = 0; i < chunkCount; ++i) {
+                int cx = i % 20;
+                int cy = i / 20;
+                auto begin = Clock::now();
+                std::optional<std::vector<TileData>> data = loader.LoadLayersFromSheet(cx, cy, ticket);
+                latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+                if (!data || data->size() != static_cast<size_t>(layerCount)) {
+                    ++mismatches;
+                    continue;
+                }
+                // 常駐チャンクと同じ形にして、追加レイヤーの分のバイト数を数える
+                ChunkTiles tiles;
+                tiles.Assign((*data)[0]);
+                for (size_t layer = 1; layer < data->size(); ++layer) {
+                    tiles.overlays.emplace_back().Assign((*data)[layer]);
+                }
+                overlayBytes = tiles.overlays.size() * sizeof(ChunkTiles);
+                for (size_t layer = 0; layer < data->size(); ++layer) {
+                    int columnOffset = layer == 0 ? 0 : layers[layer - 1].columnOffset;
+                    const ChunkTiles& read = layer == 0 ? tiles : tiles.overlays[layer - 1];
+                    if (read.ToTileData() != MockSheetServer::ExpectedChunk(cx, cy, columnOffset, 0)) ++mismatches;
+                }
+            }
+            bytesReceived = loader.GetHttpStats().bytesReceived;
+        }
+        MockSheetServer::Stats after = mock.GetStats();
+        std::printf("%-7d %9llu %12.0f %9.3f %9.3f %14zu %10zu\n", layerCount,
+            static_cast<unsigned long long>(after.served - before.served),
+            static_cast<double>(bytesReceived) / static_cast<double>(chunkCount),
+            Percentile(latencies, 0.5), Percentile(latencies, 0.95), overlayBytes, mismatches);
+        bad += mismatches;
+    }
+    mock.Stop();
+    std::printf("sizeof(ChunkTiles) = %zu bytes (one per extra layer, plus the overlays vector header in the chunk)\n",
+        sizeof(ChunkTiles));
+    return bad == 0 ? 0 : 1;
+}
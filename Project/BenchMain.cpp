@@ -0,0 +1,107 @@
+#include "Bench.h"
+#include <charconv>
+#include <cstdio>
+#include <stdexcept>
+#include <curl/curl.h>
+
+// ベンチマークのエントリーポイント（コンソールアプリ）
+//   Bench gateway [--clients 400] [--steps 60] [--area 40] [--error-rate 0.05] [--cache bench_cache]
+//   Bench soak [--seconds 60] [--quota 10] [--quota-window-ms 5000] [--error-rate 0.05] [--rate 4] [--prefetch 1]
+//   Bench csv [--width 1000] [--height 1000] [--empty-percent 10] [--piece 16384] [--reps 5]
+//   Bench collision [--world 1000] [--entities 10000] [--frames 200] [--checks 2000000]
+//   Bench cache [--source cache] [--reps 20]
+//   Bench path [--world 1000] [--queries 200]
+//   Bench flow [--area 516] [--noise 0.15] [--threads 0] [--frames 100]
+//   Bench layers [--layers 4] [--chunks 200] [--latency-ms 0]
+//   Bench edits [--edits 10000] [--latency-ms 0] [--error-rate 0.6]
+//   Bench regions [--viewers 64] [--frames 2000] [--view 1] [--prefetch 1]
+
+namespace {
+
+struct BenchEntry {
+    const char* name;
+    int (*run)(const BenchArgs& args);
+};
+
+constexpr BenchEntry kBenches[] = {
+    { "gateway", RunGatewayBench },
+    { "soak", RunSoakBench },
+    { "csv", RunCsvBench },
+    { "collision", RunCollisionBench },
+    { "cache", RunCacheBench },
+    { "path", RunPathBench },
+    { "flow", RunFlowBench },
+    { "layers", RunLayersBench },
+    { "edits", RunEditsBench },
+    { "regions", RunRegionsBench },
+};
+
+template <typename T>
+T ParseNumber(const std::string& name, const std::string& text) {
+    T value{};
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    if (result.ec != std::errc() || result.ptr != end) throw std::invalid_argument("bad number for --" + name + ": " + text);
+    return value;
+}
+
+void PrintUsage() {
+    std::fprintf(stderr, "usage: Bench <name> [--option value]...\n  names:");
+    for (const BenchEntry& bench : kBenches) std::fprintf(stderr, " %s", bench.name);
+    std::fprintf(stderr, "\n");
+}
+
+} // namespace
+
+bool BenchArgs::Parse(int argc, char* argv[], int first) {
+    for (int i = first; i < argc; i += 2) {
+        std::string name = argv[i];
+        if (name.rfind("--", 0) != 0 || i + 1 >= argc) return false;
+        values_[name.substr(2)] = argv[i + 1];
+    }
+    return true;
+}
+
+int BenchArgs::Int(const std::string& name, int fallback) const {
+    auto found = values_.find(name);
+    return found == values_.end() ? fallback : ParseNumber<int>(name, found->second);
+}
+
+double BenchArgs::Double(const std::string& name, double fallback) const {
+    auto found = values_.find(name);
+    return found == values_.end() ? fallback : ParseNumber<double>(name, found->second);
+}
+
+std::string BenchArgs::String(const std::string& name, const std::string& fallback) const {
+    auto found = values_.find(name);
+    return found == values_.end() ? fallback : found->second;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        PrintUsage();
+        return 2;
+    }
+    BenchArgs args;
+    if (!args.Parse(argc, argv, 2)) {
+        PrintUsage();
+        return 2;
+    }
+    std::string name = argv[1];
+    for (const BenchEntry& bench : kBenches) {
+        if (name != bench.name) continue;
+        // クライアント側の curl もここで初期化しておく（ChunkLoader の初期化・終了と数が釣り合う）
+        curl_global_init(CURL_GLOBAL_ALL);
+        int result = 0;
+        try {
+            result = bench.run(args);
+        } catch (const std::invalid_argument& e) {
+            std::fprintf(stderr, "%s\n", e.what());
+            result = 2;
+        }
+        curl_global_cleanup();
+        return result;
+    }
+    PrintUsage();
+    return 2;
+}
@@ -0,0 +1,232 @@
+#include "Bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <queue>
+#include <random>
+#include <vector>
+#include "Pathfinder.h"
+
+// 経路探索の比較
+// 壁の帯（一定間隔の横と縦の壁に隙間を空けたもの）とランダムな壁の世界で、同じ2点の組を
+//   A*:       タイルを1つずつ展開する参照実装（8方向、斜めは両側の縦横が通れるときだけ）
+//   JPS:      Pathfinder::SearchGrid（世界全体を1回だけ PathGrid に写す）。コストが A* と一致するか確かめる
+//   HPA*:     Pathfinder::FindPath。cold は抽象グラフが空の状態から、warm は同じ組をもう一度
+// で探し、1問あたりの時間と、A* に対する経路の長さの比を書く
+// 最後に、始点の隣のチャンクを書き換えて同じ組を探し直す時間（作り直したクラスタ数）を書く
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Tile = std::pair<int, int>;
+
+constexpr double kDiagonalCost = 1.4142135623730951;
+
+struct World {
+    int size = 0;
+    std::vector<uint8_t> solid; // size * size
+
+    bool Blocked(int x, int y) const {
+        return x < 0 || y < 0 || x >= size || y >= size || solid[static_cast<size_t>(y) * static_cast<size_t>(size) + static_cast<size_t>(x)];
+    }
+};
+
+World MakeWorld(int size, double noise, std::mt19937& random) {
+    World world;
+    world.size = size;
+    world.solid.assign(static_cast<size_t>(size) * static_cast<size_t>(size), 0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            // 50 タイルごとの壁の帯に、40 タイルごとに 4 タイルの隙間
+            bool band = (y % 50 == 25 && x % 40 >= 4) || (x % 50 == 25 && y % 40 >= 4);
+            if (band || unit(random) < noise) world.solid[static_cast<size_t>(y) * static_cast<size_t>(size) + static_cast<size_t>(x)] = 1;
+        }
+    }
+    return world;
+}
+
+void FillChunk(const World& world, CollisionMap& map, const TileClassifier& classifier, int cx, int cy) {
+    ChunkTiles tiles;
+    tiles.rowCount = ChunkTiles::kHeight;
+    for (int y = 0; y < ChunkTiles::kHeight; ++y) {
+        tiles.rowWidths[static_cast<size_t>(y)] = static_cast<uint8_t>(ChunkTiles::kWidth);
+        for (int x = 0; x < ChunkTiles::kWidth; ++x) {
+            tiles.cells[static_cast<size_t>(y * ChunkTiles::kWidth + x)] =
+                world.Blocked(cx * ChunkTiles::kWidth + x, cy * ChunkTiles::kHeight + y) ? 1 : 0;
+        }
+    }
+    map.Set(cx, cy, classifier.Build(tiles));
+}
+
+// タイルを1つずつ展開する A*（経路のコストだけを返す。届かなければ負）
+double ReferenceAStar(const World& world, Tile start, Tile goal, size_t& expanded) {
+    size_t cells = world.solid.size();
+    std::vector<double> cost(cells, 1e300);
+    std::vector<uint8_t> closed(cells, 0);
+    auto index = [&world](int x, int y) { return static_cast<size_t>(y) * static_cast<size_t>(world.size) + static_cast<size_t>(x); };
+    auto heuristic = [goal](int x, int y) {
+        double dx = std::abs(x - goal.first);
+        double dy = std::abs(y - goal.second);
+        return std::max(dx, dy) + (kDiagonalCost - 1.0) * std::min(dx, dy);
+    };
+    using Entry = std::pair<double, size_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    cost[index(start.first, start.second)] = 0.0;
+    open.push({ heuristic(start.first, start.second), index(start.first, start.second) });
+    expanded = 0;
+    while (!open.empty()) {
+        size_t current = open.top().second;
+        open.pop();
+        if (closed[current]) continue;
+        closed[current] = 1;
+        ++expanded;
+        int x = static_cast<int>(current % static_cast<size_t>(world.size));
+        int y = static_cast<int>(current / static_cast<size_t>(world.size));
+        if (x == goal.first && y == goal.second) return cost[current];
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                if ((dx == 0 && dy == 0) || world.Blocked(x + dx, y + dy)) continue;
+                if (dx != 0 && dy != 0 && (world.Blocked(x + dx, y) || world.Blocked(x, y + dy))) continue;
+                size_t next = index(x + dx, y + dy);
+                double nextCost = cost[current] + (dx != 0 && dy != 0 ? kDiagonalCost : 1.0);
+                if (closed[next] || nextCost >= cost[next]) continue;
+                cost[next] = nextCost;
+                open.push({ nextCost + heuristic(x + dx, y + dy), next });
+            }
+        }
+    }
+    return -1.0;
+}
+
+Tile RandomOpenTile(const World& world, std::mt19937& random) {
+    std::uniform_int_distribution<int> coord(0, world.size - 1);
+    for (;;) {
+        Tile tile{ coord(random), coord(random) };
+        if (!world.Blocked(tile.first, tile.second)) return tile;
+    }
+}
+
+double Ms(Clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+} // namespace
+
+int RunPathBench(const BenchArgs& args) {
+    int worldSize = args.Int("world", 1000);
+    int queryCount = std::max(1, args.Int("queries", 200));
+    std::mt19937 random(44);
+    std::printf("path: %dx%d world, %d reachable random pairs per row\n", worldSize, worldSize, queryCount);
+    std::printf("%-6s %10s %10s %10s %10s %8s %8s %10s\n", "noise", "A* ms/q", "JPS ms/q", "HPA cold", "HPA warm",
+        "warm q/s", "longer", "short ms/q");
+    size_t bad = 0;
+
+    for (double noise : { 0.02, 0.15 }) {
+        World world = MakeWorld(worldSize, noise, random);
+        CollisionMap map;
+        TileClassifier classifier;
+        int chunks = (worldSize + ChunkTiles::kWidth - 1) / ChunkTiles::kWidth;
+        for (int cy = 0; cy < chunks; ++cy) {
+            for (int cx = 0; cx < chunks; ++cx) FillChunk(world, map, classifier, cx, cy);
+        }
+
+        // 届く組だけを使う（A* の時間もここで測る）
+        std::vector<std::pair<Tile, Tile>> queries;
+        std::vector<double> expected;
+        double astarMs = 0.0;
+        while (static_cast<int>(queries.size()) < queryCount) {
+            Tile start = RandomOpenTile(world, random);
+            Tile goal = RandomOpenTile(world, random);
+            size_t expanded = 0;
+            auto begin = Clock::now();
+            double cost = ReferenceAStar(world, start, goal, expanded);
+            double ms = Ms(begin);
+            if (cost < 0.0) continue;
+            astarMs += ms;
+            queries.emplace_back(start, goal);
+            expected.push_back(cost);
+        }
+
+        PathGrid grid(map, 0, 0, worldSize, worldSize, UnloadedTiles::Blocked);
+        size_t jpsMismatches = 0;
+        auto begin = Clock::now();
+        for (size_t i = 0; i < queries.size(); ++i) {
+            std::vector<Tile> tiles;
+            double cost = 0.0;
+            size_t expanded = 0;
+            bool found = Pathfinder::SearchGrid(grid, queries[i].first, queries[i].second, tiles, cost, expanded);
+            if (!found || std::abs(cost - expected[i]) > 1e-6) ++jpsMismatches;
+        }
+        double jpsMs = Ms(begin);
+
+        Pathfinder pathfinder(map);
+
+        double hpaMs[2] = {};
+        double ratioSum = 0.0;
+        double ratioWorst = 1.0;
+        size_t notFound = 0;
+        for (int pass = 0; pass < 2; ++pass) {
+            begin = Clock::now();
+            for (size_t i = 0; i < queries.size(); ++i) {
+                const auto& [start, goal] = queries[i];
+                PathResult result = pathfinder.FindPath(start.first, start.second, goal.first, goal.second, UnloadedTiles::Blocked);
+                if (pass == 0) continue;
+                if (!result.found) {
+                    ++notFound;
+                    continue;
+                }
+                double ratio = result.cost / std::max(expected[i], 1.0);
+                ratioSum += ratio;
+                ratioWorst = std::max(ratioWorst, ratio);
+            }
+            hpaMs[pass] = Ms(begin);
+        }
+
+        // 20 タイル以内の組（抽象グラフを使わず JPS で済む）
+        std::vector<std::pair<Tile, Tile>> shortQueries;
+        while (static_cast<int>(shortQueries.size()) < queryCount) {
+            Tile start = RandomOpenTile(world, random);
+            std::uniform_int_distribution<int> offset(-20, 20);
+            Tile goal{ start.first + offset(random), start.second + offset(random) };
+            if (!world.Blocked(goal.first, goal.second)) shortQueries.emplace_back(start, goal);
+        }
+        begin = Clock::now();
+        for (const auto& [start, goal] : shortQueries) {
+            pathfinder.FindPath(start.first, start.second, goal.first, goal.second, UnloadedTiles::Blocked);
+        }
+        double shortMs = Ms(begin);
+
+        double count = static_cast<double>(queries.size());
+        size_t found = queries.size() - notFound;
+        std::printf("%5.0f%% %10.2f %10.2f %10.2f %10.2f %8.0f %7.1f%% %10.3f\n", noise * 100.0, astarMs / count, jpsMs / count,
+            hpaMs[0] / count, hpaMs[1] / count, count / (hpaMs[1] / 1000.0),
+            found > 0 ? (ratioSum / static_cast<double>(found) - 1.0) * 100.0 : 0.0, shortMs / static_cast<double>(shortQueries.size()));
+        std::printf("       JPS cost mismatches: %zu, HPA* not found: %zu, worst HPA* path %.1f%% longer, %zu clusters built\n",
+            jpsMismatches, notFound, (ratioWorst - 1.0) * 100.0, pathfinder.BuiltClusters());
+        bad += jpsMismatches + notFound;
+
+        // 始点のチャンクの隣を書き換え、近くの組を探し直す（そのクラスタと隣だけが作り直される）
+        double editMs = 0.0;
+        size_t rebuilt = 0;
+        int edits = std::min(queryCount, 50);
+        for (int i = 0; i < edits; ++i) {
+            const auto& [start, goal] = queries[static_cast<size_t>(i)];
+            int cx = std::min(start.first / ChunkTiles::kWidth + 1, chunks - 1);
+            int cy = start.second / ChunkTiles::kHeight;
+            size_t tile = static_cast<size_t>(cy * ChunkTiles::kHeight) * static_cast<size_t>(worldSize) + static_cast<size_t>(cx * ChunkTiles::kWidth);
+            world.solid[tile] ^= 1;
+            size_t builtBefore = pathfinder.BuiltClusters();
+            begin = Clock::now();
+            FillChunk(world, map, classifier, cx, cy);
+            pathfinder.OnChunkChanged(cx, cy);
+            pathfinder.FindPath(start.first, start.second, goal.first, goal.second, UnloadedTiles::Blocked);
+            editMs += Ms(begin);
+            rebuilt += pathfinder.BuiltClusters() - builtBefore;
+        }
+        std::printf("       edit one chunk + re-query the pair: %.2f ms, %.1f clusters rebuilt (avg of %d)\n",
+            editMs / edits, static_cast<double>(rebuilt) / edits, edits);
+    }
+    return bad == 0 ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+#include "Bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "InterestRegions.h"
+
+// 関心領域の共有（多数の観戦者がランダムに歩く）
+// 60x60 チャンクの BJData キャッシュを作り、プレイヤー1人（中央で止まっている）と viewers 人の領域を InterestRegionSet に置く
+// 観戦者は中央から spread タイルの正方形にばらまき、毎フレーム上下左右に1タイル歩かせて Move する
+// 範囲に入ったチャンクは常駐していなければディスクキャッシュから同期で読み（MapManager は読み込みスレッドで読む）、外れたら捨てる
+// 共有した読み込みの数と、領域ごとに自分の範囲を別々に読んだ場合の数、常駐チャンク数、1フレームの時間を書く
+// 最後に、全チャンクの参照数を全領域の範囲の数え直しと照合し、観戦者を外した後にプレイヤーの範囲だけが残るか確かめる
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kWorldChunks = 60;
+constexpr int kCenterTile = kWorldChunks * ChunkTiles::kWidth / 2;
+// 観戦者がワールドの端のチャンクの外へ出ないように歩ける範囲
+constexpr int kMinTile = 30;
+constexpr int kMaxTile = kWorldChunks * ChunkTiles::kWidth - 30;
+
+double Ms(Clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+int ChunkOf(int tile) {
+    return tile >= 0 ? tile / ChunkTiles::kWidth : (tile - ChunkTiles::kWidth + 1) / ChunkTiles::kWidth;
+}
+
+// 範囲が before から after へ動いたとき、after にだけあるチャンクの数（共有しない場合の読み込み）
+int EnteredChunks(const InterestRegion& before, const InterestRegion& after) {
+    int reach = after.viewDistanceChunks + after.prefetchDistanceChunks;
+    int entered = 0;
+    for (int dy = -reach; dy <= reach; ++dy) {
+        for (int dx = -reach; dx <= reach; ++dx) {
+            if (!InterestRegionSet::InWindow(before, after.chunkX + dx, after.chunkY + dy)) ++entered;
+        }
+    }
+    return entered;
+}
+
+// 全チャンクの参照数を、全領域の範囲を数え直したものと照合する
+size_t RecountMismatches(const InterestRegionSet& regions, size_t residentCount) {
+    std::map<std::pair<int, int>, int> expected;
+    for (const auto& kv : regions.Regions()) {
+        int reach = kv.second.viewDistanceChunks + kv.second.prefetchDistanceChunks;
+        for (int dy = -reach; dy <= reach; ++dy) {
+            for (int dx = -reach; dx <= reach; ++dx) ++expected[{ kv.second.chunkX + dx, kv.second.chunkY + dy }];
+        }
+    }
+    size_t mismatches = 0;
+    for (const auto& [chunk, count] : expected) {
+        if (regions.RefCount(chunk.first, chunk.second) != count) ++mismatches;
+    }
+    if (regions.ChunkCount() != expected.size() || residentCount != expected.size()) ++mismatches;
+    return mismatches;
+}
+
+} // namespace
+
+int RunRegionsBench(const BenchArgs& args) {
+    int viewers = std::max(1, args.Int("viewers", 64));
+    int frames = std::max(1, args.Int("frames", 2000));
+    int view = std::max(0, args.Int("view", 1));
+    int prefetch = std::max(0, args.Int("prefetch", 1));
+    std::filesystem::path cacheDir = std::filesystem::path(args.String("cache", "bench_cache")) / "regions";
+    std::error_code ec;
+    std::filesystem::remove_all(cacheDir, ec);
+
+    ChunkLoader loader("bench", "TR1_02", "", cacheDir.string());
+    loader.SetCacheEncoding(CacheEncoding::BJData);
+    loader.Initialize();
+    for (int cy = 0; cy < kWorldChunks; ++cy) {
+        for (int cx = 0; cx < kWorldChunks; ++cx) {
+            ChunkTiles tiles;
+            tiles.Assign(TileData(ChunkTiles::kHeight, std::vector<int>(ChunkTiles::kWidth, (cx + cy) % 3 + 1)));
+            loader.CommitChunk(cx, cy, tiles);
+        }
+    }
+
+    int side = (view + prefetch) * 2 + 1;
+    std::printf("regions: %d viewers + 1 player, view %d + prefetch %d (%d chunks each), %d frames, BJData cache\n",
+        viewers, view, prefetch, side * side, frames);
+    std::printf("%-7s %8s %10s %9s %9s %9s %10s %10s %10s\n", "spread", "loads", "unshared", "resident", "peak",
+        "windows", "avg ms", "max ms", "load ms");
+    size_t bad = 0;
+    std::mt19937 random(37);
+    for (int spread : { 60, 200 }) {
+        std::unordered_map<std::pair<int, int>, ChunkTiles, PairHash> resident;
+        uint64_t loads = 0;
+        double loadMs = 0.0;
+        InterestRegionSet regions(
+            [&](int cx, int cy, LoadPriority) {
+                auto [it, inserted] = resident.try_emplace({ cx, cy });
+                if (!inserted) return;
+                auto begin = Clock::now();
+                loader.LoadChunkCache(cx, cy, it->second);
+                loadMs += Ms(begin);
+                ++loads;
+            },
+            [&](int cx, int cy) { resident.erase({ cx, cy }); });
+
+        InterestRegion base;
+        base.viewDistanceChunks = view;
+        base.prefetchDistanceChunks = prefetch;
+        base.chunkX = ChunkOf(kCenterTile);
+        base.chunkY = ChunkOf(kCenterTile);
+        int player = regions.Add(base);
+        uint64_t unshared = static_cast<uint64_t>(side * side);
+
+        std::uniform_int_distribution<int> offset(-spread / 2, spread / 2);
+        std::vector<std::pair<int, int>> positions;
+        std::vector<int> ids;
+        for (int i = 0; i < viewers; ++i) {
+            int x = std::clamp(kCenterTile + offset(random), kMinTile, kMaxTile);
+            int y = std::clamp(kCenterTile + offset(random), kMinTile, kMaxTile);
+            positions.emplace_back(x, y);
+            InterestRegion region = base;
+            region.chunkX = ChunkOf(x);
+            region.chunkY = ChunkOf(y);
+            ids.push_back(regions.Add(region));
+            unshared += static_cast<uint64_t>(side * side);
+        }
+
+        std::uniform_int_distribution<int> direction(0, 3);
+        size_t peak = resident.size();
+        double totalMs = 0.0;
+        double worstMs = 0.0;
+        for (int frame = 0; frame < frames; ++frame) {
+            auto begin = Clock::now();
+            for (int i = 0; i < viewers; ++i) {
+                auto& [x, y] = positions[static_cast<size_t>(i)];
+                switch (direction(random)) {
+                case 0: ++x; break;
+                case 1: --x; break;
+                case 2: ++y; break;
+                default: --y; break;
+                }
+                x = std::clamp(x, kMinTile, kMaxTile);
+                y = std::clamp(y, kMinTile, kMaxTile);
+                InterestRegion before = *regions.Find(ids[static_cast<size_t>(i)]);
+                regions.Move(ids[static_cast<size_t>(i)], ChunkOf(x), ChunkOf(y));
+                unshared += static_cast<uint64_t>(EnteredChunks(before, *regions.Find(ids[static_cast<size_t>(i)])));
+            }
+            double ms = Ms(begin);
+            totalMs += ms;
+            worstMs = std::max(worstMs, ms);
+            peak = std::max(peak, resident.size());
+        }
+
+        size_t mismatches = RecountMismatches(regions, resident.size());
+        size_t endResident = resident.size();
+        for (int id : ids) regions.Remove(id);
+        bool onlyPlayer = resident.size() == static_cast<size_t>(side * side) && regions.Find(player) != nullptr;
+        std::printf("%-7d %8llu %10llu %9zu %9zu %9d %10.3f %10.2f %10.3f\n", spread, static_cast<unsigned long long>(loads),
+            static_cast<unsigned long long>(unshared), endResident, peak, (viewers + 1) * side * side, totalMs / frames, worstMs,
+            loadMs / frames);
+        std::printf("        ref count mismatches: %zu, resident after removing viewers: %zu\n", mismatches, resident.size());
+        bad += mismatches + (onlyPlayer ? 0 : 1);
+    }
+    return bad == 0 ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+#include "Bench.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "MockSheetServer.h"
+#include "TileSource.h"
+
+// スケジューラの耐久試験
+// クォータの厳しいモックを上流にし、ゲームと同じ読み込み（表示範囲は Visible、その外の1周は Prefetch、
+// ディスクキャッシュ → シートの順に問い合わせる）で歩き続ける。範囲外に出たチャンクの取得は取り消す
+// 最後に、書かれたキャッシュファイルを全てモックの値と照合する（失敗した取得が空のチャンクとして残っていないか）
+
+namespace {
+
+struct SoakJob {
+    int cx = 0;
+    int cy = 0;
+    std::shared_ptr<LoadTicket> ticket;
+};
+
+struct SoakCounts {
+    uint64_t fromSheet = 0;
+    uint64_t fromDisk = 0;
+    uint64_t cancelled = 0;
+    uint64_t failed = 0; // 取り消されていないのに答えが得られなかった
+};
+
+// MapManager の読み込みスレッドと同じく、優先度の高い要求から取り出して取得元に問い合わせる
+class SoakLoader {
+public:
+    SoakLoader(CachedSource& source, int threads) : source_(source) {
+        for (int i = 0; i < threads; ++i) threads_.emplace_back([this]() { Loop(); });
+    }
+
+    ~SoakLoader() { Stop(); }
+
+    void Push(SoakJob job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(job));
+        }
+        cv_.notify_one();
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (std::thread& thread : threads_) thread.join();
+        threads_.clear();
+    }
+
+    SoakCounts Counts() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return counts_;
+    }
+
+private:
+    void Loop() {
+        for (;;) {
+            SoakJob job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+                if (stopping_) return;
+                auto next = std::min_element(queue_.begin(), queue_.end(),
+                    [](const SoakJob& a, const SoakJob& b) { return a.ticket->priority < b.ticket->priority; });
+                job = std::move(*next);
+                queue_.erase(next);
+            }
+            ChunkTiles tiles;
+            const TileSource* answeredBy = nullptr;
+            bool answered = !job.ticket->cancelled && source_.Resolve(job.cx, job.cy, job.ticket, tiles, &answeredBy);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (answered) ++(answeredBy->IsRemote() ? counts_.fromSheet : counts_.fromDisk);
+            else if (job.ticket->cancelled) ++counts_.cancelled;
+            else ++counts_.failed;
+        }
+    }
+
+    CachedSource& source_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<SoakJob> queue_;
+    SoakCounts counts_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
+
+} // namespace
+
+int RunSoakBench(const BenchArgs& args) {
+    int seconds = args.Int("seconds", 60);
+    int stepMs = args.Int("step-ms", 320);
+    int area = args.Int("area", 20);
+    int viewDistance = args.Int("view", 1);
+    int prefetchDistance = args.Int("prefetch", 1);
+    double clientRate = args.Double("rate", 4.0);
+    double clientBurst = args.Double("burst", 8.0);
+    MockSheetOptions mockOptions;
+    mockOptions.quotaRequests = args.Int("quota", 10);
+    mockOptions.quotaWindowMs = args.Int("quota-window-ms", 5000);
+    mockOptions.errorRate = args.Double("error-rate", 0.05);
+    std::filesystem::path cacheDir = std::filesystem::path(args.String("cache", "bench_cache")) / "soak";
+    std::error_code ec;
+    std::filesystem::remove_all(cacheDir, ec);
+
+    MockSheetServer mock(mockOptions);
+    if (!mock.Start()) {
+        std::fprintf(stderr, "cannot start the mock upstream\n");
+        return 1;
+    }
+    std::printf("soak: %d s, step %d ms, %dx%d chunks, view %d + prefetch %d, client quota %.1f/s (burst %.0f)\n",
+        seconds, stepMs, area, area, viewDistance, prefetchDistance, clientRate, clientBurst);
+    std::printf("mock: %d requests per %d ms, 503 rate %.2f, Retry-After on every other 429\n",
+        mockOptions.quotaRequests, mockOptions.quotaWindowMs, mockOptions.errorRate);
+
+    ChunkLoader loader("mock", "TR1_02", "bench-key", cacheDir.string());
+    loader.SetApiBaseUrl(mock.BaseUrl());
+    loader.SetRevisionUrl(mock.RevisionUrl());
+    loader.SetRequestQuota(clientRate, clientBurst);
+    loader.Initialize();
+    loader.RefreshRevision();
+    auto sheets = std::make_shared<SheetsSource>(loader);
+    CachedSource source({ std::make_shared<DiskCacheSource>(loader, true), sheets });
+
+    int radius = viewDistance + prefetchDistance;
+    SoakLoader workers(source, (radius * 2 + 1) * (radius * 2 + 1));
+    std::unordered_map<std::pair<int, int>, std::shared_ptr<LoadTicket>, PairHash> tracked;
+    std::mt19937 random(3);
+    int x = area / 2;
+    int y = area / 2;
+    int steps = 0;
+    auto begin = std::chrono::steady_clock::now();
+    auto end = begin + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < end) {
+        bool changed = false;
+        // 範囲外に出たチャンクは取り消す（待っている取得はすぐに戻る）
+        for (auto it = tracked.begin(); it != tracked.end();) {
+            if (std::max(std::abs(it->first.first - x), std::abs(it->first.second - y)) > radius) {
+                it->second->cancelled = true;
+                it = tracked.erase(it);
+                changed = true;
+            } else {
+                ++it;
+            }
+        }
+        for (int cy = y - radius; cy <= y + radius; ++cy) {
+            for (int cx = x - radius; cx <= x + radius; ++cx) {
+                if (cx < 0 || cy < 0 || cx >= area || cy >= area) continue;
+                int priority = static_cast<int>(std::max(std::abs(cx - x), std::abs(cy - y)) <= viewDistance
+                    ? LoadPriority::Visible : LoadPriority::Prefetch);
+                auto found = tracked.find({ cx, cy });
+                if (found != tracked.end()) {
+                    // 先読みしていたチャンクが表示範囲に入ったら繰り上げる
+                    changed |= found->second->priority.exchange(priority) != priority;
+                    continue;
+                }
+                auto ticket = std::make_shared<LoadTicket>();
+                ticket->priority = priority;
+                tracked.emplace(std::make_pair(cx, cy), ticket);
+                workers.Push({ cx, cy, std::move(ticket) });
+            }
+        }
+        if (changed) loader.NotifyScheduler();
+        std::this_thread::sleep_for(std::chrono::milliseconds(stepMs));
+        switch (random() % 4) {
+        case 0: x = std::min(x + 1, area - 1); break;
+        case 1: x = std::max(x - 1, 0); break;
+        case 2: y = std::min(y + 1, area - 1); break;
+        default: y = std::max(y - 1, 0); break;
+        }
+        ++steps;
+    }
+    // 残りの取得を取り消し、クォータ待ちを打ち切ってから読み込みスレッドを止める
+    for (auto& kv : tracked) kv.second->cancelled = true;
+    loader.Shutdown();
+    workers.Stop();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    SoakCounts counts = workers.Counts();
+    MockSheetServer::Stats mockStats = mock.GetStats();
+    mock.Stop();
+
+    // キャッシュの照合: 空や不正な内容で書かれていないか
+    int files = 0;
+    int bad = 0;
+    ChunkTiles tiles;
+    for (int cy = 0; cy < area; ++cy) {
+        for (int cx = 0; cx < area; ++cx) {
+            if (!loader.HasChunkCache(cx, cy)) continue;
+            ++files;
+            if (!loader.LoadChunkCache(cx, cy, tiles) || tiles.ToTileData() != MockSheetServer::ExpectedChunk(cx, cy)) {
+                std::printf("  bad cache: chunk (%d, %d)\n", cx, cy);
+                ++bad;
+            }
+        }
+    }
+    std::printf("%.1f s, %d steps\n", elapsed, steps);
+    std::printf("loads: %llu from sheet, %llu from disk, %llu cancelled, %llu failed\n",
+        static_cast<unsigned long long>(counts.fromSheet), static_cast<unsigned long long>(counts.fromDisk),
+        static_cast<unsigned long long>(counts.cancelled), static_cast<unsigned long long>(counts.failed));
+    std::printf("mock: %llu served, %llu 429, %llu 503; client transfers %llu\n",
+        static_cast<unsigned long long>(mockStats.served), static_cast<unsigned long long>(mockStats.throttled),
+        static_cast<unsigned long long>(mockStats.failed), static_cast<unsigned long long>(loader.GetHttpStats().transfers));
+    std::printf("cache files: %d, bad: %d\n", files, bad);
+    return bad == 0 ? 0 : 1;
+}
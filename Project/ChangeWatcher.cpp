@@ -0,0 +1,166 @@
+#include "ChangeWatcher.h"
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+size_t AppendToString(void* contents, size_t size, size_t nmemb, void* userp) {
+    size_t realSize = size * nmemb;
+    static_cast<std::string*>(userp)->append(static_cast<char*>(contents), realSize);
+    return realSize;
+}
+
+} // namespace
+
+ChangeWatcher::ChangeWatcher(ChunkLoader& loader)
+    : loader_(loader) {
+}
+
+ChangeWatcher::~ChangeWatcher() {
+    Stop();
+}
+
+void ChangeWatcher::StartFeed(const std::string& feedUrl) {
+    Stop();
+    feedUrl_ = feedUrl;
+    stop_ = false;
+    cancel_ = std::make_shared<std::atomic<bool>>(false);
+    http_ = std::make_unique<HttpClient>(1);
+    worker_ = std::thread(&ChangeWatcher::FeedLoop, this);
+}
+
+void ChangeWatcher::StartPolling(std::chrono::milliseconds interval) {
+    Stop();
+    pollInterval_ = interval;
+    stop_ = false;
+    worker_ = std::thread(&ChangeWatcher::PollLoop, this);
+}
+
+void ChangeWatcher::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (http_) http_->Cancel(cancel_);
+    if (worker_.joinable()) worker_.join();
+    http_.reset();
+}
+
+std::optional<RevisionChange> ChangeWatcher::Take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::optional<RevisionChange> change = std::move(pending_);
+    pending_.reset();
+    return change;
+}
+
+ChangeWatcher::Stats ChangeWatcher::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ChangeWatcher::FeedLoop() {
+    // フィードの番号と、その時点のリビジョン（負なら未取得）
+    int64_t sequence = -1;
+    std::string revision;
+    for (;;) {
+        std::string buffer;
+        HttpRequest request;
+        request.url = sequence < 0 ? feedUrl_ + "?wait=0"
+            : feedUrl_ + "?since=" + std::to_string(sequence) + "&wait=" + std::to_string(kFeedWaitSec);
+        request.connectTimeoutMs = kConnectTimeoutMs;
+        request.timeoutMs = (kFeedWaitSec + 10) * 1000L;
+        request.writeFunction = AppendToString;
+        request.writeData = &buffer;
+        request.cancel = cancel_;
+        HttpResult result = http_->Perform(request);
+        if (*cancel_) break;
+
+        json j = json::parse(buffer, nullptr, false);
+        // 型の違う応答もつながらなかったときと同じに扱う（監視スレッドで例外を投げない）
+        bool ok = result.Ok() && j.is_object() && j.contains("sequence") && j["sequence"].is_number_integer()
+            && (!j.contains("revision") || j["revision"].is_string())
+            && (!j.contains("reset") || j["reset"].is_boolean());
+        CountRequest(ok);
+        if (!ok) {
+            // 途中の変更を取りこぼしたかもしれないので、つながったら確かめ直す
+            sequence = -1;
+            if (!WaitFor(kErrorDelay)) break;
+            continue;
+        }
+
+        int64_t next = j["sequence"].get<int64_t>();
+        std::string nextRevision = j.value("revision", std::string());
+        bool reset = j.value("reset", false) || next < sequence;
+        if (sequence < 0) {
+            // 最初の応答では今の番号を知るだけ。手元のマニフェストが違うリビジョンなら全チャンクを確かめる
+            reset = nextRevision != loader_.GetSheetRevision();
+        }
+
+        RevisionChange change;
+        if (!reset && sequence >= 0 && j.contains("chunks") && j["chunks"].is_array()) {
+            for (const auto& chunk : j["chunks"]) {
+                if (chunk.is_array() && chunk.size() == 2 && chunk[0].is_number_integer() && chunk[1].is_number_integer()) {
+                    change.chunks.emplace_back(chunk[0].get<int>(), chunk[1].get<int>());
+                }
+            }
+            bool advanced = nextRevision != revision || !change.chunks.empty();
+            if (advanced && !loader_.ApplyRemoteChanges(revision, nextRevision, change.chunks)) reset = true;
+        }
+        if (reset) {
+            // どのチャンクが変わったか分からない。リビジョンを確かめ直し、全チャンクを再取得させる
+            CountRequest(loader_.RefreshRevision());
+            change.chunks.clear();
+            change.allChunks = true;
+        }
+        if (reset || !change.chunks.empty()) {
+            change.changed = true;
+            Publish(change);
+        }
+        sequence = next;
+        revision = nextRevision;
+    }
+}
+
+void ChangeWatcher::PollLoop() {
+    while (WaitFor(pollInterval_)) {
+        RevisionChange change;
+        bool ok = loader_.RefreshRevision(&change);
+        CountRequest(ok);
+        if (ok && change.changed) Publish(change);
+    }
+}
+
+bool ChangeWatcher::WaitFor(std::chrono::milliseconds delay) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !cv_.wait_for(lock, delay, [this] { return stop_; });
+}
+
+void ChangeWatcher::Publish(const RevisionChange& change) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.notifications;
+    if (change.allChunks) ++stats_.resets;
+    stats_.changedChunks += change.chunks.size();
+    if (!pending_) {
+        pending_ = change;
+        return;
+    }
+    pending_->allChunks = pending_->allChunks || change.allChunks;
+    if (pending_->allChunks) {
+        pending_->chunks.clear();
+        return;
+    }
+    for (const auto& key : change.chunks) {
+        if (std::find(pending_->chunks.begin(), pending_->chunks.end(), key) == pending_->chunks.end()) {
+            pending_->chunks.push_back(key);
+        }
+    }
+}
+
+void ChangeWatcher::CountRequest(bool ok) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.requests;
+    if (!ok) ++stats_.errors;
+}
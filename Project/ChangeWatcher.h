@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include "ChunkLoader.h"
+#include "HttpClient.h"
+
+// シートの変更を作業スレッドで待ち受け、変わったチャンクを Take でメインスレッドへ渡す
+// 変更フィード（GET feedUrl?since=番号&wait=秒。タイルゲートウェイの /changes）があれば長いポーリングで待つ
+// なければ一定の間隔で ChunkLoader::RefreshRevision を呼ぶ（チェックサムRange なら変わったチャンクが分かる）
+// どちらもマニフェストを新しいリビジョンへ進め、変わっていないチャンクのキャッシュは有効のままにする
+class ChangeWatcher {
+public:
+    struct Stats {
+        uint64_t notifications = 0; // 変更の通知
+        uint64_t changedChunks = 0; // 通知で分かった変更チャンク（延べ）
+        uint64_t resets = 0;        // どのチャンクが変わったか分からなかった通知
+        uint64_t requests = 0;      // フィードとリビジョン確認のリクエスト
+        uint64_t errors = 0;
+    };
+
+    // loader は Initialize 済みのものを渡す（Stop まで生存していること）
+    explicit ChangeWatcher(ChunkLoader& loader);
+    ~ChangeWatcher();
+    ChangeWatcher(const ChangeWatcher&) = delete;
+    ChangeWatcher& operator=(const ChangeWatcher&) = delete;
+
+    // 変更フィードで待つ
+    void StartFeed(const std::string& feedUrl);
+    // interval ごとにリビジョンを確認する
+    void StartPolling(std::chrono::milliseconds interval);
+    // 待っているリクエストを取り消して作業スレッドを止める
+    void Stop();
+    bool IsRunning() const { return worker_.joinable(); }
+
+    // 前回から届いた変更（なければ nullopt）。複数の通知は1つにまとめる
+    std::optional<RevisionChange> Take();
+    Stats GetStats() const;
+
+private:
+    void FeedLoop();
+    void PollLoop();
+    // delay 待つ。Stop されたら false
+    bool WaitFor(std::chrono::milliseconds delay);
+    void Publish(const RevisionChange& change);
+    void CountRequest(bool ok);
+
+    ChunkLoader& loader_;
+    std::string feedUrl_;
+    std::chrono::milliseconds pollInterval_{ 0 };
+    // 長いポーリングがチャンク取得の接続を塞がないよう、ChunkLoader とは別に持つ
+    std::unique_ptr<HttpClient> http_;
+    HttpCancelFlag cancel_;
+    std::thread worker_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::optional<RevisionChange> pending_;
+    Stats stats_;
+
+    // フィードで1回に待つ時間（サーバー側の上限より短くする）と、通信に失敗したときに次に試すまでの時間
+    static constexpr int kFeedWaitSec = 25;
+    static constexpr long kConnectTimeoutMs = 5000;
+    static constexpr std::chrono::milliseconds kErrorDelay{ 5000 };
+};
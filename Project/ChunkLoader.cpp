@@ -0,0 +1,1105 @@
+#include "ChunkLoader.h"
+#include "CsvTileParser.h"
+#include <fstream>
+#include <cstdio>
+#include <charconv>
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+namespace {
+
+// FNV-1a 64bit
+uint64_t Fnv1a(const void* data, size_t size, uint64_t h = 14695981039346656037ull) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::string ToHex(uint64_t value) {
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(value));
+    return hex;
+}
+
+// 文字列全体を整数として読む
+bool ParseInt(const std::string& text, int& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// セルの値を文字列で（数値で返す範囲にも対応する）。文字列でも数値でもなければ false
+bool CellText(const json& cell, std::string& text) {
+    if (cell.is_string()) {
+        text = cell.get<std::string>();
+        return true;
+    }
+    if (!cell.is_number()) return false;
+    text = cell.dump();
+    return true;
+}
+
+// "cx_cy" 形式のチャンクキー
+std::string ChunkKey(int cx, int cy) {
+    return std::to_string(cx) + "_" + std::to_string(cy);
+}
+
+bool ParseChunkKey(const std::string& key, int& cx, int& cy) {
+    size_t sep = key.find('_', 1);
+    return sep != std::string::npos
+        && ParseInt(key.substr(0, sep), cx) && ParseInt(key.substr(sep + 1), cy);
+}
+
+// 16進の文字列全体を読む（マニフェストの内容ハッシュ）
+bool ParseHex(const std::string& text, uint64_t& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value, 16);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+// j[key] が文字列なら text に入れる。ないときは空のまま。それ以外の型なら false
+bool OptionalString(const json& j, const char* key, std::string& text) {
+    auto found = j.find(key);
+    if (found == j.end()) return true;
+    if (!found->is_string()) return false;
+    text = found->get<std::string>();
+    return true;
+}
+
+// CacheEncoding の順の拡張子
+constexpr const char* kCacheExtensions[] = { ".json", ".cbor", ".msgpack", ".bjd" };
+
+void AppendInt(std::string& out, int value) {
+    char text[16];
+    auto result = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, result.ptr);
+}
+
+// ファイル全体を bytes に読む（bytes の容量は使い回す）
+bool ReadWholeFile(const std::string& path, std::vector<uint8_t>& bytes) {
+    std::ifstream ifs;
+    // 全体を1回で読むのでストリームのバッファは小さくてよい。開くたびに確保しないよう、スレッドごとの配列を渡す
+    thread_local char streamBuffer[64];
+    ifs.rdbuf()->pubsetbuf(streamBuffer, sizeof(streamBuffer));
+    ifs.open(path, std::ios::binary | std::ios::ate);
+    if (!ifs) return false;
+    std::streamoff size = ifs.tellg();
+    if (size < 0) return false;
+    bytes.resize(static_cast<size_t>(size));
+    ifs.seekg(0);
+    return static_cast<bool>(ifs.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(size)));
+}
+
+// キャッシュファイルを DOM を作らずに ChunkTiles のセルへ読む SAX ハンドラ
+// 受け付ける形は、整数の行の配列（[[1,2],[3]]）と、BJData の ndarray（_ArrayType_, _ArraySize_ [高さ, 幅], _ArrayData_）
+// BJData の 1行の ndarray は整数の配列で届くので、flatRow なら1行として読む
+// チャンクの大きさを超える部分は捨てる（ChunkTiles::Assign と同じ）
+class TileCacheSax {
+public:
+    TileCacheSax(ChunkTiles& tiles, bool flatRow) : tiles_(tiles), flatRow_(flatRow) {}
+
+    bool null() { return false; }
+    bool boolean(bool) { return false; }
+    bool number_integer(json::number_integer_t value) {
+        if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max()) return false;
+        return Integer(static_cast<int64_t>(value));
+    }
+    bool number_unsigned(json::number_unsigned_t value) {
+        if (value > static_cast<json::number_unsigned_t>(std::numeric_limits<int>::max())) return false;
+        return Integer(static_cast<int64_t>(value));
+    }
+    bool number_float(json::number_float_t, const json::string_t&) { return false; }
+    bool string(json::string_t&) {
+        if (state_ != State::ArrayType) return false;
+        state_ = State::Object;
+        return true;
+    }
+    bool binary(json::binary_t&) { return false; }
+    bool key(json::string_t& key) {
+        if (state_ != State::Object) return false;
+        if (key == "_ArrayType_") {
+            state_ = State::ArrayType;
+        } else if (key == "_ArraySize_") {
+            state_ = State::ArraySize;
+        } else if (key == "_ArrayData_") {
+            // 大きさより後に来ないと置き場所が分からない
+            if (dims_ != 2) return false;
+            state_ = State::ArrayData;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    bool start_object(std::size_t) {
+        if (state_ != State::Start) return false;
+        state_ = State::Object;
+        return true;
+    }
+    bool end_object() {
+        if (state_ != State::Object || !hasData_) return false;
+        state_ = State::Done;
+        return true;
+    }
+    bool start_array(std::size_t) {
+        switch (state_) {
+        case State::Start: state_ = State::Rows; return true;
+        case State::Rows:
+            state_ = State::Row;
+            hasRows_ = true;
+            x_ = 0;
+            if (tiles_.rowCount < ChunkTiles::kHeight) tiles_.rowWidths[tiles_.rowCount] = 0;
+            return true;
+        case State::ArraySize: state_ = State::SizeValues; return true;
+        case State::ArrayData: state_ = State::DataValues; return true;
+        default: return false;
+        }
+    }
+    bool end_array() {
+        switch (state_) {
+        case State::Rows: state_ = State::Done; return true;
+        case State::FlatRow:
+            tiles_.rowCount = 1;
+            state_ = State::Done;
+            return true;
+        case State::Row:
+            state_ = State::Rows;
+            if (tiles_.rowCount < ChunkTiles::kHeight) ++tiles_.rowCount;
+            return true;
+        case State::SizeValues:
+            if (dims_ != 2) return false;
+            state_ = State::Object;
+            return true;
+        case State::DataValues: return EndData();
+        default: return false;
+        }
+    }
+    bool parse_error(std::size_t, const std::string&, const json::exception&) { return false; }
+
+    bool Done() const { return state_ == State::Done; }
+
+private:
+    enum class State { Start, Rows, Row, FlatRow, Object, ArrayType, ArraySize, SizeValues, ArrayData, DataValues, Done };
+
+    bool Integer(int64_t value) {
+        if (state_ == State::Rows && flatRow_ && !hasRows_) state_ = State::FlatRow;
+        switch (state_) {
+        case State::FlatRow:
+            if (x_ < ChunkTiles::kWidth) {
+                tiles_.cells[static_cast<size_t>(x_)] = static_cast<int>(value);
+                tiles_.rowWidths[0] = static_cast<uint8_t>(x_ + 1);
+            }
+            ++x_;
+            return true;
+        case State::Row:
+            if (tiles_.rowCount < ChunkTiles::kHeight && x_ < ChunkTiles::kWidth) {
+                tiles_.cells[static_cast<size_t>(tiles_.rowCount) * ChunkTiles::kWidth + x_] = static_cast<int>(value);
+                tiles_.rowWidths[tiles_.rowCount] = static_cast<uint8_t>(x_ + 1);
+            }
+            ++x_;
+            return true;
+        case State::SizeValues:
+            if (value < 0 || dims_ >= 2) return false;
+            size_[dims_++] = static_cast<uint64_t>(value);
+            return true;
+        case State::DataValues: {
+            // 高さ×幅より多ければ壊れている（掛け算があふれないよう割り算で確かめる）
+            if (size_[1] == 0 || count_ / size_[1] >= size_[0]) return false;
+            uint64_t y = count_ / size_[1];
+            uint64_t x = count_ % size_[1];
+            if (y < ChunkTiles::kHeight && x < ChunkTiles::kWidth) {
+                tiles_.cells[static_cast<size_t>(y) * ChunkTiles::kWidth + static_cast<size_t>(x)] = static_cast<int>(value);
+            }
+            ++count_;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    bool EndData() {
+        uint64_t height = size_[0];
+        uint64_t width = size_[1];
+        bool sizeMatches = width == 0 ? count_ == 0 && height <= static_cast<uint64_t>(ChunkTiles::kHeight)
+                                      : count_ / width == height;
+        if (!sizeMatches) return false;
+        tiles_.rowCount = static_cast<int>(std::min<uint64_t>(height, ChunkTiles::kHeight));
+        for (int y = 0; y < tiles_.rowCount; ++y) {
+            tiles_.rowWidths[y] = static_cast<uint8_t>(std::min<uint64_t>(width, ChunkTiles::kWidth));
+        }
+        hasData_ = true;
+        state_ = State::Object;
+        return true;
+    }
+
+    ChunkTiles& tiles_;
+    bool flatRow_;
+    bool hasRows_ = false;
+    State state_ = State::Start;
+    int x_ = 0;
+    uint64_t size_[2] = {};
+    int dims_ = 0;
+    uint64_t count_ = 0;
+    bool hasData_ = false;
+};
+
+enum class ScanResult { Ok, Invalid, Unsupported };
+
+// JSON のキャッシュ（整数の行の配列）を字句解析器を通さずに sax へ渡す（字句解析器は読むたびにトークンの置き場を確保する）
+// 配列と整数以外（小数、文字列、オブジェクトなど）や int64 に収まらない数が出てきたら Unsupported を返す
+// そのときは sax の途中の状態を捨てて、json::sax_parse で読み直す
+ScanResult ScanIntegerArrays(const uint8_t* p, const uint8_t* end, TileCacheSax& sax) {
+    auto isSpace = [](uint8_t c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+    int depth = 0;
+    bool expectValue = true; // 値（'[' か数）を待っている
+    bool afterOpen = false;  // 直前が '['（空の配列なら ']' が来てよい）
+    for (; p != end; ++p) {
+        uint8_t c = *p;
+        if (isSpace(c)) continue;
+        if (c == '[') {
+            if (!expectValue || !sax.start_array(static_cast<std::size_t>(-1))) return ScanResult::Invalid;
+            ++depth;
+            afterOpen = true;
+        } else if (c == ']') {
+            if (depth == 0 || (expectValue && !afterOpen) || !sax.end_array()) return ScanResult::Invalid;
+            expectValue = false;
+            afterOpen = false;
+            if (--depth == 0) {
+                // 最上位の配列の後は空白だけ
+                for (++p; p != end; ++p) {
+                    if (!isSpace(*p)) return ScanResult::Invalid;
+                }
+                return sax.Done() ? ScanResult::Ok : ScanResult::Invalid;
+            }
+        } else if (c == ',') {
+            if (expectValue || depth == 0) return ScanResult::Invalid;
+            expectValue = true;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            if (!expectValue) return ScanResult::Invalid;
+            bool negative = c == '-';
+            if (negative && ++p == end) return ScanResult::Invalid;
+            if (*p < '0' || *p > '9') return ScanResult::Invalid;
+            uint64_t value = 0;
+            for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+                uint64_t digit = static_cast<uint64_t>(*p - '0');
+                if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) return ScanResult::Unsupported;
+                value = value * 10 + digit;
+            }
+            if (p != end && (*p == '.' || *p == 'e' || *p == 'E')) return ScanResult::Unsupported;
+            bool accepted = false;
+            if (!negative) {
+                accepted = sax.number_unsigned(value);
+            } else if (value <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+                accepted = sax.number_integer(-static_cast<int64_t>(value));
+            } else {
+                return ScanResult::Unsupported;
+            }
+            if (!accepted) return ScanResult::Invalid;
+            expectValue = false;
+            afterOpen = false;
+            --p;
+        } else {
+            return ScanResult::Unsupported;
+        }
+    }
+    // 途中で切れている
+    return ScanResult::Invalid;
+}
+
+} // namespace
+
+std::string SheetLayer::Key() const {
+    std::string text = sheetName + "!" + std::to_string(columnOffset) + "," + std::to_string(rowOffset);
+    return ToHex(Fnv1a(text.data(), text.size())).substr(0, 8);
+}
+
+ChunkLoader::ChunkLoader(const std::string& spreadsheetId,
+    const std::string& sheetName,
+    const std::string& apiKey,
+    const std::string& cacheDir)
+    : spreadsheetId_(spreadsheetId)
+    , sheetName_(sheetName)
+    , apiKey_(apiKey)
+    , cacheDir_(cacheDir)
+    , scheduler_(std::make_unique<RequestScheduler>(kDefaultRequestsPerSec, kDefaultRequestBurst))
+    , revisionUrl_("https://www.googleapis.com/drive/v3/files/" + spreadsheetId
+        + "?fields=version&key=" + apiKey) {
+    // キャッシュディレクトリを作成
+    std::filesystem::create_directories(cacheDir_);
+}
+
+ChunkLoader::~ChunkLoader() {
+    scheduler_->Shutdown();
+    // 読み込み前のマニフェストで上書きしない
+    if (curlInitialized_) SaveManifest();
+    if (http_) http_->SaveTlsSessions(TlsSessionPath());
+    http_.reset();
+    if (curlInitialized_) curl_global_cleanup();
+}
+
+void ChunkLoader::Initialize() {
+    curl_global_init(CURL_GLOBAL_ALL);
+    curlInitialized_ = true;
+    http_ = std::make_unique<HttpClient>(maxHostConnections_);
+    // 前回のTLSセッションを再開できるようにしておく
+    http_->LoadTlsSessions(TlsSessionPath());
+    IndexCacheFiles();
+    std::lock_guard<std::mutex> lock(manifestMutex_);
+    LoadManifest();
+}
+
+void ChunkLoader::SetLayers(std::vector<SheetLayer> layers) {
+    layers_ = std::move(layers);
+    layerKeys_.clear();
+    for (const SheetLayer& layer : layers_) layerKeys_.push_back(layer.Key());
+    // 索引はレイヤーの番号で引くので、Initialize の後なら作り直す
+    if (curlInitialized_) IndexCacheFiles();
+}
+
+std::string ChunkLoader::GetSheetRevision() const {
+    std::lock_guard<std::mutex> lock(manifestMutex_);
+    return sheetRevision_;
+}
+
+bool ChunkLoader::HasRemoteChecksums() const {
+    std::lock_guard<std::mutex> lock(manifestMutex_);
+    return !remoteHashes_.empty();
+}
+
+void ChunkLoader::SaveManifest() const {
+    std::lock_guard<std::mutex> lock(manifestMutex_);
+    SaveManifestLocked();
+}
+
+void ChunkLoader::CommitChunk(int cx, int cy, const ChunkTiles& tiles) {
+    auto key = std::make_pair(cx, cy);
+    uint64_t hash = HashTiles(tiles);
+    uint64_t previous = 0;
+    {
+        std::lock_guard<std::mutex> lock(manifestMutex_);
+        auto found = manifest_.find(key);
+        if (found != manifest_.end()) previous = found->second.hash;
+    }
+    // 内容が変わっていなければキャッシュの書き込みを省く
+    // ファイルの書き込みはロックの外で行い、他のチャンクの読み込みやマニフェストの保存を待たせない
+    if (previous != hash || !FindCacheEncoding(cx, cy)) {
+        SaveChunkCache(cx, cy, tiles.ToTileData());
+        for (size_t i = 0; i < tiles.overlays.size() && i < layers_.size(); ++i) {
+            SaveChunkCache(cx, cy, tiles.overlays[i].ToTileData(), static_cast<int>(i) + 1);
+        }
+    }
+    std::lock_guard<std::mutex> lock(manifestMutex_);
+    ManifestEntry& entry = manifest_[key];
+    // 書いている間に別の内容が記録されていたら、どちらのファイルが残ったか分からないので次の記録で書き直させる
+    entry.hash = entry.hash == previous || entry.hash == hash ? hash : 0;
+    entry.revision = sheetRevision_;
+    auto remote = remoteHashes_.find(key);
+    entry.remoteHash = remote != remoteHashes_.end() ? remote->second : std::string();
+}
+
+std::optional<size_t> ChunkLoader::ImportCsvUrl(const std::string& url) {
+    TraceSpan span(tracer_, "ImportCsv");
+    // エラーページを取り込まないよう、成功を確認してから反映する
+    std::vector<std::pair<std::pair<int, int>, ChunkTiles>> chunks;
+    CsvTileParser parser([&chunks](int cx, int cy, ChunkTiles&& tiles) {
+        chunks.emplace_back(std::make_pair(cx, cy), std::move(tiles));
+    });
+    HttpRequest request;
+    request.url = url;
+    request.connectTimeoutMs = connectTimeoutMs_;
+    request.timeoutMs = kBulkTimeoutMs;
+    request.followRedirects = true;
+    request.writeFunction = CsvTileParser::WriteCallback;
+    request.writeData = &parser;
+    HttpResult result = http_->Perform(request);
+    RecordTransfer(result);
+    if (!result.Ok()) return std::nullopt;
+    parser.Finish();
+    for (const auto& chunk : chunks) CommitChunk(chunk.first.first, chunk.first.second, chunk.second);
+    SaveManifest();
+    return chunks.size();
+}
+
+std::optional<size_t> ChunkLoader::ImportCsvFile(const std::filesystem::path& path) {
+    TraceSpan span(tracer_, "ImportCsv");
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return std::nullopt;
+    size_t count = 0;
+    CsvTileParser parser([this, &count](int cx, int cy, ChunkTiles&& tiles) {
+        CommitChunk(cx, cy, tiles);
+        ++count;
+    }, path.extension() == ".tsv" ? '\t' : ',');
+    std::vector<char> buffer(1 << 20);
+    while (ifs.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || ifs.gcount() > 0) {
+        parser.Feed(buffer.data(), static_cast<size_t>(ifs.gcount()));
+    }
+    parser.Finish();
+    SaveManifest();
+    return count;
+}
+
+std::string ChunkLoader::CsvExportUrl(const std::string& gid) const {
+    return "https://docs.google.com/spreadsheets/d/" + spreadsheetId_ + "/export?format=csv&gid=" + gid;
+}
+
+size_t ChunkLoader::WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    size_t realSize = size * nmemb;
+    std::string* buffer = static_cast<std::string*>(userp);
+    buffer->append(static_cast<char*>(contents), realSize);
+    return realSize;
+}
+
+bool ChunkLoader::CheckOnlineStatus() const {
+    HttpRequest request;
+    request.url = "https://www.google.com";
+    request.timeoutMs = 5000;
+    request.headOnly = true;
+    return http_->Perform(request).code == CURLE_OK;
+}
+
+bool ChunkLoader::RefreshRevision(RevisionChange* change) {
+    std::string buffer;
+    HttpRequest request;
+    request.url = revisionUrl_;
+    request.timeoutMs = 5000;
+    request.writeFunction = WriteCallback;
+    request.writeData = &buffer;
+    HttpResult result = http_->Perform(request);
+    // エラー応答（403・429・5xx やエラーページ）ではリビジョンもチェックサムも変えない
+    if (!result.Ok()) return false;
+
+    std::string revision;
+    std::unordered_map<std::pair<int, int>, std::string, PairHash> remoteHashes;
+    json j = json::parse(buffer, nullptr, false);
+    if (!j.is_object()) return false;
+    if (j.contains("version")) {
+        // Driveメタデータ: version はシート編集ごとに増える
+        if (!CellText(j["version"], revision)) return false;
+    } else if (j.contains("values") && j["values"].is_array()) {
+        // チェックサムRange: 各行 [cx, cy, hash]。Range全体のハッシュをリビジョンとする
+        for (const auto& row : j["values"]) {
+            int cx = 0, cy = 0;
+            std::string x, y, hash;
+            if (!row.is_array() || row.size() < 3
+                || !CellText(row[0], x) || !CellText(row[1], y) || !CellText(row[2], hash)
+                || !ParseInt(x, cx) || !ParseInt(y, cy)) {
+                continue; // 見出し行など
+            }
+            remoteHashes[{ cx, cy }] = hash;
+        }
+        std::string values = j["values"].dump();
+        revision = ToHex(Fnv1a(values.data(), values.size()));
+    }
+    if (revision.empty()) return false;
+
+    std::lock_guard<std::mutex> lock(manifestMutex_);
+    if (change) {
+        *change = RevisionChange();
+        change->changed = revision != sheetRevision_;
+        // 前回のチェックサムがなければ、どのチャンクが変わったか分からない
+        change->allChunks = change->changed && (remoteHashes.empty() || remoteHashes_.empty());
+        if (change->changed && !change->allChunks) {
+            for (const auto& kv : remoteHashes) {
+                auto it = remoteHashes_.find(kv.first);
+                if (it == remoteHashes_.end() || it->second != kv.second) change->chunks.push_back(kv.first);
+            }
+            for (const auto& kv : remoteHashes_) {
+                if (remoteHashes.find(kv.first) == remoteHashes.end()) change->chunks.push_back(kv.first);
+            }
+        }
+    }
+    remoteHashes_ = std::move(remoteHashes);
+    if (revision != sheetRevision_) {
+        // チェックサムが一致するチャンクは新しいリビジョンでも有効
+        for (auto& kv : manifest_) {
+            auto it = remoteHashes_.find(kv.first);
+            if (it != remoteHashes_.end() && !kv.second.remoteHash.empty()
+                && it->second == kv.second.remoteHash && kv.second.revision == sheetRevision_) {
+                kv.second.revision = revision;
+            }
+        }
+    }
+    sheetRevision_ = revision;
+    SaveManifestLocked();
+    return true;
+}
+
+bool ChunkLoader::ApplyRemoteChanges(const std::string& fromRevision, const std::string& toRevision,
+    const std::vector<std::pair<int, int>>& chunks) {
+    std::unordered_set<std::pair<int, int>, PairHash> changed(chunks.begin(), chunks.end());
+    std::lock_guard<std::mutex> lock(manifestMutex_);
+    if (fromRevision.empty() || toRevision.empty() || sheetRevision_ != fromRevision) return false;
+    for (auto& kv : manifest_) {
+        if (changed.count(kv.first)) {
+            // リビジョンが同じままでも再取得させる
+            kv.second.revision.clear();
+            kv.second.remoteHash.clear();
+        } else if (kv.second.revision == fromRevision) {
+            kv.second.revision = toRevision;
+        }
+    }
+    for (const auto& key : chunks) remoteHashes_.erase(key);
+    sheetRevision_ = toRevision;
+    SaveManifestLocked();
+    return true;
+}
+
+std::filesystem::path ChunkLoader::TlsSessionPath() const {
+    return std::filesystem::path(cacheDir_) / "tls_sessions.cbor";
+}
+
+std::optional<SheetSize> ChunkLoader::FetchSheetSize() const {
+    std::string buffer;
+    HttpRequest request;
+    request.url = apiBaseUrl_ + "/v4/spreadsheets/" + spreadsheetId_
+        + "?fields=sheets.properties(title,gridProperties(rowCount,columnCount))&key=" + apiKey_;
+    request.connectTimeoutMs = connectTimeoutMs_;
+    request.timeoutMs = totalTimeoutMs_;
+    request.writeFunction = WriteCallback;
+    request.writeData = &buffer;
+    // 読み取りクォータを1つ使う
+    if (!scheduler_->Acquire(std::make_shared<LoadTicket>())) return std::nullopt;
+    HttpResult result = http_->Perform(request);
+    if (!result.Ok()) return std::nullopt;
+    json j = json::parse(buffer, nullptr, false);
+    if (!j.is_object() || !j.contains("sheets")) return std::nullopt;
+    for (const auto& sheet : j["sheets"]) {
+        json properties = sheet.value("properties", json::object());
+        if (properties.value("title", "") != sheetName_) continue;
+        json grid = properties.value("gridProperties", json::object());
+        return SheetSize{ grid.value("columnCount", 0), grid.value("rowCount", 0) };
+    }
+    return std::nullopt;
+}
+
+bool ChunkLoader::IsChunkFresh(int cx, int cy) const {
+    {
+        std::lock_guard<std::mutex> lock(manifestMutex_);
+        if (sheetRevision_.empty()) return false;
+        auto it = manifest_.find({ cx, cy });
+        if (it == manifest_.end() || it->second.revision != sheetRevision_) return false;
+    }
+    return FindCacheEncoding(cx, cy).has_value();
+}
+
+void ChunkLoader::LoadManifest() {
+    manifest_.clear();
+    std::filesystem::path path = std::filesystem::path(cacheDir_) / "manifest.json";
+    if (!std::filesystem::exists(path)) return;
+    std::ifstream ifs(path);
+    json j = json::parse(ifs, nullptr, false);
+    // 壊れたマニフェストは空として扱う（どのチャンクも未検証になり、シートから取り直す）
+    if (!j.is_object()) return;
+    std::string revision;
+    auto chunks = j.find("chunks");
+    if (!OptionalString(j, "revision", revision) || chunks == j.end() || !chunks->is_object()) return;
+    for (auto& [key, value] : chunks->items()) {
+        int cx = 0, cy = 0;
+        if (!ParseChunkKey(key, cx, cy)) continue;
+        ManifestEntry entry;
+        std::string hash;
+        if (!value.is_object() || !OptionalString(value, "hash", hash) || !ParseHex(hash, entry.hash)
+            || !OptionalString(value, "remoteHash", entry.remoteHash)
+            || !OptionalString(value, "revision", entry.revision)) {
+            manifest_.clear();
+            return;
+        }
+        manifest_[{ cx, cy }] = std::move(entry);
+    }
+    sheetRevision_ = std::move(revision);
+}
+
+void ChunkLoader::SaveManifestLocked() const {
+    json j;
+    j["revision"] = sheetRevision_;
+    j["chunks"] = json::object();
+    for (const auto& kv : manifest_) {
+        j["chunks"][ChunkKey(kv.first.first, kv.first.second)] = {
+            { "hash", ToHex(kv.second.hash) },
+            { "remoteHash", kv.second.remoteHash },
+            { "revision", kv.second.revision },
+        };
+    }
+    std::ofstream ofs(std::filesystem::path(cacheDir_) / "manifest.json");
+    ofs << j.dump();
+}
+
+uint64_t ChunkLoader::HashTiles(const ChunkTiles& tiles) {
+    // 行の長さも含めて形の違いを区別する（TileData の行ごとに並べた場合と同じ値）
+    uint64_t h = Fnv1a(nullptr, 0);
+    for (int y = 0; y < tiles.rowCount; ++y) {
+        uint64_t width = tiles.rowWidths[y];
+        h = Fnv1a(&width, sizeof(width), h);
+        h = Fnv1a(&tiles.cells[static_cast<size_t>(y) * ChunkTiles::kWidth], width * sizeof(int), h);
+    }
+    // 追加レイヤーは区切りを挟んで続ける（追加レイヤーがなければ1レイヤーのときと同じ値）
+    for (const ChunkTiles& overlay : tiles.overlays) {
+        static constexpr uint64_t kLayerSeparator = ~uint64_t{ 0 };
+        uint64_t layerHash = HashTiles(overlay);
+        h = Fnv1a(&kLayerSeparator, sizeof(kLayerSeparator), h);
+        h = Fnv1a(&layerHash, sizeof(layerHash), h);
+    }
+    return h;
+}
+
+void ChunkTiles::Assign(const TileData& data) {
+    rowCount = static_cast<int>(std::min(data.size(), static_cast<size_t>(kHeight)));
+    for (int y = 0; y < rowCount; ++y) {
+        const std::vector<int>& row = data[y];
+        size_t width = std::min(row.size(), static_cast<size_t>(kWidth));
+        rowWidths[y] = static_cast<uint8_t>(width);
+        std::copy(row.begin(), row.begin() + static_cast<std::ptrdiff_t>(width), cells.begin() + y * kWidth);
+    }
+}
+
+void ChunkTiles::Clear() {
+    rowCount = 0;
+    rowWidths.fill(0);
+    overlays.clear();
+}
+
+void ChunkTiles::Set(int x, int y, int tile) {
+    for (; rowCount <= y; ++rowCount) rowWidths[rowCount] = 0;
+    for (int w = rowWidths[y]; w <= x; ++w) cells[y * kWidth + w] = 0;
+    rowWidths[y] = static_cast<uint8_t>(std::max<int>(rowWidths[y], x + 1));
+    cells[y * kWidth + x] = tile;
+}
+
+TileData ChunkTiles::ToTileData() const {
+    TileData data(rowCount);
+    for (int y = 0; y < rowCount; ++y) {
+        data[y].assign(cells.begin() + y * kWidth, cells.begin() + y * kWidth + rowWidths[y]);
+    }
+    return data;
+}
+
+std::string ChunkLoader::ColIndexToName(int index) {
+    std::string name;
+    while (index >= 0) {
+        int rem = index % 26;
+        name.insert(name.begin(), static_cast<char>('A' + rem));
+        index = index / 26 - 1;
+    }
+    return name;
+}
+
+int ChunkLoader::ColNameToIndex(const std::string& name) {
+    if (name.empty()) return -1;
+    int index = 0;
+    for (char c : name) {
+        if (c < 'A' || c > 'Z' || index > (1 << 20)) return -1;
+        index = index * 26 + (c - 'A' + 1);
+    }
+    return index - 1;
+}
+
+bool ChunkLoader::ParseCellName(const std::string& cell, int& col, int& row) {
+    size_t digits = cell.find_first_of("0123456789");
+    if (digits == 0 || digits == std::string::npos) return false;
+    col = ColNameToIndex(cell.substr(0, digits));
+    const char* end = cell.data() + cell.size();
+    auto result = std::from_chars(cell.data() + digits, end, row);
+    return col >= 0 && result.ec == std::errc() && result.ptr == end && row >= 1;
+}
+
+std::string ChunkLoader::ChunkRange(int layer, int cx, int cy) const {
+    return CellRange(layer, cx * kChunkWidth, cy * kChunkHeight, kChunkWidth, kChunkHeight);
+}
+
+std::string ChunkLoader::CellRange(int layer, int x, int y, int width, int height) const {
+    const SheetLayer* def = layer > 0 ? &layers_[static_cast<size_t>(layer) - 1] : nullptr;
+    int column = x + (def ? def->columnOffset : 0);
+    int row = y + (def ? def->rowOffset : 0);
+    const std::string& sheet = def && !def->sheetName.empty() ? def->sheetName : sheetName_;
+    return sheet + "!" + ColIndexToName(column) + std::to_string(row + 1)
+        + ":" + ColIndexToName(column + width - 1) + std::to_string(row + height);
+}
+
+std::optional<TileData> ChunkLoader::LoadFromSheet(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket) const {
+    std::optional<std::vector<TileData>> layers = LoadLayersFromSheet(cx, cy, ticket);
+    if (!layers) return std::nullopt;
+    return std::move(layers->front());
+}
+
+std::optional<std::vector<TileData>> ChunkLoader::LoadLayersFromSheet(int cx, int cy,
+    const std::shared_ptr<LoadTicket>& ticket) const {
+    size_t layerCount = layers_.size() + 1;
+    HttpRequest request;
+    if (layerCount == 1) {
+        request.url = apiBaseUrl_ + "/v4/spreadsheets/" + spreadsheetId_
+            + "/values/" + ChunkRange(0, cx, cy) + "?key=" + apiKey_;
+    } else {
+        // 全レイヤーを1リクエストで取得する（valueRanges は ranges と同じ順に返る）
+        request.url = apiBaseUrl_ + "/v4/spreadsheets/" + spreadsheetId_ + "/values:batchGet?";
+        for (size_t i = 0; i < layerCount; ++i) request.url += "ranges=" + ChunkRange(static_cast<int>(i), cx, cy) + "&";
+        request.url += "key=" + apiKey_;
+    }
+    request.connectTimeoutMs = connectTimeoutMs_;
+    request.timeoutMs = totalTimeoutMs_;
+    request.writeFunction = SheetValuesParser::WriteCallback;
+    // 読み込みが取り消されたら転送も打ち切る（チケットを所有したまま cancelled を指す）
+    request.cancel = HttpCancelFlag(ticket, &ticket->cancelled);
+
+    for (int attempt = 0; attempt <= kMaxLoadRetries; ++attempt) {
+        auto queued = std::chrono::steady_clock::now();
+        if (!scheduler_->Acquire(ticket)) return std::nullopt;
+        stats_.Record(PipelineStage::QueueWait,
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queued).count());
+        // 受信しながら行単位で組み立てる（レスポンス全体を保持しない）
+        // ヘッジ用の複製は別のバッファへ書き、勝った方を使う
+        std::vector<TileData> data[2] = { std::vector<TileData>(layerCount), std::vector<TileData>(layerCount) };
+        auto append = [&data, layerCount](int copy, int rangeIndex, std::vector<int>&& row) {
+            // 単一 Range のレスポンスは 0
+            size_t layer = static_cast<size_t>(std::max(rangeIndex, 0));
+            if (layer < layerCount) data[copy][layer].push_back(std::move(row));
+        };
+        SheetValuesParser parsers[2] = {
+            SheetValuesParser([&append](int rangeIndex, std::vector<int>&& row) { append(0, rangeIndex, std::move(row)); }),
+            SheetValuesParser([&append](int rangeIndex, std::vector<int>&& row) { append(1, rangeIndex, std::move(row)); }),
+        };
+        HttpRequest requests[2] = { request, request };
+        requests[0].writeData = &parsers[0];
+        requests[1].writeData = &parsers[1];
+
+        auto start = std::chrono::steady_clock::now();
+        HttpResult result;
+        int winner = 0;
+        stats_.BeginTransfer();
+        {
+            TraceSpan span(tracer_, "Transfer", cx, cy);
+            bool visible = ticket->priority == static_cast<int>(LoadPriority::Visible);
+            if (hedgingEnabled_ && visible && chunkLatency_.Count() >= kMinHedgeSamples) {
+                auto hedgeAfter = std::chrono::milliseconds(static_cast<long long>(
+                    std::max(kMinHedgeDelayMs, chunkLatency_.Percentile(0.95))));
+                result = http_->PerformHedged(requests[0], requests[1], hedgeAfter,
+                    [this, &ticket]() { return !ticket->cancelled && scheduler_->TryAcquire(); }, &winner);
+            } else {
+                result = http_->Perform(requests[0]);
+            }
+        }
+        stats_.EndTransfer();
+        RecordTransfer(result);
+        stats_.Record(PipelineStage::Parse, parsers[winner].ParseMs());
+        if (result.Ok() && parsers[winner].IsComplete()) {
+            chunkLatency_.Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            return std::move(data[winner]);
+        }
+
+        // 429・5xx・通信エラーのみ再試行する
+        bool retryable = result.code != CURLE_OK || result.status == 429 || result.status >= 500;
+        if (!retryable) return std::nullopt;
+        std::chrono::milliseconds delay = scheduler_->BackoffDelay(attempt);
+        if (result.retryAfterSec >= 0) {
+            std::chrono::milliseconds retryAfter(result.retryAfterSec * 1000);
+            scheduler_->PauseFor(retryAfter);
+            delay = std::max(delay, retryAfter);
+        }
+        if (!scheduler_->Wait(ticket, delay)) return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+std::optional<std::vector<CellBlock>> ChunkLoader::ReadCells(std::vector<CellBlock> blocks,
+    const std::shared_ptr<LoadTicket>& ticket) const {
+    // 矩形が多いと batchGet の URL が長くなりすぎるので、Range をボディで送る
+    json filters = json::array();
+    for (const CellBlock& block : blocks) {
+        filters.push_back({ { "a1Range", CellRange(block.layer, block.x, block.y, block.width, block.height) } });
+    }
+    json body = { { "dataFilters", std::move(filters) }, { "majorDimension", "ROWS" } };
+    std::optional<std::string> response = PostJson(apiBaseUrl_ + "/v4/spreadsheets/" + spreadsheetId_
+        + "/values:batchGetByDataFilter?key=" + apiKey_, body.dump(), ticket);
+    if (!response) return std::nullopt;
+
+    for (CellBlock& block : blocks) block.values.assign(static_cast<size_t>(block.width) * static_cast<size_t>(block.height), 0);
+    // valueRanges は dataFilters と同じ順に返る（行の番号は受け取った順）
+    std::vector<int> rowsSeen(blocks.size(), 0);
+    SheetValuesParser parser([&blocks, &rowsSeen](int rangeIndex, std::vector<int>&& row) {
+        if (rangeIndex < 0 || static_cast<size_t>(rangeIndex) >= blocks.size()) return;
+        CellBlock& block = blocks[static_cast<size_t>(rangeIndex)];
+        int y = rowsSeen[static_cast<size_t>(rangeIndex)]++;
+        if (y >= block.height) return;
+        int width = std::min(static_cast<int>(row.size()), block.width);
+        std::copy(row.begin(), row.begin() + width, block.values.begin() + y * block.width);
+    });
+    if (!parser.Feed(response->data(), response->size()) || !parser.IsComplete()) return std::nullopt;
+    return blocks;
+}
+
+bool ChunkLoader::WriteCells(const std::vector<CellBlock>& blocks, const std::shared_ptr<LoadTicket>& ticket) const {
+    json data = json::array();
+    for (const CellBlock& block : blocks) {
+        json rows = json::array();
+        for (int y = 0; y < block.height; ++y) {
+            json row = json::array();
+            for (int x = 0; x < block.width; ++x) {
+                int tile = block.values[static_cast<size_t>(y * block.width + x)];
+                // 空のタイルはセルを空にする（読み込むと 0 に戻る）
+                if (tile == 0) row.push_back("");
+                else row.push_back(tile);
+            }
+            rows.push_back(std::move(row));
+        }
+        data.push_back({
+            { "range", CellRange(block.layer, block.x, block.y, block.width, block.height) },
+            { "majorDimension", "ROWS" },
+            { "values", std::move(rows) },
+        });
+    }
+    json body = { { "valueInputOption", "RAW" }, { "data", std::move(data) } };
+    return PostJson(apiBaseUrl_ + "/v4/spreadsheets/" + spreadsheetId_ + "/values:batchUpdate?key=" + apiKey_,
+        body.dump(), ticket).has_value();
+}
+
+std::optional<std::string> ChunkLoader::PostJson(const std::string& url, const std::string& body,
+    const std::shared_ptr<LoadTicket>& ticket) const {
+    HttpRequest request;
+    request.url = url;
+    request.body = body;
+    request.headers.push_back("Content-Type: application/json");
+    {
+        std::lock_guard<std::mutex> lock(accessTokenMutex_);
+        if (!accessToken_.empty()) request.headers.push_back("Authorization: Bearer " + accessToken_);
+    }
+    request.connectTimeoutMs = connectTimeoutMs_;
+    request.timeoutMs = totalTimeoutMs_;
+    request.writeFunction = WriteCallback;
+
+    for (int attempt = 0; attempt <= kMaxLoadRetries; ++attempt) {
+        if (!scheduler_->Acquire(ticket)) return std::nullopt;
+        std::string buffer;
+        request.writeData = &buffer;
+        HttpResult result;
+        {
+            TraceSpan span(tracer_, "Post");
+            result = http_->Perform(request);
+        }
+        RecordTransfer(result);
+        if (result.Ok()) return buffer;
+
+        bool retryable = result.code != CURLE_OK || result.status == 429 || result.status >= 500;
+        if (!retryable) return std::nullopt;
+        std::chrono::milliseconds delay = scheduler_->BackoffDelay(attempt);
+        if (result.retryAfterSec >= 0) {
+            std::chrono::milliseconds retryAfter(result.retryAfterSec * 1000);
+            scheduler_->PauseFor(retryAfter);
+            delay = std::max(delay, retryAfter);
+        }
+        if (!scheduler_->Wait(ticket, delay)) return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+void ChunkLoader::RecordTransfer(const HttpResult& result) const {
+    if (result.code != CURLE_OK) return;
+    // curl の時間は転送開始からの累積なので、区間ごとの差にする
+    if (result.newConnection) {
+        stats_.Record(PipelineStage::NameLookup, result.nameLookupMs);
+        stats_.Record(PipelineStage::Connect, result.connectMs - result.nameLookupMs);
+        if (result.appConnectMs > 0.0) stats_.Record(PipelineStage::Tls, result.appConnectMs - result.connectMs);
+    }
+    stats_.Record(PipelineStage::FirstByte, result.startTransferMs);
+    stats_.Record(PipelineStage::Transfer, result.totalMs);
+    stats_.AddBytesReceived(result.bytesReceived);
+}
+
+bool ChunkLoader::LoadChunkCache(int cx, int cy, ChunkTiles& tiles, int layer) {
+    std::optional<CacheEncoding> encoding = FindCacheEncoding(cx, cy, layer);
+    if (!encoding) return false;
+    auto start = std::chrono::steady_clock::now();
+    // パスとファイルの中身はスレッドごとに使い回す（容量が足りていれば確保しない）
+    thread_local std::string path;
+    thread_local std::vector<uint8_t> bytes;
+    path.assign(cacheDir_);
+    path += '/';
+    AppendCacheFileName(path, cx, cy, *encoding, layer);
+    bool ok = ReadWholeFile(path, bytes);
+    if (ok) {
+        TraceSpan span(tracer_, "DecodeTiles", cx, cy);
+        ok = DecodeTiles(bytes.data(), bytes.size(), *encoding, tiles);
+    }
+    stats_.Record(PipelineStage::CacheRead,
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    if (!ok) {
+        // 壊れたファイルは検証済みとみなさず、次にシートから取得したときに書き直す
+        std::lock_guard<std::mutex> lock(manifestMutex_);
+        auto found = manifest_.find({ cx, cy });
+        if (found != manifest_.end()) {
+            found->second.hash = 0;
+            found->second.revision.clear();
+        }
+    }
+    return ok;
+}
+
+void ChunkLoader::SaveChunkCache(int cx, int cy, const TileData& data, int layer) {
+    TraceSpan span(tracer_, "SaveChunkCache", cx, cy);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> bytes = EncodeTiles(data, cacheEncoding_);
+    std::ofstream ofs(CachePath(cx, cy, cacheEncoding_, layer), std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    ofs.close();
+    // 他形式の古いファイルが優先されないように消しておく
+    for (CacheEncoding e : kCacheEncodings) {
+        if (e == cacheEncoding_) continue;
+        std::error_code ec;
+        std::filesystem::remove(CachePath(cx, cy, e, layer), ec);
+    }
+    {
+        std::lock_guard<std::mutex> lock(cacheFilesMutex_);
+        uint8_t bit = static_cast<uint8_t>(1u << static_cast<int>(cacheEncoding_));
+        if (ofs) {
+            cacheFiles_[{ cx, cy, layer }] = bit;
+        } else {
+            cacheFiles_.erase({ cx, cy, layer });
+        }
+    }
+    stats_.Record(PipelineStage::CacheWrite,
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+std::filesystem::path ChunkLoader::CachePath(int cx, int cy, CacheEncoding encoding, int layer) const {
+    std::string name;
+    AppendCacheFileName(name, cx, cy, encoding, layer);
+    return std::filesystem::path(cacheDir_) / name;
+}
+
+void ChunkLoader::AppendCacheFileName(std::string& out, int cx, int cy, CacheEncoding encoding, int layer) const {
+    out += "chunk_";
+    AppendInt(out, cx);
+    out += '_';
+    AppendInt(out, cy);
+    // 追加レイヤーはレイヤーの定義ごとに別のファイル（主レイヤーは従来どおりの名前）
+    if (layer > 0) {
+        out += '_';
+        out += layerKeys_[static_cast<size_t>(layer) - 1];
+    }
+    out += kCacheExtensions[static_cast<int>(encoding)];
+}
+
+std::optional<CacheEncoding> ChunkLoader::FindCacheEncoding(int cx, int cy, int layer) const {
+    uint8_t bits = 0;
+    {
+        std::lock_guard<std::mutex> lock(cacheFilesMutex_);
+        auto found = cacheFiles_.find({ cx, cy, layer });
+        if (found == cacheFiles_.end()) return std::nullopt;
+        bits = found->second;
+    }
+    // 現在の書き込み形式を優先し、無ければ他形式（従来の .json を含む）を読む
+    if (bits & (1u << static_cast<int>(cacheEncoding_))) return cacheEncoding_;
+    for (CacheEncoding e : kCacheEncodings) {
+        if (bits & (1u << static_cast<int>(e))) return e;
+    }
+    return std::nullopt;
+}
+
+void ChunkLoader::IndexCacheFiles() {
+    std::unordered_map<CacheFileKey, uint8_t, CacheFileKeyHash> files;
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(cacheDir_, ec); !ec && it != std::filesystem::directory_iterator();
+         it.increment(ec)) {
+        // chunk_cx_cy[_レイヤーのキー].拡張子
+        std::string name = it->path().filename().string();
+        size_t dot = name.rfind('.');
+        if (name.rfind("chunk_", 0) != 0 || dot == std::string::npos) continue;
+        int encoding = -1;
+        for (int e = 0; e < static_cast<int>(std::size(kCacheExtensions)); ++e) {
+            if (name.compare(dot, std::string::npos, kCacheExtensions[e]) == 0) encoding = e;
+        }
+        std::string stem = name.substr(6, dot - 6);
+        // 座標は負のこともあるので、区切りは2文字目から探す
+        size_t first = stem.find('_', 1);
+        size_t second = first == std::string::npos ? std::string::npos : stem.find('_', first + 2);
+        CacheFileKey key;
+        if (encoding < 0 || first == std::string::npos || !ParseInt(stem.substr(0, first), key.cx)
+            || !ParseInt(stem.substr(first + 1, second == std::string::npos ? std::string::npos : second - first - 1), key.cy)) {
+            continue;
+        }
+        if (second != std::string::npos) {
+            // 今の定義にないレイヤーのファイルは読まない
+            auto layer = std::find(layerKeys_.begin(), layerKeys_.end(), stem.substr(second + 1));
+            if (layer == layerKeys_.end()) continue;
+            key.layer = static_cast<int>(layer - layerKeys_.begin()) + 1;
+        }
+        files[key] |= static_cast<uint8_t>(1u << encoding);
+    }
+    std::lock_guard<std::mutex> lock(cacheFilesMutex_);
+    cacheFiles_ = std::move(files);
+}
+
+std::vector<uint8_t> ChunkLoader::EncodeTiles(const TileData& data, CacheEncoding encoding) {
+    json j(data);
+    switch (encoding) {
+    case CacheEncoding::Cbor:
+        return json::to_cbor(j);
+    case CacheEncoding::MessagePack:
+        return json::to_msgpack(j);
+    case CacheEncoding::BJData: {
+        // 矩形かつ全タイルが uint8 に収まるなら [高さ, 幅] の ndarray にする
+        bool packable = !data.empty() && !data[0].empty();
+        for (const auto& row : data) {
+            packable = packable && row.size() == data[0].size();
+            for (int v : row) packable = packable && v >= 0 && v <= 0xFF;
+        }
+        if (packable) {
+            std::vector<uint8_t> flat;
+            flat.reserve(data.size() * data[0].size());
+            for (const auto& row : data) {
+                for (int v : row) flat.push_back(static_cast<uint8_t>(v));
+            }
+            j = {
+                { "_ArrayType_", "uint8" },
+                { "_ArraySize_", { data.size(), data[0].size() } },
+                { "_ArrayData_", flat },
+            };
+        }
+        return json::to_bjdata(j, true, true);
+    }
+    default: {
+        std::string text = j.dump();
+        return std::vector<uint8_t>(text.begin(), text.end());
+    }
+    }
+}
+
+bool ChunkLoader::DecodeTiles(const uint8_t* bytes, size_t size, CacheEncoding encoding, ChunkTiles& tiles) {
+    tiles.rowCount = 0;
+    tiles.rowWidths.fill(0);
+    // 途中で切れたファイルや形の合わない値は、途中で読むのをやめて false を返す
+    if (encoding == CacheEncoding::Json) {
+        TileCacheSax sax(tiles, false);
+        ScanResult result = ScanIntegerArrays(bytes, bytes + size, sax);
+        if (result != ScanResult::Unsupported) {
+            if (result == ScanResult::Invalid) {
+                tiles.rowCount = 0;
+                tiles.rowWidths.fill(0);
+            }
+            return result == ScanResult::Ok;
+        }
+        tiles.rowCount = 0;
+        tiles.rowWidths.fill(0);
+    }
+    TileCacheSax sax(tiles, encoding == CacheEncoding::BJData);
+    json::input_format_t format = json::input_format_t::json;
+    switch (encoding) {
+    case CacheEncoding::Cbor: format = json::input_format_t::cbor; break;
+    case CacheEncoding::MessagePack: format = json::input_format_t::msgpack; break;
+    case CacheEncoding::BJData: format = json::input_format_t::bjdata; break;
+    default: break;
+    }
+    bool ok = false;
+    try {
+        ok = json::sax_parse(bytes, bytes + size, &sax, format, true) && sax.Done();
+    } catch (const json::exception&) {
+        ok = false;
+    }
+    if (!ok) {
+        tiles.rowCount = 0;
+        tiles.rowWidths.fill(0);
+    }
+    return ok;
+}
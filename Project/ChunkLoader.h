@@ -0,0 +1,336 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <array>
+#include <unordered_map>
+#include <filesystem>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <cstdint>
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+#include "SheetValuesParser.h"
+#include "HttpClient.h"
+#include "RequestScheduler.h"
+#include "PipelineStats.h"
+#include "TraceRecorder.h"
+
+using json = nlohmann::json;
+using TileData = std::vector<std::vector<int>>;
+
+// ペア<int,int> 用のハッシュ関数
+struct PairHash {
+    size_t operator()(const std::pair<int, int>& p) const noexcept {
+        return (static_cast<size_t>(p.first) << 32) ^ static_cast<unsigned int>(p.second);
+    }
+};
+
+// チャンク1枚分のタイル。固定長で持ち、行ごとの確保をしない
+struct ChunkTiles {
+    static constexpr int kWidth = 6;
+    static constexpr int kHeight = 6;
+
+    // 追加レイヤーはこのアロケーターのメモリリソースから確保する
+    // pmr のコンテナに入れると、コンテナと同じメモリリソースが渡される
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    std::array<int, kWidth * kHeight> cells{};
+    std::array<uint8_t, kHeight> rowWidths{}; // シートの端では行が短い
+    int rowCount = 0;
+    // 追加レイヤー（ChunkLoader::SetLayers の順。このチャンク自身が主レイヤー）
+    // レイヤーごとにセルが並ぶので、1レイヤーだけを描くときに他のレイヤーを読まない
+    // 追加レイヤーを持たない取得元（.trwp、CSV、生成）では空のまま
+    std::pmr::vector<ChunkTiles> overlays;
+
+    ChunkTiles() = default;
+    explicit ChunkTiles(const allocator_type& alloc) : overlays(alloc) {}
+    ChunkTiles(const ChunkTiles& other, const allocator_type& alloc)
+        : cells(other.cells), rowWidths(other.rowWidths), rowCount(other.rowCount), overlays(other.overlays, alloc) {}
+    ChunkTiles(ChunkTiles&& other, const allocator_type& alloc)
+        : cells(other.cells), rowWidths(other.rowWidths), rowCount(other.rowCount), overlays(std::move(other.overlays), alloc) {}
+    ChunkTiles(const ChunkTiles&) = default;
+    ChunkTiles(ChunkTiles&&) = default;
+    ChunkTiles& operator=(const ChunkTiles&) = default;
+    ChunkTiles& operator=(ChunkTiles&&) = default;
+
+    // チャンクの大きさを超える部分は捨てる
+    void Assign(const TileData& data);
+    // 空にする（追加レイヤーの確保は残し、同じ ChunkTiles に読み直すときに使い回す）
+    void Clear();
+    TileData ToTileData() const;
+    // 1セルを書き換える。行の外なら、間のセルを空（0）にして行を延ばす
+    void Set(int x, int y, int tile);
+    bool Empty() const { return rowCount == 0; }
+    int Width(int y) const { return rowWidths[y]; }
+    int At(int x, int y) const { return cells[y * kWidth + x]; }
+};
+
+// チャンクキャッシュのエンコード形式
+enum class CacheEncoding {
+    Json,        // .json（従来形式）
+    Cbor,        // .cbor
+    MessagePack, // .msgpack
+    BJData,      // .bjd（uint8に収まる矩形タイルはndarrayで格納）
+};
+
+// マニフェストのチャンク記録（内容ハッシュと検証済みリビジョン）
+struct ManifestEntry {
+    uint64_t hash = 0;
+    std::string remoteHash;
+    std::string revision;
+};
+
+// 主レイヤー以外のレイヤーのシート上の位置（地面・当たり判定・装飾などを別のタブや同じシートの別の範囲に置く）
+struct SheetLayer {
+    std::string sheetName;  // 空なら主レイヤーと同じシート
+    int columnOffset = 0;   // チャンク (0, 0) の左上のセルが、主レイヤーより何列・何行ずれているか
+    int rowOffset = 0;
+
+    // キャッシュファイルの名前に使う（定義を変えると別のファイルになり、古い内容を読まない）
+    std::string Key() const;
+};
+
+// シートへ書き戻す・読み直す矩形（タイル座標。values は行優先で width * height 個）
+struct CellBlock {
+    int layer = 0; // 0 が主レイヤー、1 以降が ChunkLoader::SetLayers の順
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<int> values;
+};
+
+// リビジョン確認や変更フィードで分かったシートの変更
+struct RevisionChange {
+    bool changed = false;   // リビジョンが変わった
+    bool allChunks = false; // どのチャンクが変わったか分からない（Drive の version だけのとき）
+    std::vector<std::pair<int, int>> chunks; // 内容が変わったチャンク（allChunks なら空）
+};
+
+// シートのグリッドの大きさ（セルの入っていない末尾の行・列を含む）
+struct SheetSize {
+    int columns = 0;
+    int rows = 0;
+};
+
+// シートからのチャンク取得とディスクキャッシュ（描画に依存しない。ゲームとタイルゲートウェイで共用）
+// LoadFromSheet / LoadChunkCache / CommitChunk / IsChunkFresh は複数スレッドから呼べる
+class ChunkLoader {
+public:
+    // スプレッドシートID、シート名、APIキー、キャッシュディレクトリ
+    ChunkLoader(const std::string& spreadsheetId,
+        const std::string& sheetName,
+        const std::string& apiKey,
+        const std::string& cacheDir = "cache");
+    ~ChunkLoader();
+    ChunkLoader(const ChunkLoader&) = delete;
+    ChunkLoader& operator=(const ChunkLoader&) = delete;
+
+    // 通信の準備（curl初期化、TLSセッションとマニフェストの読み込み）
+    void Initialize();
+    // 順番待ちの取得を打ち切る（破棄の前に、取得中のスレッドを止めるため）
+    void Shutdown() { scheduler_->Shutdown(); }
+
+    // リビジョン確認URL（既定: Driveメタデータ。モックサーバーのチェックサムRangeも可）
+    void SetRevisionUrl(const std::string& url) { revisionUrl_ = url; }
+    // キャッシュ書き込み形式（読み込みは全形式と従来の .json に対応）
+    void SetCacheEncoding(CacheEncoding encoding) { cacheEncoding_ = encoding; }
+    // Sheets API の接続先（モックサーバーやゲートウェイに向ける場合）
+    void SetApiBaseUrl(const std::string& url) { apiBaseUrl_ = url; }
+    // 読み取りクォータ（1秒あたりのリクエスト数とバースト）
+    void SetRequestQuota(double ratePerSec, double burst) { scheduler_->SetRate(ratePerSec, burst); }
+    // 1リクエストの接続期限と全体期限（ミリ秒）
+    void SetRequestDeadlines(long connectTimeoutMs, long totalTimeoutMs) {
+        connectTimeoutMs_ = connectTimeoutMs;
+        totalTimeoutMs_ = totalTimeoutMs;
+    }
+    // 1ホストあたりの同時接続数（Initialize の前に呼ぶ。HTTP/1.1 の接続先へ並行に取得する場合）
+    void SetMaxHostConnections(long connections) { maxHostConnections_ = connections; }
+    // 表示中チャンクの読み込みが直近のp95を超えたら同じリクエストを追加で送る
+    void SetHedgingEnabled(bool enabled) { hedgingEnabled_ = enabled; }
+    bool IsHedgingEnabled() const { return hedgingEnabled_; }
+
+    const std::string& GetSpreadsheetId() const { return spreadsheetId_; }
+    const std::string& GetSheetName() const { return sheetName_; }
+    // 追加レイヤー（読み込みを始める前に呼ぶ）。チャンクの全レイヤーを1回の batchGet で取得する
+    void SetLayers(std::vector<SheetLayer> layers);
+    const std::vector<SheetLayer>& GetLayers() const { return layers_; }
+    std::string GetSheetRevision() const;
+
+    // ネットワーク
+    bool CheckOnlineStatus() const;
+    // リビジョン確認（1リクエスト）。リビジョンが分かったら true
+    // エラー応答や解釈できない本文なら false で、前回のリビジョンとチェックサムをそのまま残す
+    // change: 前回の確認からの変更（チェックサムRange なら変わったチャンク、Drive の version なら allChunks）
+    bool RefreshRevision(RevisionChange* change = nullptr);
+    // 最後に成功したリビジョン確認がチェックサムRange（チャンクごとのハッシュ）だったか
+    bool HasRemoteChecksums() const;
+    // 変更フィードで分かった変更を反映する（リクエストはしない）
+    // fromRevision で検証済みのチャンクは、chunks 以外を toRevision でも有効とし、chunks は再取得の対象にする
+    // マニフェストが fromRevision でなければ何もせず false（RefreshRevision で確かめ直す）
+    bool ApplyRemoteChanges(const std::string& fromRevision, const std::string& toRevision,
+        const std::vector<std::pair<int, int>>& chunks);
+    // シートの行数・列数（spreadsheets.get の gridProperties）。取得できなければ nullopt
+    std::optional<SheetSize> FetchSheetSize() const;
+    // マニフェスト上、現在のリビジョンで検証済みのキャッシュがあるか
+    bool IsChunkFresh(int cx, int cy) const;
+
+    // シートから1チャンク取得する。取り消し・再試行切れ・非再試行エラーなら nullopt
+    std::optional<TileData> LoadFromSheet(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket) const;
+    // 主レイヤーと追加レイヤーをまとめて取得する（添字 0 が主レイヤー）
+    std::optional<std::vector<TileData>> LoadLayersFromSheet(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket) const;
+    // layer: 0 が主レイヤー、1 以降が追加レイヤー。tiles のセルだけを書き換える（追加レイヤーには触れない）
+    // ファイルがないか壊れていれば false（壊れていたらマニフェストの記録を消し、シートから取り直させる）
+    // パスと読み込みのバッファはスレッドごとに使い回し、DOM を作らずに読むので、チャンクごとの確保をしない
+    bool LoadChunkCache(int cx, int cy, ChunkTiles& tiles, int layer = 0);
+    bool HasLayerCache(int cx, int cy, int layer) const { return FindCacheEncoding(cx, cy, layer).has_value(); }
+    // リビジョンに関係なく、キャッシュファイルがあるか
+    bool HasChunkCache(int cx, int cy) const { return FindCacheEncoding(cx, cy).has_value(); }
+    // シートから取得した内容をマニフェストに記録し、内容が変わっていればキャッシュに書く（追加レイヤーも）
+    void CommitChunk(int cx, int cy, const ChunkTiles& tiles);
+    void SaveManifest() const;
+
+    // シート全体を CSV/TSV で一括取り込みし、全チャンクをマニフェストとキャッシュに反映する
+    // 戻り値は取り込んだチャンク数（取得・読み込みに失敗したら nullopt）。.tsv はタブ区切りとして読む
+    std::optional<size_t> ImportCsvUrl(const std::string& url);
+    std::optional<size_t> ImportCsvFile(const std::filesystem::path& path);
+    // CSVエクスポートのURL（gid はシートのタブID。リンクを知っていれば閲覧できるシートのみ）
+    std::string CsvExportUrl(const std::string& gid) const;
+
+    // 優先度変更や取り消しを待機中の取得へ知らせる
+    void NotifyScheduler() {
+        scheduler_->Notify();
+        // 取り消された読み込みの転送も打ち切らせる
+        if (http_) http_->Wakeup();
+    }
+
+    // 書き戻し用の OAuth アクセストークン（API キーでは書き込めない。モックサーバーでは不要）
+    void SetAccessToken(const std::string& token) {
+        std::lock_guard<std::mutex> lock(accessTokenMutex_);
+        accessToken_ = token;
+    }
+    // WriteCells が通るはずか（Google の Sheets API ならトークンが要る。接続先を変えていれば通るものとする）
+    bool CanWriteCells() const {
+        std::lock_guard<std::mutex> lock(accessTokenMutex_);
+        return !accessToken_.empty() || apiBaseUrl_ != kSheetsApiBaseUrl;
+    }
+    // 矩形の今の値をまとめて読む（values:batchGetByDataFilter を1回）。blocks の values を埋めて返す
+    // シートが返さない末尾の空セルは 0 になる
+    std::optional<std::vector<CellBlock>> ReadCells(std::vector<CellBlock> blocks, const std::shared_ptr<LoadTicket>& ticket) const;
+    // 矩形をまとめて書く（values:batchUpdate を1回。0 は空のセルとして書く）。再試行しても書けなければ false
+    bool WriteCells(const std::vector<CellBlock>& blocks, const std::shared_ptr<LoadTicket>& ticket) const;
+
+    // 統計
+    HttpStats GetHttpStats() const { return http_ ? http_->GetStats() : HttpStats{}; }
+    const LatencyTracker& GetChunkLatency() const { return chunkLatency_; }
+    PipelineStats& GetPipelineStats() const { return stats_; }
+    TraceRecorder& GetTracer() const { return tracer_; }
+
+    static uint64_t HashTiles(const ChunkTiles& tiles);
+    // 列番号からGoogleシート列文字列
+    static std::string ColIndexToName(int index);
+    // Googleシート列文字列から列番号（不正なら-1）
+    static int ColNameToIndex(const std::string& name);
+    // セル名から列番号と行番号（"B12" → 列1, 行12）。不正なら false
+    static bool ParseCellName(const std::string& cell, int& col, int& row);
+
+    static constexpr int kChunkWidth = ChunkTiles::kWidth;
+    static constexpr int kChunkHeight = ChunkTiles::kHeight;
+
+private:
+    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
+    std::filesystem::path TlsSessionPath() const;
+
+    // マニフェストI/O（manifestMutex_ を取った状態で呼ぶ）
+    void LoadManifest();
+    void SaveManifestLocked() const;
+
+    // 読み込み結果の通信時間を区間ごとに記録する
+    void RecordTransfer(const HttpResult& result) const;
+
+    // 1レイヤーの Range（シート名!A1:F6）
+    std::string ChunkRange(int layer, int cx, int cy) const;
+    // タイル座標の矩形の Range（レイヤーのシートとずれを含む）
+    std::string CellRange(int layer, int x, int y, int width, int height) const;
+    // JSON を POST し、レスポンスを返す。429・5xx・通信エラーは読み込みと同じく再試行する
+    std::optional<std::string> PostJson(const std::string& url, const std::string& body,
+        const std::shared_ptr<LoadTicket>& ticket) const;
+
+    // キャッシュI/O
+    void SaveChunkCache(int cx, int cy, const TileData& data, int layer = 0);
+    std::filesystem::path CachePath(int cx, int cy, CacheEncoding encoding, int layer = 0) const;
+    // ファイル名（chunk_cx_cy[_レイヤーのキー].拡張子）を out の後ろに付ける
+    void AppendCacheFileName(std::string& out, int cx, int cy, CacheEncoding encoding, int layer) const;
+    // 索引から、読むファイルの形式を選ぶ（現在の書き込み形式を優先する）。なければ nullopt
+    std::optional<CacheEncoding> FindCacheEncoding(int cx, int cy, int layer = 0) const;
+    // キャッシュディレクトリを調べて索引を作り直す（Initialize と、その後にレイヤーを変えたとき）
+    void IndexCacheFiles();
+    static std::vector<uint8_t> EncodeTiles(const TileData& data, CacheEncoding encoding);
+    // tiles のセルに読む。壊れている（途中で切れた・形が合わない）なら false
+    static bool DecodeTiles(const uint8_t* bytes, size_t size, CacheEncoding encoding, ChunkTiles& tiles);
+
+    // メンバ変数
+    std::string spreadsheetId_;
+    std::string sheetName_;
+    std::vector<SheetLayer> layers_;
+    std::vector<std::string> layerKeys_; // layers_ の SheetLayer::Key（ファイル名に使う）
+    std::string apiKey_;
+    mutable std::mutex accessTokenMutex_; // 書き戻しの作業スレッドも読む
+    std::string accessToken_;
+    std::string cacheDir_;
+    std::string apiBaseUrl_ = kSheetsApiBaseUrl;
+    bool curlInitialized_ = false;
+    std::unique_ptr<HttpClient> http_;
+    std::unique_ptr<RequestScheduler> scheduler_;
+    long connectTimeoutMs_ = kDefaultConnectTimeoutMs;
+    long totalTimeoutMs_ = kDefaultTotalTimeoutMs;
+    bool hedgingEnabled_ = false;
+    long maxHostConnections_ = HttpClient::kMaxHostConnections;
+    mutable LatencyTracker chunkLatency_;
+    mutable PipelineStats stats_;
+    mutable TraceRecorder tracer_;
+    CacheEncoding cacheEncoding_ = CacheEncoding::Json;
+
+    // リビジョンマニフェスト
+    std::string revisionUrl_;
+    mutable std::mutex manifestMutex_;
+    std::string sheetRevision_;
+    std::unordered_map<std::pair<int, int>, ManifestEntry, PairHash> manifest_;
+    std::unordered_map<std::pair<int, int>, std::string, PairHash> remoteHashes_;
+
+    // キャッシュファイルの索引（チャンクとレイヤーごとに、どの形式のファイルがあるか。kCacheEncodings の順のビット）
+    // 読み込みのたびにパスを作ってファイルを探さないよう、Initialize で1回だけディレクトリを調べ、書き込みで更新する
+    struct CacheFileKey {
+        int cx = 0;
+        int cy = 0;
+        int layer = 0;
+        bool operator==(const CacheFileKey&) const = default;
+    };
+    struct CacheFileKeyHash {
+        size_t operator()(const CacheFileKey& key) const noexcept {
+            return PairHash()({ key.cx, key.cy }) ^ (static_cast<size_t>(key.layer) * 0x9E3779B97F4A7C15ull);
+        }
+    };
+    mutable std::mutex cacheFilesMutex_;
+    std::unordered_map<CacheFileKey, uint8_t, CacheFileKeyHash> cacheFiles_;
+
+    static constexpr CacheEncoding kCacheEncodings[] = {
+        CacheEncoding::Json, CacheEncoding::Cbor, CacheEncoding::MessagePack, CacheEncoding::BJData,
+    };
+    // Sheets API の既定の接続先
+    static constexpr const char* kSheetsApiBaseUrl = "https://sheets.googleapis.com";
+    // Sheets API の既定クォータ（300リクエスト/分）に合わせる
+    static constexpr double kDefaultRequestsPerSec = 5.0;
+    static constexpr double kDefaultRequestBurst = 30.0;
+    static constexpr int kMaxLoadRetries = 5;
+    static constexpr long kDefaultConnectTimeoutMs = 5000;
+    static constexpr long kDefaultTotalTimeoutMs = 15000;
+    // 一括取り込みはシート全体を受け取るので長めに待つ
+    static constexpr long kBulkTimeoutMs = 120000;
+    // ヘッジを始めるのに必要な計測数と、ヘッジまでの最短待ち時間
+    static constexpr size_t kMinHedgeSamples = 20;
+    static constexpr double kMinHedgeDelayMs = 50.0;
+};
@@ -0,0 +1,208 @@
+#include "CsvTileParser.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#if defined(_M_X64) || defined(__x86_64__)
+#define CSV_TILE_PARSER_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+// GCC/Clang では AVX2 の関数だけ命令セットを広げる（MSVC は指定なしで使える）
+#if defined(__GNUC__) || defined(__clang__)
+#define CSV_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CSV_TARGET_AVX2
+#endif
+
+uint64_t StructuralMaskScalar(const char* p, char delimiter) {
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; ++i) {
+        char c = p[i];
+        if (c == delimiter || c == '\n' || c == '"') mask |= uint64_t{ 1 } << i;
+    }
+    return mask;
+}
+
+#ifdef CSV_TILE_PARSER_X64
+uint64_t StructuralMaskSse2(const char* p, char delimiter) {
+    const __m128i delim = _mm_set1_epi8(delimiter);
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i quote = _mm_set1_epi8('"');
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, delim), _mm_cmpeq_epi8(v, newline)),
+            _mm_cmpeq_epi8(v, quote));
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hit))) << (i * 16);
+    }
+    return mask;
+}
+
+CSV_TARGET_AVX2 uint64_t StructuralMaskAvx2(const char* p, char delimiter) {
+    const __m256i delim = _mm256_set1_epi8(delimiter);
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i quote = _mm256_set1_epi8('"');
+    uint64_t mask = 0;
+    for (int i = 0; i < 2; ++i) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i * 32));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, delim), _mm256_cmpeq_epi8(v, newline)),
+            _mm256_cmpeq_epi8(v, quote));
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit))) << (i * 32);
+    }
+    return mask;
+}
+
+bool CpuHasAvx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    // OS が YMM レジスタを保存しているか（OSXSAVE と XCR0）
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// セルの先頭の空白と引用符を飛ばし、数値として読めるところまでを使う（空セルなどは0）
+int ParseCellValue(const char* begin, const char* end) {
+    // タイル番号はほとんど1桁
+    if (end - begin == 1 && *begin >= '0' && *begin <= '9') return *begin - '0';
+    while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '"')) ++begin;
+    int value = 0;
+    std::from_chars(begin, end, value);
+    return value;
+}
+
+} // namespace
+
+CsvTileParser::CsvTileParser(ChunkCallback onChunk, char delimiter, CsvScanner scanner)
+    : onChunk_(std::move(onChunk))
+    , delimiter_(delimiter)
+    , scanner_(CsvScanner::Scalar)
+    , mask_(StructuralMaskScalar) {
+#ifdef CSV_TILE_PARSER_X64
+    if (scanner == CsvScanner::Auto || scanner == CsvScanner::Avx2) {
+        scanner = CpuHasAvx2() ? CsvScanner::Avx2 : CsvScanner::Sse2;
+    }
+    if (scanner == CsvScanner::Avx2) {
+        scanner_ = scanner;
+        mask_ = StructuralMaskAvx2;
+    } else if (scanner == CsvScanner::Sse2) {
+        scanner_ = scanner;
+        mask_ = StructuralMaskSse2;
+    }
+#else
+    static_cast<void>(scanner);
+#endif
+}
+
+const char* CsvTileParser::ScannerName() const {
+    switch (scanner_) {
+    case CsvScanner::Avx2: return "avx2";
+    case CsvScanner::Sse2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+void CsvTileParser::Feed(const char* data, size_t size) {
+    auto start = std::chrono::steady_clock::now();
+    const char* cellStart = data;
+    size_t offset = 0;
+    for (; offset + 64 <= size; offset += 64) {
+        ProcessMask(data + offset, mask_(data + offset, delimiter_), cellStart);
+    }
+    if (offset < size) {
+        // 64バイトに満たない末尾は0で埋めた領域で調べる（0は区切りにならない）
+        char tail[64] = {};
+        size_t rest = size - offset;
+        std::memcpy(tail, data + offset, rest);
+        ProcessMask(data + offset, mask_(tail, delimiter_) & ((uint64_t{ 1 } << rest) - 1), cellStart);
+    }
+    // 閉じていないセルは次の Feed に持ち越す
+    carry_.append(cellStart, data + size);
+    byteCount_ += size;
+    parseNs_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CsvTileParser::ProcessMask(const char* block, uint64_t mask, const char*& cellStart) {
+    while (mask) {
+        const char* p = block + std::countr_zero(mask);
+        mask &= mask - 1;
+        if (*p == '"') {
+            // "" のエスケープは2回反転するので、引用符の内外だけ追えばよい
+            inQuotes_ = !inQuotes_;
+            continue;
+        }
+        if (inQuotes_) continue;
+        EndCell(cellStart, p);
+        cellStart = p + 1;
+        if (*p == '\n') EndRow();
+    }
+}
+
+void CsvTileParser::Finish() {
+    auto start = std::chrono::steady_clock::now();
+    if (!carry_.empty() || column_ > 0) {
+        EndCell(nullptr, nullptr);
+        EndRow();
+    }
+    if (rowCount_ % ChunkTiles::kHeight != 0) FlushBand();
+    parseNs_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CsvTileParser::EndCell(const char* begin, const char* end) {
+    if (!carry_.empty()) {
+        carry_.append(begin, end);
+        begin = carry_.data();
+        end = begin + carry_.size();
+    }
+    // CRLF の行末
+    if (end > begin && end[-1] == '\r') --end;
+    int x = column_ % ChunkTiles::kWidth;
+    int y = static_cast<int>(rowCount_ % ChunkTiles::kHeight);
+    size_t chunkIndex = static_cast<size_t>(column_ / ChunkTiles::kWidth);
+    if (chunkIndex >= band_.size()) band_.resize(chunkIndex + 1);
+    ChunkTiles& tiles = band_[chunkIndex];
+    tiles.cells[y * ChunkTiles::kWidth + x] = ParseCellValue(begin, end);
+    if (end > begin) {
+        tiles.rowWidths[y] = std::max(tiles.rowWidths[y], static_cast<uint8_t>(x + 1));
+        tiles.rowCount = std::max(tiles.rowCount, y + 1);
+    }
+    ++column_;
+    ++cellCount_;
+    carry_.clear();
+}
+
+void CsvTileParser::EndRow() {
+    column_ = 0;
+    ++rowCount_;
+    if (rowCount_ % ChunkTiles::kHeight == 0) FlushBand();
+}
+
+void CsvTileParser::FlushBand() {
+    int chunkY = static_cast<int>((rowCount_ - 1) / ChunkTiles::kHeight);
+    for (size_t i = 0; i < band_.size(); ++i) {
+        onChunk_(static_cast<int>(i), chunkY, std::move(band_[i]));
+        band_[i] = ChunkTiles{};
+    }
+}
+
+size_t CsvTileParser::WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    size_t realSize = size * nmemb;
+    static_cast<CsvTileParser*>(userp)->Feed(static_cast<const char*>(contents), realSize);
+    return realSize;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "ChunkLoader.h"
+
+// 区切り文字・改行・引用符を探す実装
+enum class CsvScanner {
+    Auto,   // 実行環境で使える最速のもの
+    Scalar, // 1バイトずつ
+    Sse2,   // 16バイトずつ（x64 では常に使える）
+    Avx2,   // 32バイトずつ（CPUが対応していなければ Sse2）
+};
+
+// シートの CSV/TSV エクスポートを受信しながら解析し、チャンク単位のタイルにするパーサ
+// 64バイトごとに区切り位置のビットマスクを作り、セルの中身は読み飛ばす
+// 6行たまるごとに、その帯に含まれる全チャンクを左から順に通知する
+// セルの幅は values API に合わせる（行末の空セルは幅に含めない）
+class CsvTileParser {
+public:
+    using ChunkCallback = std::function<void(int chunkX, int chunkY, ChunkTiles&& tiles)>;
+
+    explicit CsvTileParser(ChunkCallback onChunk, char delimiter = ',', CsvScanner scanner = CsvScanner::Auto);
+
+    // 受信した断片を解析する（セルや行の途中で切れていてよい）
+    void Feed(const char* data, size_t size);
+    // 改行で終わらない最後の行と、6行に満たない最後の帯を確定する
+    void Finish();
+
+    size_t RowCount() const { return rowCount_; }
+    size_t CellCount() const { return cellCount_; }
+    uint64_t ByteCount() const { return byteCount_; }
+    // Feed と Finish に費やした時間の合計（ミリ秒）
+    double ParseMs() const { return static_cast<double>(parseNs_) / 1e6; }
+    // 実際に使われている実装（"avx2" / "sse2" / "scalar"）
+    const char* ScannerName() const;
+
+    // curl の CURLOPT_WRITEFUNCTION 用（userp に CsvTileParser* を渡す）
+    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
+
+private:
+    // 64バイト分の区切り文字・改行・引用符の位置（ビットiがp[i]）
+    using MaskFunction = uint64_t (*)(const char* p, char delimiter);
+
+    void ProcessMask(const char* block, uint64_t mask, const char*& cellStart);
+    void EndCell(const char* begin, const char* end);
+    void EndRow();
+    void FlushBand();
+
+    ChunkCallback onChunk_;
+    char delimiter_;
+    CsvScanner scanner_;
+    MaskFunction mask_;
+    // 前回の Feed から続いているセル
+    std::string carry_;
+    bool inQuotes_ = false;
+    // 組み立て中の6行帯（横に並ぶチャンク）
+    std::vector<ChunkTiles> band_;
+    int column_ = 0;
+    size_t rowCount_ = 0;
+    size_t cellCount_ = 0;
+    uint64_t byteCount_ = 0;
+    long long parseNs_ = 0;
+};
@@ -0,0 +1,451 @@
+#include "FlowField.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+
+namespace {
+
+constexpr float kUnreached = std::numeric_limits<float>::infinity();
+constexpr float kDiagonalCost = 1.41421356f;
+
+// 向きの候補（縦横を先に並べ、同じ距離なら縦横に進む）
+constexpr int kDirectionCount = 8;
+constexpr int kDirections[kDirectionCount][2] = {
+    { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 },
+};
+constexpr uint8_t kNoDirection = kDirectionCount;
+
+int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+} // namespace
+
+void FlowField::SetArea(int tileX, int tileY, int width, int height) {
+    int size = BlockTiles();
+    areaX_ = FloorDiv(tileX, size) * size;
+    areaY_ = FloorDiv(tileY, size) * size;
+    blocksX_ = std::max(0, FloorDiv(tileX + width - 1, size) * size + size - areaX_) / size;
+    blocksY_ = std::max(0, FloorDiv(tileY + height - 1, size) * size + size - areaY_) / size;
+    blocks_.clear();
+    size_t tiles = static_cast<size_t>(size) * static_cast<size_t>(size);
+    for (int i = 0; i < blocksX_ * blocksY_; ++i) {
+        auto block = std::make_unique<Block>();
+        block->distance = std::make_unique<std::atomic<float>[]>(tiles);
+        block->direction = std::make_unique<uint8_t[]>(tiles);
+        blocks_.push_back(std::move(block));
+        BuildGrid(i);
+    }
+    changedChunks_.clear();
+    hasGoal_ = hasGoal_ && InArea(goalX_, goalY_);
+    restart_ = true;
+    // ブロックごとの距離・向きと、外周1タイルを含む通れるタイル
+    size_t ringTiles = static_cast<size_t>(size + 2) * static_cast<size_t>(size + 2);
+    stats_.bytes = sizeof(FlowField) + blocks_.size() * (sizeof(Block) + sizeof(std::unique_ptr<Block>) +
+        tiles * (sizeof(std::atomic<float>) + sizeof(uint8_t)) + ringTiles);
+}
+
+void FlowField::SetBlockChunks(int chunks) {
+    blockChunks_ = std::max(1, chunks);
+    blocks_.clear();
+    blocksX_ = 0;
+    blocksY_ = 0;
+}
+
+void FlowField::SetGoal(int tileX, int tileY) {
+    hasGoal_ = InArea(tileX, tileY);
+    goalX_ = tileX;
+    goalY_ = tileY;
+    restart_ = true;
+}
+
+void FlowField::ClearGoal() {
+    hasGoal_ = false;
+    restart_ = true;
+}
+
+void FlowField::OnChunkChanged(int cx, int cy) {
+    if (!blocks_.empty()) changedChunks_.emplace_back(cx, cy);
+}
+
+void FlowField::Invalidate() {
+    for (int i = 0; i < static_cast<int>(blocks_.size()); ++i) BuildGrid(i);
+    changedChunks_.clear();
+    restart_ = true;
+}
+
+int FlowField::BlockOf(int x, int y) const {
+    if (!InArea(x, y)) return -1;
+    return (y - areaY_) / BlockTiles() * blocksX_ + (x - areaX_) / BlockTiles();
+}
+
+int FlowField::TileIndex(int x, int y) const {
+    int size = BlockTiles();
+    return (y - areaY_) % size * size + (x - areaX_) % size;
+}
+
+float FlowField::Distance(int x, int y) const {
+    int block = BlockOf(x, y);
+    if (block < 0) return kUnreached;
+    return blocks_[block]->distance[TileIndex(x, y)].load(std::memory_order_relaxed);
+}
+
+std::pair<int, int> FlowField::Direction(int x, int y) const {
+    int block = BlockOf(x, y);
+    if (block < 0) return { 0, 0 };
+    uint8_t direction = blocks_[block]->direction[TileIndex(x, y)];
+    if (direction == kNoDirection) return { 0, 0 };
+    return { kDirections[direction][0], kDirections[direction][1] };
+}
+
+void FlowField::BuildGrid(int index) {
+    int size = BlockTiles();
+    int x0 = areaX_ + index % blocksX_ * size;
+    int y0 = areaY_ + index / blocksX_ * size;
+    // 内側のループで毎回ビットを取り出さないよう、バイトに広げておく
+    PathGrid grid(map_, x0 - 1, y0 - 1, size + 2, size + 2, UnloadedTiles::Blocked);
+    std::vector<uint8_t>& passable = blocks_[index]->passable;
+    passable.resize(static_cast<size_t>(size + 2) * static_cast<size_t>(size + 2));
+    for (int y = y0 - 1; y <= y0 + size; ++y) {
+        for (int x = x0 - 1; x <= x0 + size; ++x) {
+            passable[(y - y0 + 1) * (size + 2) + (x - x0 + 1)] = InArea(x, y) && !grid.Blocked(x, y);
+        }
+    }
+}
+
+template <class F>
+void FlowField::ForEachBlockNear(int cx, int cy, F&& f) const {
+    int size = BlockTiles();
+    int x0 = cx * ChunkTiles::kWidth;
+    int y0 = cy * ChunkTiles::kHeight;
+    int bx0 = std::max(0, FloorDiv(x0 - 1 - areaX_, size));
+    int bx1 = std::min(blocksX_ - 1, FloorDiv(x0 + ChunkTiles::kWidth - areaX_, size));
+    int by0 = std::max(0, FloorDiv(y0 - 1 - areaY_, size));
+    int by1 = std::min(blocksY_ - 1, FloorDiv(y0 + ChunkTiles::kHeight - areaY_, size));
+    for (int by = by0; by <= by1; ++by) {
+        for (int bx = bx0; bx <= bx1; ++bx) f(by * blocksX_ + bx);
+    }
+}
+
+void FlowField::ResetDistances() {
+    size_t tiles = static_cast<size_t>(BlockTiles()) * static_cast<size_t>(BlockTiles());
+    for (auto& block : blocks_) {
+        for (size_t i = 0; i < tiles; ++i) block->distance[i].store(kUnreached, std::memory_order_relaxed);
+        block->changed.store(true, std::memory_order_relaxed);
+        block->reseed = true;
+    }
+}
+
+float FlowField::ApplyChunkChanges(std::vector<int>& scheduled) {
+    // 通れないタイルが増えたチャンク（読み込み前は全体が通れないので、読み込まれただけなら距離は下がるだけ）
+    // ブロックの写しを作り直す前に、変わる前の写しと比べる
+    std::vector<std::pair<int, int>> blockedChunks;
+    float key = kUnreached;
+    for (const auto& [cx, cy] : changedChunks_) {
+        int x0 = cx * ChunkTiles::kWidth;
+        int y0 = cy * ChunkTiles::kHeight;
+        int block = BlockOf(x0, y0);
+        if (block >= 0) {
+            const std::vector<uint8_t>& before = blocks_[block]->passable;
+            int stride = BlockTiles() + 2;
+            int left = (x0 - areaX_) % BlockTiles() + 1;
+            int top = (y0 - areaY_) % BlockTiles() + 1;
+            bool blocked = false;
+            for (int y = 0; y < ChunkTiles::kHeight && !blocked; ++y) {
+                uint64_t solid = map_.SolidRow(x0, y0 + y, true);
+                for (int x = 0; x < ChunkTiles::kWidth && !blocked; ++x) {
+                    blocked = ((solid >> x) & 1) && before[(top + y) * stride + left + x];
+                }
+            }
+            if (blocked) blockedChunks.emplace_back(cx, cy);
+        }
+        // 計算し直しは、チャンクとその外周1タイルの変わる前の最小距離の帯から始める
+        for (int y = y0 - 1; y <= y0 + ChunkTiles::kHeight; ++y) {
+            for (int x = x0 - 1; x <= x0 + ChunkTiles::kWidth; ++x) key = std::min(key, Distance(x, y));
+        }
+    }
+    for (const auto& [cx, cy] : changedChunks_) {
+        ForEachBlockNear(cx, cy, [&](int index) {
+            BuildGrid(index);
+            blocks_[index]->changed.store(true, std::memory_order_relaxed);
+            blocks_[index]->reseed = true;
+            scheduled.push_back(index);
+        });
+    }
+
+    // 変わる前の向きをたどってそのチャンクを通っていたタイル（最短経路の木の、チャンクから先の部分）だけを消す
+    // 残ったタイルの経路はそのまま通れるので、距離も変わらない
+    std::vector<uint8_t> reset(blocks_.size(), 0);
+    std::vector<std::pair<int, int>> stack;
+    auto resetTile = [&](int x, int y) {
+        int block = BlockOf(x, y);
+        if (block < 0) return;
+        std::atomic<float>& distance = blocks_[block]->distance[TileIndex(x, y)];
+        if (distance.load(std::memory_order_relaxed) == kUnreached) return;
+        distance.store(kUnreached, std::memory_order_relaxed);
+        reset[block] = 1;
+        ++stats_.resetTiles;
+        stack.emplace_back(x, y);
+    };
+    for (const auto& [cx, cy] : blockedChunks) {
+        int x0 = cx * ChunkTiles::kWidth;
+        int y0 = cy * ChunkTiles::kHeight;
+        auto inChunk = [&](int x, int y) {
+            return x >= x0 && y >= y0 && x < x0 + ChunkTiles::kWidth && y < y0 + ChunkTiles::kHeight;
+        };
+        for (int y = y0 - 1; y <= y0 + ChunkTiles::kHeight; ++y) {
+            for (int x = x0 - 1; x <= x0 + ChunkTiles::kWidth; ++x) {
+                // 外周のタイルは、チャンクの角をかすめて斜めに進んでいたものだけ
+                auto [dx, dy] = Direction(x, y);
+                if (inChunk(x, y) || (dx && dy && (inChunk(x + dx, y) || inChunk(x, y + dy)))) resetTile(x, y);
+            }
+        }
+    }
+    while (!stack.empty()) {
+        auto [x, y] = stack.back();
+        stack.pop_back();
+        for (const auto& direction : kDirections) {
+            int nx = x + direction[0];
+            int ny = y + direction[1];
+            auto [dx, dy] = Direction(nx, ny);
+            if (nx + dx == x && ny + dy == y && (dx || dy)) resetTile(nx, ny);
+        }
+    }
+    for (int block = 0; block < static_cast<int>(blocks_.size()); ++block) {
+        if (!reset[block]) continue;
+        blocks_[block]->changed.store(true, std::memory_order_relaxed);
+        blocks_[block]->reseed = true;
+        scheduled.push_back(block);
+    }
+    return key;
+}
+
+void FlowField::Update() {
+    if (blocks_.empty() || (!restart_ && changedChunks_.empty())) return;
+    auto start = std::chrono::steady_clock::now();
+    blockRuns_ = 0;
+    stats_.resetTiles = 0;
+
+    // 距離を消し終えてから積む（消す前の値を隣のブロックが読まないように）
+    std::vector<int> scheduled;
+    float startKey = 0.0f;
+    if (restart_) {
+        for (const auto& [cx, cy] : changedChunks_) ForEachBlockNear(cx, cy, [this](int index) { BuildGrid(index); });
+        ResetDistances();
+        if (hasGoal_) scheduled.push_back(BlockOf(goalX_, goalY_));
+    } else {
+        startKey = ApplyChunkChanges(scheduled);
+    }
+    changedChunks_.clear();
+    restart_ = false;
+    // 付近がどこからも届かないチャンクなら、距離は変わらない（向きだけ作り直す）
+    if (startKey != kUnreached) {
+        for (int index : scheduled) blocks_[index]->key.store(startKey, std::memory_order_relaxed);
+    }
+
+    // 距離の帯ごとに、帯に入ったブロックを並列に計算する（帯の中で縁が下がった隣はすぐ積む）
+    for (;;) {
+        float minKey = kUnreached;
+        for (const auto& block : blocks_) minKey = std::min(minKey, block->key.load(std::memory_order_relaxed));
+        if (minKey == kUnreached) break;
+        bandEnd_.store(minKey + static_cast<float>(BlockTiles()), std::memory_order_relaxed);
+        for (int i = 0; i < static_cast<int>(blocks_.size()); ++i) {
+            if (blocks_[i]->key.load(std::memory_order_relaxed) < bandEnd_.load(std::memory_order_relaxed)) Schedule(i);
+        }
+        pool_.Wait();
+    }
+
+    // 距離が変わったブロックと、その隣（縁の向きが隣の距離で決まる）の向きを作り直す
+    std::vector<int> rebuild;
+    for (int by = 0; by < blocksY_; ++by) {
+        for (int bx = 0; bx < blocksX_; ++bx) {
+            bool changed = false;
+            for (int oy = std::max(0, by - 1); oy <= std::min(blocksY_ - 1, by + 1) && !changed; ++oy) {
+                for (int ox = std::max(0, bx - 1); ox <= std::min(blocksX_ - 1, bx + 1) && !changed; ++ox) {
+                    changed = blocks_[oy * blocksX_ + ox]->changed.load(std::memory_order_relaxed);
+                }
+            }
+            if (changed) rebuild.push_back(by * blocksX_ + bx);
+        }
+    }
+    for (int index : rebuild) pool_.Submit([this, index]() { BuildDirections(index); });
+    pool_.Wait();
+    for (auto& block : blocks_) block->changed.store(false, std::memory_order_relaxed);
+
+    stats_.blockRuns = blockRuns_.load(std::memory_order_relaxed);
+    stats_.updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FlowField::Notify(int index, float key) {
+    std::atomic<float>& current = blocks_[index]->key;
+    float value = current.load(std::memory_order_relaxed);
+    while (key < value && !current.compare_exchange_weak(value, key, std::memory_order_relaxed)) {
+    }
+    if (key < bandEnd_.load(std::memory_order_relaxed)) Schedule(index);
+}
+
+void FlowField::Schedule(int index) {
+    Block& block = *blocks_[index];
+    int state = block.state.load(std::memory_order_acquire);
+    for (;;) {
+        if (state == kQueued || state == kRerun) return;
+        int next = state == kIdle ? kQueued : kRerun;
+        if (!block.state.compare_exchange_weak(state, next, std::memory_order_acq_rel)) continue;
+        if (next == kQueued) pool_.Submit([this, index]() { RunBlock(index); });
+        return;
+    }
+}
+
+void FlowField::RunBlock(int index) {
+    Block& block = *blocks_[index];
+    block.state.store(kRunning, std::memory_order_release);
+    for (;;) {
+        // ここから後に下がった縁は、次の計算か後の帯で拾う
+        block.key.store(kUnreached, std::memory_order_relaxed);
+        RelaxBlock(index);
+        blockRuns_.fetch_add(1, std::memory_order_relaxed);
+        int expected = kRunning;
+        if (block.state.compare_exchange_strong(expected, kIdle, std::memory_order_acq_rel)) return;
+        // 計算中に隣から積み直された
+        block.state.store(kRunning, std::memory_order_release);
+    }
+}
+
+void FlowField::RelaxBlock(int index) {
+    Block& block = *blocks_[index];
+    int size = BlockTiles();
+    int x0 = areaX_ + index % blocksX_ * size;
+    int y0 = areaY_ + index / blocksX_ * size;
+    // ブロックと外周1タイルのどこかであること
+    auto passable = [&](int x, int y) { return block.passable[(y - y0 + 1) * (size + 2) + (x - x0 + 1)] != 0; };
+    auto inside = [&](int x, int y) { return x >= x0 && y >= y0 && x < x0 + size && y < y0 + size; };
+    // 斜めは両側の縦横が通れるときだけ（from と to はどちらも通れるとする）
+    auto canStep = [&](int x, int y, int dx, int dy) { return !dx || !dy || (passable(x + dx, y) && passable(x, y + dy)); };
+
+    // 呼ぶたびに確保しないよう、スレッドごとに使い回す
+    thread_local std::vector<float> local;
+    thread_local std::vector<std::pair<float, int>> open;
+    local.resize(static_cast<size_t>(size) * static_cast<size_t>(size));
+    for (int i = 0; i < size * size; ++i) local[i] = block.distance[i].load(std::memory_order_relaxed);
+    // ブロック内の距離は前回の計算で互いに矛盾しないので、下がったタイルだけから広げる
+    // 距離を消したり通れるタイルが変わったりした後は、値の分かっているタイルすべてから広げる
+    // ヒープは std::greater で最小値を先頭に置く
+    open.clear();
+    if (block.reseed) {
+        for (int i = 0; i < size * size; ++i) {
+            if (local[i] != kUnreached) open.emplace_back(local[i], i);
+        }
+        block.reseed = false;
+    }
+    if (hasGoal_ && inside(goalX_, goalY_) && passable(goalX_, goalY_) && local[TileIndex(goalX_, goalY_)] > 0.0f) {
+        local[TileIndex(goalX_, goalY_)] = 0.0f;
+        open.emplace_back(0.0f, TileIndex(goalX_, goalY_));
+    }
+
+    // 縁のタイルは隣のブロックのタイルから
+    for (int ly = 0; ly < size; ++ly) {
+        for (int lx = 0; lx < size; lx += (ly == 0 || ly == size - 1) ? 1 : size - 1) {
+            int x = x0 + lx;
+            int y = y0 + ly;
+            if (!passable(x, y)) continue;
+            float& value = local[ly * size + lx];
+            float before = value;
+            for (const auto& direction : kDirections) {
+                int nx = x + direction[0];
+                int ny = y + direction[1];
+                if (inside(nx, ny) || !passable(nx, ny) || !canStep(x, y, direction[0], direction[1])) continue;
+                float step = direction[0] && direction[1] ? kDiagonalCost : 1.0f;
+                value = std::min(value, Distance(nx, ny) + step);
+            }
+            if (value < before) open.emplace_back(value, ly * size + lx);
+        }
+    }
+
+    std::make_heap(open.begin(), open.end(), std::greater<>());
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), std::greater<>());
+        auto [d, current] = open.back();
+        open.pop_back();
+        if (d > local[current]) continue;
+        int x = x0 + current % size;
+        int y = y0 + current / size;
+        for (const auto& direction : kDirections) {
+            int nx = x + direction[0];
+            int ny = y + direction[1];
+            if (!inside(nx, ny) || !passable(nx, ny) || !canStep(x, y, direction[0], direction[1])) continue;
+            int next = (ny - y0) * size + (nx - x0);
+            float nextD = d + (direction[0] && direction[1] ? kDiagonalCost : 1.0f);
+            if (nextD >= local[next]) continue;
+            local[next] = nextD;
+            open.emplace_back(nextD, next);
+            std::push_heap(open.begin(), open.end(), std::greater<>());
+        }
+    }
+
+    // 書き戻し、縁が下がった向きの隣を積み直す
+    bool changed = false;
+    float notify[3][3] = { { kUnreached, kUnreached, kUnreached }, { kUnreached, kUnreached, kUnreached },
+        { kUnreached, kUnreached, kUnreached } };
+    for (int ly = 0; ly < size; ++ly) {
+        for (int lx = 0; lx < size; ++lx) {
+            int i = ly * size + lx;
+            float old = block.distance[i].load(std::memory_order_relaxed);
+            if (!(local[i] < old)) continue;
+            block.distance[i].store(local[i], std::memory_order_relaxed);
+            changed = true;
+            if (!(local[i] < old - kNotifyEpsilon)) continue;
+            int ox = lx == 0 ? -1 : (lx == size - 1 ? 1 : 0);
+            int oy = ly == 0 ? -1 : (ly == size - 1 ? 1 : 0);
+            notify[1][1 + ox] = std::min(notify[1][1 + ox], local[i]);
+            notify[1 + oy][1] = std::min(notify[1 + oy][1], local[i]);
+            notify[1 + oy][1 + ox] = std::min(notify[1 + oy][1 + ox], local[i]);
+        }
+    }
+    if (changed) block.changed.store(true, std::memory_order_relaxed);
+    int bx = index % blocksX_;
+    int by = index / blocksX_;
+    for (int oy = -1; oy <= 1; ++oy) {
+        for (int ox = -1; ox <= 1; ++ox) {
+            if ((!ox && !oy) || notify[1 + oy][1 + ox] == kUnreached) continue;
+            if (bx + ox < 0 || by + oy < 0 || bx + ox >= blocksX_ || by + oy >= blocksY_) continue;
+            Notify((by + oy) * blocksX_ + bx + ox, notify[1 + oy][1 + ox]);
+        }
+    }
+}
+
+void FlowField::BuildDirections(int index) {
+    Block& block = *blocks_[index];
+    int size = BlockTiles();
+    int x0 = areaX_ + index % blocksX_ * size;
+    int y0 = areaY_ + index / blocksX_ * size;
+    // ブロックと外周1タイルのどこかであること
+    auto passable = [&](int x, int y) { return block.passable[(y - y0 + 1) * (size + 2) + (x - x0 + 1)] != 0; };
+    for (int ly = 0; ly < size; ++ly) {
+        for (int lx = 0; lx < size; ++lx) {
+            int x = x0 + lx;
+            int y = y0 + ly;
+            int i = ly * size + lx;
+            float own = block.distance[i].load(std::memory_order_relaxed);
+            uint8_t best = kNoDirection;
+            if (own != kUnreached && own > 0.0f && passable(x, y)) {
+                // 進んだ先の距離と1歩のコストの和が最小の向き（最短経路に沿う）
+                float bestCost = kUnreached;
+                for (int d = 0; d < kDirectionCount; ++d) {
+                    int dx = kDirections[d][0];
+                    int dy = kDirections[d][1];
+                    if (!passable(x + dx, y + dy)) continue;
+                    if (dx && dy && (!passable(x + dx, y) || !passable(x, y + dy))) continue;
+                    float next = Distance(x + dx, y + dy);
+                    if (!(next < own)) continue;
+                    float cost = next + (dx && dy ? kDiagonalCost : 1.0f);
+                    if (cost < bestCost) {
+                        best = static_cast<uint8_t>(d);
+                        bestCost = cost;
+                    }
+                }
+            }
+            block.direction[i] = best;
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Pathfinder.h"
+#include "WorkStealingPool.h"
+
+// 1つの目的地へ向かう流れ場（群衆用。エージェントは自分のタイルの向きを引くだけで進める）
+// 範囲をブロック（既定 4x4 チャンク）に分け、ブロックごとのダイクストラをスレッドプールで並列に回す
+// ブロックの縁の距離が下がったら隣のブロックを積み直し、積むものがなくなった時点で範囲全体の最短距離になる
+// 目的地に近い距離の帯から順に（帯の中は並列に）進めるので、遠いブロックを仮の距離で何度も計算し直さない
+// チャンクが解放されると、そのチャンクを通っていたタイル（向きをたどると通るもの）だけを消して計算し直す
+// 読み込まれたチャンクは通れるタイルが増えるだけなので、消さずに付近から距離を下げる
+// 移動の規則は Pathfinder と同じ（8方向。斜めは両側の縦横が通れるときだけ。読み込み前のチャンクは通れない）
+class FlowField {
+public:
+    FlowField(const CollisionMap& map, WorkStealingPool& pool) : map_(map), pool_(pool) {}
+
+    // 計算する範囲（タイル座標。ブロック単位に広げる）。変えると全体を計算し直す
+    void SetArea(int tileX, int tileY, int width, int height);
+    // ブロックの大きさ（チャンク数）。SetArea の前に呼ぶ
+    void SetBlockChunks(int chunks);
+    // 目的地（SetArea の後に呼ぶ。範囲外なら流れ場を消す）
+    void SetGoal(int tileX, int tileY);
+    void ClearGoal();
+    bool HasGoal() const { return hasGoal_; }
+    // チャンクが読み込まれた・解放された・書き換わった（次の Update で反映する）
+    void OnChunkChanged(int cx, int cy);
+    // タイルの種類が変わったなど、全体を読み直す
+    void Invalidate();
+    // たまった変更を計算する（毎フレーム呼ぶ。変更がなければすぐ戻る）
+    void Update();
+
+    // 目的地までの距離（届かない・範囲外は無限大）
+    float Distance(int x, int y) const;
+    // 次に進む向き（目的地にいる・届かない・範囲外なら {0, 0}）
+    std::pair<int, int> Direction(int x, int y) const;
+
+    struct Stats {
+        double updateMs = 0.0;    // 最後の Update にかかった時間
+        size_t blockRuns = 0;     // 最後の Update でブロックを計算した回数（同じブロックの計算し直しを含む）
+        size_t resetTiles = 0;    // 最後の Update で距離を消したタイル
+        size_t bytes = 0;         // 流れ場が持つメモリ（概算）
+    };
+    const Stats& GetStats() const { return stats_; }
+
+private:
+    struct Block {
+        std::vector<uint8_t> passable; // ブロックと外周1タイルの通れるタイル（1バイト1タイル。範囲外は通れない）
+        std::unique_ptr<std::atomic<float>[]> distance; // ブロックの持ち主のタスクだけが書き、隣のタスクが縁を読む
+        std::unique_ptr<uint8_t[]> direction;           // kDirections の添字（kNoDirection なら止まる）
+        std::atomic<int> state = kIdle;
+        std::atomic<float> key = std::numeric_limits<float>::infinity(); // 隣から下がった縁の距離のうち、まだ計算していない最小のもの
+        std::atomic<bool> changed = false; // 距離が変わった（向きを作り直す）
+        bool reseed = true; // 次の計算でブロック内のすべてのタイルから広げ直す（Update が積む前に立てる）
+    };
+    // ブロックの計算の状態（同じブロックを2つのスレッドが同時に計算しない）
+    static constexpr int kIdle = 0;
+    static constexpr int kQueued = 1;
+    static constexpr int kRunning = 2;
+    static constexpr int kRerun = 3; // 計算中に隣の縁が下がった（終わったらもう一度）
+
+    int BlockTiles() const { return blockChunks_ * ChunkTiles::kWidth; }
+    bool InArea(int x, int y) const {
+        return x >= areaX_ && y >= areaY_ && x < areaX_ + blocksX_ * BlockTiles() && y < areaY_ + blocksY_ * BlockTiles();
+    }
+    // (x, y) を含むブロック（範囲外なら -1）と、そのブロック内での添字
+    int BlockOf(int x, int y) const;
+    int TileIndex(int x, int y) const;
+    // 通れるタイルを CollisionMap から写し直す
+    void BuildGrid(int index);
+    // 外周1タイルまで含めてチャンク (cx, cy) に重なるブロック
+    template <class F>
+    void ForEachBlockNear(int cx, int cy, F&& f) const;
+    void ResetDistances();
+    // 変わったチャンクを通っていたタイルの距離を消し、計算し直すブロックを scheduled に加える
+    // 戻り値は計算し直しの起点になる距離（変わったチャンク付近の最小距離）
+    float ApplyChunkChanges(std::vector<int>& scheduled);
+    // ブロックの縁が key まで下がった。今の帯に入っていれば積み、でなければ後の帯に回す
+    void Notify(int index, float key);
+    void Schedule(int index);
+    void RunBlock(int index);
+    // 自分と隣のブロックの縁から、ブロック内のダイクストラで距離を下げる
+    void RelaxBlock(int index);
+    void BuildDirections(int index);
+
+    const CollisionMap& map_;
+    WorkStealingPool& pool_;
+    int blockChunks_ = 4;
+    int areaX_ = 0;
+    int areaY_ = 0;
+    int blocksX_ = 0;
+    int blocksY_ = 0;
+    std::vector<std::unique_ptr<Block>> blocks_;
+    bool hasGoal_ = false;
+    int goalX_ = 0;
+    int goalY_ = 0;
+    bool restart_ = false; // 次の Update で目的地から計算し直す
+    std::vector<std::pair<int, int>> changedChunks_;
+    std::atomic<size_t> blockRuns_ = 0;
+    std::atomic<float> bandEnd_ = 0.0f; // 今の帯の上端（これより近い縁の変化だけをすぐ計算する）
+    Stats stats_;
+
+    // 縁の距離がこれ以上下がったときだけ隣のブロックを積み直す（浮動小数点の誤差で往復し続けない）
+    static constexpr float kNotifyEpsilon = 1.0f / 1024.0f;
+};
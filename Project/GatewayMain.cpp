@@ -0,0 +1,105 @@
+#include "TileGateway.h"
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+// タイルゲートウェイのエントリーポイント（コンソールアプリ）
+//   Gateway --key APIキー [--port 8700] [--cache cache] [--spreadsheet ID] [--sheet シート名]
+//           [--upstream Sheets APIのURL] [--revision-url URL] [--revision-interval 30] [--rate 5] [--burst 30] [--hot 4096]
+//           [--import CSV/TSVファイルかエクスポートURL]
+
+namespace {
+
+std::atomic<bool> gStop = false;
+
+void OnSignal(int) {
+    gStop = true;
+}
+
+template <typename T>
+bool ParseNumber(const std::string& text, T& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string spreadsheetId = "1fL9it6HK4IsAzmViTchDWWG5koE7nbxEfSYKjx6VFM8";
+    std::string sheetName = "TR1_02";
+    std::string apiKey;
+    std::string cacheDir = "cache";
+    std::string upstream;
+    std::string revisionUrl;
+    std::string importSource;
+    double rate = 0.0;
+    double burst = 0.0;
+    TileGatewayOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return 2;
+        }
+        std::string value = argv[++i];
+        bool ok = true;
+        if (arg == "--port") ok = ParseNumber(value, options.port);
+        else if (arg == "--cache") cacheDir = value;
+        else if (arg == "--spreadsheet") spreadsheetId = value;
+        else if (arg == "--sheet") sheetName = value;
+        else if (arg == "--key") apiKey = value;
+        else if (arg == "--upstream") upstream = value;
+        else if (arg == "--revision-url") revisionUrl = value;
+        else if (arg == "--revision-interval") ok = ParseNumber(value, options.revisionCheckIntervalSec) && options.revisionCheckIntervalSec > 0;
+        else if (arg == "--rate") ok = ParseNumber(value, rate);
+        else if (arg == "--burst") ok = ParseNumber(value, burst);
+        else if (arg == "--hot") ok = ParseNumber(value, options.hotSetCapacity);
+        else if (arg == "--import") importSource = value;
+        else ok = false;
+        if (!ok) {
+            std::fprintf(stderr, "bad argument: %s %s\n", arg.c_str(), value.c_str());
+            return 2;
+        }
+    }
+
+    ChunkLoader loader(spreadsheetId, sheetName, apiKey, cacheDir);
+    if (!upstream.empty()) loader.SetApiBaseUrl(upstream);
+    if (!revisionUrl.empty()) loader.SetRevisionUrl(revisionUrl);
+    if (rate > 0.0) loader.SetRequestQuota(rate, burst > 0.0 ? burst : rate);
+    loader.Initialize();
+    if (!importSource.empty()) {
+        // 待ち受けの前にシート全体を取り込み、現在のリビジョンで検証済みのキャッシュにしておく
+        loader.RefreshRevision();
+        bool fromUrl = importSource.rfind("http://", 0) == 0 || importSource.rfind("https://", 0) == 0;
+        std::optional<size_t> imported = fromUrl ? loader.ImportCsvUrl(importSource) : loader.ImportCsvFile(importSource);
+        if (!imported) {
+            std::fprintf(stderr, "cannot import %s\n", importSource.c_str());
+            return 1;
+        }
+        std::printf("imported %zu chunks from %s\n", *imported, importSource.c_str());
+    }
+
+    TileGateway gateway(loader, options);
+    if (!gateway.Start()) {
+        std::fprintf(stderr, "cannot listen on port %u\n", static_cast<unsigned>(options.port));
+        return 1;
+    }
+    std::printf("tile gateway listening on port %u (revision %s)\n",
+        static_cast<unsigned>(gateway.Port()), loader.GetSheetRevision().c_str());
+
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+    while (!gStop) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // クォータ待ちの取得を打ち切ってから接続を閉じる
+    loader.Shutdown();
+    gateway.Stop();
+    std::printf("%s\n", gateway.StatsJson().dump(2).c_str());
+    return 0;
+}
@@ -0,0 +1,399 @@
+#include "HttpClient.h"
+#include <nlohmann/json.hpp>
+#include <fstream>
+#include <ctime>
+#include <cstdlib>
+#include <algorithm>
+#include <string_view>
+
+HttpClient::HttpClient(long maxHostConnections) {
+    share_ = curl_share_init();
+    if (share_) {
+        curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, LockCallback);
+        curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, UnlockCallback);
+        curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        // 接続はマルチハンドルの接続プールで共有する（多重化のため）
+    }
+    multi_ = curl_multi_init();
+    if (multi_) {
+        curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, maxHostConnections);
+        worker_ = std::thread(&HttpClient::WorkerLoop, this);
+    }
+}
+
+HttpClient::~HttpClient() {
+    stop_ = true;
+    if (multi_) curl_multi_wakeup(multi_);
+    if (worker_.joinable()) worker_.join();
+    if (multi_) curl_multi_cleanup(multi_);
+    if (share_) curl_share_cleanup(share_);
+}
+
+std::future<HttpResult> HttpClient::Submit(const HttpRequest& request) {
+    auto transfer = std::make_unique<Transfer>();
+    transfer->request = request;
+    std::future<HttpResult> future = transfer->promise.get_future();
+    if (!multi_ || stop_) {
+        transfer->promise.set_value(HttpResult());
+        return future;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        pending_.push_back(std::move(transfer));
+    }
+    curl_multi_wakeup(multi_);
+    return future;
+}
+
+void HttpClient::WorkerLoop() {
+    while (!stop_) {
+        std::vector<std::unique_ptr<Transfer>> added;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            added.swap(pending_);
+        }
+        for (auto& transfer : added) {
+            CURL* easy = CreateEasy(*transfer);
+            if (!easy) {
+                transfer->promise.set_value(HttpResult());
+                continue;
+            }
+            curl_multi_add_handle(multi_, easy);
+            active_[easy] = std::move(transfer);
+        }
+
+        // 取り消された転送を外す
+        for (auto it = active_.begin(); it != active_.end();) {
+            CURL* easy = it->first;
+            const HttpRequest& request = it->second->request;
+            bool cancelled = (request.cancel && *request.cancel) || (request.outerCancel && *request.outerCancel);
+            ++it;
+            if (cancelled) CompleteTransfer(easy, CURLE_ABORTED_BY_CALLBACK);
+        }
+
+        int running = 0;
+        curl_multi_perform(multi_, &running);
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi_, &queued)) {
+            if (msg->msg == CURLMSG_DONE) CompleteTransfer(msg->easy_handle, msg->data.result);
+        }
+        curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+    }
+
+    // 終了時に残っている転送は中断扱いで返す
+    while (!active_.empty()) CompleteTransfer(active_.begin()->first, CURLE_ABORTED_BY_CALLBACK);
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    for (auto& transfer : pending_) {
+        HttpResult result;
+        result.code = CURLE_ABORTED_BY_CALLBACK;
+        transfer->promise.set_value(result);
+    }
+    pending_.clear();
+}
+
+CURL* HttpClient::CreateEasy(Transfer& transfer) const {
+    const HttpRequest& request = transfer.request;
+    CURL* curl = curl_easy_init();
+    if (!curl) return nullptr;
+    curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+    if (share_) curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+    // HTTP/2 で既存の接続に相乗りする（接続中なら新規に張らずに待つ）
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    // 対応している全ての圧縮形式を受け入れる
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    if (!request.body.empty()) {
+        // ボディは Transfer が持っているので、curl に複製させない
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.data());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(request.body.size()));
+    }
+    for (const std::string& header : request.headers) {
+        transfer.headers = curl_slist_append(transfer.headers, header.c_str());
+    }
+    if (transfer.headers) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer.headers);
+    if (request.connectTimeoutMs > 0) curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, request.connectTimeoutMs);
+    if (request.timeoutMs > 0) curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, request.timeoutMs);
+    if (request.headOnly) curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    if (request.followRedirects) {
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+    }
+    if (request.writeFunction) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, request.writeFunction);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, request.writeData);
+    }
+    return curl;
+}
+
+void HttpClient::CompleteTransfer(CURL* easy, CURLcode code) {
+    auto it = active_.find(easy);
+    if (it == active_.end()) return;
+    std::unique_ptr<Transfer> transfer = std::move(it->second);
+    active_.erase(it);
+
+    HttpResult result;
+    result.code = code;
+    long connects = 0;
+    long headerBytes = 0;
+    curl_off_t nameLookupUs = 0;
+    curl_off_t connectUs = 0;
+    curl_off_t appConnectUs = 0;
+    curl_off_t startTransferUs = 0;
+    curl_off_t totalUs = 0;
+    curl_off_t bodyBytes = 0;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &result.status);
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME_T, &nameLookupUs);
+    curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &connectUs);
+    curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME_T, &appConnectUs);
+    curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME_T, &startTransferUs);
+    curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &totalUs);
+    curl_easy_getinfo(easy, CURLINFO_HTTP_VERSION, &result.httpVersion);
+    curl_easy_getinfo(easy, CURLINFO_HEADER_SIZE, &headerBytes);
+    curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD_T, &bodyBytes);
+    // Retry-After は秒数の形式のみ扱う（日付形式は無視）
+    curl_header* retryAfter = nullptr;
+    if (curl_easy_header(easy, "Retry-After", 0, CURLH_HEADER, -1, &retryAfter) == CURLHE_OK) {
+        char* end = nullptr;
+        long seconds = std::strtol(retryAfter->value, &end, 10);
+        if (end != retryAfter->value && seconds >= 0) result.retryAfterSec = seconds;
+    }
+    curl_multi_remove_handle(multi_, easy);
+    curl_easy_cleanup(easy);
+
+    result.newConnection = connects > 0;
+    result.nameLookupMs = static_cast<double>(nameLookupUs) / 1000.0;
+    result.connectMs = static_cast<double>(connectUs) / 1000.0;
+    result.appConnectMs = static_cast<double>(appConnectUs) / 1000.0;
+    result.startTransferMs = static_cast<double>(startTransferUs) / 1000.0;
+    result.totalMs = static_cast<double>(totalUs) / 1000.0;
+    result.bytesReceived = static_cast<uint64_t>(headerBytes) + static_cast<uint64_t>(bodyBytes);
+    ++transfers_;
+    bytesReceived_ += result.bytesReceived;
+    if (result.httpVersion == CURL_HTTP_VERSION_2_0) ++http2Transfers_;
+    if (result.newConnection) {
+        ++newConnections_;
+        connectUs_ += static_cast<uint64_t>(connectUs);
+        // 再利用した接続では APPCONNECT は0になる
+        if (appConnectUs > 0) {
+            ++tlsHandshakes_;
+            appConnectUs_ += static_cast<uint64_t>(appConnectUs);
+        }
+    }
+    transfer->promise.set_value(result);
+    if (transfer->request.onComplete) transfer->request.onComplete();
+}
+
+HttpResult HttpClient::PerformHedged(const HttpRequest& primary, const HttpRequest& hedge,
+    std::chrono::milliseconds hedgeAfter, const std::function<bool()>& shouldHedge, int* winner) {
+    // どちらの転送が終わったかを待ち合わせる
+    struct Race {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done[2] = { false, false };
+    };
+    auto race = std::make_shared<Race>();
+    HttpRequest requests[2] = { primary, hedge };
+    std::future<HttpResult> futures[2];
+    for (int i = 0; i < 2; ++i) {
+        // 負けた方だけを取り消せるように複製ごとのフラグを持たせ、呼び出し元のフラグでも両方を打ち切る
+        requests[i].outerCancel = requests[i].cancel;
+        requests[i].cancel = std::make_shared<std::atomic<bool>>(false);
+        requests[i].onComplete = [race, i]() {
+            std::lock_guard<std::mutex> lock(race->mutex);
+            race->done[i] = true;
+            race->cv.notify_all();
+        };
+    }
+    if (winner) *winner = 0;
+    futures[0] = Submit(requests[0]);
+    {
+        std::unique_lock<std::mutex> lock(race->mutex);
+        if (race->cv.wait_for(lock, hedgeAfter, [&race] { return race->done[0]; })) {
+            lock.unlock();
+            return futures[0].get();
+        }
+    }
+    if (!shouldHedge || !shouldHedge()) return futures[0].get();
+
+    futures[1] = Submit(requests[1]);
+    HttpResult results[2];
+    bool ready[2] = { false, false };
+    int first = -1;
+    while (first < 0) {
+        {
+            std::unique_lock<std::mutex> lock(race->mutex);
+            race->cv.wait(lock, [&race, &ready] {
+                return (race->done[0] && !ready[0]) || (race->done[1] && !ready[1]);
+            });
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (ready[i] || futures[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+            results[i] = futures[i].get();
+            ready[i] = true;
+            if (results[i].Ok()) first = i;
+        }
+        // 両方失敗したら primary の結果を返す
+        if (first < 0 && ready[0] && ready[1]) first = 0;
+    }
+    // 負けた方を取り消し、書き込み先が使われなくなるまで待つ
+    int loser = 1 - first;
+    if (!ready[loser]) {
+        Cancel(requests[loser].cancel);
+        futures[loser].get();
+    }
+    if (winner) *winner = first;
+    return results[first];
+}
+
+void HttpClient::Cancel(const HttpCancelFlag& flag) {
+    if (!flag) return;
+    *flag = true;
+    Wakeup();
+}
+
+void HttpClient::Wakeup() {
+    if (multi_) curl_multi_wakeup(multi_);
+}
+
+void LatencyTracker::Add(double ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (samples_.size() < kCapacity) {
+        samples_.push_back(ms);
+    } else {
+        samples_[next_] = ms;
+        next_ = (next_ + 1) % kCapacity;
+    }
+}
+
+double LatencyTracker::Percentile(double p) const {
+    std::vector<double> sorted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sorted = samples_;
+    }
+    if (sorted.empty()) return 0.0;
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size())));
+    std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(index), sorted.end());
+    return sorted[index];
+}
+
+size_t LatencyTracker::Count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_.size();
+}
+
+HttpStats HttpClient::GetStats() const {
+    HttpStats stats;
+    stats.transfers = transfers_;
+    stats.newConnections = newConnections_;
+    stats.tlsHandshakes = tlsHandshakes_;
+    stats.totalConnectMs = static_cast<double>(connectUs_.load()) / 1000.0;
+    stats.totalAppConnectMs = static_cast<double>(appConnectUs_.load()) / 1000.0;
+    stats.http2Transfers = http2Transfers_;
+    stats.bytesReceived = bytesReceived_;
+    return stats;
+}
+
+void HttpClient::LockCallback(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+    static_cast<HttpClient*>(userptr)->locks_[data].lock();
+}
+
+void HttpClient::UnlockCallback(CURL*, curl_lock_data data, void* userptr) {
+    static_cast<HttpClient*>(userptr)->locks_[data].unlock();
+}
+
+namespace {
+
+// ExportTlsSession へ渡すもの（書き出し先と、セッションごとの最初の保存時刻）
+struct TlsExport {
+    nlohmann::json& sessions;
+    std::unordered_map<size_t, int64_t>& savedAt;
+};
+
+} // namespace
+
+size_t HttpClient::SaveTlsSessions(const std::filesystem::path& path) {
+    if (!share_) return 0;
+    CURL* curl = curl_easy_init();
+    if (!curl) return 0;
+    curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+    nlohmann::json sessions = nlohmann::json::array();
+    TlsExport context{ sessions, tlsSessionSavedAt_ };
+    CURLcode res = curl_easy_ssls_export(curl, ExportTlsSession, &context);
+    curl_easy_cleanup(curl);
+    // TLSバックエンドが未対応などで取り出せなければ前回のファイルを残す
+    if (res != CURLE_OK) return 0;
+    std::vector<uint8_t> bytes = nlohmann::json::to_cbor(sessions);
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return sessions.size();
+}
+
+size_t HttpClient::LoadTlsSessions(const std::filesystem::path& path) {
+    if (!share_ || !std::filesystem::exists(path)) return 0;
+    std::ifstream ifs(path, std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    nlohmann::json sessions = nlohmann::json::from_cbor(bytes, true, false);
+    if (!sessions.is_array()) return 0;
+
+    CURL* curl = curl_easy_init();
+    if (!curl) return 0;
+    curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+    size_t imported = 0;
+    for (const auto& session : sessions) {
+        // 壊れた項目は読み飛ばす（ファイルが壊れていても起動は続ける）
+        if (!session.is_object()) continue;
+        auto shmacField = session.find("shmac");
+        auto sdataField = session.find("sdata");
+        auto validUntilField = session.find("validUntil");
+        auto savedAtField = session.find("savedAt");
+        if (shmacField == session.end() || !shmacField->is_binary()
+            || sdataField == session.end() || !sdataField->is_binary()
+            || validUntilField == session.end() || !validUntilField->is_number_integer()
+            || savedAtField == session.end() || !savedAtField->is_number_integer()) {
+            continue;
+        }
+        // 期限切れ、または期限不明で古すぎるものは読み込まない
+        int64_t validUntil = validUntilField->get<int64_t>();
+        int64_t savedAt = savedAtField->get<int64_t>();
+        if (validUntil > 0 ? validUntil <= now : savedAt + kTlsSessionLifetimeSec <= now) continue;
+        const auto& shmac = shmacField->get_binary();
+        const auto& sdata = sdataField->get_binary();
+        if (curl_easy_ssls_import(curl, nullptr, shmac.data(), shmac.size(), sdata.data(), sdata.size()) == CURLE_OK) {
+            if (validUntil <= 0) tlsSessionSavedAt_[TlsSessionKey(sdata.data(), sdata.size())] = savedAt;
+            ++imported;
+        }
+    }
+    curl_easy_cleanup(curl);
+    return imported;
+}
+
+CURLcode HttpClient::ExportTlsSession(CURL*, void* userptr, const char*,
+    const unsigned char* shmac, size_t shmacLen, const unsigned char* sdata, size_t sdataLen,
+    curl_off_t validUntil, int, const char*, size_t) {
+    TlsExport& context = *static_cast<TlsExport*>(userptr);
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+    if (validUntil > 0 && validUntil <= now) return CURLE_OK;
+    // 期限不明のセッションは、前回までに保存したものなら最初の保存時刻を引き継ぐ（保存のたびに延命しない）
+    int64_t savedAt = now;
+    if (validUntil <= 0) {
+        savedAt = context.savedAt.try_emplace(TlsSessionKey(sdata, sdataLen), now).first->second;
+        if (savedAt + kTlsSessionLifetimeSec <= now) return CURLE_OK;
+    }
+    context.sessions.push_back({
+        { "shmac", nlohmann::json::binary_t(std::vector<uint8_t>(shmac, shmac + shmacLen)) },
+        { "sdata", nlohmann::json::binary_t(std::vector<uint8_t>(sdata, sdata + sdataLen)) },
+        { "validUntil", static_cast<int64_t>(validUntil) },
+        { "savedAt", savedAt },
+    });
+    return CURLE_OK;
+}
+
+size_t HttpClient::TlsSessionKey(const unsigned char* sdata, size_t sdataLen) {
+    return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(sdata), sdataLen));
+}
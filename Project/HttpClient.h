@@ -0,0 +1,167 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <string>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
+#include <future>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+#include <condition_variable>
+
+// 受信データの書き込み関数（CURLOPT_WRITEFUNCTION と同じ形）
+using HttpWriteFunction = size_t (*)(void* contents, size_t size, size_t nmemb, void* userp);
+
+// 転送の取り消しフラグ（HttpClient::Cancel で立てる）
+using HttpCancelFlag = std::shared_ptr<std::atomic<bool>>;
+
+// HTTPリクエスト
+struct HttpRequest {
+    std::string url;
+    long connectTimeoutMs = 0;    // 接続完了までの期限（0: curl既定）
+    long timeoutMs = 0;           // 転送全体の期限（0: 無制限）
+    bool headOnly = false;        // ボディを受け取らない（疎通確認用）
+    bool followRedirects = false; // 3xx の転送先へ進む（CSVエクスポートなど）
+    // 空でなければ POST で送る
+    std::string body;
+    std::vector<std::string> headers; // 追加のヘッダ（"Name: value"）
+    // 受信データの書き込み先（CURLOPT_WRITEFUNCTION / CURLOPT_WRITEDATA）
+    HttpWriteFunction writeFunction = nullptr;
+    void* writeData = nullptr;
+    HttpCancelFlag cancel;
+    // PerformHedged が複製ごとの cancel に差し替えたときの、呼び出し元の取り消しフラグ
+    HttpCancelFlag outerCancel;
+    // 完了時に通信スレッドから呼ばれる
+    std::function<void()> onComplete;
+};
+
+// HTTPレスポンスの結果
+struct HttpResult {
+    CURLcode code = CURLE_FAILED_INIT;
+    long status = 0;
+    bool newConnection = false; // 新しく接続したか（共有キャッシュの接続を再利用しなかった）
+    // 転送開始からの経過時間（CURLINFO_*_TIME_T）
+    double nameLookupMs = 0.0;    // 名前解決の完了まで
+    double connectMs = 0.0;       // TCP接続の完了まで
+    double appConnectMs = 0.0;    // TLSハンドシェイクの完了まで（再利用した接続では0）
+    double startTransferMs = 0.0; // 最初のバイトを受信するまで
+    double totalMs = 0.0;         // 転送の完了まで
+    long httpVersion = 0;       // CURLINFO_HTTP_VERSION
+    uint64_t bytesReceived = 0; // ヘッダ＋ボディ（圧縮されたまま）のバイト数
+    long retryAfterSec = -1;    // Retry-After ヘッダ（秒）。無ければ-1
+
+    bool Ok() const { return code == CURLE_OK && status >= 200 && status < 300; }
+};
+
+// 通信統計
+struct HttpStats {
+    uint64_t transfers = 0;
+    uint64_t newConnections = 0;
+    uint64_t tlsHandshakes = 0;
+    double totalConnectMs = 0.0;
+    double totalAppConnectMs = 0.0;
+    uint64_t http2Transfers = 0;
+    uint64_t bytesReceived = 0;
+};
+
+// 直近の転送時間からパーセンタイルを求める（複数スレッドから呼べる）
+class LatencyTracker {
+public:
+    void Add(double ms);
+    double Percentile(double p) const;
+    size_t Count() const;
+
+private:
+    static constexpr size_t kCapacity = 256;
+    mutable std::mutex mutex_;
+    std::vector<double> samples_;
+    size_t next_ = 0;
+};
+
+// 全転送を1つのマルチハンドルで処理するHTTPクライアント
+// HTTP/2 で1本の接続に多重化し、gzip/br/zstd の圧縮転送を受け入れる
+// DNS・TLSセッションは共有ハンドルに持つ
+// curl_global_init 後に生成すること。Submit / Perform は複数スレッドから同時に呼べる
+class HttpClient {
+public:
+    // 1ホストあたりの同時接続数の既定値（HTTP/2 では通常1本に多重化される）
+    static constexpr long kMaxHostConnections = 4;
+
+    // maxHostConnections: 1ホストあたりの同時接続数（HTTP/1.1 の接続先ではこれが同時転送数の上限になる）
+    explicit HttpClient(long maxHostConnections = kMaxHostConnections);
+    ~HttpClient();
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    // 転送を開始する。書き込み関数は通信スレッドから呼ばれる
+    std::future<HttpResult> Submit(const HttpRequest& request);
+    // 同期的に転送する（呼び出しスレッドでブロックする）
+    HttpResult Perform(const HttpRequest& request) { return Submit(request).get(); }
+    // hedgeAfter 経過しても終わらず shouldHedge が true なら hedge を追加で送り、
+    // 先に成功した方を返す（負けた方は取り消す）。winner に 0:primary / 1:hedge を返す
+    HttpResult PerformHedged(const HttpRequest& primary, const HttpRequest& hedge,
+        std::chrono::milliseconds hedgeAfter, const std::function<bool()>& shouldHedge, int* winner);
+    // 転送を取り消す（結果は CURLE_ABORTED_BY_CALLBACK になる）
+    void Cancel(const HttpCancelFlag& flag);
+    // 取り消しフラグを外で立てたときに、通信スレッドをすぐ起こして転送を外させる
+    void Wakeup();
+
+    HttpStats GetStats() const;
+
+    // TLSセッションチケットの保存／読み込み（期限切れは捨てる）。件数を返す
+    size_t SaveTlsSessions(const std::filesystem::path& path);
+    size_t LoadTlsSessions(const std::filesystem::path& path);
+
+private:
+    struct Transfer {
+        HttpRequest request;
+        std::promise<HttpResult> promise;
+        curl_slist* headers = nullptr; // 転送が終わるまで curl が参照する
+
+        ~Transfer() { curl_slist_free_all(headers); }
+    };
+
+    // 通信スレッド
+    void WorkerLoop();
+    CURL* CreateEasy(Transfer& transfer) const;
+    void CompleteTransfer(CURL* easy, CURLcode code);
+
+    static void LockCallback(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void UnlockCallback(CURL* handle, curl_lock_data data, void* userptr);
+    static CURLcode ExportTlsSession(CURL* handle, void* userptr, const char* sessionKey,
+        const unsigned char* shmac, size_t shmacLen, const unsigned char* sdata, size_t sdataLen,
+        curl_off_t validUntil, int ietfTlsId, const char* alpn, size_t earlydataMax);
+
+    // 有効期限が不明なセッションを保持する時間（最初に保存した時刻から数える）
+    static constexpr int64_t kTlsSessionLifetimeSec = 24 * 60 * 60;
+    // セッションデータのハッシュ
+    static size_t TlsSessionKey(const unsigned char* sdata, size_t sdataLen);
+
+    CURLSH* share_ = nullptr;
+    CURLM* multi_ = nullptr;
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> locks_;
+    // 読み込んだセッションの最初の保存時刻（セッションデータのハッシュごと）
+    // curl は保存のたびに同じセッションを書き出すので、期限不明のセッションの保存時刻を引き継ぐのに使う
+    std::unordered_map<size_t, int64_t> tlsSessionSavedAt_;
+
+    std::thread worker_;
+    std::atomic<bool> stop_ = false;
+    std::mutex queueMutex_;
+    std::vector<std::unique_ptr<Transfer>> pending_;
+    std::unordered_map<CURL*, std::unique_ptr<Transfer>> active_; // 通信スレッドのみが触る
+
+    // 統計（時間はマイクロ秒で積算）
+    std::atomic<uint64_t> transfers_ = 0;
+    std::atomic<uint64_t> newConnections_ = 0;
+    std::atomic<uint64_t> tlsHandshakes_ = 0;
+    std::atomic<uint64_t> connectUs_ = 0;
+    std::atomic<uint64_t> appConnectUs_ = 0;
+    std::atomic<uint64_t> http2Transfers_ = 0;
+    std::atomic<uint64_t> bytesReceived_ = 0;
+};
@@ -0,0 +1,373 @@
+#include "HttpServer.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <nlohmann/json.hpp>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+using NativeSocket = SOCKET;
+#else
+using NativeSocket = int;
+#endif
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL; // 切断済みの相手に送っても SIGPIPE で落ちない
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+NativeSocket Native(std::intptr_t socket) {
+    return static_cast<NativeSocket>(socket);
+}
+
+int Receive(std::intptr_t socket, char* buffer, int size) {
+#ifdef _WIN32
+    return recv(Native(socket), buffer, size, 0);
+#else
+    return static_cast<int>(recv(Native(socket), buffer, static_cast<size_t>(size), 0));
+#endif
+}
+
+bool SendAll(std::intptr_t socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int chunk = static_cast<int>(std::min<size_t>(data.size() - sent, 1 << 20));
+#ifdef _WIN32
+        int n = send(Native(socket), data.data() + sent, chunk, kSendFlags);
+#else
+        int n = static_cast<int>(send(Native(socket), data.data() + sent, static_cast<size_t>(chunk), kSendFlags));
+#endif
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void ConfigureClientSocket(std::intptr_t socket, int idleTimeoutSec) {
+    // 小さなレスポンスを keep-alive で返すので Nagle を切る
+    int noDelay = 1;
+    setsockopt(Native(socket), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+#ifdef _WIN32
+    DWORD timeoutMs = static_cast<DWORD>(idleTimeoutSec) * 1000;
+    setsockopt(Native(socket), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeoutMs), sizeof(timeoutMs));
+#else
+    timeval timeout{};
+    timeout.tv_sec = idleTimeoutSec;
+    setsockopt(Native(socket), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#endif
+}
+
+// ヘッダの終わりまで受信する。切断・タイムアウト・大きすぎるヘッダなら false
+bool ReceiveHead(std::intptr_t socket, std::string& buffer, size_t maxBytes, size_t& headEnd) {
+    char chunk[4096];
+    while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (buffer.size() > maxBytes) return false;
+        int n = Receive(socket, chunk, static_cast<int>(sizeof(chunk)));
+        if (n <= 0) return false;
+        buffer.append(chunk, static_cast<size_t>(n));
+    }
+    return true;
+}
+
+// ボディの length バイト目まで受信する（ヘッダの後に受け取った分は buffer に入っている）
+bool ReceiveBody(std::intptr_t socket, std::string& buffer, size_t length) {
+    char chunk[4096];
+    while (buffer.size() < length) {
+        int n = Receive(socket, chunk, static_cast<int>(sizeof(chunk)));
+        if (n <= 0) return false;
+        buffer.append(chunk, static_cast<size_t>(n));
+    }
+    return true;
+}
+
+char ToLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// ヘッダの値（名前は大文字小文字を区別しない）。無ければ空
+std::string HeaderValue(const std::string& head, const std::string& name) {
+    size_t pos = head.find("\r\n");
+    while (pos != std::string::npos && pos + 2 < head.size()) {
+        size_t lineStart = pos + 2;
+        size_t lineEnd = head.find("\r\n", lineStart);
+        if (lineEnd == std::string::npos) lineEnd = head.size();
+        size_t colon = head.find(':', lineStart);
+        if (colon != std::string::npos && colon < lineEnd && colon - lineStart == name.size()) {
+            bool match = true;
+            for (size_t i = 0; i < name.size(); ++i) {
+                if (ToLower(head[lineStart + i]) != ToLower(name[i])) match = false;
+            }
+            if (match) {
+                size_t valueStart = head.find_first_not_of(' ', colon + 1);
+                if (valueStart == std::string::npos || valueStart > lineEnd) return std::string();
+                std::string value = head.substr(valueStart, lineEnd - valueStart);
+                for (char& c : value) c = ToLower(c);
+                return value;
+            }
+        }
+        pos = lineEnd;
+    }
+    return std::string();
+}
+
+int HexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+const char* ReasonPhrase(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 411: return "Length Required";
+    case 413: return "Content Too Large";
+    case 429: return "Too Many Requests";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    default: return "Error";
+    }
+}
+
+std::string ResponseHead(const HttpServerResponse& response, bool keepAlive) {
+    std::string head = "HTTP/1.1 " + std::to_string(response.status) + " " + ReasonPhrase(response.status)
+        + "\r\nContent-Type: application/json; charset=UTF-8\r\nContent-Length: " + std::to_string(response.body->size());
+    if (response.retryAfterSec >= 0) head += "\r\nRetry-After: " + std::to_string(response.retryAfterSec);
+    return head + (keepAlive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+}
+
+} // namespace
+
+HttpServer::HttpServer(const HttpServerOptions& options, Handler handler)
+    : options_(options)
+    , handler_(std::move(handler)) {
+}
+
+HttpServer::~HttpServer() {
+    Stop();
+}
+
+bool HttpServer::Start() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return false;
+#endif
+    started_ = true;
+    stopping_ = false;
+    NativeSocket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    listenSocket_ = static_cast<SocketHandle>(listener);
+    if (listenSocket_ == kInvalidSocket) {
+        Stop();
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options_.port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listener, SOMAXCONN) != 0) {
+        Stop();
+        return false;
+    }
+    // port 0 で開いたときに割り当てられたポート
+    sockaddr_in bound{};
+    socklen_t boundSize = sizeof(bound);
+    port_ = getsockname(listener, reinterpret_cast<sockaddr*>(&bound), &boundSize) == 0 ? ntohs(bound.sin_port) : options_.port;
+    acceptThread_ = std::thread([this, listener = listenSocket_]() { AcceptLoop(listener); });
+    return true;
+}
+
+void HttpServer::Stop() {
+    if (!started_) return;
+    started_ = false;
+    stopping_ = true;
+    if (listenSocket_ != kInvalidSocket) {
+        // Linux では close だけでは accept が戻らない
+#ifdef _WIN32
+        shutdown(Native(listenSocket_), SD_BOTH);
+#else
+        shutdown(Native(listenSocket_), SHUT_RDWR);
+#endif
+        CloseSocket(listenSocket_);
+        listenSocket_ = kInvalidSocket;
+    }
+    if (acceptThread_.joinable()) acceptThread_.join();
+    {
+        // 受信待ちの接続を起こし、各スレッドが自分のソケットを閉じて抜けるのを待つ
+        std::unique_lock<std::mutex> lock(connectionMutex_);
+        for (SocketHandle connection : connections_) {
+#ifdef _WIN32
+            shutdown(Native(connection), SD_BOTH);
+#else
+            shutdown(Native(connection), SHUT_RDWR);
+#endif
+        }
+        connectionCv_.wait(lock, [this]() { return connections_.empty(); });
+    }
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+size_t HttpServer::ConnectionCount() const {
+    std::lock_guard<std::mutex> lock(connectionMutex_);
+    return connections_.size();
+}
+
+void HttpServer::AcceptLoop(SocketHandle listener) {
+    while (!stopping_) {
+        NativeSocket accepted = accept(Native(listener), nullptr, nullptr);
+        SocketHandle client = static_cast<SocketHandle>(accepted);
+        if (client == kInvalidSocket) {
+            // ディスクリプタ切れなどで失敗し続けるときに空回りしない
+            if (!stopping_) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        bool admitted = false;
+        {
+            std::lock_guard<std::mutex> lock(connectionMutex_);
+            if (!stopping_ && connections_.size() < static_cast<size_t>(options_.maxConnections)) {
+                connections_.insert(client);
+                admitted = true;
+            }
+        }
+        if (!admitted) {
+            ++rejected_;
+            HttpServerResponse rejected = ErrorResponse(503, "too many connections");
+            SendAll(client, ResponseHead(rejected, false) + *rejected.body);
+            CloseSocket(client);
+            continue;
+        }
+        std::thread([this, client]() { ServeConnection(client); }).detach();
+    }
+}
+
+void HttpServer::ServeConnection(SocketHandle socket) {
+    ConfigureClientSocket(socket, options_.idleTimeoutSec);
+    std::string buffer;
+    bool keepAlive = true;
+    while (keepAlive && !stopping_) {
+        size_t headEnd = 0;
+        if (!ReceiveHead(socket, buffer, kMaxHeaderBytes, headEnd)) break;
+        auto start = std::chrono::steady_clock::now();
+        std::string head = buffer.substr(0, headEnd + 2);
+        buffer.erase(0, headEnd + 4);
+
+        // リクエスト行: メソッド ターゲット バージョン
+        size_t lineEnd = head.find("\r\n");
+        size_t sp1 = head.find(' ');
+        size_t sp2 = sp1 == std::string::npos ? std::string::npos : head.find(' ', sp1 + 1);
+        HttpServerResponse response;
+        if (sp2 == std::string::npos || sp2 > lineEnd) {
+            response = ErrorResponse(400, "malformed request line");
+            keepAlive = false;
+        } else {
+            std::string method = head.substr(0, sp1);
+            std::string target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+            std::string version = head.substr(sp2 + 1, lineEnd - sp2 - 1);
+            std::string connection = HeaderValue(head, "Connection");
+            keepAlive = version == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+            std::string contentLength = HeaderValue(head, "Content-Length");
+            size_t length = 0;
+            auto [ptr, ec] = std::from_chars(contentLength.data(), contentLength.data() + contentLength.size(), length);
+            bool lengthOk = contentLength.empty() || (ec == std::errc() && ptr == contentLength.data() + contentLength.size());
+            // 受けないボディは読み捨てずに閉じる
+            if (!HeaderValue(head, "Transfer-Encoding").empty()) {
+                response = ErrorResponse(411, "chunked bodies are not supported");
+                keepAlive = false;
+            } else if (!lengthOk) {
+                response = ErrorResponse(400, "bad Content-Length");
+                keepAlive = false;
+            } else if (length > 0 && options_.maxBodyBytes == 0) {
+                response = ErrorResponse(405, "only GET is supported");
+                keepAlive = false;
+            } else if (length > options_.maxBodyBytes) {
+                response = ErrorResponse(413, "request body too large");
+                keepAlive = false;
+            } else {
+                // curl は大きなボディの前に 100 Continue を待つ（来なければ1秒待ってから送る）
+                if (buffer.size() < length && HeaderValue(head, "Expect") == "100-continue"
+                    && !SendAll(socket, "HTTP/1.1 100 Continue\r\n\r\n")) {
+                    break;
+                }
+                if (!ReceiveBody(socket, buffer, length)) break;
+                std::string body = buffer.substr(0, length);
+                buffer.erase(0, length);
+                response = handler_(method, target, body);
+            }
+        }
+        if (response.status >= 400) ++errors_;
+        if (!SendAll(socket, ResponseHead(response, keepAlive) + *response.body)) break;
+        latency_.Record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    CloseSocket(socket);
+    std::lock_guard<std::mutex> lock(connectionMutex_);
+    connections_.erase(socket);
+    connectionCv_.notify_all();
+}
+
+HttpServerResponse HttpServer::ErrorResponse(int status, const std::string& message) {
+    nlohmann::json j = { { "error", { { "code", status }, { "message", message } } } };
+    return { status, std::make_shared<const std::string>(j.dump()) };
+}
+
+bool HttpServer::PercentDecode(const std::string& text, std::string& decoded) {
+    decoded.clear();
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '%') {
+            decoded.push_back(text[i]);
+            continue;
+        }
+        if (i + 2 >= text.size()) return false;
+        int high = HexDigit(text[i + 1]);
+        int low = HexDigit(text[i + 2]);
+        if (high < 0 || low < 0) return false;
+        decoded.push_back(static_cast<char>(high * 16 + low));
+        i += 2;
+    }
+    return true;
+}
+
+int64_t HttpServer::QueryInt(const std::string& target, const std::string& name, int64_t fallback) {
+    size_t pos = target.find('?');
+    while (pos != std::string::npos) {
+        size_t start = pos + 1;
+        size_t end = target.find('&', start);
+        size_t valueEnd = end == std::string::npos ? target.size() : end;
+        if (target.compare(start, name.size(), name) == 0 && start + name.size() < valueEnd
+            && target[start + name.size()] == '=') {
+            int64_t value = 0;
+            const char* first = target.data() + start + name.size() + 1;
+            const char* last = target.data() + valueEnd;
+            auto [ptr, ec] = std::from_chars(first, last, value);
+            return ec == std::errc() && ptr == last ? value : fallback;
+        }
+        pos = end;
+    }
+    return fallback;
+}
+
+void HttpServer::CloseSocket(SocketHandle socket) {
+#ifdef _WIN32
+    closesocket(Native(socket));
+#else
+    close(Native(socket));
+#endif
+}
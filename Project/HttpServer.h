@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include "PipelineStats.h"
+
+// HTTP サーバーの設定
+struct HttpServerOptions {
+    uint16_t port = 0;         // 0 なら空いているポートを使う（Port で分かる）
+    int maxConnections = 1024; // 同時接続数の上限（超えたら503で閉じる）
+    int idleTimeoutSec = 30;   // keep-alive 接続の無通信タイムアウト
+    size_t maxBodyBytes = 0;   // 受けるリクエストボディの上限（0 ならボディ付きのリクエストは 405 で閉じる）
+};
+
+// 1件のレスポンス（ボディはJSON）
+struct HttpServerResponse {
+    int status = 200;
+    std::shared_ptr<const std::string> body;
+    long retryAfterSec = -1; // 0 以上なら Retry-After ヘッダを付ける
+};
+
+// 小さな HTTP/1.1 サーバー（keep-alive の接続ごとに1スレッド）
+// リクエストボディは Content-Length 付きで maxBodyBytes までのものだけを受ける（chunked は受けない）
+// タイルゲートウェイと、負荷試験で上流の代わりに置くモックが使う
+class HttpServer {
+public:
+    // method と target（パスとクエリ）とボディ（無ければ空）を受けてレスポンスを返す。接続スレッドから同時に呼ばれる
+    using Handler = std::function<HttpServerResponse(const std::string& method, const std::string& target,
+        const std::string& body)>;
+
+    HttpServer(const HttpServerOptions& options, Handler handler);
+    ~HttpServer();
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    // 待ち受けを開始する。ポートを開けなければfalse
+    bool Start();
+    // 新しい接続の受け付けを止め、処理中の接続を閉じて終わるまで待つ
+    // ハンドラの中で待っている処理は、先に起こしておく
+    void Stop();
+
+    // 待ち受けているポート（port 0 で開いたときは実際のポート）
+    uint16_t Port() const { return port_; }
+    size_t ConnectionCount() const;
+    uint64_t RejectedConnections() const { return rejected_.load(); }
+    // 400 以上を返したリクエスト
+    uint64_t Errors() const { return errors_.load(); }
+    // リクエストを受けてからレスポンスを送り終えるまで
+    const LatencyHistogram& Latency() const { return latency_; }
+
+    // Sheets API と同じ形のエラーレスポンス
+    static HttpServerResponse ErrorResponse(int status, const std::string& message);
+    // パスのパーセントエンコードを戻す（シート名が日本語の場合など）
+    static bool PercentDecode(const std::string& text, std::string& decoded);
+    // クエリの整数（"?since=3&wait=25" の since → 3）。無いか整数でなければ fallback
+    static int64_t QueryInt(const std::string& target, const std::string& name, int64_t fallback);
+
+private:
+    // ソケット（Windows の SOCKET も収まる整数で持つ）
+    using SocketHandle = std::intptr_t;
+    static constexpr SocketHandle kInvalidSocket = -1;
+
+    void AcceptLoop(SocketHandle listener);
+    void ServeConnection(SocketHandle socket);
+    static void CloseSocket(SocketHandle socket);
+
+    HttpServerOptions options_;
+    Handler handler_;
+    bool started_ = false;
+    uint16_t port_ = 0;
+    SocketHandle listenSocket_ = kInvalidSocket;
+    std::thread acceptThread_;
+    std::atomic<bool> stopping_ = false;
+
+    // 接続スレッドの管理（Stop で全ソケットを閉じて終了を待つ）
+    mutable std::mutex connectionMutex_;
+    std::condition_variable connectionCv_;
+    std::unordered_set<SocketHandle> connections_;
+
+    std::atomic<uint64_t> rejected_ = 0;
+    std::atomic<uint64_t> errors_ = 0;
+    LatencyHistogram latency_;
+
+    static constexpr size_t kMaxHeaderBytes = 16 * 1024;
+};
@@ -0,0 +1,94 @@
+#include "InterestRegions.h"
+#include <algorithm>
+#include <cstdlib>
+
+int InterestRegionSet::Add(const InterestRegion& region) {
+    int id = nextId_++;
+    regions_[id] = region;
+    Apply(nullptr, &region);
+    return id;
+}
+
+void InterestRegionSet::Move(int id, int chunkX, int chunkY) {
+    auto found = regions_.find(id);
+    if (found == regions_.end()) return;
+    InterestRegion before = found->second;
+    InterestRegion& after = found->second;
+    after.chunkX = chunkX;
+    after.chunkY = chunkY;
+    if (after.chunkX == before.chunkX && after.chunkY == before.chunkY) return;
+    Apply(&before, &after);
+}
+
+void InterestRegionSet::Remove(int id) {
+    auto found = regions_.find(id);
+    if (found == regions_.end()) return;
+    InterestRegion before = found->second;
+    regions_.erase(found);
+    Apply(&before, nullptr);
+}
+
+void InterestRegionSet::EnqueueAll() {
+    for (const auto& kv : regions_) EnqueueWindow(kv.second, &kv.second);
+}
+
+const InterestRegion* InterestRegionSet::Find(int id) const {
+    auto found = regions_.find(id);
+    return found != regions_.end() ? &found->second : nullptr;
+}
+
+int InterestRegionSet::RefCount(int cx, int cy) const {
+    auto found = refCounts_.find({ cx, cy });
+    return found != refCounts_.end() ? found->second : 0;
+}
+
+int InterestRegionSet::WindowChunkCount() const {
+    int count = 0;
+    for (const auto& kv : regions_) {
+        int side = (kv.second.viewDistanceChunks + kv.second.prefetchDistanceChunks) * 2 + 1;
+        count += side * side;
+    }
+    return count;
+}
+
+bool InterestRegionSet::InWindow(const InterestRegion& region, int cx, int cy) {
+    int reach = region.viewDistanceChunks + region.prefetchDistanceChunks;
+    return std::abs(cx - region.chunkX) <= reach && std::abs(cy - region.chunkY) <= reach;
+}
+
+void InterestRegionSet::EnqueueWindow(const InterestRegion& region, const InterestRegion* before) {
+    // 表示範囲を先に積み、その外側を先読みとして積む
+    // before の範囲になかったチャンクだけ参照数を増やす
+    int view = region.viewDistanceChunks;
+    int reach = view + region.prefetchDistanceChunks;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int dy = -reach; dy <= reach; ++dy) {
+            for (int dx = -reach; dx <= reach; ++dx) {
+                bool visible = std::abs(dx) <= view && std::abs(dy) <= view;
+                if (visible != (pass == 0)) continue;
+                int cx = region.chunkX + dx;
+                int cy = region.chunkY + dy;
+                if (!before || !InWindow(*before, cx, cy)) ++refCounts_[{ cx, cy }];
+                enqueue_(cx, cy, visible ? region.priority : std::max(region.priority, LoadPriority::Prefetch));
+            }
+        }
+    }
+}
+
+void InterestRegionSet::Apply(const InterestRegion* before, const InterestRegion* after) {
+    if (after) EnqueueWindow(*after, before);
+    if (!before) return;
+    // 範囲から外れたチャンクは、他の領域が参照していなければ解放する
+    int reach = before->viewDistanceChunks + before->prefetchDistanceChunks;
+    for (int dy = -reach; dy <= reach; ++dy) {
+        for (int dx = -reach; dx <= reach; ++dx) {
+            int cx = before->chunkX + dx;
+            int cy = before->chunkY + dy;
+            if (after && InWindow(*after, cx, cy)) continue;
+            auto found = refCounts_.find({ cx, cy });
+            if (found == refCounts_.end() || --found->second > 0) continue;
+            refCounts_.erase(found);
+            release_(cx, cy);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include "ChunkLoader.h"
+
+// 関心領域（プレイヤー、観戦カメラ、ミニマップ、サーバーに接続中の各プレイヤーなど）
+// 範囲が重なる領域どうしはチャンクの読み込みとメモリを共有する
+struct InterestRegion {
+    int chunkX = 0;
+    int chunkY = 0;
+    int viewDistanceChunks = 1;
+    int prefetchDistanceChunks = 0;
+    LoadPriority priority = LoadPriority::Visible; // 表示範囲の読み込み優先度（先読み範囲は Prefetch 以下）
+};
+
+// 関心領域の集まりと、チャンクごとの参照数（そのチャンクを範囲に含む領域の数）
+// 領域の追加・移動・削除では、範囲に入る・外れるチャンクだけを調べ、読み込みと解放を呼び出し側に頼む
+// 描画に依存しない（MapManager とベンチマークで共用）
+class InterestRegionSet {
+public:
+    // 範囲のチャンクの読み込みを積む。範囲に残ったチャンクも呼び直し、先読みから表示範囲に入ったものの優先度を上げさせる
+    using EnqueueFn = std::function<void(int cx, int cy, LoadPriority priority)>;
+    // どの領域の範囲からも外れたチャンクを解放する
+    using ReleaseFn = std::function<void(int cx, int cy)>;
+
+    InterestRegionSet(EnqueueFn enqueue, ReleaseFn release) : enqueue_(std::move(enqueue)), release_(std::move(release)) {}
+
+    // 戻り値のIDで移動・削除する
+    int Add(const InterestRegion& region);
+    void Move(int id, int chunkX, int chunkY);
+    void Remove(int id);
+    // 全領域の範囲を積み直す（チャンクを捨てて読み込み直すとき。参照数は変えない）
+    void EnqueueAll();
+
+    const InterestRegion* Find(int id) const;
+    // (cx, cy) を範囲に含む領域の数
+    int RefCount(int cx, int cy) const;
+    // どれかの領域の範囲に入っているチャンクの数
+    size_t ChunkCount() const { return refCounts_.size(); }
+    // 全領域の表示範囲＋先読み範囲のチャンク数（重なりを含む）
+    int WindowChunkCount() const;
+    const std::unordered_map<int, InterestRegion>& Regions() const { return regions_; }
+    static bool InWindow(const InterestRegion& region, int cx, int cy);
+
+private:
+    // before から after へ変わった領域の範囲を反映する（追加なら before、削除なら after が nullptr）
+    void Apply(const InterestRegion* before, const InterestRegion* after);
+    void EnqueueWindow(const InterestRegion& region, const InterestRegion* before);
+
+    EnqueueFn enqueue_;
+    ReleaseFn release_;
+    std::unordered_map<int, InterestRegion> regions_;
+    std::unordered_map<std::pair<int, int>, int, PairHash> refCounts_;
+    int nextId_ = 0;
+};
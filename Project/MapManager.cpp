@@ -1,6 +1,59 @@
 #include "MapManager.h"
+#include <algorithm>
+#include <cmath>
 #include <fstream>
-#include <iostream>
+
+namespace {
+
+// 実行ごとに比較できるよう書き出すファイル名に付ける時刻（UNIX秒）
+std::string TimestampSuffix() {
+    return std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// チャンク用プールの設定。表示範囲のチャンク数を1回に補充するブロック数の目安にする
+std::pmr::pool_options ChunkPoolOptions(int viewDistanceChunks) {
+    size_t side = static_cast<size_t>(viewDistanceChunks) * 2 + 1;
+    std::pmr::pool_options options;
+    options.max_blocks_per_chunk = side * side * 2;
+    return options;
+}
+
+// 負の座標でも小さい方へ丸める割り算
+int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// タイル番号ごとの色（0 とそれ以外の番号は描かない）
+bool TileColor(int tile, unsigned int& color) {
+    switch (tile) {
+    case 1: color = BLUE; return true;
+    case 2: color = RED; return true;
+    case 3: color = GREEN; return true;
+    default: return false;
+    }
+}
+
+// 色（0xRRGGBBAA）の RGB を明るさ level / LightMap::kMaxLight 倍にする
+unsigned int ShadeColor(unsigned int color, int level) {
+    unsigned int r = (color >> 24 & 0xFF) * level / LightMap::kMaxLight;
+    unsigned int g = (color >> 16 & 0xFF) * level / LightMap::kMaxLight;
+    unsigned int b = (color >> 8 & 0xFF) * level / LightMap::kMaxLight;
+    return r << 24 | g << 16 | b << 8 | (color & 0xFF);
+}
+
+// 読み込みスレッドで起きた例外（壊れたキャッシュなど）をゲームループに持ち込まず、失敗した結果として受け取る
+ChunkLoadResult TakeLoadResult(std::future<ChunkLoadResult>& future) {
+    try {
+        return future.get();
+    } catch (...) {
+        ChunkLoadResult result;
+        result.failed = true;
+        return result;
+    }
+}
+
+} // namespace
 
 MapManager::MapManager(const std::string& spreadsheetId,
     const std::string& sheetName,
@@ -9,182 +62,819 @@ MapManager::MapManager(const std::string& spreadsheetId,
     int yOffset,
     int viewDistanceChunks,
     const std::string& cacheDir)
-    : spreadsheetId_(spreadsheetId)
-    , sheetName_(sheetName)
-    , apiKey_(apiKey)
+    : loader_(spreadsheetId, sheetName, apiKey, cacheDir)
+    , memorySource_(std::make_shared<MemorySource>(kMemoryCacheChunks))
+    , sheetsSource_(std::make_shared<SheetsSource>(loader_))
     , tileSize_(tileSize)
     , yOffset_(yOffset)
     , viewDistanceChunks_(viewDistanceChunks)
-    , cacheDir_(cacheDir) {
-    // キャッシュディレクトリを作成
-    std::filesystem::create_directories(cacheDir_);
+    , cacheDir_(cacheDir)
+    , chunkPool_(ChunkPoolOptions(viewDistanceChunks))
+    , chunks_(&chunkPool_)
+    , loadQueue_(&chunkPool_)
+    , regions_([this](int cx, int cy, LoadPriority priority) { EnqueueChunkLoad(cx, cy, priority); },
+        [this](int cx, int cy) { ReleaseChunk(cx, cy); })
+    , editor_(loader_, std::filesystem::path(cacheDir) / "pending_edits.json")
+    , watcher_(loader_) {
+    source_ = std::make_shared<CachedSource>(
+        std::vector<std::shared_ptr<TileSource>>{
+            memorySource_, std::make_shared<DiskCacheSource>(loader_, true), sheetsSource_ },
+        std::make_shared<DiskCacheSource>(loader_, false));
 }
 
 MapManager::~MapManager() {
-    curl_global_cleanup();
+    watcher_.Stop();
+    // 残りの編集を送ってから通信を止める
+    editor_.Shutdown();
+    // 順番待ちの読み込みを打ち切り、転送中のものを待ってから ChunkLoader を破棄する
+    loader_.Shutdown();
+    StopLoaders();
+    overviewLoads_.clear();
+    chunks_.clear();
+    overview_.Save(std::filesystem::path(cacheDir_) / "overview.json");
 }
 
 void MapManager::Initialize(int startPlayerTileX, int startPlayerTileY) {
-    curl_global_init(CURL_GLOBAL_ALL);
-    isOnline_ = CheckOnlineStatus();
-    int cx = startPlayerTileX / kChunkWidth;
-    int cy = startPlayerTileY / kChunkHeight;
-    for (int dy = -viewDistanceChunks_; dy <= viewDistanceChunks_; ++dy) {
-        for (int dx = -viewDistanceChunks_; dx <= viewDistanceChunks_; ++dx) {
-            EnqueueChunkLoad(cx + dx, cy + dy);
+    loader_.Initialize();
+    // リビジョン確認が通ればオンライン（確認用の通信を別に行わない）
+    // 手元のファイルだけから読むときは通信しない
+    if (source_->IsRemote()) isOnline_ = loader_.RefreshRevision() || loader_.CheckOnlineStatus();
+    sheetsSource_->SetOnline(isOnline_);
+    editor_.SetOnline(isOnline_);
+    // 変更の待ち受けは、起動時に確かめたリビジョンからの変更を拾う
+    // Drive の version はどのチャンクが変わったかを言わず、確かめるたびに全チャンクを取り直すことになるので、
+    // 間隔を指定されたときだけ確かめる（既定ではチェックサムRange のときだけ）
+    if (source_->IsRemote()) {
+        bool poll = revisionPollInterval_.count() > 0 && (revisionPollRequested_ || loader_.HasRemoteChecksums());
+        if (!changeFeedUrl_.empty()) {
+            watcher_.StartFeed(changeFeedUrl_);
+        } else if (poll) {
+            watcher_.StartPolling(revisionPollInterval_);
         }
     }
+    // 前回までに分かった縮小地図（遠くの地域を読み込まずに描ける）
+    overview_.Load(std::filesystem::path(cacheDir_) / "overview.json");
+    playerRegion_ = AddInterestRegion(startPlayerTileX, startPlayerTileY, viewDistanceChunks_);
+}
+
+void MapManager::UseGateway(const std::string& baseUrl) {
+    // ゲートウェイは Sheets API と Drive のリビジョン確認を同じパスで受ける（キーはゲートウェイ側が持つ）
+    loader_.SetApiBaseUrl(baseUrl);
+    loader_.SetRevisionUrl(baseUrl + "/drive/v3/files/" + loader_.GetSpreadsheetId() + "?fields=version");
+    changeFeedUrl_ = baseUrl + "/changes";
+}
+
+int MapManager::AddLayer(const MapLayer& layer) {
+    layers_.push_back(layer);
+    std::vector<SheetLayer> sheets;
+    for (const MapLayer& l : layers_) sheets.push_back(l.sheet);
+    loader_.SetLayers(std::move(sheets));
+    // 優先度の小さい順（同じなら追加した順。主レイヤーは優先度 0 で最初）
+    layerOrder_.assign(1, 0);
+    for (int i = 1; i <= static_cast<int>(layers_.size()); ++i) layerOrder_.push_back(i);
+    std::stable_sort(layerOrder_.begin(), layerOrder_.end(), [this](int a, int b) {
+        return LayerPriority(a) < LayerPriority(b);
+    });
+    return static_cast<int>(layers_.size());
+}
+
+void MapManager::UseWorldFile(const std::filesystem::path& path) {
+    SetTileSource(std::make_shared<CachedSource>(
+        std::vector<std::shared_ptr<TileSource>>{ std::make_shared<FileSource>(path) }));
+}
+
+void MapManager::SetTileClasses(int tile, TileClassifier::ClassMask classes) {
+    tileClassifier_.SetClasses(tile, classes);
+    for (const auto& kv : chunks_) {
+        const MapChunk& chunk = kv.second;
+        if (!chunk.loaded) continue;
+        ChunkOccupancy occupancy = tileClassifier_.Build(chunk.tiles);
+        collision_.Set(chunk.chunkX, chunk.chunkY, occupancy);
+        lightMap_.Set(chunk.chunkX, chunk.chunkY, occupancy.Of(TileClass::Solid), chunk.tiles);
+    }
+    pathfinder_.Invalidate();
+    flowField_.Invalidate();
+}
+
+void MapManager::SetTileLight(int tile, int level) {
+    lightMap_.SetEmission(tile, level);
+    // 光源の変わったチャンクだけが計算し直される
+    for (const auto& kv : chunks_) {
+        const MapChunk& chunk = kv.second;
+        if (chunk.loaded) lightMap_.Set(chunk.chunkX, chunk.chunkY, tileClassifier_.Build(chunk.tiles).Of(TileClass::Solid), chunk.tiles);
+    }
+}
+
+PathResult MapManager::FindPath(int fromTileX, int fromTileY, int toTileX, int toTileY, UnloadedTiles unloaded) {
+    PathResult result = pathfinder_.FindPath(fromTileX, fromTileY, toTileX, toTileY, unloaded);
+    auto expiry = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(kPathChunkSeconds));
+    // 先読み範囲を付けず、経路が通るチャンクだけを読み込む
+    for (const auto& chunk : result.unloadedChunks) {
+        auto [it, inserted] = pathRegions_.try_emplace(chunk);
+        if (inserted) {
+            it->second.regionId = AddInterestRegion(chunk.first * kChunkWidth, chunk.second * kChunkHeight, 0,
+                LoadPriority::Prefetch, 0);
+        }
+        it->second.expiry = expiry;
+    }
+    return result;
+}
+
+void MapManager::ExpirePathRegions() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = pathRegions_.begin(); it != pathRegions_.end();) {
+        if (it->second.expiry > now) {
+            ++it;
+            continue;
+        }
+        RemoveInterestRegion(it->second.regionId);
+        it = pathRegions_.erase(it);
+    }
+}
+
+bool MapManager::SavePipelineStats(const std::filesystem::path& path) const {
+    nlohmann::json j = loader_.GetPipelineStats().ToJson();
+    j["sources"] = source_->LayersJson();
+    std::ofstream ofs(path);
+    if (!ofs) return false;
+    ofs << j.dump(2);
+    return static_cast<bool>(ofs);
 }
 
 void MapManager::Update(const char keys[256], const char preKeys[256], int playerTileX, int playerTileY) {
     if (keys[DIK_O] && !preKeys[DIK_O]) {
-        isOnline_ = CheckOnlineStatus();
+        isOnline_ = loader_.CheckOnlineStatus();
+        sheetsSource_->SetOnline(isOnline_);
+        editor_.SetOnline(isOnline_);
+        overviewMissing_.clear();
+        overviewScanned_.reset();
+        for (auto& kv : chunks_) {
+            if (kv.second.failed) RefreshChunk(kv.second);
+        }
     }
     if (keys[DIK_U] && !preKeys[DIK_U]) {
+        for (auto& kv : chunks_) CancelChunkLoad(kv.second);
         chunks_.clear();
+        collision_.Clear();
+        pathfinder_.Invalidate();
+        flowField_.Invalidate();
+        lightMap_.Clear();
+        if (isOnline_) loader_.RefreshRevision();
+        source_->Invalidate();
+        CancelOverviewLoads();
+        overviewMissing_.clear();
+        // 全領域の範囲を読み込み直す
+        regions_.EnqueueAll();
     }
-    int cx = playerTileX / kChunkWidth;
-    int cy = playerTileY / kChunkHeight;
-    for (int dy = -viewDistanceChunks_; dy <= viewDistanceChunks_; ++dy) {
-        for (int dx = -viewDistanceChunks_; dx <= viewDistanceChunks_; ++dx) {
-            EnqueueChunkLoad(cx + dx, cy + dy);
-        }
+    if (keys[DIK_P] && !preKeys[DIK_P]) {
+        SavePipelineStats(std::filesystem::path(cacheDir_) / ("pipeline_stats_" + TimestampSuffix() + ".json"));
     }
-    for (auto it = chunks_.begin(); it != chunks_.end();) {
-        int dx = it->first.first - cx;
-        int dy = it->first.second - cy;
-        if (abs(dx) > viewDistanceChunks_ || abs(dy) > viewDistanceChunks_) {
-            it = chunks_.erase(it);
+    if (keys[DIK_T] && !preKeys[DIK_T]) {
+        if (loader_.GetTracer().IsEnabled()) {
+            SetTracingEnabled(false);
+            SaveTrace(std::filesystem::path(cacheDir_) / ("trace_" + TimestampSuffix() + ".json"));
         } else {
-            ++it;
+            SetTracingEnabled(true);
         }
     }
+    if (keys[DIK_Q] && !preKeys[DIK_Q]) SetZoom(zoom_ / 2.0);
+    if (keys[DIK_E] && !preKeys[DIK_E]) SetZoom(zoom_ * 2.0);
+    if (keys[DIK_L] && !preKeys[DIK_L]) lightingEnabled_ = !lightingEnabled_;
+    if (keys[DIK_K] && !preKeys[DIK_K]) autotileEnabled_ = !autotileEnabled_;
+    MoveInterestRegion(playerRegion_, playerTileX, playerTileY);
+    ExpirePathRegions();
     PollLoadedChunks();
+    ApplySheetChanges();
+    ApplyEditConflicts();
+    flowField_.Update();
+    lightMap_.SetViewer(playerTileX, playerTileY, kViewRadiusTiles);
+    lightMap_.Update();
+    PollOverviewLoads();
+    RequestOverviews(playerTileX, playerTileY);
+    loader_.GetPipelineStats().SetResidentBytes(ResidentChunkBytes());
 }
 
 void MapManager::Draw(int offsetX, int offsetY) const {
+    TraceSpan span(loader_.GetTracer(), "Draw");
     Novice::ScreenPrintf(10, 10, isOnline_ ? "Online" : "Offline");
+    HttpStats stats = loader_.GetHttpStats();
+    const LatencyTracker& chunkLatency = loader_.GetChunkLatency();
+    Novice::ScreenPrintf(10, 50, "HTTP req:%llu h2:%llu conn:%llu tls:%llu (avg %.1fms) %lluKB",
+        static_cast<unsigned long long>(stats.transfers),
+        static_cast<unsigned long long>(stats.http2Transfers),
+        static_cast<unsigned long long>(stats.newConnections),
+        static_cast<unsigned long long>(stats.tlsHandshakes),
+        stats.tlsHandshakes ? stats.totalAppConnectMs / static_cast<double>(stats.tlsHandshakes) : 0.0,
+        static_cast<unsigned long long>(stats.bytesReceived / 1024));
+    Novice::ScreenPrintf(10, 70, "chunk p50:%.0fms p95:%.0fms p99:%.0fms%s",
+        chunkLatency.Percentile(0.50), chunkLatency.Percentile(0.95), chunkLatency.Percentile(0.99),
+        loader_.IsHedgingEnabled() ? " hedge" : "");
+    int layerY = 90;
+    source_->ForEachLayer([&layerY](const TileSource& layer) {
+        Novice::ScreenPrintf(10, layerY, "%-10s hit:%3.0f%% (%llu/%llu) p99:%.1fms", layer.Name(),
+            layer.HitRate() * 100.0, static_cast<unsigned long long>(layer.Hits()),
+            static_cast<unsigned long long>(layer.Hits() + layer.Misses()), layer.Latency().PercentileMs(0.99));
+        layerY += 20;
+    });
+    loader_.GetPipelineStats().DrawOverlay();
+    int level = CurrentLodLevel();
+    int boxes = level < TileLod::kChunkLevel ? DrawChunks(offsetX, offsetY, level) : DrawOverview(offsetX, offsetY, level);
+    Novice::ScreenPrintf(10, layerY, "zoom:%.3f lod:%d boxes:%d layers:%zu overview:%zu (loading %zu) load failures:%llu",
+        zoom_, level, boxes, layers_.size() + 1, overview_.ChunkCount(), overviewLoads_.size(),
+        static_cast<unsigned long long>(loadFailures_));
+    const LightMap::Stats& light = lightMap_.GetStats();
+    Novice::ScreenPrintf(10, layerY + 20, "light%s: %.2fms (%zu chunks) fov: %.2fms",
+        lightingEnabled_ ? "(on)" : "", light.lightMs, light.lightChunks, light.fovMs);
+    TileEditor::Stats edits = editor_.GetStats();
+    Novice::ScreenPrintf(10, layerY + 40, "edits%s pending:%zu written:%llu (%llu flushes, %llu req) conflicts:%llu failed:%llu not sent:%llu %.0fms",
+        edits.writable ? "" : "(no OAuth token)",
+        edits.pendingCells,
+        static_cast<unsigned long long>(edits.cellsWritten),
+        static_cast<unsigned long long>(edits.flushes),
+        static_cast<unsigned long long>(edits.requests),
+        static_cast<unsigned long long>(edits.conflicts),
+        static_cast<unsigned long long>(edits.failures),
+        static_cast<unsigned long long>(edits.rejected),
+        edits.lastFlushMs);
+    ChangeStats changes = GetChangeStats();
+    Novice::ScreenPrintf(10, layerY + 60, "changes:%llu (%llu chunks, %llu all) refetched:%llu swapped:%llu req:%llu err:%llu",
+        static_cast<unsigned long long>(changes.watcher.notifications),
+        static_cast<unsigned long long>(changes.watcher.changedChunks),
+        static_cast<unsigned long long>(changes.watcher.resets),
+        static_cast<unsigned long long>(changes.refreshes),
+        static_cast<unsigned long long>(changes.swaps),
+        static_cast<unsigned long long>(changes.watcher.requests),
+        static_cast<unsigned long long>(changes.watcher.errors));
+}
+
+int MapManager::DrawChunks(int offsetX, int offsetY, int level) const {
+    int tileSize = GetScaledTileSize();
+    int boxes = 0;
     for (const auto& kv : chunks_) {
         const auto& chunk = kv.second;
         if (!chunk.loaded) continue;
-        for (int y = 0; y < (int)chunk.tiles.size(); ++y) {
-            for (int x = 0; x < (int)chunk.tiles[y].size(); ++x) {
-                int tile = chunk.tiles[y][x];
-                int mapTileX = chunk.chunkX * kChunkWidth + x;
-                int mapTileY = chunk.chunkY * kChunkHeight + y;
-                int screenX = mapTileX * tileSize_ - offsetX;
-                int screenY = mapTileY * tileSize_ - offsetY + yOffset_;
-                if (tile == 1) Novice::DrawBox(screenX, screenY, tileSize_, tileSize_, 0, BLUE, kFillModeSolid);
-                if (tile == 2) Novice::DrawBox(screenX, screenY, tileSize_, tileSize_, 0, RED, kFillModeSolid);
-                if (tile == 3) Novice::DrawBox(screenX, screenY, tileSize_, tileSize_, 0, GREEN, kFillModeSolid);
+        int chunkScreenX = chunk.chunkX * kChunkWidth * tileSize - offsetX;
+        int chunkScreenY = chunk.chunkY * kChunkHeight * tileSize - offsetY + yOffset_;
+        // 画面外のチャンクは描かない
+        if (chunkScreenX >= viewportWidth_ || chunkScreenY >= viewportHeight_ ||
+            chunkScreenX + kChunkWidth * tileSize <= 0 || chunkScreenY + kChunkHeight * tileSize <= 0) {
+            continue;
+        }
+        // 縮小表示では主レイヤーだけを描く
+        if (level > 0) {
+            boxes += DrawChunkTiles(chunk, chunkScreenX, chunkScreenY, level);
+            continue;
+        }
+        // 描画キャッシュは、チャンクが読み込まれてから最初に描くときに作る
+        if (!chunk.drawRunsValid) BuildDrawRuns(chunk);
+        for (int layer : layerOrder_) {
+            // 明るさと境目はタイルごとに変わるので、主レイヤーをタイルごとに描く
+            if (layer == 0 && (lightingEnabled_ || autotileEnabled_)) {
+                boxes += DrawChunkTiles(chunk, chunkScreenX, chunkScreenY, 0);
+                continue;
+            }
+            for (const MapChunk::DrawRun& run : chunk.drawRuns[static_cast<size_t>(layer)]) {
+                Novice::DrawBox(chunkScreenX + run.x * tileSize, chunkScreenY + run.y * tileSize,
+                    run.length * tileSize, tileSize, 0, run.color, kFillModeSolid);
+                ++boxes;
+            }
+        }
+        if (collisionOverlayEnabled_) boxes += DrawCollisionOverlay(chunk, chunkScreenX, chunkScreenY);
+    }
+    return boxes;
+}
+
+int MapManager::DrawCollisionOverlay(const MapChunk& chunk, int chunkScreenX, int chunkScreenY) const {
+    int tileSize = GetScaledTileSize();
+    int boxes = 0;
+    int tileX0 = chunk.chunkX * kChunkWidth;
+    int tileY0 = chunk.chunkY * kChunkHeight;
+    for (int y = 0; y < kChunkHeight; ++y) {
+        for (int x = 0; x < kChunkWidth; ++x) {
+            if (!collision_.AnyInRect(tileX0 + x, tileY0 + y, tileX0 + x, tileY0 + y, TileClass::Solid)) continue;
+            Novice::DrawBox(chunkScreenX + x * tileSize, chunkScreenY + y * tileSize, tileSize, tileSize, 0,
+                WHITE, kFillModeWireFrame);
+            ++boxes;
+        }
+    }
+    return boxes;
+}
+
+int MapManager::DrawChunkTiles(const MapChunk& chunk, int chunkScreenX, int chunkScreenY, int level) const {
+    int tileSize = GetScaledTileSize();
+    int step = TileLod::BlockTiles(level);
+    int blockSize = tileSize * step;
+    int boxes = 0;
+    const LightMap::Light* light = lightingEnabled_ ? lightMap_.ChunkLight(chunk.chunkX, chunk.chunkY) : nullptr;
+    for (int y = 0; y < chunk.tiles.rowCount; y += step) {
+        for (int x = 0; x < chunk.tiles.Width(y); x += step) {
+            int tile = level == 0 ? chunk.tiles.At(x, y) : chunk.lod.Level1At(x / step, y / step);
+            unsigned int color = 0;
+            if (!TileColor(tile, color)) continue;
+            if (light) {
+                // 縮小表示ではブロックの左上のタイルの明るさで描く
+                bool visible = lightMap_.Visible(chunk.chunkX * kChunkWidth + x, chunk.chunkY * kChunkHeight + y);
+                int brightness = visible ? std::max<int>(kAmbientLight, (*light)[y * kChunkWidth + x]) : kHiddenLight;
+                color = ShadeColor(color, brightness);
+            }
+            int boxX = chunkScreenX + x * tileSize;
+            int boxY = chunkScreenY + y * tileSize;
+            int boxW = blockSize;
+            int boxH = blockSize;
+            if (autotileEnabled_ && level == 0) {
+                // 隣と番号が違う辺を空ける（マスクはタイルと同じ添字で引ける）
+                uint8_t mask = chunk.autotile.At(x, y);
+                int gap = std::max(1, tileSize / kAutotileGapDivisor);
+                if (!(mask & TileAutotile::kN)) { boxY += gap; boxH -= gap; }
+                if (!(mask & TileAutotile::kS)) boxH -= gap;
+                if (!(mask & TileAutotile::kW)) { boxX += gap; boxW -= gap; }
+                if (!(mask & TileAutotile::kE)) boxW -= gap;
             }
+            Novice::DrawBox(boxX, boxY, boxW, boxH, 0, color, kFillModeSolid);
+            ++boxes;
         }
     }
+    return boxes;
 }
 
-size_t MapManager::WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    size_t realSize = size * nmemb;
-    std::string* buffer = static_cast<std::string*>(userp);
-    buffer->append(static_cast<char*>(contents), realSize);
-    return realSize;
-}
-
-bool MapManager::CheckOnlineStatus() const {
-    CURL* curl = curl_easy_init();
-    if (!curl) return false;
-    curl_easy_setopt(curl, CURLOPT_URL, "https://www.google.com");
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5);
-    curl_easy_setopt(curl, CURLOPT_NOBODY, 1);
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
-    return res == CURLE_OK;
-}
-
-std::string MapManager::ColIndexToName(int index) {
-    std::string name;
-    while (index >= 0) {
-        int rem = index % 26;
-        name.insert(name.begin(), static_cast<char>('A' + rem));
-        index = index / 26 - 1;
-    }
-    return name;
-}
-
-TileData MapManager::LoadFromSheet(int cx, int cy) const {
-    std::vector<std::vector<int>> data;
-    CURL* curl = curl_easy_init();
-    std::string buffer;
-    if (curl) {
-        std::string startC = ColIndexToName(cx * kChunkWidth);
-        std::string endC = ColIndexToName(cx * kChunkWidth + (kChunkWidth - 1));
-        int startR = cy * kChunkHeight + 1;
-        int endR = startR + (kChunkHeight - 1);
-        std::string range = sheetName_ + "!" + startC + std::to_string(startR)
-            + ":" + endC + std::to_string(endR);
-        std::string url = "https://sheets.googleapis.com/v4/spreadsheets/" + spreadsheetId_
-            + "/values/" + range + "?key=" + apiKey_;
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
-        if (curl_easy_perform(curl) == CURLE_OK) {
-            auto j = json::parse(buffer);
-            for (auto& row : j["values"]) {
-                std::vector<int> rowData;
-                for (auto& cell : row) {
-                    rowData.push_back(std::stoi(cell.get<std::string>()));
+void MapManager::BuildDrawRuns(const MapChunk& chunk) const {
+    // 読み直しでは前回の確保を使い回す
+    chunk.drawRuns.resize(layers_.size() + 1);
+    for (size_t layer = 0; layer <= layers_.size(); ++layer) {
+        // 追加レイヤーを持たない取得元から読んだチャンクは、そのレイヤーが空
+        const ChunkTiles* tiles = layer == 0 ? &chunk.tiles
+            : (layer - 1 < chunk.tiles.overlays.size() ? &chunk.tiles.overlays[layer - 1] : nullptr);
+        if (!tiles) continue;
+        std::pmr::vector<MapChunk::DrawRun>& runs = chunk.drawRuns[layer];
+        runs.clear();
+        for (int y = 0; y < tiles->rowCount; ++y) {
+            // 横に並んだ同じ色のタイルは1つの矩形で描く
+            for (int x = 0; x < tiles->Width(y);) {
+                unsigned int color = 0;
+                if (!TileColor(tiles->At(x, y), color)) {
+                    ++x;
+                    continue;
                 }
-                data.push_back(rowData);
+                int run = 1;
+                unsigned int next = 0;
+                while (x + run < tiles->Width(y) && TileColor(tiles->At(x + run, y), next) && next == color) ++run;
+                runs.push_back({ static_cast<uint8_t>(x), static_cast<uint8_t>(y), static_cast<uint8_t>(run), color });
+                x += run;
+            }
+        }
+    }
+    chunk.drawRunsValid = true;
+}
+
+int MapManager::DrawOverview(int offsetX, int offsetY, int level) const {
+    int tileSize = GetScaledTileSize();
+    int blockTiles = TileLod::BlockTiles(level);
+    int blockSize = blockTiles * tileSize;
+    // 画面に入るブロックの範囲
+    int minX = FloorDiv(FloorDiv(offsetX, tileSize), blockTiles);
+    int maxX = FloorDiv(FloorDiv(offsetX + viewportWidth_, tileSize), blockTiles);
+    int minY = FloorDiv(FloorDiv(offsetY - yOffset_, tileSize), blockTiles);
+    int maxY = FloorDiv(FloorDiv(offsetY - yOffset_ + viewportHeight_, tileSize), blockTiles);
+    int boxes = 0;
+    for (int by = minY; by <= maxY; ++by) {
+        // 横に並んだ同じ色のブロックは1つの矩形で描く
+        for (int bx = minX; bx <= maxX;) {
+            std::optional<int> value = overview_.At(level, bx, by);
+            unsigned int color = 0;
+            if (!value || !TileColor(*value, color)) {
+                ++bx;
+                continue;
             }
+            int run = 1;
+            while (bx + run <= maxX && overview_.At(level, bx + run, by) == value) ++run;
+            Novice::DrawBox(bx * blockSize - offsetX, by * blockSize - offsetY + yOffset_,
+                blockSize * run, blockSize, 0, color, kFillModeSolid);
+            ++boxes;
+            bx += run;
         }
-        curl_easy_cleanup(curl);
     }
-    return data;
+    return boxes;
 }
 
-TileData MapManager::LoadChunkCache(int cx, int cy) const {
-    TileData data;
-    std::filesystem::path dir(cacheDir_);
-    std::filesystem::path path = dir / ("chunk_" + std::to_string(cx) + "_" + std::to_string(cy) + ".json");
-    if (!std::filesystem::exists(path)) return data;
-    std::ifstream ifs(path);
-    json j; ifs >> j;
-    data = j.get<TileData>();
-    return data;
+void MapManager::SetZoom(double zoom) {
+    zoom_ = std::clamp(zoom, kMinZoom, kMaxZoom);
+    // 縮小地図を使わない拡大率に戻ったら、取り寄せ中のものは要らない
+    if (CurrentLodLevel() < TileLod::kChunkLevel) CancelOverviewLoads();
 }
 
-void MapManager::SaveChunkCache(int cx, int cy, const TileData& data) const {
-    std::filesystem::path dir(cacheDir_);
-    std::filesystem::path path = dir / ("chunk_" + std::to_string(cx) + "_" + std::to_string(cy) + ".json");
-    std::ofstream ofs(path);
-    ofs << json(data).dump();
+int MapManager::GetScaledTileSize() const {
+    return std::max(1, static_cast<int>(std::lround(tileSize_ * zoom_)));
 }
 
-void MapManager::EnqueueChunkLoad(int cx, int cy) {
+int MapManager::CurrentLodLevel() const {
+    int tileSize = GetScaledTileSize();
+    for (int level = 0; level < TileLod::kMaxLevel; ++level) {
+        if (TileLod::BlockTiles(level) * tileSize >= kMinLodBlockPixels) return level;
+    }
+    return TileLod::kMaxLevel;
+}
+
+uint64_t MapManager::ResidentChunkBytes() const {
+    uint64_t bytes = 0;
+    // タイルはチャンクの記録に含まれる
+    bytes += chunks_.size() * sizeof(decltype(chunks_)::value_type);
+    bytes += chunks_.bucket_count() * sizeof(void*);
+    // 追加レイヤーと描画キャッシュはチャンクの記録の外にある
+    for (const auto& kv : chunks_) {
+        const MapChunk& chunk = kv.second;
+        bytes += chunk.tiles.overlays.capacity() * sizeof(ChunkTiles);
+        bytes += chunk.drawRuns.capacity() * sizeof(chunk.drawRuns[0]);
+        for (const auto& runs : chunk.drawRuns) bytes += runs.capacity() * sizeof(MapChunk::DrawRun);
+    }
+    return bytes;
+}
+
+void MapManager::EnqueueChunkLoad(int cx, int cy, LoadPriority priority) {
     auto key = std::make_pair(cx, cy);
     auto& chunk = chunks_[key];
-    if (chunk.loaded || chunk.loaderFuture.valid()) return;
+    if (chunk.loaded) return;
+    if (chunk.loaderFuture.valid()) {
+        // 先読み中のチャンクが表示範囲に入ったら優先度を上げる
+        if (chunk.ticket && static_cast<int>(priority) < chunk.ticket->priority) {
+            chunk.ticket->priority = static_cast<int>(priority);
+            loader_.NotifyScheduler();
+        }
+        return;
+    }
+    TraceSpan span(loader_.GetTracer(), "EnqueueChunkLoad", cx, cy);
     chunk.chunkX = cx;
     chunk.chunkY = cy;
-    if (isOnline_) {
-        chunk.loaderFuture = std::async(std::launch::async, [this, cx, cy]() {
-            return LoadFromSheet(cx, cy);
-            });
+    chunk.ticket = std::allocate_shared<LoadTicket>(std::pmr::polymorphic_allocator<LoadTicket>(&chunkPool_));
+    chunk.ticket->priority = static_cast<int>(priority);
+    chunk.loaderFuture = SubmitLoad(cx, cy, chunk.ticket);
+}
+
+std::future<ChunkLoadResult> MapManager::SubmitLoad(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket) {
+    LoadJob job{ cx, cy, ticket,
+        std::promise<ChunkLoadResult>(std::allocator_arg, std::pmr::polymorphic_allocator<ChunkLoadResult>(&chunkPool_)) };
+    std::future<ChunkLoadResult> future = job.promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(loadMutex_);
+        loadQueue_.push_back(std::move(job));
+    }
+    loadCv_.notify_one();
+    return future;
+}
+
+void MapManager::RequestOverviews(int playerTileX, int playerTileY) {
+    // 縮小地図で描く拡大率のときだけ、画面内で値の分からないチャンクを取り寄せる
+    if (CurrentLodLevel() < TileLod::kChunkLevel || overviewLoads_.size() >= kMaxOverviewLoads) return;
+    int tileSize = GetScaledTileSize();
+    int centerX = FloorDiv(playerTileX, kChunkWidth);
+    int centerY = FloorDiv(playerTileY, kChunkHeight);
+    int reachX = viewportWidth_ / 2 / tileSize / kChunkWidth + 1;
+    int reachY = viewportHeight_ / 2 / tileSize / kChunkHeight + 1;
+    auto scanKey = std::make_tuple(centerX, centerY, tileSize);
+    if (overviewScanned_ == scanKey) return;
+    // 近いリングから順に（最初の数フレームで手前から埋まる）
+    for (int ring = 0; ring <= std::max(reachX, reachY); ++ring) {
+        for (int dy = -std::min(ring, reachY); dy <= std::min(ring, reachY); ++dy) {
+            for (int dx = -std::min(ring, reachX); dx <= std::min(ring, reachX); ++dx) {
+                if (std::max(abs(dx), abs(dy)) != ring) continue;
+                auto key = std::make_pair(centerX + dx, centerY + dy);
+                if (overview_.Contains(key.first, key.second) || chunks_.count(key) ||
+                    overviewLoads_.count(key) || overviewMissing_.count(key)) {
+                    continue;
+                }
+                OverviewLoad load;
+                load.ticket = std::allocate_shared<LoadTicket>(std::pmr::polymorphic_allocator<LoadTicket>(&chunkPool_));
+                load.ticket->priority = static_cast<int>(LoadPriority::Overview);
+                load.future = SubmitLoad(key.first, key.second, load.ticket);
+                overviewLoads_.emplace(key, std::move(load));
+                if (overviewLoads_.size() >= kMaxOverviewLoads) return;
+            }
+        }
+    }
+    overviewScanned_ = scanKey;
+}
+
+void MapManager::PollOverviewLoads() {
+    for (auto it = overviewLoads_.begin(); it != overviewLoads_.end();) {
+        if (it->second.future.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+        // タイルは持たず、縮小地図の値だけを残す
+        ChunkLoadResult result = TakeLoadResult(it->second.future);
+        if (result.answered) {
+            overview_.Set(it->first.first, it->first.second, lodReducer_.Build(result.tiles).level2);
+        } else if (!it->second.ticket->cancelled) {
+            overviewMissing_.insert(it->first);
+        }
+        it = overviewLoads_.erase(it);
+    }
+}
+
+void MapManager::CancelOverviewLoads() {
+    // 取り消した読み込みは PollOverviewLoads で片付ける
+    for (auto& kv : overviewLoads_) kv.second.ticket->cancelled = true;
+    overviewScanned_.reset();
+    if (!overviewLoads_.empty()) loader_.NotifyScheduler();
+}
+
+void MapManager::EnsureLoaders() {
+    // 全領域の表示範囲と先読み範囲のチャンクが同時に読み込めるだけ用意する（上限あり）
+    int count = std::min(regions_.WindowChunkCount(), kMaxLoaderThreads);
+    chunks_.reserve(static_cast<size_t>(regions_.WindowChunkCount()) * 2);
+    while (static_cast<int>(loaders_.size()) < count) {
+        loaders_.emplace_back([this]() { LoaderLoop(); });
+    }
+}
+
+void MapManager::StopLoaders() {
+    {
+        std::lock_guard<std::mutex> lock(loadMutex_);
+        stopLoaders_ = true;
+    }
+    loadCv_.notify_all();
+    for (std::thread& loader : loaders_) loader.join();
+    loaders_.clear();
+    // 残った要求の future は broken_promise になる
+    loadQueue_.clear();
+}
+
+void MapManager::LoaderLoop() {
+    for (;;) {
+        std::optional<LoadJob> job;
+        {
+            std::unique_lock<std::mutex> lock(loadMutex_);
+            loadCv_.wait(lock, [this]() { return stopLoaders_ || !loadQueue_.empty(); });
+            if (stopLoaders_) return;
+            // 優先度の高い要求から取り出す（同じ優先度なら先に積んだもの）
+            auto next = std::min_element(loadQueue_.begin(), loadQueue_.end(),
+                [](const LoadJob& a, const LoadJob& b) { return a.ticket->priority < b.ticket->priority; });
+            job.emplace(std::move(*next));
+            loadQueue_.erase(next);
+        }
+        try {
+            job->promise.set_value(RunLoad(*job));
+        } catch (...) {
+            job->promise.set_exception(std::current_exception());
+        }
+    }
+}
+
+ChunkLoadResult MapManager::RunLoad(const LoadJob& job) {
+    // 取得元は result.tiles へ直接書く。追加レイヤーは chunks_ と同じリソースにあり、チャンクへ移すと確保ごと渡る
+    ChunkLoadResult result(&chunkPool_);
+    // 待っている間に範囲外へ出たチャンクは読まない
+    if (job.ticket->cancelled) return result;
+    // 速い層から順に問い合わせる。ネットワークから得た内容はその場でディスクとメモリに保存される
+    // どの層も答えなければ（オフラインで未キャッシュなど）空のチャンクになる
+    const TileSource* answeredBy = nullptr;
+    if (source_->Resolve(job.chunkX, job.chunkY, job.ticket, result.tiles, &answeredBy)) {
+        result.fromNetwork = answeredBy->IsRemote();
+        result.answered = true;
     } else {
-        chunk.loaderFuture = std::async(std::launch::async, [this, cx, cy]() {
-            return LoadChunkCache(cx, cy);
-            });
+        result.tiles.Clear();
     }
+    return result;
+}
+
+int MapManager::AddInterestRegion(int tileX, int tileY, int viewDistanceChunks, LoadPriority priority,
+    std::optional<int> prefetchDistanceChunks) {
+    InterestRegion region;
+    region.chunkX = FloorDiv(tileX, kChunkWidth);
+    region.chunkY = FloorDiv(tileY, kChunkHeight);
+    region.viewDistanceChunks = viewDistanceChunks;
+    region.prefetchDistanceChunks = prefetchDistanceChunks.value_or(prefetchDistanceChunks_);
+    region.priority = priority;
+    int id = regions_.Add(region);
+    // 積んだ読み込みは、ここで増やしたスレッドも取り出す
+    EnsureLoaders();
+    return id;
+}
+
+void MapManager::MoveInterestRegion(int id, int tileX, int tileY) {
+    regions_.Move(id, FloorDiv(tileX, kChunkWidth), FloorDiv(tileY, kChunkHeight));
+}
+
+void MapManager::RemoveInterestRegion(int id) {
+    regions_.Remove(id);
+}
+
+void MapManager::ReleaseChunk(int cx, int cy) {
+    auto found = chunks_.find(std::make_pair(cx, cy));
+    if (found == chunks_.end()) return;
+    CancelChunkLoad(found->second);
+    collision_.Erase(cx, cy);
+    bool wasLoaded = found->second.loaded;
+    if (wasLoaded) {
+        pathfinder_.OnChunkChanged(cx, cy);
+        flowField_.OnChunkChanged(cx, cy);
+        lightMap_.Erase(cx, cy);
+    }
+    chunks_.erase(found);
+    if (wasLoaded) RestitchAutotile(cx, cy);
+}
+
+void MapManager::CancelChunkLoad(MapChunk& chunk) {
+    if (chunk.refreshTicket) chunk.refreshTicket->cancelled = true;
+    if (!chunk.ticket) return;
+    chunk.ticket->cancelled = true;
+    loader_.NotifyScheduler();
+}
+
+void MapManager::IntegrateChunk(MapChunk& chunk, bool updateOverview) {
+    chunk.drawRunsValid = false;
+    chunk.lod = lodReducer_.Build(chunk.tiles);
+    if (updateOverview) overview_.Set(chunk.chunkX, chunk.chunkY, chunk.lod.level2);
+    ChunkOccupancy occupancy = tileClassifier_.Build(chunk.tiles);
+    collision_.Set(chunk.chunkX, chunk.chunkY, occupancy);
+    pathfinder_.OnChunkChanged(chunk.chunkX, chunk.chunkY);
+    flowField_.OnChunkChanged(chunk.chunkX, chunk.chunkY);
+    lightMap_.Set(chunk.chunkX, chunk.chunkY, occupancy.Of(TileClass::Solid), chunk.tiles);
+    chunk.loaded = true;
+    // 周りのチャンクの縁は、端のタイルを延ばしたものからこのチャンクの実際のタイルに変わる
+    BuildAutotile(chunk);
+    RestitchAutotile(chunk.chunkX, chunk.chunkY);
+}
+
+bool MapManager::SetTile(int tileX, int tileY, int tile, int layer) {
+    return FillRect(tileX, tileY, 1, 1, tile, layer) > 0;
+}
+
+std::optional<int> MapManager::GetTile(int tileX, int tileY, int layer) const {
+    int cx = FloorDiv(tileX, kChunkWidth);
+    int cy = FloorDiv(tileY, kChunkHeight);
+    auto it = chunks_.find({ cx, cy });
+    if (it == chunks_.end() || !it->second.loaded || layer < 0) return std::nullopt;
+    const ChunkTiles& base = it->second.tiles;
+    if (layer > 0 && static_cast<size_t>(layer) > base.overlays.size()) return 0;
+    const ChunkTiles& tiles = layer == 0 ? base : base.overlays[static_cast<size_t>(layer) - 1];
+    int x = tileX - cx * kChunkWidth;
+    int y = tileY - cy * kChunkHeight;
+    return y < tiles.rowCount && x < tiles.Width(y) ? tiles.At(x, y) : 0;
+}
+
+int MapManager::FillRect(int tileX, int tileY, int width, int height, int tile, int layer) {
+    if (layer < 0 || layer > static_cast<int>(layers_.size()) || width <= 0 || height <= 0) return 0;
+    int written = 0;
+    // チャンクごとに書き換えてから1回だけ作り直す
+    for (int cy = FloorDiv(tileY, kChunkHeight); cy <= FloorDiv(tileY + height - 1, kChunkHeight); ++cy) {
+        for (int cx = FloorDiv(tileX, kChunkWidth); cx <= FloorDiv(tileX + width - 1, kChunkWidth); ++cx) {
+            auto it = chunks_.find({ cx, cy });
+            if (it == chunks_.end() || !it->second.loaded) continue;
+            MapChunk& chunk = it->second;
+            int changed = 0;
+            for (int y = std::max(tileY, cy * kChunkHeight); y < std::min(tileY + height, (cy + 1) * kChunkHeight); ++y) {
+                for (int x = std::max(tileX, cx * kChunkWidth); x < std::min(tileX + width, (cx + 1) * kChunkWidth); ++x) {
+                    if (WriteTile(chunk, x, y, tile, layer)) ++changed;
+                }
+            }
+            if (changed == 0) continue;
+            written += changed;
+            // 追加レイヤーは描画にしか使わない
+            if (layer == 0) IntegrateChunk(chunk, true);
+            else chunk.drawRunsValid = false;
+            // 範囲の外に出て戻ったときも、メモリの層が編集後の内容を答える
+            memorySource_->Store(cx, cy, chunk.tiles);
+        }
+    }
+    return written;
+}
+
+bool MapManager::WriteTile(MapChunk& chunk, int tileX, int tileY, int tile, int layer) {
+    if (layer > 0 && chunk.tiles.overlays.size() < layers_.size()) chunk.tiles.overlays.resize(layers_.size());
+    ChunkTiles& tiles = layer == 0 ? chunk.tiles : chunk.tiles.overlays[static_cast<size_t>(layer) - 1];
+    int x = tileX - chunk.chunkX * kChunkWidth;
+    int y = tileY - chunk.chunkY * kChunkHeight;
+    // 行の外のセルは空（0）として扱う
+    int before = y < tiles.rowCount && x < tiles.Width(y) ? tiles.At(x, y) : 0;
+    if (before == tile) return false;
+    tiles.Set(x, y, tile);
+    editor_.Record(layer, tileX, tileY, before, tile);
+    return true;
+}
+
+void MapManager::ApplyEditConflicts() {
+    std::vector<TileEditConflict> conflicts = editor_.TakeConflicts();
+    if (conflicts.empty()) return;
+    std::unordered_set<std::pair<int, int>, PairHash> changed;
+    for (const TileEditConflict& conflict : conflicts) {
+        if (conflict.layer > static_cast<int>(layers_.size())) continue;
+        int cx = FloorDiv(conflict.x, kChunkWidth);
+        int cy = FloorDiv(conflict.y, kChunkHeight);
+        auto it = chunks_.find({ cx, cy });
+        if (it == chunks_.end() || !it->second.loaded) continue;
+        MapChunk& chunk = it->second;
+        if (conflict.layer > 0 && chunk.tiles.overlays.size() < layers_.size()) chunk.tiles.overlays.resize(layers_.size());
+        ChunkTiles& tiles = conflict.layer == 0 ? chunk.tiles : chunk.tiles.overlays[static_cast<size_t>(conflict.layer) - 1];
+        // シートの値に戻すだけなので書き戻しには記録しない
+        tiles.Set(conflict.x - cx * kChunkWidth, conflict.y - cy * kChunkHeight, conflict.remote);
+        if (conflict.layer == 0) changed.insert({ cx, cy });
+        else chunk.drawRunsValid = false;
+        memorySource_->Store(cx, cy, chunk.tiles);
+    }
+    for (const auto& key : changed) IntegrateChunk(chunks_.at(key), true);
+}
+
+void MapManager::ApplySheetChanges() {
+    std::optional<RevisionChange> change = watcher_.Take();
+    if (!change) return;
+    TraceSpan span(loader_.GetTracer(), "ApplySheetChanges");
+    if (change->allChunks) {
+        // どれが変わったか分からない。U キーと違い、読み直し終えるまで今のタイルで描く
+        source_->Invalidate();
+        overviewMissing_.clear();
+        overviewScanned_.reset();
+        for (auto& kv : chunks_) RefreshChunk(kv.second);
+        return;
+    }
+    for (const auto& key : change->chunks) {
+        source_->InvalidateChunk(key.first, key.second);
+        overviewMissing_.erase(key);
+        auto found = chunks_.find(key);
+        if (found != chunks_.end()) RefreshChunk(found->second);
+    }
+    if (!change->chunks.empty()) overviewScanned_.reset();
+}
+
+void MapManager::RefreshChunk(MapChunk& chunk) {
+    // 読み込み中・読み直し中のものは、古い内容を読んだかもしれないので終わってからもう一度読む
+    if (!chunk.loaded || chunk.refreshFuture.valid()) {
+        chunk.stale = true;
+        return;
+    }
+    chunk.stale = false;
+    chunk.refreshTicket = std::allocate_shared<LoadTicket>(std::pmr::polymorphic_allocator<LoadTicket>(&chunkPool_));
+    chunk.refreshTicket->priority = chunk.ticket ? chunk.ticket->priority.load() : static_cast<int>(LoadPriority::Visible);
+    chunk.refreshFuture = SubmitLoad(chunk.chunkX, chunk.chunkY, chunk.refreshTicket);
+    ++chunkRefreshes_;
+}
+
+void MapManager::PollRefreshedChunk(MapChunk& chunk) {
+    if (chunk.refreshFuture.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) return;
+    ChunkLoadResult result = TakeLoadResult(chunk.refreshFuture);
+    chunk.refreshTicket.reset();
+    if (result.failed) ++loadFailures_;
+    // 取得できなければ（オフラインなど）今のタイルのまま
+    if (result.answered) {
+        editor_.ApplyPending(chunk.chunkX, chunk.chunkY, layers_.size(), result.tiles);
+        chunk.failed = false;
+        if (ChunkLoader::HashTiles(result.tiles) != ChunkLoader::HashTiles(chunk.tiles)) {
+            // 同じフレームで入れ替えるので、空のチャンクを描くフレームはない
+            chunk.tiles = std::move(result.tiles);
+            IntegrateChunk(chunk, true);
+            ++chunkSwaps_;
+        }
+    }
+    if (chunk.stale) RefreshChunk(chunk);
+}
+
+void MapManager::BuildAutotile(MapChunk& chunk) {
+    std::array<const ChunkTiles*, TileAutotile::kNeighborCount> neighbors{};
+    for (int i = 0; i < TileAutotile::kNeighborCount; ++i) {
+        auto found = chunks_.find({ chunk.chunkX + TileAutotile::kNeighborDx[i], chunk.chunkY + TileAutotile::kNeighborDy[i] });
+        if (found != chunks_.end() && found->second.loaded) neighbors[i] = &found->second.tiles;
+    }
+    chunk.autotile = TileAutotile::Build(chunk.tiles, neighbors);
+}
+
+void MapManager::RestitchAutotile(int cx, int cy) {
+    for (int i = 0; i < TileAutotile::kNeighborCount; ++i) {
+        auto found = chunks_.find({ cx + TileAutotile::kNeighborDx[i], cy + TileAutotile::kNeighborDy[i] });
+        if (found != chunks_.end() && found->second.loaded) BuildAutotile(found->second);
+    }
+}
+
+bool MapManager::IsSettled() const {
+    return std::all_of(chunks_.begin(), chunks_.end(),
+        [](const auto& kv) { return kv.second.loaded && !kv.second.refreshFuture.valid(); });
 }
 
 void MapManager::PollLoadedChunks() {
+    TraceSpan span(loader_.GetTracer(), "PollLoadedChunks");
+    PipelineStats& stats = loader_.GetPipelineStats();
     for (auto& kv : chunks_) {
         auto& chunk = kv.second;
+        if (chunk.refreshFuture.valid()) PollRefreshedChunk(chunk);
         if (chunk.loaded || !chunk.loaderFuture.valid()) continue;
         if (chunk.loaderFuture.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
-            TileData data = chunk.loaderFuture.get();
-            SaveChunkCache(chunk.chunkX, chunk.chunkY, data);
-            chunk.tiles = std::move(data);
-            chunk.loaded = true;
+            ChunkLoadResult result = TakeLoadResult(chunk.loaderFuture);
+            ++chunkLoads_;
+            chunk.failed = result.failed;
+            if (result.failed) ++loadFailures_;
+            auto start = std::chrono::steady_clock::now();
+            if (result.fromNetwork) {
+                stats.AddCacheMiss();
+            } else if (!result.tiles.Empty()) {
+                stats.AddCacheHit();
+            }
+            chunk.tiles = std::move(result.tiles);
+            // 書き戻す前に解放したチャンクでも、編集した内容で表示する
+            editor_.ApplyPending(chunk.chunkX, chunk.chunkY, layers_.size(), chunk.tiles);
+            // 内容が分かったチャンクだけ縮小地図に反映する（上位のブロックも更新される）
+            IntegrateChunk(chunk, result.answered);
+            if (chunk.stale) RefreshChunk(chunk);
+            stats.Record(PipelineStage::Integrate,
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
         }
     }
 }
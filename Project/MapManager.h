@@ -5,28 +5,83 @@
 #include <string>
 #include <unordered_map>
 #include <filesystem>
-#include <curl/curl.h>
-#include <nlohmann/json.hpp>
 #include <future>
 #include <chrono>
+#include <memory>
+#include <optional>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory_resource>
+#include <tuple>
+#include <unordered_set>
+#include "ChunkLoader.h"
+#include "TileSource.h"
+#include "TileLod.h"
+#include "TileAutotile.h"
+#include "TileCollision.h"
+#include "Pathfinder.h"
+#include "FlowField.h"
+#include "TileLight.h"
+#include "TileEditor.h"
+#include "ChangeWatcher.h"
+#include "InterestRegions.h"
 
-using json = nlohmann::json;
-using TileData = std::vector<std::vector<int>>;
+// 非同期読み込みの結果
+// 読み込みスレッドはチャンク用のメモリリソースの上に作り、チャンクへはタイルを写さずに移す
+struct ChunkLoadResult {
+    using allocator_type = std::pmr::polymorphic_allocator<>;
 
-// ペア<int,int> 用のハッシュ関数
-struct PairHash {
-    size_t operator()(const std::pair<int, int>& p) const noexcept {
-        return (static_cast<size_t>(p.first) << 32) ^ static_cast<unsigned int>(p.second);
-    }
+    ChunkLoadResult() = default;
+    explicit ChunkLoadResult(const allocator_type& alloc) : tiles(alloc) {}
+
+    ChunkTiles tiles;
+    bool fromNetwork = false; // 通信を伴う取得元が答えた（falseならキャッシュやファイルの内容）
+    bool answered = false;    // どれかの取得元が答えた（falseなら内容が分からず空のまま）
+    bool failed = false;      // 取得元で例外が起きた（answered も false）
+};
+
+// 地図の追加レイヤー（装飾や当たり判定用の別のタブなど）
+// 当たり判定・明るさ・縮小表示・境目のマスクは主レイヤー（コンストラクタのシート）から作る
+struct MapLayer {
+    std::string name;
+    SheetLayer sheet;  // シート上の位置
+    int priority = 0;  // 小さい順に描く（主レイヤーは 0。負なら主レイヤーの下）
 };
 
 // マップチャンクを表す構造体（非同期読み込み用）
 struct MapChunk {
+    // 描画キャッシュの1矩形（横に並んだ同じ色のタイル）
+    struct DrawRun {
+        uint8_t x = 0;
+        uint8_t y = 0;
+        uint8_t length = 0;
+        unsigned int color = 0;
+    };
+
+    // chunks_ のメモリリソースから追加レイヤーと描画キャッシュを確保する
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    MapChunk() = default;
+    explicit MapChunk(const allocator_type& alloc) : tiles(alloc), drawRuns(alloc) {}
+
     int chunkX = 0;
     int chunkY = 0;
-    TileData tiles;
+    ChunkTiles tiles; // 主レイヤー（追加レイヤーは tiles.overlays）
+    ChunkLod lod; // 読み込み時に作る縮小レベル
+    ChunkAutotile autotile; // 8近傍マスク（隣のチャンクが読み込まれた・解放されたときに縁を作り直す）
+    // レイヤーごとの描画キャッシュ（Draw の中で、読み込み後に最初に描くときに作る）
+    mutable std::pmr::vector<std::pmr::vector<DrawRun>> drawRuns;
+    mutable bool drawRunsValid = false;
     bool loaded = false;
-    std::future<TileData> loaderFuture;
+    bool failed = false; // 読み込みで例外が起きて空で表示している（オンライン切替・変更の通知・U キーで読み直す）
+    std::future<ChunkLoadResult> loaderFuture;
+    std::shared_ptr<LoadTicket> ticket;
+    // シートで内容が変わったときの読み直し（終わるまで今のタイルで描き、読み終えたフレームで入れ替える）
+    std::future<ChunkLoadResult> refreshFuture;
+    std::shared_ptr<LoadTicket> refreshTicket;
+    bool stale = false; // 読み込み・読み直しの途中でまた変わった（終わったらもう一度読み直す）
 };
 
 class MapManager {
@@ -43,39 +98,290 @@ public:
 
     // 初期化（オンラインチェック＋初期チャンク読み込み開始）
     void Initialize(int startPlayerTileX, int startPlayerTileY);
-    // 入力処理 (Oキー:オンライン切替, Uキー:チャンク再読み込み)
+    // 入力処理 (Oキー:オンライン切替, Uキー:全チャンクを捨てて再読み込み, Pキー:読み込み統計をJSONに書き出す,
+    //           Tキー:トレース開始／停止して書き出す, Qキー:縮小, Eキー:拡大, Lキー:明るさと視界で描く,
+    //           Kキー:隣と違うタイルとの境目を描く)
     void Update(const char keys[256], const char preKeys[256], int playerTileX, int playerTileY);
     // 描画
     void Draw(int offsetX, int offsetY) const;
 
+    // リビジョン確認URL（既定: Driveメタデータ。モックサーバーのチェックサムRangeも可）
+    void SetRevisionUrl(const std::string& url) { loader_.SetRevisionUrl(url); }
+    // キャッシュ書き込み形式（読み込みは全形式と従来の .json に対応）
+    void SetCacheEncoding(CacheEncoding encoding) { loader_.SetCacheEncoding(encoding); }
+    // Sheets API の接続先（モックサーバーやゲートウェイに向ける場合）
+    void SetApiBaseUrl(const std::string& url) { loader_.SetApiBaseUrl(url); }
+    // タイルゲートウェイ経由で読む（チャンクとリビジョン確認の両方をゲートウェイに向け、変更はゲートウェイの /changes で待つ）
+    void UseGateway(const std::string& baseUrl);
+    // シートの変更の待ち受け（Initialize の前に呼ぶ）。変わったチャンクだけを読み直し、読み終えたフレームで入れ替える
+    // feedUrl: 変更フィード。空なら、起動時のリビジョン確認がチェックサムRange だったときだけ
+    // kDefaultRevisionPollInterval ごとにリビジョンを確かめる（変わったチャンクだけを読み直せる）
+    void SetChangeFeedUrl(const std::string& feedUrl) { changeFeedUrl_ = feedUrl; }
+    // リビジョン確認の間隔を指定すると、Drive の version でも確かめる（変わるたびに常駐チャンクをすべて読み直す）
+    // 0 なら確かめない
+    void SetRevisionPollInterval(std::chrono::milliseconds interval) {
+        revisionPollInterval_ = interval;
+        revisionPollRequested_ = true;
+    }
+    // チャンクの取得元を差し替える（Initialize の前に呼ぶ）
+    // 既定はメモリ → 検証済みのディスクキャッシュ → Sheets API、どれも答えなければ古いキャッシュ
+    void SetTileSource(std::shared_ptr<CachedSource> source) { source_ = std::move(source); }
+    // 追加レイヤー（Initialize の前に呼ぶ）。戻り値はレイヤーの番号（1 から。0 が主レイヤー）
+    // チャンクの全レイヤーは1回の batchGet で取得し、キャッシュにはレイヤーごとのファイルで置く
+    int AddLayer(const MapLayer& layer);
+    const std::vector<MapLayer>& GetLayers() const { return layers_; }
+    // 事前に焼いたワールドファイル（.trwp）や CSV/TSV だけから読む（シートへは問い合わせない）
+    void UseWorldFile(const std::filesystem::path& path);
+    const CachedSource& GetTileSource() const { return *source_; }
+    // 表示範囲の外側に先読みするチャンク数（この後に追加する関心領域から使われる）
+    void SetPrefetchDistance(int chunks) { prefetchDistanceChunks_ = chunks; }
+    // 読み取りクォータ（1秒あたりのリクエスト数とバースト）
+    void SetRequestQuota(double ratePerSec, double burst) { loader_.SetRequestQuota(ratePerSec, burst); }
+    // 1リクエストの接続期限と全体期限（ミリ秒）
+    void SetRequestDeadlines(long connectTimeoutMs, long totalTimeoutMs) {
+        loader_.SetRequestDeadlines(connectTimeoutMs, totalTimeoutMs);
+    }
+    // 表示中チャンクの読み込みが直近のp95を超えたら同じリクエストを追加で送る
+    void SetHedgingEnabled(bool enabled) { loader_.SetHedgingEnabled(enabled); }
+
+    // 拡大率（1.0 でタイルサイズどおり）。小さくすると、ブロックが kMinLodBlockPixels 以上になる粗いレベルで描く
+    void SetZoom(double zoom);
+    double GetZoom() const { return zoom_; }
+    // 拡大率をかけたタイルの大きさ（ピクセル、1以上）
+    int GetScaledTileSize() const;
+    // 今の拡大率で描くレベル（TileLod を参照）
+    int CurrentLodLevel() const;
+    // 画面の大きさ。縮小表示で描く範囲と、縮小地図を取り寄せる範囲に使う
+    void SetViewportSize(int width, int height) {
+        viewportWidth_ = width;
+        viewportHeight_ = height;
+    }
+    // 縮小表示でタイルをまとめる方法と、タイルの優先度
+    void SetLodReduce(LodReduce mode) { lodReducer_.SetMode(mode); }
+    void SetLodPriority(int tile, int priority) { lodReducer_.SetPriority(tile, priority); }
+    const OverviewMap& GetOverview() const { return overview_; }
+
+    // 当たり判定でのタイルの種類（既定では 0 以外が Solid）。変えると常駐チャンクの占有ビットを作り直す
+    void SetTileClasses(int tile, TileClassifier::ClassMask classes);
+    // 常駐チャンクの占有ビット（読み込みの終わったチャンクだけ。まだのチャンクは通れる扱い。CollisionMap::SetUnloadedSolid で変えられる）
+    const CollisionMap& GetCollision() const { return collision_; }
+    // 常駐チャンクの上の経路（タイル座標）。UnloadedTiles::Open のとき、経路が通る読み込み前のチャンクを
+    // 読み込み始め、kPathChunkSeconds の間は常駐させておく（読み込み後に探し直すと実際の経路になる）
+    PathResult FindPath(int fromTileX, int fromTileY, int toTileX, int toTileY, UnloadedTiles unloaded = UnloadedTiles::Blocked);
+    Pathfinder& GetPathfinder() { return pathfinder_; }
+    // 群衆用の流れ場（SetArea と SetGoal で有効になり、チャンクの出入りは Update の中で反映される）
+    FlowField& GetFlowField() { return flowField_; }
+    // タイル番号ごとの光源の明るさ（0 - LightMap::kMaxLight）。変えると常駐チャンクの明るさを計算し直す
+    void SetTileLight(int tile, int level);
+    // 常駐チャンクの明るさと、プレイヤーからの視界（Solid のタイルが光と視線を遮る）
+    const LightMap& GetLightMap() const { return lightMap_; }
+    void SetLightingEnabled(bool enabled) { lightingEnabled_ = enabled; }
+    // 隣と番号の違うタイルとの境目を空けて描く（MapChunk::autotile のマスクだけを使う）
+    void SetAutotileEnabled(bool enabled) { autotileEnabled_ = enabled; }
+    // 当たり判定の Solid のタイルを枠で描く（デバッグ用）
+    void SetCollisionOverlayEnabled(bool enabled) { collisionOverlayEnabled_ = enabled; }
+
+    // タイルを書き換える（layer 0 が主レイヤー）。読み込みの終わったチャンクのタイルだけ書き換えられる
+    // 描画・縮小表示・当たり判定・経路・明るさ・境目のマスクへすぐに反映し、シートへは editor_ がまとめて書き戻す
+    // 書き換えたら true（読み込み前のチャンクや同じ値なら false）
+    bool SetTile(int tileX, int tileY, int tile, int layer = 0);
+    // タイルの番号（読み込み前のチャンクなら nullopt。行の外のセルは 0）
+    std::optional<int> GetTile(int tileX, int tileY, int layer = 0) const;
+    // 矩形を同じタイルで埋める（読み込みの終わったチャンクの部分だけ）。書き換えたセル数を返す
+    int FillRect(int tileX, int tileY, int width, int height, int tile, int layer = 0);
+    // 書き戻しを待たずに始める
+    void FlushEdits() { editor_.Flush(); }
+    // 書き戻しの統計と、送り終えていないセル数
+    TileEditor::Stats GetEditStats() const { return editor_.GetStats(); }
+    // 書き戻し用の OAuth アクセストークン（API キーでは書き込めない）
+    // 設定するまで編集はシートへ送らず、ゲームの中にだけ反映する（GetEditStats().writable が false）
+    void SetAccessToken(const std::string& token) {
+        loader_.SetAccessToken(token);
+        editor_.NotifyWritable();
+    }
+
+    // シートの変更の統計
+    struct ChangeStats {
+        ChangeWatcher::Stats watcher;
+        uint64_t refreshes = 0; // 変更で読み直したチャンク
+        uint64_t swaps = 0;     // 読み直して内容が変わっていたチャンク
+    };
+    ChangeStats GetChangeStats() const { return { watcher_.GetStats(), chunkRefreshes_, chunkSwaps_ }; }
+
+    // 関心領域の追加（Initialize の後に呼ぶ）。先読み距離を渡さなければ追加時の SetPrefetchDistance の値を使う
+    // 戻り値のIDで移動・削除する。Update に渡すプレイヤー位置は Initialize で作られる領域になる
+    int AddInterestRegion(int tileX, int tileY, int viewDistanceChunks, LoadPriority priority = LoadPriority::Visible,
+        std::optional<int> prefetchDistanceChunks = std::nullopt);
+    void MoveInterestRegion(int id, int tileX, int tileY);
+    void RemoveInterestRegion(int id);
+    size_t ResidentChunkCount() const { return chunks_.size(); }
+    // 常駐チャンクがすべて読み終わり、読み直しもしていなければ true
+    bool IsSettled() const;
+    // 読み終えて反映したチャンクの数（起動から。読み直しは含まない）
+    uint64_t LoadedChunkCount() const { return chunkLoads_; }
+
+    // 読み込みパイプラインの統計
+    const PipelineStats& GetPipelineStats() const { return loader_.GetPipelineStats(); }
+    // 取得元の層ごとのヒット率も一緒に書き出す
+    bool SavePipelineStats(const std::filesystem::path& path) const;
+    // Chrome trace_event 形式のトレース（既定は無効）
+    void SetTracingEnabled(bool enabled) { loader_.GetTracer().SetEnabled(enabled); }
+    bool SaveTrace(const std::filesystem::path& path) const { return loader_.GetTracer().SaveJson(path); }
+
 private:
-    // ネットワーク
-    bool CheckOnlineStatus() const;
-    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
+    // 常駐チャンクのメモリ量（概算）
+    uint64_t ResidentChunkBytes() const;
 
-    // シート読み込み／キャッシュI/O
-    TileData LoadFromSheet(int cx, int cy) const;
-    TileData LoadChunkCache(int cx, int cy) const;
-    void SaveChunkCache(int cx, int cy, const TileData& data) const;
+    // 読み込みスレッド
+    struct LoadJob {
+        int chunkX;
+        int chunkY;
+        std::shared_ptr<LoadTicket> ticket;
+        std::promise<ChunkLoadResult> promise;
+    };
+    void EnsureLoaders();
+    void StopLoaders();
+    void LoaderLoop();
+    ChunkLoadResult RunLoad(const LoadJob& job);
 
     // 非同期読み込み管理
     void PollLoadedChunks();
-    void EnqueueChunkLoad(int cx, int cy);
+    void EnqueueChunkLoad(int cx, int cy, LoadPriority priority);
+    std::future<ChunkLoadResult> SubmitLoad(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket);
 
-    // 列番号からGoogleシート列文字列
-    static std::string ColIndexToName(int index);
+    // 縮小地図: 画面内で値の分からないチャンクを近い順に取り寄せ、終わったものを反映する
+    void RequestOverviews(int playerTileX, int playerTileY);
+    void PollOverviewLoads();
+    void CancelOverviewLoads();
+    // 描画（描いた矩形の数を返す）
+    int DrawChunks(int offsetX, int offsetY, int level) const;
+    // 主レイヤーをタイルごとに描く（縮小表示、明るさ、境目）
+    int DrawChunkTiles(const MapChunk& chunk, int chunkScreenX, int chunkScreenY, int level) const;
+    // 当たり判定の Solid のタイルを枠で描く
+    int DrawCollisionOverlay(const MapChunk& chunk, int chunkScreenX, int chunkScreenY) const;
+    void BuildDrawRuns(const MapChunk& chunk) const;
+    int LayerPriority(int layer) const { return layer == 0 ? 0 : layers_[static_cast<size_t>(layer) - 1].priority; }
+    int DrawOverview(int offsetX, int offsetY, int level) const;
+    // どの関心領域の範囲からも外れたチャンクを解放する
+    void ReleaseChunk(int cx, int cy);
+    void CancelChunkLoad(MapChunk& chunk);
+    // チャンクのタイルが変わった（読み込み・編集）。縮小レベル・当たり判定・経路・明るさ・境目のマスクを作り直す
+    // updateOverview: 縮小地図にも反映する（内容の分かったチャンクだけ）
+    void IntegrateChunk(MapChunk& chunk, bool updateOverview);
+    // 1セルを書き換え、変わったら書き戻しに記録する（チャンクの作り直しは呼び出し側でまとめて行う）
+    bool WriteTile(MapChunk& chunk, int tileX, int tileY, int tile, int layer);
+    // 書き戻しで競合したセルをシートの値に戻す
+    void ApplyEditConflicts();
+    // シートで変わったチャンクを取得元から捨て、常駐していれば読み直す
+    void ApplySheetChanges();
+    void RefreshChunk(MapChunk& chunk);
+    // 読み直しの終わったチャンクを入れ替える
+    void PollRefreshedChunk(MapChunk& chunk);
+    // 周りの読み込み済みのチャンクと合わせて近傍マスクを作り直す
+    void BuildAutotile(MapChunk& chunk);
+    // (cx, cy) が読み込まれた・解放されたので、周りの8チャンクの縁を作り直す
+    void RestitchAutotile(int cx, int cy);
+    // 期限の過ぎた経路用の関心領域を外す
+    void ExpirePathRegions();
 
     // メンバ変数
-    std::string spreadsheetId_;
-    std::string sheetName_;
-    std::string apiKey_;
+    // シート取得とキャッシュ（読み込みスレッドより後に破棄されるよう先に宣言する）
+    ChunkLoader loader_;
+    // チャンクの取得元（既定の層は loader_ を参照する）
+    std::shared_ptr<MemorySource> memorySource_;
+    std::shared_ptr<SheetsSource> sheetsSource_;
+    std::shared_ptr<CachedSource> source_;
     bool isOnline_ = false;
     int tileSize_;
     int yOffset_;
     int viewDistanceChunks_;
+    int prefetchDistanceChunks_ = 0;
     std::string cacheDir_;
-    std::unordered_map<std::pair<int, int>, MapChunk, PairHash> chunks_;
+    // 追加レイヤーと、主レイヤー（0）を含めた描く順
+    std::vector<MapLayer> layers_;
+    std::vector<int> layerOrder_{ 0 };
+    // チャンクの記録・読み込み結果の共有状態・チケット・読み込み待ち行列はこのプールから確保する
+    // 解放されたブロックはプール内で再利用され、定常状態ではヒープに戻らない
+    std::pmr::synchronized_pool_resource chunkPool_;
+    std::pmr::unordered_map<std::pair<int, int>, MapChunk, PairHash> chunks_;
+    std::vector<std::thread> loaders_;
+    std::mutex loadMutex_;
+    std::condition_variable loadCv_;
+    std::pmr::deque<LoadJob> loadQueue_;
+    bool stopLoaders_ = false;
+    // 範囲に入ったチャンクを EnqueueChunkLoad で積み、どの領域からも外れたら ReleaseChunk で解放する
+    InterestRegionSet regions_;
+    int playerRegion_ = -1;
+
+    // 縮小表示
+    double zoom_ = 1.0;
+    int viewportWidth_ = 1280;
+    int viewportHeight_ = 720;
+    LodReducer lodReducer_;
+    OverviewMap overview_{ lodReducer_ };
+    struct OverviewLoad {
+        std::shared_ptr<LoadTicket> ticket;
+        std::future<ChunkLoadResult> future;
+    };
+    std::unordered_map<std::pair<int, int>, OverviewLoad, PairHash> overviewLoads_;
+    // どの取得元も答えなかったチャンク（オフラインで未キャッシュなど）。再読み込みかオンライン切替まで聞き直さない
+    std::unordered_set<std::pair<int, int>, PairHash> overviewMissing_;
+    // 最後に画面内を調べ終えたときの中心チャンクとタイルの大きさ（変わるまで調べ直さない）
+    std::optional<std::tuple<int, int, int>> overviewScanned_;
+
+    // 当たり判定
+    TileClassifier tileClassifier_;
+    CollisionMap collision_;
+    Pathfinder pathfinder_{ collision_ };
+    // 経路が通るために読み込んでいるチャンク（関心領域のIDと、外す時刻）
+    struct PathRegion {
+        int regionId = -1;
+        std::chrono::steady_clock::time_point expiry;
+    };
+    std::unordered_map<std::pair<int, int>, PathRegion, PairHash> pathRegions_;
+    // 流れ場（プールは流れ場より先に作り、後に壊す）
+    WorkStealingPool flowPool_;
+    FlowField flowField_{ collision_, flowPool_ };
+    // 明るさと視界（計算は LightMap の作業スレッドで行い、Update で公開された値で描く）
+    LightMap lightMap_;
+    bool lightingEnabled_ = false;
+    bool autotileEnabled_ = false;
+    bool collisionOverlayEnabled_ = false;
+    // 編集の書き戻し（送れなかった編集はキャッシュディレクトリに残し、次の起動で送る）
+    TileEditor editor_;
+    // シートの変更の待ち受け
+    ChangeWatcher watcher_;
+    std::string changeFeedUrl_;
+    std::chrono::milliseconds revisionPollInterval_ = kDefaultRevisionPollInterval;
+    bool revisionPollRequested_ = false; // SetRevisionPollInterval で指定された
+    uint64_t chunkRefreshes_ = 0;
+    uint64_t chunkSwaps_ = 0;
+    // 読み込みで例外が起きた回数
+    uint64_t loadFailures_ = 0;
+    // 読み終えて反映したチャンクの数
+    uint64_t chunkLoads_ = 0;
 
-    static constexpr int kChunkWidth = 6;
-    static constexpr int kChunkHeight = 6;
+    // 読み込みスレッド数の上限（表示範囲＋先読み範囲のチャンク数と小さい方）
+    static constexpr int kMaxLoaderThreads = 64;
+    // メモリに置いておくチャンク数（常駐範囲の外に出たものを含む）
+    static constexpr size_t kMemoryCacheChunks = 4096;
+    // 縮小表示の1ブロックの最小の大きさ（ピクセル）。画面内の矩形の数をほぼ一定に保つ
+    static constexpr int kMinLodBlockPixels = 12;
+    // 同時に取り寄せる縮小地図のチャンク数
+    static constexpr size_t kMaxOverviewLoads = 64;
+    // 経路のために読み込んだチャンクを常駐させておく時間
+    static constexpr double kPathChunkSeconds = 30.0;
+    // 変更フィードがないときにリビジョンを確認する間隔
+    static constexpr std::chrono::milliseconds kDefaultRevisionPollInterval{ 30000 };
+    // 視界の半径（タイル）
+    static constexpr int kViewRadiusTiles = 24;
+    // 明るさで描くとき、光の届かない見えているタイルと、視界の外のタイルの明るさ
+    static constexpr int kAmbientLight = 5;
+    static constexpr int kHiddenLight = 2;
+    // 境目を描くとき空ける幅（タイルの大きさの 1/8）
+    static constexpr int kAutotileGapDivisor = 8;
+    static constexpr double kMinZoom = 1.0 / 64.0;
+    static constexpr double kMaxZoom = 4.0;
+    static constexpr int kChunkWidth = ChunkLoader::kChunkWidth;
+    static constexpr int kChunkHeight = ChunkLoader::kChunkHeight;
 };
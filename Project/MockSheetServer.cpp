@@ -0,0 +1,281 @@
+#include "MockSheetServer.h"
+#include <charconv>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// クエリの name の値をすべて（パーセントエンコードを戻して）。戻せない値があれば false
+bool QueryValues(const std::string& target, const std::string& name, std::vector<std::string>& values) {
+    values.clear();
+    size_t pos = target.find('?');
+    while (pos != std::string::npos) {
+        size_t start = pos + 1;
+        size_t end = target.find('&', start);
+        size_t valueEnd = end == std::string::npos ? target.size() : end;
+        if (target.compare(start, name.size(), name) == 0 && start + name.size() < valueEnd
+            && target[start + name.size()] == '=') {
+            std::string value;
+            size_t valueStart = start + name.size() + 1;
+            if (!HttpServer::PercentDecode(target.substr(valueStart, valueEnd - valueStart), value)) return false;
+            values.push_back(std::move(value));
+        }
+        pos = end;
+    }
+    return true;
+}
+
+// batchUpdate のセルの値（空文字列は空のセル）。数でなければ false
+bool CellValue(const json& cell, int& tile) {
+    if (cell.is_number_integer()) {
+        tile = cell.get<int>();
+        return true;
+    }
+    if (!cell.is_string()) return false;
+    const std::string& text = cell.get_ref<const std::string&>();
+    tile = 0;
+    if (text.empty()) return true;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), tile);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+// 書き込みを受ける大きさ（TileEditor の1回の書き戻しの上限 20000 セルに余裕を持たせる）
+constexpr size_t kMaxBodyBytes = 8 * 1024 * 1024;
+
+} // namespace
+
+MockSheetServer::MockSheetServer(const MockSheetOptions& options)
+    : options_(options)
+    , random_(options.seed)
+    , server_(HttpServerOptions{ 0, 1024, 30, kMaxBodyBytes },
+        [this](const std::string& method, const std::string& target, const std::string& body) {
+            return Handle(method, target, body);
+        }) {
+}
+
+std::string MockSheetServer::BaseUrl() const {
+    return "http://127.0.0.1:" + std::to_string(server_.Port());
+}
+
+std::string MockSheetServer::RevisionUrl() const {
+    return BaseUrl() + "/drive/v3/files/" + options_.spreadsheetId;
+}
+
+MockSheetServer::Stats MockSheetServer::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+int MockSheetServer::Tile(int x, int y) {
+    uint32_t h = static_cast<uint32_t>(x) * 73856093u ^ static_cast<uint32_t>(y) * 19349663u;
+    h ^= h >> 13;
+    h *= 0x5BD1E995u;
+    h ^= h >> 15;
+    // 4分の1を空のセルにする（行末の空セルを省く処理も通す）
+    return h % 4 == 0 ? 0 : static_cast<int>(h / 4 % 3) + 1;
+}
+
+int MockSheetServer::Cell(int x, int y) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return CellLocked(x, y);
+}
+
+void MockSheetServer::SetCell(int x, int y, int tile) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    written_[{ x, y }] = tile;
+}
+
+int MockSheetServer::CellLocked(int x, int y) const {
+    auto found = written_.find({ x, y });
+    return found != written_.end() ? found->second : Tile(x, y);
+}
+
+TileData MockSheetServer::ExpectedChunk(int cx, int cy, int columnOffset, int rowOffset) {
+    TileData rows;
+    for (int y = 0; y < ChunkTiles::kHeight; ++y) {
+        std::vector<int> row;
+        for (int x = 0; x < ChunkTiles::kWidth; ++x) {
+            row.push_back(Tile(cx * ChunkTiles::kWidth + x + columnOffset, cy * ChunkTiles::kHeight + y + rowOffset));
+        }
+        while (!row.empty() && row.back() == 0) row.pop_back();
+        rows.push_back(std::move(row));
+    }
+    while (!rows.empty() && rows.back().empty()) rows.pop_back();
+    return rows;
+}
+
+HttpServerResponse MockSheetServer::Handle(const std::string& method, const std::string& target, const std::string& body) {
+    std::string path;
+    if (!HttpServer::PercentDecode(target.substr(0, target.find('?')), path)) {
+        return HttpServer::ErrorResponse(400, "bad percent-encoding");
+    }
+    const std::string spreadsheetPath = "/v4/spreadsheets/" + options_.spreadsheetId;
+    if (method == "POST") {
+        bool read = path == spreadsheetPath + "/values:batchGetByDataFilter";
+        if (!read && path != spreadsheetPath + "/values:batchUpdate") return HttpServer::ErrorResponse(404, "not found");
+        if (std::optional<HttpServerResponse> refused = Admit()) return *refused;
+        if (options_.latencyMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(options_.latencyMs));
+        return read ? HandleBatchGetByDataFilter(body) : HandleBatchUpdate(body);
+    }
+    if (method != "GET") return HttpServer::ErrorResponse(405, "only GET and POST are supported");
+    if (path == "/drive/v3/files/" + options_.spreadsheetId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.revisions;
+        return { 200, std::make_shared<const std::string>(R"({"version":"1"})") };
+    }
+    const std::string valuesPrefix = spreadsheetPath + "/values/";
+    bool batchGet = path == spreadsheetPath + "/values:batchGet";
+    if (!batchGet && path.rfind(valuesPrefix, 0) != 0) return HttpServer::ErrorResponse(404, "not found");
+    if (std::optional<HttpServerResponse> refused = Admit()) return *refused;
+    if (options_.latencyMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(options_.latencyMs));
+    return batchGet ? HandleBatchGet(target) : HandleValues(path.substr(valuesPrefix.size()));
+}
+
+HttpServerResponse MockSheetServer::HandleValues(const std::string& range) {
+    std::optional<json> j;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        j = ValueRange(range);
+        if (!j) return HttpServer::ErrorResponse(400, "bad range");
+        ++stats_.served;
+    }
+    return { 200, std::make_shared<const std::string>(j->dump()) };
+}
+
+HttpServerResponse MockSheetServer::HandleBatchGet(const std::string& target) {
+    std::vector<std::string> ranges;
+    if (!QueryValues(target, "ranges", ranges) || ranges.empty()) return HttpServer::ErrorResponse(400, "bad ranges");
+    json valueRanges = json::array();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const std::string& range : ranges) {
+            std::optional<json> j = ValueRange(range);
+            if (!j) return HttpServer::ErrorResponse(400, "bad range");
+            valueRanges.push_back(std::move(*j));
+        }
+        ++stats_.served;
+    }
+    json j = { { "spreadsheetId", options_.spreadsheetId }, { "valueRanges", std::move(valueRanges) } };
+    return { 200, std::make_shared<const std::string>(j.dump()) };
+}
+
+HttpServerResponse MockSheetServer::HandleBatchGetByDataFilter(const std::string& body) {
+    json request = json::parse(body, nullptr, false);
+    if (!request.is_object() || !request.contains("dataFilters") || !request["dataFilters"].is_array()) {
+        return HttpServer::ErrorResponse(400, "bad dataFilters");
+    }
+    json valueRanges = json::array();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const json& filter : request["dataFilters"]) {
+            if (!filter.is_object() || !filter.contains("a1Range") || !filter["a1Range"].is_string()) {
+                return HttpServer::ErrorResponse(400, "only a1Range filters are supported");
+            }
+            std::optional<json> j = ValueRange(filter["a1Range"].get<std::string>());
+            if (!j) return HttpServer::ErrorResponse(400, "bad range");
+            valueRanges.push_back({ { "valueRange", std::move(*j) }, { "dataFilters", json::array({ filter }) } });
+        }
+        ++stats_.served;
+    }
+    json j = { { "spreadsheetId", options_.spreadsheetId }, { "valueRanges", std::move(valueRanges) } };
+    return { 200, std::make_shared<const std::string>(j.dump()) };
+}
+
+HttpServerResponse MockSheetServer::HandleBatchUpdate(const std::string& body) {
+    json request = json::parse(body, nullptr, false);
+    if (!request.is_object() || !request.contains("data") || !request["data"].is_array()) {
+        return HttpServer::ErrorResponse(400, "bad data");
+    }
+    // 全体を確かめてから書く（途中の不正な範囲で一部だけ書かない）
+    std::vector<std::pair<std::pair<int, int>, int>> cells;
+    for (const json& range : request["data"]) {
+        CellRect rect;
+        if (!range.is_object() || !range.contains("range") || !range["range"].is_string()
+            || !ParseRange(range["range"].get<std::string>(), rect)) {
+            return HttpServer::ErrorResponse(400, "bad range");
+        }
+        if (!range.contains("values")) continue;
+        const json& rows = range["values"];
+        if (!rows.is_array() || static_cast<int>(rows.size()) > rect.y1 - rect.y0 + 1) {
+            return HttpServer::ErrorResponse(400, "values do not fit the range");
+        }
+        for (size_t y = 0; y < rows.size(); ++y) {
+            if (!rows[y].is_array() || static_cast<int>(rows[y].size()) > rect.x1 - rect.x0 + 1) {
+                return HttpServer::ErrorResponse(400, "values do not fit the range");
+            }
+            for (size_t x = 0; x < rows[y].size(); ++x) {
+                int tile = 0;
+                if (!CellValue(rows[y][x], tile)) return HttpServer::ErrorResponse(400, "only numbers are supported");
+                cells.push_back({ { rect.x0 + static_cast<int>(x), rect.y0 + static_cast<int>(y) }, tile });
+            }
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [cell, tile] : cells) written_[cell] = tile;
+        stats_.cellsWritten += cells.size();
+        ++stats_.served;
+    }
+    json j = { { "spreadsheetId", options_.spreadsheetId }, { "totalUpdatedCells", cells.size() } };
+    return { 200, std::make_shared<const std::string>(j.dump()) };
+}
+
+bool MockSheetServer::ParseRange(const std::string& range, CellRect& rect) const {
+    size_t bang = range.rfind('!');
+    size_t colon = range.find(':', bang == std::string::npos ? 0 : bang);
+    if (bang == std::string::npos || colon == std::string::npos) return false;
+    if (range.compare(0, bang, options_.sheetName) != 0) return false;
+    int startCol = 0, startRow = 0, endCol = 0, endRow = 0;
+    if (!ChunkLoader::ParseCellName(range.substr(bang + 1, colon - bang - 1), startCol, startRow)
+        || !ChunkLoader::ParseCellName(range.substr(colon + 1), endCol, endRow)
+        || endCol < startCol || endRow < startRow) {
+        return false;
+    }
+    rect = { startCol, startRow - 1, endCol, endRow - 1 };
+    return true;
+}
+
+std::optional<json> MockSheetServer::ValueRange(const std::string& range) const {
+    CellRect rect;
+    if (!ParseRange(range, rect)) return std::nullopt;
+    json values = json::array();
+    size_t kept = 0; // 末尾の空行を除いた行数
+    for (int y = rect.y0; y <= rect.y1; ++y) {
+        int width = rect.x1 - rect.x0 + 1;
+        while (width > 0 && CellLocked(rect.x0 + width - 1, y) == 0) --width;
+        json cells = json::array();
+        for (int x = 0; x < width; ++x) {
+            int tile = CellLocked(rect.x0 + x, y);
+            cells.push_back(tile == 0 ? std::string() : std::to_string(tile));
+        }
+        values.push_back(std::move(cells));
+        if (width > 0) kept = values.size();
+    }
+    values.erase(values.begin() + static_cast<std::ptrdiff_t>(kept), values.end());
+    json j = { { "range", range }, { "majorDimension", "ROWS" } };
+    if (!values.empty()) j["values"] = std::move(values);
+    return j;
+}
+
+std::optional<HttpServerResponse> MockSheetServer::Admit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (options_.quotaRequests > 0) {
+        int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (nowMs - windowStartMs_ >= options_.quotaWindowMs) {
+            windowStartMs_ = nowMs;
+            windowCount_ = 0;
+        }
+        if (windowCount_ >= options_.quotaRequests) {
+            HttpServerResponse response = HttpServer::ErrorResponse(429, "RESOURCE_EXHAUSTED");
+            if (stats_.throttled++ % 2 == 0) response.retryAfterSec = 1;
+            return response;
+        }
+        ++windowCount_;
+    }
+    if (options_.errorRate > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(random_) < options_.errorRate) {
+        ++stats_.failed;
+        return HttpServer::ErrorResponse(503, "backend error");
+    }
+    return std::nullopt;
+}
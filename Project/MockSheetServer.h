@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include "ChunkLoader.h"
+#include "HttpServer.h"
+
+// MockSheetServer の設定
+struct MockSheetOptions {
+    std::string spreadsheetId = "mock";
+    std::string sheetName = "TR1_02";
+    int quotaRequests = 0;    // quotaWindowMs ごとに答えるチャンクの数（0 なら無制限）。超えたら429
+    int quotaWindowMs = 1000;
+    double errorRate = 0.0;   // 503 を返す割合（クォータの内側のリクエストだけ）
+    int latencyMs = 0;        // チャンクのリクエストごとに待つ時間
+    uint32_t seed = 1;        // 503 を返すリクエストを選ぶ乱数の種
+};
+
+// 負荷試験で上流の代わりに置く Sheets API のモック（同じプロセスの中で HttpServer として動く）
+// タイルの値は座標だけで決まる（書き込まれたセルはその値）。空のセルを含み、行末の空セルと末尾の空行は values API と同じく省く
+//   GET /v4/spreadsheets/{id}/values/{sheet}!A1:F6   セルの値
+//   GET /v4/spreadsheets/{id}/values:batchGet?ranges=...&ranges=...   複数の Range（1リクエスト、1チャンクとして数える）
+//   POST /v4/spreadsheets/{id}/values:batchGetByDataFilter   ボディの dataFilters の a1Range を読む
+//   POST /v4/spreadsheets/{id}/values:batchUpdate            ボディの data を書く（シートの大きさは変えない）
+//   GET /drive/v3/files/{id}                          {"version": "1"}（リビジョンは変わらない）
+// 429 には2回に1回 Retry-After: 1 を付ける
+class MockSheetServer {
+public:
+    struct Stats {
+        uint64_t served = 0;    // 200 で答えたチャンク
+        uint64_t throttled = 0; // 429
+        uint64_t failed = 0;    // 503
+        uint64_t revisions = 0; // リビジョン確認
+        uint64_t cellsWritten = 0; // batchUpdate で書いたセル
+    };
+
+    explicit MockSheetServer(const MockSheetOptions& options = {});
+    MockSheetServer(const MockSheetServer&) = delete;
+    MockSheetServer& operator=(const MockSheetServer&) = delete;
+
+    // 空いているポートで待ち受ける
+    bool Start() { return server_.Start(); }
+    void Stop() { server_.Stop(); }
+
+    // ChunkLoader::SetApiBaseUrl と SetRevisionUrl に渡すURL
+    std::string BaseUrl() const;
+    std::string RevisionUrl() const;
+    Stats GetStats() const;
+
+    // タイル (x, y) の初めの値（0 は空のセル）
+    static int Tile(int x, int y);
+    // セル (x, y) の今の値（書き込まれていればその値）
+    int Cell(int x, int y) const;
+    // 他の人の編集の代わりに、セルを直接書き換える
+    void SetCell(int x, int y, int tile);
+    // values API でチャンク (cx, cy) を読んだときの形（キャッシュの照合に使う。書き込まれたセルは含まない）
+    // 追加レイヤーは、SheetLayer と同じく列・行をずらした位置を読む
+    static TileData ExpectedChunk(int cx, int cy, int columnOffset = 0, int rowOffset = 0);
+
+private:
+    // A1 形式の範囲の列・行（0 始まり、両端を含む）
+    struct CellRect {
+        int x0 = 0;
+        int y0 = 0;
+        int x1 = 0;
+        int y1 = 0;
+    };
+
+    HttpServerResponse Handle(const std::string& method, const std::string& target, const std::string& body);
+    HttpServerResponse HandleValues(const std::string& range);
+    HttpServerResponse HandleBatchGet(const std::string& target);
+    HttpServerResponse HandleBatchGetByDataFilter(const std::string& body);
+    HttpServerResponse HandleBatchUpdate(const std::string& body);
+    // シート名や形が違えば false
+    bool ParseRange(const std::string& range, CellRect& rect) const;
+    // Range の valueRanges の1要素（範囲の形が違えば nullopt）。mutex_ を持って呼ぶ
+    std::optional<json> ValueRange(const std::string& range) const;
+    int CellLocked(int x, int y) const;
+    // クォータと 503 の判定。答えてよければ nullopt、断るなら 429 か 503 のレスポンス
+    std::optional<HttpServerResponse> Admit();
+
+    MockSheetOptions options_;
+    mutable std::mutex mutex_;
+    std::mt19937 random_;
+    int64_t windowStartMs_ = 0;
+    int windowCount_ = 0;
+    Stats stats_;
+    std::unordered_map<std::pair<int, int>, int, PairHash> written_; // 書き込まれたセル
+    // 接続スレッドが Handle を呼ぶので最後に置く
+    HttpServer server_;
+};
@@ -0,0 +1,544 @@
+#include "Pathfinder.h"
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <unordered_set>
+
+namespace {
+
+using Tile = std::pair<int, int>;
+
+constexpr double kDiagonalCost = 1.4142135623730951;
+constexpr double kUnreached = std::numeric_limits<double>::infinity();
+
+int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+int Sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+uint64_t LowBits(int count) {
+    return count >= 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << count) - 1;
+}
+
+// 8方向（斜め √2）で障害物がないときの距離
+double Octile(Tile a, Tile b) {
+    int dx = std::abs(a.first - b.first);
+    int dy = std::abs(a.second - b.second);
+    return static_cast<double>(dx + dy) + (kDiagonalCost - 2.0) * static_cast<double>(std::min(dx, dy));
+}
+
+// 跳躍点の探索（斜めは両側の縦横が通れるときだけ進める規則）
+// 横方向は 64 列ずつのワード演算で、止まるべき列（壁・強制隣接・終点）をまとめて探す
+class Jumper {
+public:
+    Jumper(const PathGrid& grid, Tile goal) : grid_(grid), goal_(goal) {}
+
+    bool Free(int x, int y) const { return !grid_.Blocked(x, y); }
+
+    // (x, y) から dx の向きへ進み、最初の跳躍点（x + dx から調べる）
+    std::optional<Tile> Horizontal(int x, int y, int dx) const {
+        if (dx > 0) {
+            // ビット 0 が base（1つ手前の列）、ビット i が base + i。63 列ずつ進む
+            for (int base = x;; base += 63) {
+                uint64_t blocked = grid_.Bits(base, y);
+                uint64_t above = grid_.Bits(base, y - 1);
+                uint64_t below = grid_.Bits(base, y + 1);
+                // 上下の行が「手前は壁、この列は空き」になる列は強制隣接を持つ
+                uint64_t stop = blocked | (~above & (above << 1)) | (~below & (below << 1));
+                if (goal_.second == y && goal_.first > base && goal_.first - base < 64) stop |= uint64_t{ 1 } << (goal_.first - base);
+                stop &= ~uint64_t{ 1 };
+                if (!stop) continue;
+                int i = std::countr_zero(stop);
+                if ((blocked >> i) & 1) return std::nullopt;
+                return Tile{ base + i, y };
+            }
+        }
+        // ビット 63 が base（1つ手前の列）、ビット i が base - 63 + i
+        for (int base = x;; base -= 63) {
+            int left = base - 63;
+            uint64_t blocked = grid_.Bits(left, y);
+            uint64_t above = grid_.Bits(left, y - 1);
+            uint64_t below = grid_.Bits(left, y + 1);
+            uint64_t stop = blocked | (~above & (above >> 1)) | (~below & (below >> 1));
+            if (goal_.second == y && goal_.first < base && base - goal_.first < 64) stop |= uint64_t{ 1 } << (goal_.first - left);
+            stop &= ~(uint64_t{ 1 } << 63);
+            if (!stop) continue;
+            int i = static_cast<int>(std::bit_width(stop)) - 1;
+            if ((blocked >> i) & 1) return std::nullopt;
+            return Tile{ left + i, y };
+        }
+    }
+
+    // (x, y) から dy の向きへ進み、最初の跳躍点（y + dy から調べる）
+    std::optional<Tile> Vertical(int x, int y, int dy) const {
+        // ビット 0, 1, 2 が列 x - 1, x, x + 1
+        uint64_t previous = grid_.Bits(x - 1, y) & 7;
+        for (int row = y + dy;; row += dy) {
+            uint64_t current = grid_.Bits(x - 1, row) & 7;
+            if (current & 2) return std::nullopt;
+            if (x == goal_.first && row == goal_.second) return Tile{ x, row };
+            if (~current & previous & 5) return Tile{ x, row };
+            previous = current;
+        }
+    }
+
+    // (x, y) から斜めに進む（(x, y) から調べる）。縦横へ跳べる点があればそこで止まる
+    std::optional<Tile> Diagonal(int x, int y, int dx, int dy) const {
+        for (;; x += dx, y += dy) {
+            if (!Free(x, y)) return std::nullopt;
+            if (x == goal_.first && y == goal_.second) return Tile{ x, y };
+            if (Horizontal(x, y, dx) || Vertical(x, y, dy)) return Tile{ x, y };
+            if (!Free(x + dx, y) || !Free(x, y + dy)) return std::nullopt;
+        }
+    }
+
+    // 親 (px, py) から隣の (x, y) へ進んだ先の跳躍点
+    std::optional<Tile> Jump(int x, int y, int px, int py) const {
+        int dx = Sign(x - px);
+        int dy = Sign(y - py);
+        if (dx && dy) return Diagonal(x, y, dx, dy);
+        if (dx) return Horizontal(px, py, dx);
+        return Vertical(px, py, dy);
+    }
+
+    // 進んできた向きで刈り込んだ隣（親がなければ8方向すべて）
+    void Neighbors(int x, int y, const Tile* parent, std::vector<Tile>& out) const {
+        out.clear();
+        if (!parent) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    if (!dx && !dy) continue;
+                    if (dx && dy && (!Free(x + dx, y) || !Free(x, y + dy))) continue;
+                    if (Free(x + dx, y + dy)) out.emplace_back(x + dx, y + dy);
+                }
+            }
+            return;
+        }
+        int dx = Sign(x - parent->first);
+        int dy = Sign(y - parent->second);
+        if (dx && dy) {
+            bool nextX = Free(x + dx, y);
+            bool nextY = Free(x, y + dy);
+            if (nextY) out.emplace_back(x, y + dy);
+            if (nextX) out.emplace_back(x + dx, y);
+            if (nextX && nextY) out.emplace_back(x + dx, y + dy);
+        } else if (dx) {
+            bool next = Free(x + dx, y);
+            bool down = Free(x, y + 1);
+            bool up = Free(x, y - 1);
+            if (next) {
+                out.emplace_back(x + dx, y);
+                if (down) out.emplace_back(x + dx, y + 1);
+                if (up) out.emplace_back(x + dx, y - 1);
+            }
+            if (down) out.emplace_back(x, y + 1);
+            if (up) out.emplace_back(x, y - 1);
+        } else {
+            bool next = Free(x, y + dy);
+            bool right = Free(x + 1, y);
+            bool left = Free(x - 1, y);
+            if (next) {
+                out.emplace_back(x, y + dy);
+                if (right) out.emplace_back(x + 1, y + dy);
+                if (left) out.emplace_back(x - 1, y + dy);
+            }
+            if (right) out.emplace_back(x + 1, y);
+            if (left) out.emplace_back(x - 1, y);
+        }
+    }
+
+private:
+    const PathGrid& grid_;
+    Tile goal_;
+};
+
+} // namespace
+
+PathGrid::PathGrid(const CollisionMap& map, int originX, int originY, int width, int height, UnloadedTiles unloaded)
+    : originX_(originX)
+    , originY_(originY)
+    , width_(width)
+    , height_(height)
+    , wordsPerRow_((width + 63) / 64) {
+    // 範囲の右にはみ出すビットは 1（通れない）のまま残す
+    words_.assign(static_cast<size_t>(wordsPerRow_) * static_cast<size_t>(height), ~uint64_t{ 0 });
+    bool unloadedSolid = unloaded == UnloadedTiles::Blocked;
+    for (int y = 0; y < height; ++y) {
+        uint64_t* row = &words_[static_cast<size_t>(y) * static_cast<size_t>(wordsPerRow_)];
+        for (int x = 0; x < width; x += CollisionMap::kRowBits) {
+            uint64_t mask = LowBits(std::min(CollisionMap::kRowBits, width - x));
+            uint64_t bits = map.SolidRow(originX + x, originY + y, unloadedSolid) & mask;
+            int index = x / 64;
+            int shift = x % 64;
+            row[index] = (row[index] & ~(mask << shift)) | (bits << shift);
+            if (shift && index + 1 < wordsPerRow_) {
+                row[index + 1] = (row[index + 1] & ~(mask >> (64 - shift))) | (bits >> (64 - shift));
+            }
+        }
+    }
+}
+
+uint64_t PathGrid::Word(int row, int index) const {
+    if (index < 0 || index >= wordsPerRow_) return ~uint64_t{ 0 };
+    return words_[static_cast<size_t>(row) * static_cast<size_t>(wordsPerRow_) + static_cast<size_t>(index)];
+}
+
+uint64_t PathGrid::Bits(int x, int y) const {
+    int row = y - originY_;
+    if (row < 0 || row >= height_) return ~uint64_t{ 0 };
+    int column = x - originX_;
+    int index = FloorDiv(column, 64);
+    int shift = column - index * 64;
+    uint64_t bits = Word(row, index) >> shift;
+    if (shift) bits |= Word(row, index + 1) << (64 - shift);
+    return bits;
+}
+
+bool Pathfinder::SearchGrid(const PathGrid& grid, Tile start, Tile goal,
+    std::vector<Tile>& tiles, double& cost, size_t& expanded) {
+    tiles.clear();
+    cost = 0.0;
+    if (!grid.Contains(start.first, start.second) || !grid.Contains(goal.first, goal.second)) return false;
+    if (grid.Blocked(start.first, start.second) || grid.Blocked(goal.first, goal.second)) return false;
+    int width = grid.Width();
+    auto indexOf = [&](Tile tile) {
+        return (tile.second - grid.OriginY()) * width + (tile.first - grid.OriginX());
+    };
+    auto tileOf = [&](int index) { return Tile{ grid.OriginX() + index % width, grid.OriginY() + index / width }; };
+
+    size_t cells = static_cast<size_t>(width) * static_cast<size_t>(grid.Height());
+    std::vector<double> g(cells, kUnreached);
+    std::vector<int> parent(cells, -1);
+    std::vector<uint8_t> closed(cells, 0);
+    std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<>> open;
+    int startIndex = indexOf(start);
+    int goalIndex = indexOf(goal);
+    g[startIndex] = 0.0;
+    open.emplace(Octile(start, goal), startIndex);
+
+    Jumper jumper(grid, goal);
+    std::vector<Tile> neighbors;
+    while (!open.empty()) {
+        int current = open.top().second;
+        open.pop();
+        if (closed[current]) continue;
+        closed[current] = 1;
+        ++expanded;
+        if (current == goalIndex) break;
+        Tile tile = tileOf(current);
+        Tile parentTile = parent[current] >= 0 ? tileOf(parent[current]) : tile;
+        jumper.Neighbors(tile.first, tile.second, parent[current] >= 0 ? &parentTile : nullptr, neighbors);
+        for (Tile neighbor : neighbors) {
+            std::optional<Tile> jumpPoint = jumper.Jump(neighbor.first, neighbor.second, tile.first, tile.second);
+            if (!jumpPoint) continue;
+            int next = indexOf(*jumpPoint);
+            if (closed[next]) continue;
+            double nextG = g[current] + Octile(tile, *jumpPoint);
+            if (nextG >= g[next]) continue;
+            g[next] = nextG;
+            parent[next] = current;
+            open.emplace(nextG + Octile(*jumpPoint, goal), next);
+        }
+    }
+    if (!closed[goalIndex]) return false;
+
+    // 跳躍点の間は縦・横・斜めの直線なので、1タイルずつに展開する
+    std::vector<Tile> jumpPoints;
+    for (int index = goalIndex; index >= 0; index = parent[index]) jumpPoints.push_back(tileOf(index));
+    std::reverse(jumpPoints.begin(), jumpPoints.end());
+    tiles.push_back(start);
+    for (size_t i = 1; i < jumpPoints.size(); ++i) {
+        Tile at = jumpPoints[i - 1];
+        Tile to = jumpPoints[i];
+        int dx = Sign(to.first - at.first);
+        int dy = Sign(to.second - at.second);
+        while (at != to) {
+            at.first += dx;
+            at.second += dy;
+            tiles.push_back(at);
+        }
+    }
+    cost = g[goalIndex];
+    return true;
+}
+
+std::vector<double> Pathfinder::DistanceField(const PathGrid& grid, Tile from) {
+    int width = grid.Width();
+    int height = grid.Height();
+    std::vector<double> distance(static_cast<size_t>(width) * static_cast<size_t>(height), kUnreached);
+    if (!grid.Contains(from.first, from.second) || grid.Blocked(from.first, from.second)) return distance;
+    auto passable = [&](int x, int y) { return grid.Contains(x, y) && !grid.Blocked(x, y); };
+    std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<>> open;
+    int fromIndex = (from.second - grid.OriginY()) * width + (from.first - grid.OriginX());
+    distance[fromIndex] = 0.0;
+    open.emplace(0.0, fromIndex);
+    while (!open.empty()) {
+        auto [d, current] = open.top();
+        open.pop();
+        if (d > distance[current]) continue;
+        int x = grid.OriginX() + current % width;
+        int y = grid.OriginY() + current / width;
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                if (!dx && !dy) continue;
+                if (!passable(x + dx, y + dy)) continue;
+                if (dx && dy && (!passable(x + dx, y) || !passable(x, y + dy))) continue;
+                int next = current + dy * width + dx;
+                double nextD = d + (dx && dy ? kDiagonalCost : 1.0);
+                if (nextD >= distance[next]) continue;
+                distance[next] = nextD;
+                open.emplace(nextD, next);
+            }
+        }
+    }
+    return distance;
+}
+
+int Pathfinder::Cluster::NodeIndex(Tile tile) const {
+    auto found = std::find(nodes.begin(), nodes.end(), tile);
+    return found != nodes.end() ? static_cast<int>(found - nodes.begin()) : -1;
+}
+
+void Pathfinder::SetClusterChunks(int chunks) {
+    clusterChunks_ = std::max(1, chunks);
+    Invalidate();
+}
+
+void Pathfinder::OnChunkChanged(int cx, int cy) {
+    // 出入口は隣のクラスタと共有するので、縦横の隣も作り直す
+    int kx = FloorDiv(cx, clusterChunks_);
+    int ky = FloorDiv(cy, clusterChunks_);
+    const Tile keys[] = { { kx, ky }, { kx - 1, ky }, { kx + 1, ky }, { kx, ky - 1 }, { kx, ky + 1 } };
+    for (Graph& graph : graphs_) {
+        for (const Tile& key : keys) graph.erase(key);
+    }
+}
+
+void Pathfinder::Invalidate() {
+    for (Graph& graph : graphs_) graph.clear();
+}
+
+Tile Pathfinder::ClusterOf(int x, int y) const {
+    int size = ClusterTiles();
+    return { FloorDiv(x, size), FloorDiv(y, size) };
+}
+
+const Pathfinder::Cluster& Pathfinder::GetCluster(Graph& graph, Tile key, UnloadedTiles unloaded) {
+    auto [it, inserted] = graph.try_emplace(key);
+    if (inserted) {
+        BuildCluster(it->second, key, unloaded);
+        ++builtClusters_;
+    }
+    return it->second;
+}
+
+void Pathfinder::BuildCluster(Cluster& cluster, Tile key, UnloadedTiles unloaded) const {
+    int size = ClusterTiles();
+    int x0 = key.first * size;
+    int y0 = key.second * size;
+    cluster.grid = PathGrid(map_, x0, y0, size, size, unloaded);
+    // 出入口を探すため、外周の1タイルも含めて読む
+    PathGrid ring(map_, x0 - 1, y0 - 1, size + 2, size + 2, unloaded);
+
+    auto addTransition = [&](Tile inside, Tile outside) {
+        int index = cluster.NodeIndex(inside);
+        if (index < 0) {
+            index = static_cast<int>(cluster.nodes.size());
+            cluster.nodes.push_back(inside);
+            cluster.crossings.emplace_back();
+        }
+        cluster.crossings[index].push_back(outside);
+    };
+    // 各辺で、内側と外側の両方が通れるタイルの並びを出入口にする
+    // 隣のクラスタも同じタイルの組を同じ順に調べるので、両側の出入口は必ず一致する
+    struct Side {
+        int x, y;       // 辺の最初の内側のタイル
+        int stepX, stepY;
+        int outX, outY; // 外側への向き
+    };
+    const Side sides[] = {
+        { x0, y0, 0, 1, -1, 0 },
+        { x0 + size - 1, y0, 0, 1, 1, 0 },
+        { x0, y0, 1, 0, 0, -1 },
+        { x0, y0 + size - 1, 1, 0, 0, 1 },
+    };
+    for (const Side& side : sides) {
+        int runStart = -1;
+        for (int t = 0; t <= size; ++t) {
+            int x = side.x + side.stepX * t;
+            int y = side.y + side.stepY * t;
+            bool open = t < size && !ring.Blocked(x, y) && !ring.Blocked(x + side.outX, y + side.outY);
+            if (open && runStart < 0) runStart = t;
+            if (open || runStart < 0) continue;
+            int runEnd = t - 1;
+            auto add = [&](int at) {
+                Tile inside{ side.x + side.stepX * at, side.y + side.stepY * at };
+                addTransition(inside, { inside.first + side.outX, inside.second + side.outY });
+            };
+            if (runEnd - runStart + 1 >= kSplitEntranceLength) {
+                add(runStart);
+                add(runEnd);
+            } else {
+                add((runStart + runEnd) / 2);
+            }
+            runStart = -1;
+        }
+    }
+
+    // 出入口どうしのクラスタ内の距離
+    cluster.edges.assign(cluster.nodes.size(), {});
+    for (size_t i = 0; i < cluster.nodes.size(); ++i) {
+        std::vector<double> distance = DistanceField(cluster.grid, cluster.nodes[i]);
+        for (size_t j = i + 1; j < cluster.nodes.size(); ++j) {
+            Tile node = cluster.nodes[j];
+            double d = distance[static_cast<size_t>((node.second - y0) * size + (node.first - x0))];
+            if (d == kUnreached) continue;
+            cluster.edges[i].emplace_back(static_cast<int>(j), d);
+            cluster.edges[j].emplace_back(static_cast<int>(i), d);
+        }
+    }
+}
+
+PathResult Pathfinder::FindPathDirect(int startX, int startY, int goalX, int goalY, UnloadedTiles unloaded, int margin) const {
+    PathResult result;
+    int left = std::min(startX, goalX) - margin;
+    int top = std::min(startY, goalY) - margin;
+    PathGrid grid(map_, left, top, std::abs(goalX - startX) + 1 + margin * 2, std::abs(goalY - startY) + 1 + margin * 2, unloaded);
+    result.found = SearchGrid(grid, { startX, startY }, { goalX, goalY }, result.tiles, result.cost, result.expanded);
+    CollectUnloadedChunks(result);
+    return result;
+}
+
+PathResult Pathfinder::FindPath(int startX, int startY, int goalX, int goalY, UnloadedTiles unloaded) {
+    // 近ければ2点を囲む範囲の JPS だけで済ませる（範囲の外を回り込む経路は抽象グラフで探す）
+    int size = ClusterTiles();
+    size_t directExpanded = 0;
+    if (std::max(std::abs(goalX - startX), std::abs(goalY - startY)) <= size * 2) {
+        PathResult direct = FindPathDirect(startX, startY, goalX, goalY, unloaded, size);
+        if (direct.found) return direct;
+        directExpanded = direct.expanded;
+    }
+    PathResult result = FindPathAbstract({ startX, startY }, { goalX, goalY }, unloaded);
+    result.expanded += directExpanded;
+    CollectUnloadedChunks(result);
+    return result;
+}
+
+PathResult Pathfinder::FindPathAbstract(Tile start, Tile goal, UnloadedTiles unloaded) {
+    PathResult result;
+    Graph& graph = graphs_[static_cast<int>(unloaded)];
+    Tile startKey = ClusterOf(start.first, start.second);
+    Tile goalKey = ClusterOf(goal.first, goal.second);
+    const Cluster& startCluster = GetCluster(graph, startKey, unloaded);
+    const Cluster& goalCluster = GetCluster(graph, goalKey, unloaded);
+    if (startCluster.grid.Blocked(start.first, start.second) || goalCluster.grid.Blocked(goal.first, goal.second)) return result;
+
+    // 始点と終点から、それぞれのクラスタの出入口までの距離
+    std::vector<double> fromStart = DistanceField(startCluster.grid, start);
+    std::vector<double> toGoal = DistanceField(goalCluster.grid, goal);
+    auto fieldAt = [](const Cluster& cluster, const std::vector<double>& field, Tile tile) {
+        const PathGrid& grid = cluster.grid;
+        return field[static_cast<size_t>((tile.second - grid.OriginY()) * grid.Width() + (tile.first - grid.OriginX()))];
+    };
+
+    // 抽象グラフの A*。始点と終点は出入口と重なっても区別できるよう、タイルにない座標をキーにする
+    const Tile startNode{ INT_MIN, 0 };
+    const Tile goalNode{ INT_MIN, 1 };
+    auto position = [&](Tile node) { return node == startNode ? start : node == goalNode ? goal : node; };
+    struct Visit {
+        double g = kUnreached;
+        Tile parent;
+        bool closed = false;
+    };
+    std::unordered_map<Tile, Visit, PairHash> visits;
+    std::priority_queue<std::pair<double, Tile>, std::vector<std::pair<double, Tile>>, std::greater<>> open;
+    visits[startNode].g = 0.0;
+    open.emplace(Octile(start, goal), startNode);
+    auto relax = [&](Tile from, Tile to, double step) {
+        double g = visits[from].g + step;
+        Visit& visit = visits[to];
+        if (visit.closed || g >= visit.g) return;
+        visit.g = g;
+        visit.parent = from;
+        open.emplace(g + Octile(position(to), goal), to);
+    };
+
+    bool reached = false;
+    while (!open.empty() && result.expanded < maxAbstractExpansions_) {
+        Tile node = open.top().second;
+        open.pop();
+        Visit& visit = visits[node];
+        if (visit.closed) continue;
+        visit.closed = true;
+        ++result.expanded;
+        if (node == goalNode) {
+            reached = true;
+            break;
+        }
+        if (node == startNode) {
+            for (Tile entrance : startCluster.nodes) {
+                double d = fieldAt(startCluster, fromStart, entrance);
+                if (d != kUnreached) relax(startNode, entrance, d);
+            }
+            if (startKey == goalKey && fieldAt(startCluster, fromStart, goal) != kUnreached) {
+                relax(startNode, goalNode, fieldAt(startCluster, fromStart, goal));
+            }
+            continue;
+        }
+        Tile key = ClusterOf(node.first, node.second);
+        const Cluster& cluster = GetCluster(graph, key, unloaded);
+        int index = cluster.NodeIndex(node);
+        if (index < 0) continue;
+        for (const auto& [other, d] : cluster.edges[index]) relax(node, cluster.nodes[other], d);
+        for (Tile crossing : cluster.crossings[index]) relax(node, crossing, 1.0);
+        if (key == goalKey && fieldAt(goalCluster, toGoal, node) != kUnreached) {
+            relax(node, goalNode, fieldAt(goalCluster, toGoal, node));
+        }
+    }
+    if (!reached) return result;
+
+    std::vector<Tile> waypoints;
+    for (Tile node = goalNode; node != startNode; node = visits[node].parent) waypoints.push_back(position(node));
+    waypoints.push_back(start);
+    std::reverse(waypoints.begin(), waypoints.end());
+
+    // 出入口の間をクラスタ内の JPS で1タイルずつにする（クラスタをまたぐ所は隣のタイルへ1歩）
+    result.tiles.push_back(start);
+    std::vector<Tile> segment;
+    for (size_t i = 1; i < waypoints.size(); ++i) {
+        Tile from = waypoints[i - 1];
+        Tile to = waypoints[i];
+        Tile key = ClusterOf(from.first, from.second);
+        if (key != ClusterOf(to.first, to.second)) {
+            result.tiles.push_back(to);
+            result.cost += 1.0;
+            continue;
+        }
+        double cost = 0.0;
+        if (!SearchGrid(GetCluster(graph, key, unloaded).grid, from, to, segment, cost, result.expanded)) {
+            result.tiles.clear();
+            result.cost = 0.0;
+            return result;
+        }
+        result.tiles.insert(result.tiles.end(), segment.begin() + 1, segment.end());
+        result.cost += cost;
+    }
+    result.found = true;
+    return result;
+}
+
+void Pathfinder::CollectUnloadedChunks(PathResult& result) const {
+    std::unordered_set<Tile, PairHash> seen;
+    for (const Tile& tile : result.tiles) {
+        Tile chunk{ FloorDiv(tile.first, ChunkTiles::kWidth), FloorDiv(tile.second, ChunkTiles::kHeight) };
+        if (!map_.IsChunkLoaded(chunk.first, chunk.second) && seen.insert(chunk).second) result.unloadedChunks.push_back(chunk);
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "TileCollision.h"
+
+// 経路探索で、読み込みの終わっていないチャンクをどう扱うか
+enum class UnloadedTiles {
+    Blocked, // 通れない（読み込み済みの範囲だけで探す）
+    Open,    // 通れるとみなして探し、経路が通る読み込み前のチャンクを返す（読み込み後に探し直す）
+};
+
+// 経路（8方向に1タイルずつ。斜めは両側の縦横が通れるときだけ）
+struct PathResult {
+    bool found = false;
+    std::vector<std::pair<int, int>> tiles; // 始点から終点まで（両端を含む）
+    double cost = 0.0;                      // 縦横 1、斜め √2
+    std::vector<std::pair<int, int>> unloadedChunks; // UnloadedTiles::Open のとき、経路が通る読み込み前のチャンク
+    size_t expanded = 0;                    // 展開したノード数（タイルと抽象グラフの合計）
+};
+
+// 矩形範囲の通れないタイルのビット（CollisionMap からの写し。範囲外は通れない）
+class PathGrid {
+public:
+    PathGrid() = default;
+    PathGrid(const CollisionMap& map, int originX, int originY, int width, int height, UnloadedTiles unloaded);
+
+    int OriginX() const { return originX_; }
+    int OriginY() const { return originY_; }
+    int Width() const { return width_; }
+    int Height() const { return height_; }
+    bool Contains(int x, int y) const {
+        return x >= originX_ && y >= originY_ && x < originX_ + width_ && y < originY_ + height_;
+    }
+    bool Blocked(int x, int y) const { return Bits(x, y) & 1; }
+    // 行 y の列 [x, x + 64) のビット（ビット 0 が x）
+    uint64_t Bits(int x, int y) const;
+
+private:
+    uint64_t Word(int row, int index) const;
+
+    int originX_ = 0;
+    int originY_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    int wordsPerRow_ = 0;
+    std::vector<uint64_t> words_;
+};
+
+// CollisionMap の Solid ビットの上で経路を探す（NPC 用）
+// 近い2点は範囲を区切った JPS（跳躍点探索）で、遠い2点は HPA*（クラスタ単位の抽象グラフ）で探す
+// クラスタは探索で必要になったときに作り、チャンクが変わるとそのクラスタと隣だけを作り直す
+class Pathfinder {
+public:
+    explicit Pathfinder(const CollisionMap& map) : map_(map) {}
+
+    // クラスタの大きさ（チャンク数）。変えると抽象グラフを作り直す
+    void SetClusterChunks(int chunks);
+    // 抽象グラフで展開するノード数の上限（読み込み前を通れるとみなすと、外側の空白へ広がり続けるため）
+    void SetMaxAbstractExpansions(size_t count) { maxAbstractExpansions_ = count; }
+    // チャンクが読み込まれた・解放された・書き換わった
+    void OnChunkChanged(int cx, int cy);
+    void Invalidate();
+
+    PathResult FindPath(int startX, int startY, int goalX, int goalY, UnloadedTiles unloaded);
+    // 抽象グラフを使わず、2点を囲む範囲（margin タイル広げる）だけで JPS を行う
+    PathResult FindPathDirect(int startX, int startY, int goalX, int goalY, UnloadedTiles unloaded, int margin) const;
+
+    size_t ClusterCount(UnloadedTiles unloaded) const { return graphs_[static_cast<int>(unloaded)].size(); }
+    size_t BuiltClusters() const { return builtClusters_; }
+    int ClusterTiles() const { return clusterChunks_ * ChunkTiles::kWidth; }
+
+    // 範囲内の JPS（grid の外には出ない）。見つからなければ false
+    static bool SearchGrid(const PathGrid& grid, std::pair<int, int> start, std::pair<int, int> goal,
+        std::vector<std::pair<int, int>>& tiles, double& cost, size_t& expanded);
+
+private:
+    // クラスタ: 隣のクラスタとの出入口のタイルと、その間の距離
+    struct Cluster {
+        PathGrid grid; // クラスタの内側
+        std::vector<std::pair<int, int>> nodes;
+        std::vector<std::vector<std::pair<int, double>>> edges;      // 同じクラスタの出入口への距離
+        std::vector<std::vector<std::pair<int, int>>> crossings;     // 隣のクラスタの出入口（距離 1）
+        int NodeIndex(std::pair<int, int> tile) const;
+    };
+    using Graph = std::unordered_map<std::pair<int, int>, Cluster, PairHash>;
+
+    std::pair<int, int> ClusterOf(int x, int y) const;
+    const Cluster& GetCluster(Graph& graph, std::pair<int, int> key, UnloadedTiles unloaded);
+    void BuildCluster(Cluster& cluster, std::pair<int, int> key, UnloadedTiles unloaded) const;
+    PathResult FindPathAbstract(std::pair<int, int> start, std::pair<int, int> goal, UnloadedTiles unloaded);
+    void CollectUnloadedChunks(PathResult& result) const;
+
+    // 範囲内のダイクストラ（from からの距離。届かないタイルは無限大）
+    static std::vector<double> DistanceField(const PathGrid& grid, std::pair<int, int> from);
+
+    const CollisionMap& map_;
+    int clusterChunks_ = 4;
+    size_t maxAbstractExpansions_ = 200000;
+    std::array<Graph, 2> graphs_; // UnloadedTiles ごと
+    size_t builtClusters_ = 0;
+
+    // 出入口の列がこの長さ以上なら両端に、短ければ中央に1つ置く
+    static constexpr int kSplitEntranceLength = 6;
+};
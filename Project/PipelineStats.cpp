@@ -0,0 +1,131 @@
+#include "PipelineStats.h"
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <fstream>
+#if defined(_DEBUG) && !defined(HEADLESS)
+#include <imgui.h>
+#endif
+
+void LatencyHistogram::Record(double ms) {
+    uint64_t us = ms > 0.0 ? static_cast<uint64_t>(ms * 1000.0) : 0;
+    int index = std::min(static_cast<int>(std::bit_width(us)), kBuckets - 1);
+    buckets_[index].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sumUs_.fetch_add(us, std::memory_order_relaxed);
+    uint64_t max = maxUs_.load(std::memory_order_relaxed);
+    while (us > max && !maxUs_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+double LatencyHistogram::MeanMs() const {
+    uint64_t count = Count();
+    if (count == 0) return 0.0;
+    return static_cast<double>(sumUs_.load(std::memory_order_relaxed)) / 1000.0 / static_cast<double>(count);
+}
+
+double LatencyHistogram::BucketUpperMs(int index) {
+    return static_cast<double>(uint64_t{ 1 } << index) / 1000.0;
+}
+
+double LatencyHistogram::PercentileMs(double p) const {
+    uint64_t count = Count();
+    if (count == 0) return 0.0;
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets - 1; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        // 記録途中の読み取りでは合計がずれるので、最大値を超えないようにする
+        if (seen > rank) return std::min(BucketUpperMs(i), MaxMs());
+    }
+    return MaxMs();
+}
+
+nlohmann::json LatencyHistogram::ToJson() const {
+    nlohmann::json buckets = nlohmann::json::array();
+    for (int i = 0; i < kBuckets; ++i) {
+        uint64_t n = buckets_[i].load(std::memory_order_relaxed);
+        if (n == 0) continue;
+        buckets.push_back({ { "le_ms", i == kBuckets - 1 ? -1.0 : BucketUpperMs(i) }, { "count", n } });
+    }
+    return {
+        { "count", Count() },
+        { "mean_ms", MeanMs() },
+        { "p50_ms", PercentileMs(0.50) },
+        { "p95_ms", PercentileMs(0.95) },
+        { "p99_ms", PercentileMs(0.99) },
+        { "max_ms", MaxMs() },
+        { "buckets", buckets },
+    };
+}
+
+double PipelineStats::CacheHitRatio() const {
+    uint64_t hits = cacheHits_.load(std::memory_order_relaxed);
+    uint64_t total = hits + cacheMisses_.load(std::memory_order_relaxed);
+    return total ? static_cast<double>(hits) / static_cast<double>(total) : 0.0;
+}
+
+const char* PipelineStats::StageName(PipelineStage stage) {
+    static const char* const kNames[] = {
+        "queue_wait", "dns", "connect", "tls", "ttfb", "transfer",
+        "parse", "cache_read", "cache_write", "integrate",
+    };
+    static_assert(std::size(kNames) == static_cast<size_t>(PipelineStage::Count));
+    return kNames[static_cast<int>(stage)];
+}
+
+nlohmann::json PipelineStats::ToJson() const {
+    nlohmann::json stages = nlohmann::json::object();
+    for (int i = 0; i < static_cast<int>(PipelineStage::Count); ++i) {
+        stages[StageName(static_cast<PipelineStage>(i))] = histograms_[i].ToJson();
+    }
+    return {
+        { "stages", stages },
+        { "cache_hits", cacheHits_.load(std::memory_order_relaxed) },
+        { "cache_misses", cacheMisses_.load(std::memory_order_relaxed) },
+        { "cache_hit_ratio", CacheHitRatio() },
+        { "bytes_received", bytesReceived_.load(std::memory_order_relaxed) },
+        { "in_flight", inFlight_.load(std::memory_order_relaxed) },
+        { "resident_bytes", residentBytes_.load(std::memory_order_relaxed) },
+    };
+}
+
+bool PipelineStats::SaveJson(const std::filesystem::path& path) const {
+    std::ofstream ofs(path);
+    if (!ofs) return false;
+    ofs << ToJson().dump(2);
+    return static_cast<bool>(ofs);
+}
+
+void PipelineStats::DrawOverlay() const {
+#if defined(_DEBUG) && !defined(HEADLESS)
+    ImGui::Begin("Chunk Pipeline");
+    ImGui::Text("cache hit %.1f%% (%llu / %llu)", CacheHitRatio() * 100.0,
+        static_cast<unsigned long long>(cacheHits_.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(cacheHits_.load(std::memory_order_relaxed) + cacheMisses_.load(std::memory_order_relaxed)));
+    ImGui::Text("in flight %d  received %.1f KB  resident %.1f KB", inFlight_.load(std::memory_order_relaxed),
+        static_cast<double>(bytesReceived_.load(std::memory_order_relaxed)) / 1024.0,
+        static_cast<double>(residentBytes_.load(std::memory_order_relaxed)) / 1024.0);
+    if (ImGui::BeginTable("stages", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("stage");
+        ImGui::TableSetupColumn("count");
+        ImGui::TableSetupColumn("mean ms");
+        ImGui::TableSetupColumn("p50 ms");
+        ImGui::TableSetupColumn("p99 ms");
+        ImGui::TableSetupColumn("max ms");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < static_cast<int>(PipelineStage::Count); ++i) {
+            const LatencyHistogram& h = histograms_[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(StageName(static_cast<PipelineStage>(i)));
+            ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(h.Count()));
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", h.MeanMs());
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", h.PercentileMs(0.50));
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", h.PercentileMs(0.99));
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", h.MaxMs());
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+#endif
+}
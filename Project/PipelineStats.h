@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+
+// 読み込みパイプラインの計測区間
+enum class PipelineStage : int {
+    QueueWait,  // クォータ待ち（RequestScheduler::Acquire）
+    NameLookup, // 名前解決（新規接続のみ）
+    Connect,    // TCP接続（新規接続のみ）
+    Tls,        // TLSハンドシェイク（新規接続のみ）
+    FirstByte,  // 転送開始から最初のバイトまで（TTFB）
+    Transfer,   // 転送全体
+    Parse,      // レスポンスの解析（SheetValuesParser::Feed の合計）
+    CacheRead,  // キャッシュファイルの読み込み＋デコード
+    CacheWrite, // キャッシュファイルのエンコード＋書き込み
+    Integrate,  // 読み込み結果をチャンクへ反映
+    Count,
+};
+
+// 2のべき乗（マイクロ秒）で区切ったヒストグラム。Record はロックなしで複数スレッドから呼べる
+class LatencyHistogram {
+public:
+    void Record(double ms);
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    double MeanMs() const;
+    double MaxMs() const { return static_cast<double>(maxUs_.load(std::memory_order_relaxed)) / 1000.0; }
+    // p が入るバケットの上端（ミリ秒）
+    double PercentileMs(double p) const;
+
+    nlohmann::json ToJson() const;
+
+private:
+    // バケットi: [2^(i-1), 2^i) マイクロ秒（0は1マイクロ秒未満）。最後のバケットは上限なし
+    static constexpr int kBuckets = 32;
+    static double BucketUpperMs(int index);
+
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t> count_ = 0;
+    std::atomic<uint64_t> sumUs_ = 0;
+    std::atomic<uint64_t> maxUs_ = 0;
+};
+
+// チャンク読み込みの統計（区間ごとの時間、キャッシュヒット率、受信量、転送中の数、常駐メモリ）
+class PipelineStats {
+public:
+    void Record(PipelineStage stage, double ms) { histograms_[static_cast<int>(stage)].Record(ms); }
+    const LatencyHistogram& Histogram(PipelineStage stage) const { return histograms_[static_cast<int>(stage)]; }
+
+    void AddCacheHit() { cacheHits_.fetch_add(1, std::memory_order_relaxed); }
+    void AddCacheMiss() { cacheMisses_.fetch_add(1, std::memory_order_relaxed); }
+    void AddBytesReceived(uint64_t bytes) { bytesReceived_.fetch_add(bytes, std::memory_order_relaxed); }
+    void BeginTransfer() { inFlight_.fetch_add(1, std::memory_order_relaxed); }
+    void EndTransfer() { inFlight_.fetch_sub(1, std::memory_order_relaxed); }
+    void SetResidentBytes(uint64_t bytes) { residentBytes_.store(bytes, std::memory_order_relaxed); }
+
+    // キャッシュから読めたチャンクの割合（0〜1）
+    double CacheHitRatio() const;
+
+    nlohmann::json ToJson() const;
+    // 実行ごとに比較できるようJSONで書き出す
+    bool SaveJson(const std::filesystem::path& path) const;
+    // ImGui のオーバーレイ（Debug ビルドのみ）
+    void DrawOverlay() const;
+
+    static const char* StageName(PipelineStage stage);
+
+private:
+    std::array<LatencyHistogram, static_cast<int>(PipelineStage::Count)> histograms_;
+    std::atomic<uint64_t> cacheHits_ = 0;
+    std::atomic<uint64_t> cacheMisses_ = 0;
+    std::atomic<uint64_t> bytesReceived_ = 0;
+    std::atomic<int> inFlight_ = 0;
+    std::atomic<uint64_t> residentBytes_ = 0;
+};
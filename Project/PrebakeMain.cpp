@@ -0,0 +1,195 @@
+#include "ChunkLoader.h"
+#include "WorldPack.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// シート全体をワールドファイル（.trwp）に焼くツール（コンソールアプリ）
+// 書きかけは <出力>.part に残り、同じコマンドをもう一度実行すると続きから取得する
+//   Prebake --key APIキー [--out world.trwp] [--jobs 8] [--spreadsheet ID] [--sheet シート名]
+//           [--upstream Sheets APIのURL] [--revision-url URL] [--rate 5] [--burst 30]
+//           [--columns 列数 --rows 行数]（指定しなければシートのグリッドの大きさを問い合わせる）
+
+namespace {
+
+std::atomic<bool> gStop = false;
+
+void OnSignal(int) {
+    gStop = true;
+}
+
+template <typename T>
+bool ParseNumber(const std::string& text, T& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string spreadsheetId = "1fL9it6HK4IsAzmViTchDWWG5koE7nbxEfSYKjx6VFM8";
+    std::string sheetName = "TR1_02";
+    std::string apiKey;
+    std::string cacheDir = "cache";
+    std::string upstream;
+    std::string revisionUrl;
+    std::filesystem::path outPath = "world.trwp";
+    int jobs = 8;
+    double rate = 0.0;
+    double burst = 0.0;
+    SheetSize size;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return 2;
+        }
+        std::string value = argv[++i];
+        bool ok = true;
+        if (arg == "--out") outPath = value;
+        else if (arg == "--jobs") ok = ParseNumber(value, jobs) && jobs > 0;
+        else if (arg == "--cache") cacheDir = value;
+        else if (arg == "--spreadsheet") spreadsheetId = value;
+        else if (arg == "--sheet") sheetName = value;
+        else if (arg == "--key") apiKey = value;
+        else if (arg == "--upstream") upstream = value;
+        else if (arg == "--revision-url") revisionUrl = value;
+        else if (arg == "--rate") ok = ParseNumber(value, rate);
+        else if (arg == "--burst") ok = ParseNumber(value, burst);
+        else if (arg == "--columns") ok = ParseNumber(value, size.columns);
+        else if (arg == "--rows") ok = ParseNumber(value, size.rows);
+        else ok = false;
+        if (!ok) {
+            std::fprintf(stderr, "bad argument: %s %s\n", arg.c_str(), value.c_str());
+            return 2;
+        }
+    }
+
+    ChunkLoader loader(spreadsheetId, sheetName, apiKey, cacheDir);
+    if (!upstream.empty()) loader.SetApiBaseUrl(upstream);
+    if (!revisionUrl.empty()) loader.SetRevisionUrl(revisionUrl);
+    if (rate > 0.0) loader.SetRequestQuota(rate, burst > 0.0 ? burst : rate);
+    // HTTP/2 なら1本に多重化されるが、HTTP/1.1 の接続先（ゲートウェイなど）でも --jobs 本を同時に流す
+    loader.SetMaxHostConnections(jobs);
+    loader.Initialize();
+    if (!loader.RefreshRevision()) std::fprintf(stderr, "warning: cannot check the sheet revision\n");
+    std::string revision = loader.GetSheetRevision();
+
+    if (size.columns <= 0 || size.rows <= 0) {
+        std::optional<SheetSize> fetched = loader.FetchSheetSize();
+        if (!fetched) {
+            std::fprintf(stderr, "cannot get the size of sheet %s (use --columns and --rows)\n", sheetName.c_str());
+            return 1;
+        }
+        size = *fetched;
+    }
+    int chunkColumns = (size.columns + ChunkLoader::kChunkWidth - 1) / ChunkLoader::kChunkWidth;
+    int chunkRows = (size.rows + ChunkLoader::kChunkHeight - 1) / ChunkLoader::kChunkHeight;
+
+    // 同じリビジョンの書きかけがあれば続きから。リビジョンが変わっていたら最初から
+    std::filesystem::path partPath = outPath;
+    partPath += ".part";
+    WorldPackWriter writer;
+    bool resumed = std::filesystem::exists(partPath) && writer.Resume(partPath, revision);
+    if (!resumed && !writer.Create(partPath, revision)) {
+        std::fprintf(stderr, "cannot write %s\n", partPath.string().c_str());
+        return 1;
+    }
+
+    std::vector<std::pair<int, int>> pending;
+    for (int cy = 0; cy < chunkRows; ++cy) {
+        for (int cx = 0; cx < chunkColumns; ++cx) {
+            if (!writer.Contains(cx, cy)) pending.emplace_back(cx, cy);
+        }
+    }
+    size_t total = static_cast<size_t>(chunkColumns) * static_cast<size_t>(chunkRows);
+    std::printf("sheet %s: %dx%d cells, %zu chunks, revision %s\n",
+        sheetName.c_str(), size.columns, size.rows, total, revision.empty() ? "(unknown)" : revision.c_str());
+    if (resumed) std::printf("resuming %s: %zu chunks already done\n", partPath.string().c_str(), total - pending.size());
+
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+
+    // 各スレッドが1チャンクずつ取得する（転送は ChunkLoader の multi ハンドルで並行に進む）
+    std::atomic<size_t> next = 0;
+    std::atomic<size_t> done = 0;
+    std::atomic<size_t> failed = 0;
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < std::min<int>(jobs, static_cast<int>(pending.size())); ++i) {
+        workers.emplace_back([&]() {
+            for (size_t n = next++; n < pending.size() && !gStop; n = next++) {
+                auto [cx, cy] = pending[n];
+                std::optional<TileData> data = loader.LoadFromSheet(cx, cy, std::make_shared<LoadTicket>());
+                if (!data) {
+                    ++failed;
+                    continue;
+                }
+                ChunkTiles tiles;
+                tiles.Assign(*data);
+                if (!writer.Append(cx, cy, tiles)) {
+                    ++failed;
+                    continue;
+                }
+                ++done;
+            }
+        });
+    }
+
+    // 1秒ごとに進み具合と速度を表示する
+    auto lastReport = start;
+    while (done + failed < pending.size() && !gStop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (SecondsSince(lastReport) < 1.0) continue;
+        lastReport = std::chrono::steady_clock::now();
+        double elapsed = SecondsSince(start);
+        double perSec = static_cast<double>(done) / elapsed;
+        double remaining = perSec > 0.0 ? static_cast<double>(pending.size() - done - failed) / perSec : 0.0;
+        std::printf("%zu/%zu chunks  %.1f chunks/s  %.1f KB/s  eta %.0fs  failed %zu\n",
+            total - pending.size() + done, total, perSec,
+            static_cast<double>(loader.GetHttpStats().bytesReceived) / 1024.0 / elapsed, remaining, failed.load());
+        std::fflush(stdout);
+    }
+    // 中断されたら順番待ちの取得を打ち切る（転送中のものは書き終えてから止まる）
+    if (gStop) loader.Shutdown();
+    for (std::thread& worker : workers) worker.join();
+
+    double elapsed = SecondsSince(start);
+    HttpStats stats = loader.GetHttpStats();
+    std::printf("fetched %zu chunks in %.1fs (%.1f chunks/s, %.1f KB/s, %llu requests, %llu connections)\n",
+        done.load(), elapsed, elapsed > 0.0 ? static_cast<double>(done) / elapsed : 0.0,
+        elapsed > 0.0 ? static_cast<double>(stats.bytesReceived) / 1024.0 / elapsed : 0.0,
+        static_cast<unsigned long long>(stats.transfers), static_cast<unsigned long long>(stats.newConnections));
+
+    if (gStop || writer.Count() < total) {
+        std::fprintf(stderr, "%zu chunks missing (%zu failed); run again to resume from %s\n",
+            total - writer.Count(), failed.load(), partPath.string().c_str());
+        return 1;
+    }
+    if (!writer.Finish()) {
+        std::fprintf(stderr, "cannot finish %s\n", partPath.string().c_str());
+        return 1;
+    }
+    // 索引まで書き終えてから本来の名前にする（ゲームが書きかけを読まないように）
+    std::error_code ec;
+    std::filesystem::rename(partPath, outPath, ec);
+    if (ec) {
+        std::fprintf(stderr, "cannot rename %s to %s\n", partPath.string().c_str(), outPath.string().c_str());
+        return 1;
+    }
+    std::printf("wrote %s (%zu chunks, %llu bytes)\n", outPath.string().c_str(), total,
+        static_cast<unsigned long long>(std::filesystem::file_size(outPath, ec)));
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "RequestScheduler.h"
+#include <algorithm>
+
+RequestScheduler::RequestScheduler(double ratePerSec, double burst)
+    : ratePerSec_(ratePerSec)
+    , burst_(burst)
+    , tokens_(burst)
+    , lastRefill_(Clock::now())
+    , pausedUntil_(Clock::now()) {
+}
+
+RequestScheduler::~RequestScheduler() {
+    Shutdown();
+}
+
+bool RequestScheduler::Acquire(const std::shared_ptr<LoadTicket>& ticket) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiters_.push_back({ ticket.get(), nextOrder_++ });
+    bool acquired = false;
+    while (!shutdown_ && !ticket->cancelled) {
+        Clock::time_point now = Clock::now();
+        Refill(now);
+        if (now >= pausedUntil_ && tokens_ >= 1.0 && IsFirstInLine(ticket.get())) {
+            tokens_ -= 1.0;
+            acquired = true;
+            break;
+        }
+        // 次のトークンが溜まる時刻まで待つ（優先度変更・取り消しで起こされる）
+        Clock::time_point wake = std::max(pausedUntil_, now);
+        if (tokens_ < 1.0 && ratePerSec_ > 0.0) {
+            wake = std::max(wake, now + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((1.0 - tokens_) / ratePerSec_)));
+        }
+        if (wake <= now) wake = now + std::chrono::milliseconds(100);
+        cv_.wait_until(lock, wake);
+    }
+    waiters_.erase(std::find_if(waiters_.begin(), waiters_.end(),
+        [&ticket](const Waiter& w) { return w.ticket == ticket.get(); }));
+    // 次の待機者に順番が回る
+    cv_.notify_all();
+    return acquired;
+}
+
+bool RequestScheduler::TryAcquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Clock::time_point now = Clock::now();
+    Refill(now);
+    // 順番待ちの要求がある間は割り込まない
+    if (shutdown_ || now < pausedUntil_ || tokens_ < 1.0 || !waiters_.empty()) return false;
+    tokens_ -= 1.0;
+    return true;
+}
+
+bool RequestScheduler::Wait(const std::shared_ptr<LoadTicket>& ticket, std::chrono::milliseconds delay) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Clock::time_point until = Clock::now() + delay;
+    cv_.wait_until(lock, until, [this, &ticket, until] {
+        return shutdown_ || ticket->cancelled || Clock::now() >= until;
+    });
+    return !shutdown_ && !ticket->cancelled;
+}
+
+void RequestScheduler::PauseFor(std::chrono::milliseconds delay) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pausedUntil_ = std::max(pausedUntil_, Clock::now() + delay);
+    // 止めている間にトークンが溜まり込まないようにする
+    tokens_ = std::min(tokens_, 1.0);
+}
+
+void RequestScheduler::Notify() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cv_.notify_all();
+}
+
+void RequestScheduler::Shutdown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+    cv_.notify_all();
+}
+
+void RequestScheduler::SetRate(double ratePerSec, double burst) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Refill(Clock::now());
+    ratePerSec_ = ratePerSec;
+    burst_ = burst;
+    tokens_ = std::min(tokens_, burst_);
+    cv_.notify_all();
+}
+
+std::chrono::milliseconds RequestScheduler::BackoffDelay(int attempt) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t limit = std::min<int64_t>(kBackoffMaxMs, int64_t(kBackoffBaseMs) << std::min(attempt, 16));
+    std::uniform_int_distribution<int64_t> dist(0, limit);
+    return std::chrono::milliseconds(dist(rng_));
+}
+
+void RequestScheduler::Refill(Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - lastRefill_).count();
+    lastRefill_ = now;
+    if (now < pausedUntil_) return;
+    tokens_ = std::min(burst_, tokens_ + elapsed * ratePerSec_);
+}
+
+bool RequestScheduler::IsFirstInLine(const LoadTicket* ticket) const {
+    // 優先度→到着順で最も前にいる待機者か
+    const Waiter* best = nullptr;
+    int bestPriority = 0;
+    for (const Waiter& w : waiters_) {
+        if (w.ticket->cancelled) continue;
+        int priority = w.ticket->priority;
+        if (!best || priority < bestPriority || (priority == bestPriority && w.order < best->order)) {
+            best = &w;
+            bestPriority = priority;
+        }
+    }
+    return best && best->ticket == ticket;
+}
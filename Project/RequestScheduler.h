@@ -0,0 +1,76 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <memory>
+
+// 読み込み要求の優先度（値が小さいほど優先）
+enum class LoadPriority : int {
+    Visible = 0,    // 表示範囲内
+    Prefetch = 1,   // 先読み
+    Background = 2, // 優先度の低い関心領域（ミニマップなど）の表示範囲
+    Overview = 3,   // 縮小表示で見えている、常駐範囲の外のチャンク（縮小地図の値だけを使う）
+};
+
+// 1件の読み込み要求。優先度の変更と取り消しを待機中のスレッドへ伝える
+struct LoadTicket {
+    std::atomic<int> priority = static_cast<int>(LoadPriority::Visible);
+    std::atomic<bool> cancelled = false;
+};
+
+// Sheets API の読み取りクォータに合わせたトークンバケット式のスケジューラ
+// トークンが足りないときは優先度の高い要求から順に通す
+class RequestScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // ratePerSec: 1秒あたりの補充数、burst: バケット容量
+    RequestScheduler(double ratePerSec, double burst);
+    ~RequestScheduler();
+
+    // トークンを1つ取得するまで待つ。取り消し・終了ならfalse
+    bool Acquire(const std::shared_ptr<LoadTicket>& ticket);
+    // 待たずに取れるときだけトークンを取る（追加の保険リクエスト用）
+    bool TryAcquire();
+    // 指定時間待つ（再試行の間隔）。取り消し・終了ならfalse
+    bool Wait(const std::shared_ptr<LoadTicket>& ticket, std::chrono::milliseconds delay);
+    // Retry-After を受けて全体の送信を止める
+    void PauseFor(std::chrono::milliseconds delay);
+    // 優先度変更や取り消しを待機中のスレッドへ知らせる
+    void Notify();
+    // 待機中の要求を全て解放する
+    void Shutdown();
+
+    void SetRate(double ratePerSec, double burst);
+
+    // 指数バックオフ（フルジッター）: [0, min(上限, 基準 * 2^attempt)) の乱数
+    std::chrono::milliseconds BackoffDelay(int attempt);
+
+private:
+    struct Waiter {
+        const LoadTicket* ticket;
+        uint64_t order;
+    };
+
+    void Refill(Clock::time_point now);
+    bool IsFirstInLine(const LoadTicket* ticket) const;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    double ratePerSec_;
+    double burst_;
+    double tokens_;
+    Clock::time_point lastRefill_;
+    Clock::time_point pausedUntil_;
+    std::vector<Waiter> waiters_;
+    uint64_t nextOrder_ = 0;
+    bool shutdown_ = false;
+    std::mt19937 rng_{ std::random_device{}() };
+
+    static constexpr int kBackoffBaseMs = 500;
+    static constexpr int kBackoffMaxMs = 32000;
+};
@@ -0,0 +1,174 @@
+#include "SheetValuesParser.h"
+#include <charconv>
+#include <chrono>
+
+SheetValuesParser::SheetValuesParser(RowCallback onRow)
+    : onRow_(std::move(onRow)) {
+}
+
+bool SheetValuesParser::Feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size && !error_; ++i) {
+        OnChar(data[i]);
+    }
+    return !error_;
+}
+
+size_t SheetValuesParser::WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    size_t realSize = size * nmemb;
+    SheetValuesParser* parser = static_cast<SheetValuesParser*>(userp);
+    auto start = std::chrono::steady_clock::now();
+    bool ok = parser->Feed(static_cast<char*>(contents), realSize);
+    parser->parseNs_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    // 解析に失敗したら転送を打ち切る
+    return ok ? realSize : 0;
+}
+
+void SheetValuesParser::OnChar(char c) {
+    switch (lex_) {
+    case LexState::String:
+        if (c == '\\') {
+            lex_ = LexState::StringEscape;
+        } else if (unicodeDigits_ > 0) {
+            --unicodeDigits_;
+        } else if (c == '"') {
+            lex_ = LexState::Default;
+            OnScalar(token_, true);
+        } else {
+            token_ += c;
+        }
+        return;
+    case LexState::StringEscape:
+        lex_ = LexState::String;
+        switch (c) {
+        case 'n': token_ += '\n'; break;
+        case 't': token_ += '\t'; break;
+        case 'r': token_ += '\r'; break;
+        case 'b': token_ += '\b'; break;
+        case 'f': token_ += '\f'; break;
+        // \uXXXX はタイル値に現れないので読み飛ばす
+        case 'u': token_ += '?'; unicodeDigits_ = 4; break;
+        default: token_ += c; break;
+        }
+        return;
+    case LexState::Literal:
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E') {
+            token_ += c;
+            return;
+        }
+        lex_ = LexState::Default;
+        OnScalar(token_, false);
+        if (error_) return;
+        break; // 区切り文字として続けて処理する
+    case LexState::Default:
+        break;
+    }
+
+    switch (c) {
+    case ' ': case '\t': case '\r': case '\n':
+        break;
+    case '{':
+        OpenContainer(false);
+        break;
+    case '[':
+        OpenContainer(true);
+        break;
+    case '}':
+        CloseContainer(false);
+        break;
+    case ']':
+        CloseContainer(true);
+        break;
+    case ':':
+        if (stack_.empty() || stack_.back().kind != FrameKind::Object) error_ = true;
+        break;
+    case ',':
+        if (stack_.empty()) error_ = true;
+        else expectKey_ = stack_.back().kind == FrameKind::Object;
+        break;
+    case '"':
+        token_.clear();
+        unicodeDigits_ = 0;
+        lex_ = LexState::String;
+        break;
+    default:
+        if (stack_.empty() || expectKey_) {
+            error_ = true;
+            break;
+        }
+        token_.assign(1, c);
+        lex_ = LexState::Literal;
+        break;
+    }
+}
+
+void SheetValuesParser::OpenContainer(bool isArray) {
+    if (complete_ || expectKey_) {
+        error_ = true;
+        return;
+    }
+    FrameKind kind = isArray ? FrameKind::Array : FrameKind::Object;
+    if (!stack_.empty()) {
+        const Frame& parent = stack_.back();
+        if (isArray && parent.kind == FrameKind::Object) {
+            if (parent.key == "values") kind = FrameKind::Values;
+            else if (parent.key == "valueRanges") {
+                kind = FrameKind::ValueRanges;
+                rangeIndex_ = -1;
+            }
+        } else if (isArray && parent.kind == FrameKind::Values) {
+            kind = FrameKind::Row;
+            row_.clear();
+        } else if (!isArray && parent.kind == FrameKind::ValueRanges) {
+            ++rangeIndex_;
+        }
+    } else if (!isArray) {
+        rangeIndex_ = 0;
+    }
+    stack_.push_back({ kind, std::string() });
+    expectKey_ = !isArray;
+}
+
+void SheetValuesParser::CloseContainer(bool isArray) {
+    if (stack_.empty() || (stack_.back().kind == FrameKind::Object) == isArray) {
+        error_ = true;
+        return;
+    }
+    FrameKind kind = stack_.back().kind;
+    stack_.pop_back();
+    expectKey_ = false;
+    if (kind == FrameKind::Row) {
+        ++rowCount_;
+        onRow_(rangeIndex_ < 0 ? 0 : rangeIndex_, std::move(row_));
+        row_.clear();
+    }
+    if (stack_.empty()) complete_ = true;
+}
+
+void SheetValuesParser::OnScalar(const std::string& text, bool isString) {
+    if (stack_.empty()) {
+        error_ = true;
+        return;
+    }
+    Frame& top = stack_.back();
+    if (expectKey_) {
+        if (!isString) {
+            error_ = true;
+            return;
+        }
+        top.key = text;
+        expectKey_ = false;
+        return;
+    }
+    if (top.kind == FrameKind::Row) {
+        row_.push_back(ParseCell(text));
+    }
+}
+
+int SheetValuesParser::ParseCell(const std::string& text) {
+    // 先頭の空白を飛ばし、数値として読めるところまでを使う（空セルなどは0）
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) return 0;
+    int value = 0;
+    std::from_chars(text.data() + begin, text.data() + text.size(), value);
+    return value;
+}
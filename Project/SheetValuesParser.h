@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+
+// Sheets API の values / batchGet レスポンスを受信しながら解析するパーサ
+// WriteCallback に届いた断片をそのまま Feed し、行が閉じた時点で通知する
+class SheetValuesParser {
+public:
+    // rangeIndex: batchGet の valueRanges 内の番号（単一Rangeのレスポンスは0）
+    using RowCallback = std::function<void(int rangeIndex, std::vector<int>&& row)>;
+
+    explicit SheetValuesParser(RowCallback onRow);
+
+    // 受信した断片を解析する。不正なJSONを検出したらfalse
+    bool Feed(const char* data, size_t size);
+    // トップレベルのJSONが閉じたか
+    bool IsComplete() const { return complete_; }
+    bool HasError() const { return error_; }
+    size_t RowCount() const { return rowCount_; }
+    // Feed に費やした時間の合計（ミリ秒）
+    double ParseMs() const { return static_cast<double>(parseNs_) / 1e6; }
+
+    // curl の CURLOPT_WRITEFUNCTION 用（userp に SheetValuesParser* を渡す）
+    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
+
+private:
+    enum class FrameKind {
+        Object,
+        Array,
+        ValueRanges, // batchGet の "valueRanges"
+        Values,      // "values"
+        Row,         // "values" の1行
+    };
+    struct Frame {
+        FrameKind kind;
+        std::string key; // Object の直近のキー
+    };
+    enum class LexState {
+        Default,
+        String,
+        StringEscape,
+        Literal,
+    };
+
+    void OnChar(char c);
+    void OpenContainer(bool isArray);
+    void CloseContainer(bool isArray);
+    void OnScalar(const std::string& text, bool isString);
+    static int ParseCell(const std::string& text);
+
+    RowCallback onRow_;
+    std::vector<Frame> stack_;
+    LexState lex_ = LexState::Default;
+    std::string token_;
+    std::vector<int> row_;
+    bool expectKey_ = false;
+    int unicodeDigits_ = 0;
+    int rangeIndex_ = -1;
+    size_t rowCount_ = 0;
+    long long parseNs_ = 0;
+    bool complete_ = false;
+    bool error_ = false;
+};
@@ -0,0 +1,154 @@
+#include "TileAutotile.h"
+#include <algorithm>
+#if defined(_M_X64) || defined(__x86_64__)
+#define TILE_AUTOTILE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr int kWidth = ChunkTiles::kWidth;
+constexpr int kHeight = ChunkTiles::kHeight;
+// 外周1タイルを含む窓（8x8。窓の (x + 1, y + 1) がチャンクの (x, y)）
+constexpr int kWindow = 8;
+// 窓の前後に置く余白（左上に1つずらして読んでも配列の外に出ない）
+constexpr int kPad = 16;
+static_assert(kWidth + 2 == kWindow && kHeight + 2 == kWindow, "the window must be one 64-bit word");
+
+// 下位6ビットの各ビットを、同じ番目のバイトの最下位ビットに広げる表
+constexpr std::array<uint64_t, 64> MakeSpreadTable() {
+    std::array<uint64_t, 64> table{};
+    for (int v = 0; v < 64; ++v) {
+        for (int i = 0; i < kWidth; ++i) {
+            if (v & (1 << i)) table[v] |= uint64_t{ 1 } << (i * 8);
+        }
+    }
+    return table;
+}
+constexpr std::array<uint64_t, 64> kSpread = MakeSpreadTable();
+
+// (ox, oy) の方向の隣のチャンク（中心なら center）
+const ChunkTiles* NeighborAt(int ox, int oy, const ChunkTiles& center,
+    const std::array<const ChunkTiles*, TileAutotile::kNeighborCount>& neighbors) {
+    if (ox == 0 && oy == 0) return &center;
+    for (int i = 0; i < TileAutotile::kNeighborCount; ++i) {
+        if (TileAutotile::kNeighborDx[i] == ox && TileAutotile::kNeighborDy[i] == oy) return neighbors[i];
+    }
+    return nullptr;
+}
+
+// 窓を作る。隣のチャンクがなければ、一番近い読み込み済みのタイルを外へ延ばす
+// （斜めのチャンクだけがなければ、横か縦の隣のチャンクの端の行・列を延ばす）
+void FillWindow(int* window, const ChunkTiles& center,
+    const std::array<const ChunkTiles*, TileAutotile::kNeighborCount>& neighbors) {
+    for (int wy = 0; wy < kWindow; ++wy) {
+        for (int wx = 0; wx < kWindow; ++wx) {
+            int x = wx - 1;
+            int y = wy - 1;
+            int ox = x < 0 ? -1 : (x >= kWidth ? 1 : 0);
+            int oy = y < 0 ? -1 : (y >= kHeight ? 1 : 0);
+            const ChunkTiles* source = NeighborAt(ox, oy, center, neighbors);
+            if (!source && ox != 0 && oy != 0) {
+                if ((source = NeighborAt(ox, 0, center, neighbors)) != nullptr) {
+                    oy = 0;
+                } else if ((source = NeighborAt(0, oy, center, neighbors)) != nullptr) {
+                    ox = 0;
+                }
+            }
+            if (!source) {
+                source = &center;
+                ox = 0;
+                oy = 0;
+            }
+            x = std::clamp(x - ox * kWidth, 0, kWidth - 1);
+            y = std::clamp(y - oy * kHeight, 0, kHeight - 1);
+            window[wy * kWindow + wx] = source->At(x, y);
+        }
+    }
+}
+
+// 窓の中でのずれ（マスクのビットの順）
+int WindowOffset(int direction) {
+    return TileAutotile::kNeighborDy[direction] * kWindow + TileAutotile::kNeighborDx[direction];
+}
+
+// 方向ごとの比較結果（ビット wy * 8 + wx）をタイルごとのマスクに並べ替える
+ChunkAutotile Transpose(const std::array<uint64_t, TileAutotile::kNeighborCount>& planes) {
+    ChunkAutotile result;
+    for (int y = 0; y < kHeight; ++y) {
+        int shift = (y + 1) * kWindow + 1;
+        uint64_t row = 0;
+        for (int d = 0; d < TileAutotile::kNeighborCount; ++d) {
+            row |= kSpread[(planes[d] >> shift) & 0x3F] << d;
+        }
+        for (int x = 0; x < kWidth; ++x) result.masks[y * kWidth + x] = static_cast<uint8_t>(row >> (x * 8));
+    }
+    return result;
+}
+
+} // namespace
+
+ChunkAutotile TileAutotile::Build(const ChunkTiles& center, const std::array<const ChunkTiles*, kNeighborCount>& neighbors) {
+#ifdef TILE_AUTOTILE_SSE2
+    alignas(16) int buffer[kPad + kWindow * kWindow + kPad]{};
+    int* window = buffer + kPad;
+    FillWindow(window, center, neighbors);
+    std::array<uint64_t, kNeighborCount> planes{};
+    for (int d = 0; d < kNeighborCount; ++d) {
+        int offset = WindowOffset(d);
+        // チャンクの行（窓の 1 - 6 行目）を4タイルずつ、ずらした窓と比べる
+        for (int wy = 1; wy <= kHeight; ++wy) {
+            for (int half = 0; half < kWindow; half += 4) {
+                const int* p = window + wy * kWindow + half;
+                __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + offset));
+                uint64_t bits = static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))));
+                planes[d] |= bits << (wy * kWindow + half);
+            }
+        }
+    }
+    return Transpose(planes);
+#else
+    return BuildScalar(center, neighbors);
+#endif
+}
+
+ChunkAutotile TileAutotile::BuildScalar(const ChunkTiles& center, const std::array<const ChunkTiles*, kNeighborCount>& neighbors) {
+    int window[kWindow * kWindow];
+    FillWindow(window, center, neighbors);
+    ChunkAutotile result;
+    for (int y = 0; y < kHeight; ++y) {
+        for (int x = 0; x < kWidth; ++x) {
+            int index = (y + 1) * kWindow + x + 1;
+            uint8_t mask = 0;
+            for (int d = 0; d < kNeighborCount; ++d) {
+                if (window[index + WindowOffset(d)] == window[index]) mask |= static_cast<uint8_t>(1 << d);
+            }
+            result.masks[y * kWidth + x] = mask;
+        }
+    }
+    return result;
+}
+
+int TileAutotile::BlobIndex(uint8_t mask) {
+    // 角のビットを、両側の辺がつながっているときだけ残す
+    auto reduce = [](int m) {
+        if ((m & (kN | kE)) != (kN | kE)) m &= ~kNE;
+        if ((m & (kS | kE)) != (kS | kE)) m &= ~kSE;
+        if ((m & (kS | kW)) != (kS | kW)) m &= ~kSW;
+        if ((m & (kN | kW)) != (kN | kW)) m &= ~kNW;
+        return m;
+    };
+    // 残ったマスクの小さい順に番号を振る（47種類）
+    static const std::array<uint8_t, 256> table = [&reduce]() {
+        std::array<uint8_t, 256> indices{};
+        std::array<int, 256> byReduced{};
+        int next = 0;
+        for (int m = 0; m < 256; ++m) {
+            if (reduce(m) == m) byReduced[m] = next++;
+        }
+        for (int m = 0; m < 256; ++m) indices[m] = static_cast<uint8_t>(byReduced[reduce(m)]);
+        return indices;
+    }();
+    return table[mask];
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "ChunkLoader.h"
+
+// チャンクの全タイルの8近傍マスク（隣のタイルが同じ番号ならビットが立つ。読み込み時に作る）
+// タイルと同じ並び（y * 6 + x）なので、描画はタイルと同じ添字でスプライトを選べる
+struct ChunkAutotile {
+    std::array<uint8_t, ChunkTiles::kWidth * ChunkTiles::kHeight> masks{};
+
+    uint8_t At(int x, int y) const { return masks[y * ChunkTiles::kWidth + x]; }
+};
+
+// 近傍マスクの作り方
+// チャンクと外周1タイルの 8x8 の窓を作り、8方向それぞれ窓をずらしたものと行ごとに比べる（SSE2 で4タイルずつ）
+// 比べた結果は方向ごとの 64 ビットのビット列になるので、表引きでタイルごとのバイトに並べ替える
+struct TileAutotile {
+    // マスクのビット（上から時計回り）
+    static constexpr uint8_t kN = 1 << 0;
+    static constexpr uint8_t kNE = 1 << 1;
+    static constexpr uint8_t kE = 1 << 2;
+    static constexpr uint8_t kSE = 1 << 3;
+    static constexpr uint8_t kS = 1 << 4;
+    static constexpr uint8_t kSW = 1 << 5;
+    static constexpr uint8_t kW = 1 << 6;
+    static constexpr uint8_t kNW = 1 << 7;
+
+    // 隣のチャンクの並び（Build の neighbors の添字。マスクのビットと同じ順）
+    static constexpr int kNeighborCount = 8;
+    static constexpr int kNeighborDx[kNeighborCount] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+    static constexpr int kNeighborDy[kNeighborCount] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+
+    // 周りの8チャンク（読み込みが終わっていなければ nullptr）も使って作る
+    // 隣のチャンクがない辺は端のタイルが続いているものとして扱う（読み込み待ちの間に縁が切れて見えない）
+    static ChunkAutotile Build(const ChunkTiles& center, const std::array<const ChunkTiles*, kNeighborCount>& neighbors);
+    // 1タイルずつ比べる（SSE2 の使えない環境と、結果の確かめ用）
+    static ChunkAutotile BuildScalar(const ChunkTiles& center, const std::array<const ChunkTiles*, kNeighborCount>& neighbors);
+
+    // 47種類のブロブタイルの番号（角は両側の辺がつながっているときだけ数える。0 は孤立したタイル）
+    static int BlobIndex(uint8_t mask);
+};
@@ -0,0 +1,233 @@
+#include "TileCollision.h"
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+constexpr int kChunkWidth = ChunkTiles::kWidth;
+constexpr int kChunkHeight = ChunkTiles::kHeight;
+constexpr int kSolid = static_cast<int>(TileClass::Solid);
+constexpr uint64_t kChunkRowMask = (uint64_t{ 1 } << kChunkWidth) - 1;
+// 計算誤差で辺がわずかにはみ出しても、隣のタイルに重なったとみなさない幅
+constexpr float kEpsilon = 1.0f / 1024.0f;
+
+int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+uint64_t LowBits(int count) {
+    return count >= 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << count) - 1;
+}
+
+// 辺の座標から、その辺より右（下）で最初のタイル／左（上）で最後のタイル
+// 1回の移動で何度も呼ぶので、std::floor / std::ceil の関数呼び出しを避けて整数への切り捨てから求める
+int FirstTile(float edge) {
+    float value = edge + kEpsilon;
+    int tile = static_cast<int>(value);
+    return static_cast<float>(tile) > value ? tile - 1 : tile;
+}
+
+int LastTile(float edge) {
+    float value = edge - kEpsilon;
+    int tile = static_cast<int>(value);
+    return (static_cast<float>(tile) < value ? tile + 1 : tile) - 1;
+}
+
+} // namespace
+
+TileClassifier::ClassMask TileClassifier::ClassesOf(int tile) const {
+    auto found = classes_.find(tile);
+    if (found != classes_.end()) return found->second;
+    return tile != 0 ? Bit(TileClass::Solid) : 0;
+}
+
+ChunkOccupancy TileClassifier::Build(const ChunkTiles& tiles) const {
+    ChunkOccupancy occupancy;
+    for (int y = 0; y < tiles.rowCount; ++y) {
+        for (int x = 0; x < tiles.Width(y); ++x) {
+            ClassMask classes = ClassesOf(tiles.At(x, y));
+            for (int c = 0; c < ChunkOccupancy::kClassCount; ++c) {
+                if (classes & (1u << c)) occupancy.bits[c] |= uint64_t{ 1 } << (y * kChunkWidth + x);
+            }
+        }
+    }
+    return occupancy;
+}
+
+CollisionMap::Page& CollisionMap::GetPage(int px, int py) {
+    auto [it, inserted] = pages_.try_emplace({ px, py });
+    if (inserted && unloadedSolid_) it->second.rows[kSolid].fill(LowBits(kPageWidth));
+    return it->second;
+}
+
+void CollisionMap::FillChunk(Page& page, int slot, const ChunkOccupancy* occupancy) const {
+    int shift = (slot % kPageChunks) * kChunkWidth;
+    int top = (slot / kPageChunks) * kChunkHeight;
+    for (int c = 0; c < ChunkOccupancy::kClassCount; ++c) {
+        for (int y = 0; y < kChunkHeight; ++y) {
+            uint64_t bits = occupancy ? occupancy->Row(c, y) : (c == kSolid && unloadedSolid_ ? kChunkRowMask : 0);
+            uint64_t& row = page.rows[c][top + y];
+            row = (row & ~(kChunkRowMask << shift)) | (bits << shift);
+        }
+    }
+}
+
+void CollisionMap::Set(int cx, int cy, const ChunkOccupancy& occupancy) {
+    // 負の座標も算術シフトでページに分ける
+    Page& page = GetPage(cx >> kPageShift, cy >> kPageShift);
+    int slot = PageSlot(cx, cy);
+    uint64_t bit = uint64_t{ 1 } << slot;
+    if (!(page.loaded & bit)) ++chunkCount_;
+    page.loaded |= bit;
+    page.loadedColumns[slot / kPageChunks] |= kChunkRowMask << ((slot % kPageChunks) * kChunkWidth);
+    FillChunk(page, slot, &occupancy);
+}
+
+void CollisionMap::Erase(int cx, int cy) {
+    auto found = pages_.find({ cx >> kPageShift, cy >> kPageShift });
+    if (found == pages_.end()) return;
+    Page& page = found->second;
+    int slot = PageSlot(cx, cy);
+    uint64_t bit = uint64_t{ 1 } << slot;
+    if (!(page.loaded & bit)) return;
+    --chunkCount_;
+    page.loaded &= ~bit;
+    page.loadedColumns[slot / kPageChunks] &= ~(kChunkRowMask << ((slot % kPageChunks) * kChunkWidth));
+    if (!page.loaded) {
+        pages_.erase(found);
+        return;
+    }
+    FillChunk(page, slot, nullptr);
+}
+
+void CollisionMap::SetUnloadedSolid(bool solid) {
+    unloadedSolid_ = solid;
+    for (auto& kv : pages_) {
+        Page& page = kv.second;
+        for (int slot = 0; slot < kPageChunks * kPageChunks; ++slot) {
+            if (!(page.loaded & (uint64_t{ 1 } << slot))) FillChunk(page, slot, nullptr);
+        }
+    }
+}
+
+const CollisionMap::Page* CollisionMap::FindPage(int px, int py, PageCursor& cursor) const {
+    if (!cursor.valid || cursor.px != px || cursor.py != py) {
+        auto found = pages_.find({ px, py });
+        cursor = { px, py, found != pages_.end() ? &found->second : nullptr, true };
+    }
+    return cursor.page;
+}
+
+uint64_t CollisionMap::ColumnBits(int x0, int x1, int y0, int y1, int tileClass, PageCursor& cursor) const {
+    uint64_t unloaded = tileClass == kSolid && unloadedSolid_ ? LowBits(kPageWidth) : 0;
+    uint64_t bits = 0;
+    for (int py = FloorDiv(y0, kPageHeight); py * kPageHeight <= y1; ++py) {
+        int localY0 = std::max(y0 - py * kPageHeight, 0);
+        int localY1 = std::min(y1 - py * kPageHeight, kPageHeight - 1);
+        // 列の範囲はページ幅以下なので、またぐページは高々2つ
+        for (int px = FloorDiv(x0, kPageWidth); px * kPageWidth <= x1; ++px) {
+            const Page* page = FindPage(px, py, cursor);
+            uint64_t row = unloaded;
+            if (page) {
+                const auto& rows = page->rows[tileClass];
+                row = 0;
+                for (int y = localY0; y <= localY1; ++y) row |= rows[y];
+            }
+            int offset = px * kPageWidth - x0;
+            bits |= offset >= 0 ? row << offset : row >> -offset;
+        }
+    }
+    return bits & LowBits(x1 - x0 + 1);
+}
+
+uint64_t CollisionMap::SolidRow(int x0, int y, bool unloadedSolid) const {
+    int py = FloorDiv(y, kPageHeight);
+    int localY = y - py * kPageHeight;
+    uint64_t bits = 0;
+    PageCursor cursor;
+    for (int px = FloorDiv(x0, kPageWidth); px * kPageWidth < x0 + kRowBits; ++px) {
+        const Page* page = FindPage(px, py, cursor);
+        uint64_t loaded = page ? page->loadedColumns[localY / kChunkHeight] : 0;
+        uint64_t solid = page ? page->rows[kSolid][localY] & loaded : 0;
+        if (unloadedSolid) solid |= ~loaded & LowBits(kPageWidth);
+        int offset = px * kPageWidth - x0;
+        bits |= offset >= 0 ? solid << offset : solid >> -offset;
+    }
+    return bits & LowBits(kRowBits);
+}
+
+bool CollisionMap::IsChunkLoaded(int cx, int cy) const {
+    auto found = pages_.find({ cx >> kPageShift, cy >> kPageShift });
+    return found != pages_.end() && (found->second.loaded & (uint64_t{ 1 } << PageSlot(cx, cy)));
+}
+
+bool CollisionMap::AnyInRect(int x0, int y0, int x1, int y1, TileClass tileClass) const {
+    PageCursor cursor;
+    for (int left = x0; left <= x1; left += kPageWidth) {
+        if (ColumnBits(left, std::min(x1, left + kPageWidth - 1), y0, y1, static_cast<int>(tileClass), cursor)) return true;
+    }
+    return false;
+}
+
+bool CollisionMap::Overlaps(const TileBox& box, TileClass tileClass) const {
+    return AnyInRect(FirstTile(box.x), FirstTile(box.y),
+        LastTile(box.x + box.width), LastTile(box.y + box.height), tileClass);
+}
+
+float CollisionMap::SweepX(const TileBox& box, float dx, TileClass tileClass, PageCursor& cursor) const {
+    if (dx == 0.0f || tileClass == TileClass::Platform) return dx;
+    int y0 = FirstTile(box.y);
+    int y1 = LastTile(box.y + box.height);
+    if (y1 < y0) return dx;
+    // 新しく入る列 [x0, x1] を進む向きにページ幅ずつ区切り、行を OR したビットで最初に塞がっている列を探す
+    bool right = dx > 0.0f;
+    int x0 = right ? LastTile(box.x + box.width) + 1 : FirstTile(box.x + dx);
+    int x1 = right ? LastTile(box.x + box.width + dx) : FirstTile(box.x) - 1;
+    int tileClassIndex = static_cast<int>(tileClass);
+    for (int done = 0; done <= x1 - x0; done += kPageWidth) {
+        int width = std::min(kPageWidth, x1 - x0 + 1 - done);
+        int left = right ? x0 + done : x1 - done - width + 1;
+        uint64_t columns = ColumnBits(left, left + width - 1, y0, y1, tileClassIndex, cursor);
+        if (!columns) continue;
+        if (right) return std::max(0.0f, static_cast<float>(left + std::countr_zero(columns)) - (box.x + box.width));
+        int wall = left + static_cast<int>(std::bit_width(columns)) - 1;
+        return std::min(0.0f, static_cast<float>(wall + 1) - box.x);
+    }
+    return dx;
+}
+
+float CollisionMap::SweepY(const TileBox& box, float dy, TileClass tileClass, PageCursor& cursor) const {
+    if (dy == 0.0f || (tileClass == TileClass::Platform && dy < 0.0f)) return dy;
+    int x0 = FirstTile(box.x);
+    int x1 = LastTile(box.x + box.width);
+    if (x1 < x0) return dy;
+    // 新しく入る行を進む向きに1行ずつ調べる（1行はページ幅ずつのワード演算）
+    bool down = dy > 0.0f;
+    int y0 = down ? LastTile(box.y + box.height) + 1 : FirstTile(box.y + dy);
+    int y1 = down ? LastTile(box.y + box.height + dy) : FirstTile(box.y) - 1;
+    int tileClassIndex = static_cast<int>(tileClass);
+    for (int i = 0; i <= y1 - y0; ++i) {
+        int y = down ? y0 + i : y1 - i;
+        bool blocked = false;
+        for (int left = x0; left <= x1 && !blocked; left += kPageWidth) {
+            blocked = ColumnBits(left, std::min(x1, left + kPageWidth - 1), y, y, tileClassIndex, cursor) != 0;
+        }
+        if (!blocked) continue;
+        if (down) return std::max(0.0f, static_cast<float>(y) - (box.y + box.height));
+        return std::min(0.0f, static_cast<float>(y + 1) - box.y);
+    }
+    return dy;
+}
+
+TileMove CollisionMap::Move(const TileBox& box, float dx, float dy, TileClass tileClass) const {
+    // X と Y で同じページを引き直さない
+    PageCursor cursor;
+    TileMove move;
+    move.dx = SweepX(box, dx, tileClass, cursor);
+    move.hitX = move.dx != dx;
+    TileBox moved = box;
+    moved.x += move.dx;
+    move.dy = SweepY(moved, dy, tileClass, cursor);
+    move.hitY = move.dy != dy;
+    return move;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include "ChunkLoader.h"
+
+// 当たり判定でのタイルの種類（1つのタイルが複数の種類を持てる）
+enum class TileClass {
+    Solid,    // 通れない壁
+    Platform, // 上からだけ乗れる足場
+    Hazard,   // 触れるとダメージ
+};
+
+// チャンク内の種類ごとの占有ビット（読み込み時に1回だけ作る）
+// 6x6 のチャンクは 1 ワードに収まり、(x, y) のタイルがビット y * 6 + x になる
+struct ChunkOccupancy {
+    static constexpr int kClassCount = 3;
+
+    std::array<uint64_t, kClassCount> bits{};
+
+    uint64_t Of(TileClass tileClass) const { return bits[static_cast<int>(tileClass)]; }
+    // y 行目の6ビット（ビット x がタイル (x, y)）
+    uint64_t Row(int tileClass, int y) const {
+        return (bits[tileClass] >> (y * ChunkTiles::kWidth)) & ((uint64_t{ 1 } << ChunkTiles::kWidth) - 1);
+    }
+};
+
+// タイル番号から種類への対応（既定では 0 以外のタイルがすべて Solid）
+class TileClassifier {
+public:
+    using ClassMask = uint8_t;
+    static constexpr ClassMask Bit(TileClass tileClass) { return static_cast<ClassMask>(1u << static_cast<int>(tileClass)); }
+
+    void SetClasses(int tile, ClassMask classes) { classes_[tile] = classes; }
+    ClassMask ClassesOf(int tile) const;
+    ChunkOccupancy Build(const ChunkTiles& tiles) const;
+
+private:
+    std::unordered_map<int, ClassMask> classes_;
+};
+
+// タイル単位の矩形（左上と大きさ）
+struct TileBox {
+    float x = 0.0f;
+    float y = 0.0f;
+    float width = 1.0f;
+    float height = 1.0f;
+};
+
+// 移動の結果（実際に動けた量と、どの軸でぶつかったか）
+struct TileMove {
+    float dx = 0.0f;
+    float dy = 0.0f;
+    bool hitX = false;
+    bool hitY = false;
+};
+
+// 常駐チャンクの占有ビットから、矩形の重なりと移動を調べる
+// 8x8 チャンク（48x48 タイル）を1ページとし、ページの各行を 1 ワードのビット列で持つ
+// 行の中ではチャンクの境界がないので、矩形の1行分はシフトと AND 1回で調べられる
+// SSE2/AVX2 で複数行をまとめて OR しても速くならなかった（時間の大半はページの検索。Bench collision で差は誤差の範囲）ので、
+// 64 ビットのワード演算のままにしている
+class CollisionMap {
+public:
+    void Set(int cx, int cy, const ChunkOccupancy& occupancy);
+    void Erase(int cx, int cy);
+    void Clear() {
+        pages_.clear();
+        chunkCount_ = 0;
+    }
+    size_t ChunkCount() const { return chunkCount_; }
+    // 読み込みが終わっていないチャンクを Solid として扱うか（既定: 扱わない。読み込み待ちの間も止めない）
+    // 扱うと、読み込み待ちの間に落ちたりすり抜けたりしない代わりに、読み込みが遅いと手前で止まる
+    void SetUnloadedSolid(bool solid);
+
+    // タイル (x0, y0)-(x1, y1)（両端を含む）に tileClass のタイルがあるか
+    bool AnyInRect(int x0, int y0, int x1, int y1, TileClass tileClass) const;
+    // 矩形が tileClass のタイルに重なっているか（辺が接しているだけなら重ならない）
+    bool Overlaps(const TileBox& box, TileClass tileClass) const;
+    // X、Y の順に動かし、tileClass のタイルの手前で止める（すでに重なっているタイルは無視する）
+    // Platform は下向きの移動でだけ止める
+    TileMove Move(const TileBox& box, float dx, float dy, TileClass tileClass) const;
+
+    // 経路探索用: 行 y の列 [x0, x0 + kRowBits) の Solid のビット（ビット 0 が x0）
+    // 読み込み前のチャンクは unloadedSolid に従う（SetUnloadedSolid の設定は使わない）
+    static constexpr int kRowBits = 8 * ChunkTiles::kWidth;
+    uint64_t SolidRow(int x0, int y, bool unloadedSolid) const;
+    bool IsChunkLoaded(int cx, int cy) const;
+
+private:
+    static constexpr int kPageShift = 3;
+    static constexpr int kPageChunks = 1 << kPageShift;
+    static constexpr int kPageWidth = kPageChunks * ChunkTiles::kWidth;
+    static constexpr int kPageHeight = kPageChunks * ChunkTiles::kHeight;
+    static_assert(kPageWidth == kRowBits);
+    struct Page {
+        // rows[種類][行] のビット x がページ内のタイル (x, 行)
+        std::array<std::array<uint64_t, kPageHeight>, ChunkOccupancy::kClassCount> rows{};
+        uint64_t loaded = 0; // 読み込み済みのチャンク（1チャンク1ビット）
+        std::array<uint64_t, kPageChunks> loadedColumns{}; // チャンクの行ごとの、読み込み済みの列
+    };
+    // 問い合わせの間だけ、最後に引いたページを覚えておく
+    struct PageCursor {
+        int px = 0;
+        int py = 0;
+        const Page* page = nullptr;
+        bool valid = false;
+    };
+
+    static int PageSlot(int cx, int cy) { return (cy & (kPageChunks - 1)) * kPageChunks + (cx & (kPageChunks - 1)); }
+    Page& GetPage(int px, int py);
+    // ページ内のチャンクの 6x6 を書き換える（occupancy が nullptr なら読み込み前の状態）
+    void FillChunk(Page& page, int slot, const ChunkOccupancy* occupancy) const;
+    const Page* FindPage(int px, int py, PageCursor& cursor) const;
+    // 行 [y0, y1] を OR した、列 [x0, x1] のビット（ビット 0 が x0。列の幅は kPageWidth 以下）
+    uint64_t ColumnBits(int x0, int x1, int y0, int y1, int tileClass, PageCursor& cursor) const;
+    float SweepX(const TileBox& box, float dx, TileClass tileClass, PageCursor& cursor) const;
+    float SweepY(const TileBox& box, float dy, TileClass tileClass, PageCursor& cursor) const;
+
+    // 読み込み範囲の移動でページが空になって消え、また作られるので、節はプールから確保する
+    std::pmr::unsynchronized_pool_resource pool_;
+    std::pmr::unordered_map<std::pair<int, int>, Page, PairHash> pages_{ &pool_ };
+    size_t chunkCount_ = 0;
+    bool unloadedSolid_ = false;
+};
@@ -0,0 +1,328 @@
+#include "TileEditor.h"
+#include <algorithm>
+#include <fstream>
+#include <unordered_set>
+
+namespace {
+
+template <typename Map>
+size_t CountCells(const std::vector<Map>& layers) {
+    size_t count = 0;
+    for (const Map& edits : layers) count += edits.size();
+    return count;
+}
+
+} // namespace
+
+TileEditor::TileEditor(ChunkLoader& loader, std::filesystem::path pendingPath)
+    : loader_(loader)
+    , pendingPath_(std::move(pendingPath)) {
+    LoadPending();
+    worker_ = std::thread(&TileEditor::WorkerLoop, this);
+}
+
+TileEditor::~TileEditor() {
+    Shutdown();
+}
+
+bool TileEditor::Record(int layer, int x, int y, int before, int after) {
+    if (layer < 0) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 送れない編集を溜めると、保存して次の起動でまた送ろうとし続ける
+    if (!loader_.CanWriteCells()) {
+        ++stats_.rejected;
+        return false;
+    }
+    Clock::time_point now = Clock::now();
+    if (CountCells(pending_) == 0) firstEdit_ = now;
+    lastEdit_ = now;
+    if (pending_.size() <= static_cast<size_t>(layer)) pending_.resize(static_cast<size_t>(layer) + 1);
+    EditMap& edits = pending_[static_cast<size_t>(layer)];
+    auto [it, inserted] = edits.try_emplace({ x, y }, Edit{ before, after });
+    if (!inserted) it->second.after = after;
+    // 元の値に戻したセルは送らない
+    if (it->second.before == it->second.after) edits.erase(it);
+    cv_.notify_all();
+    return true;
+}
+
+void TileEditor::Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flushRequested_ = true;
+    cv_.notify_all();
+}
+
+void TileEditor::SetOnline(bool online) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    online_ = online;
+    cv_.notify_all();
+}
+
+void TileEditor::Shutdown() {
+    if (!worker_.joinable()) return;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+        cv_.notify_all();
+        // 最後の書き戻しが再試行を続けていたら打ち切る
+        if (!cv_.wait_for(lock, kMaxFlushWait + kFlushDelay, [this]() { return finished_; })) {
+            ticket_->cancelled = true;
+            loader_.NotifyScheduler();
+        }
+    }
+    worker_.join();
+    SavePending();
+}
+
+void TileEditor::ApplyPending(int cx, int cy, size_t overlayCount, ChunkTiles& tiles) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t layerCount = std::min(std::max(pending_.size(), inflight_.size()), overlayCount + 1);
+    for (size_t layer = 0; layer < layerCount; ++layer) {
+        const EditMap* maps[2] = {
+            layer < pending_.size() ? &pending_[layer] : nullptr,
+            layer < inflight_.size() ? &inflight_[layer] : nullptr,
+        };
+        if ((!maps[0] || maps[0]->empty()) && (!maps[1] || maps[1]->empty())) continue;
+        if (layer > 0 && tiles.overlays.size() < overlayCount) tiles.overlays.resize(overlayCount);
+        ChunkTiles& target = layer == 0 ? tiles : tiles.overlays[layer - 1];
+        for (int y = 0; y < ChunkTiles::kHeight; ++y) {
+            for (int x = 0; x < ChunkTiles::kWidth; ++x) {
+                std::pair<int, int> key{ cx * ChunkTiles::kWidth + x, cy * ChunkTiles::kHeight + y };
+                // 送っている最中の値より、その後の編集を優先する
+                for (const EditMap* edits : maps) {
+                    if (!edits) continue;
+                    auto it = edits->find(key);
+                    if (it == edits->end()) continue;
+                    target.Set(x, y, it->second.after);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+std::vector<TileEditConflict> TileEditor::TakeConflicts() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<TileEditConflict> conflicts;
+    conflicts.swap(conflicts_);
+    return conflicts;
+}
+
+bool TileEditor::WaitIdle(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, timeout, [this]() {
+        return !busy_ && CountCells(pending_) == 0;
+    });
+}
+
+TileEditor::Stats TileEditor::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.pendingCells = CountCells(pending_) + CountCells(inflight_);
+    stats.writable = loader_.CanWriteCells();
+    return stats;
+}
+
+std::vector<CellBlock> TileEditor::Coalesce(int layer, std::vector<std::pair<int, int>> cells) {
+    std::sort(cells.begin(), cells.end(), [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+        return a.second != b.second ? a.second < b.second : a.first < b.first;
+    });
+    std::unordered_set<std::pair<int, int>, PairHash> open(cells.begin(), cells.end());
+    std::vector<CellBlock> blocks;
+    for (const auto& [x, y] : cells) {
+        if (!open.count({ x, y })) continue;
+        int width = 1;
+        while (open.count({ x + width, y })) ++width;
+        // 下の行が同じ幅だけ全部残っていれば延ばす
+        int height = 1;
+        for (;; ++height) {
+            bool full = true;
+            for (int i = 0; i < width && full; ++i) full = open.count({ x + i, y + height }) != 0;
+            if (!full) break;
+        }
+        for (int dy = 0; dy < height; ++dy) {
+            for (int dx = 0; dx < width; ++dx) open.erase({ x + dx, y + dy });
+        }
+        blocks.push_back({ layer, x, y, width, height, {} });
+    }
+    return blocks;
+}
+
+std::vector<CellBlock> TileEditor::CoalesceEdits(const std::vector<EditMap>& edits, bool withValues) {
+    std::vector<CellBlock> blocks;
+    for (size_t layer = 0; layer < edits.size(); ++layer) {
+        std::vector<std::pair<int, int>> cells;
+        cells.reserve(edits[layer].size());
+        for (const auto& kv : edits[layer]) cells.push_back(kv.first);
+        for (CellBlock& block : Coalesce(static_cast<int>(layer), std::move(cells))) {
+            if (withValues) {
+                block.values.reserve(static_cast<size_t>(block.width) * static_cast<size_t>(block.height));
+                for (int y = 0; y < block.height; ++y) {
+                    for (int x = 0; x < block.width; ++x) {
+                        block.values.push_back(edits[layer].at({ block.x + x, block.y + y }).after);
+                    }
+                }
+            }
+            blocks.push_back(std::move(block));
+        }
+    }
+    return blocks;
+}
+
+void TileEditor::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        bool hasEdits = CountCells(pending_) > 0;
+        // 書き戻せない間は前回の起動から残った編集も送らない（NotifyWritable で起こされる）
+        bool sendable = online_ && loader_.CanWriteCells();
+        // 終了時は残りを1回だけ送ってみる
+        if (stop_ && (!hasEdits || !sendable)) break;
+        if (!hasEdits || !sendable) {
+            cv_.wait(lock);
+            continue;
+        }
+        Clock::time_point due = std::max(std::min(lastEdit_ + kFlushDelay, firstEdit_ + kMaxFlushWait), retryAt_);
+        if (!flushRequested_ && !stop_ && Clock::now() < due) {
+            cv_.wait_until(lock, due);
+            continue;
+        }
+        flushRequested_ = false;
+
+        // 上限までのセルを送る側へ移す（残りは次の書き戻しで送る）
+        inflight_.resize(pending_.size());
+        size_t taken = 0;
+        for (size_t layer = 0; layer < pending_.size() && taken < kMaxFlushCells; ++layer) {
+            EditMap& edits = pending_[layer];
+            for (auto it = edits.begin(); it != edits.end() && taken < kMaxFlushCells; ++taken) {
+                inflight_[layer].insert(*it);
+                it = edits.erase(it);
+            }
+        }
+        if (CountCells(pending_) > 0) firstEdit_ = Clock::now();
+        busy_ = true;
+        lock.unlock();
+        FlushInflight();
+        lock.lock();
+        busy_ = false;
+        cv_.notify_all();
+        bool failed = CountCells(inflight_) > 0;
+        if (failed) RestoreInflight();
+        if (stop_ && failed) break;
+    }
+    finished_ = true;
+    cv_.notify_all();
+}
+
+void TileEditor::FlushInflight() {
+    // inflight_ を書き換えるのはこのスレッドだけなので、読むだけならロックは要らない
+    Clock::time_point start = Clock::now();
+    std::optional<std::vector<CellBlock>> remote = loader_.ReadCells(CoalesceEdits(inflight_, false), ticket_);
+    uint64_t requests = 1;
+
+    // シートの今の値を編集前・編集後の値と比べる
+    std::vector<EditMap> writes(inflight_.size());
+    std::vector<TileEditConflict> conflicts;
+    bool written = false;
+    std::vector<CellBlock> blocks;
+    if (remote) {
+        for (const CellBlock& block : *remote) {
+            const EditMap& edits = inflight_[static_cast<size_t>(block.layer)];
+            for (int y = 0; y < block.height; ++y) {
+                for (int x = 0; x < block.width; ++x) {
+                    std::pair<int, int> key{ block.x + x, block.y + y };
+                    int value = block.values[static_cast<size_t>(y * block.width + x)];
+                    const Edit& edit = edits.at(key);
+                    // 既に同じ値なら送らない
+                    if (value == edit.after) continue;
+                    if (value == edit.before) writes[static_cast<size_t>(block.layer)].emplace(key, edit);
+                    else conflicts.push_back({ block.layer, key.first, key.second, value });
+                }
+            }
+        }
+        blocks = CoalesceEdits(writes, true);
+        written = blocks.empty();
+        if (!written) {
+            written = loader_.WriteCells(blocks, ticket_);
+            ++requests;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.requests += requests;
+    stats_.lastFlushMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    if (!written) {
+        // RestoreInflight で pending_ に戻す
+        ++stats_.failures;
+        retryAt_ = Clock::now() + kRetryDelay;
+        return;
+    }
+    ++stats_.flushes;
+    stats_.blocksWritten += blocks.size();
+    stats_.cellsWritten += CountCells(writes);
+    stats_.conflicts += conflicts.size();
+    // 競合したセルはシートの値を優先し、その後の編集も取り消す
+    for (const TileEditConflict& conflict : conflicts) {
+        if (static_cast<size_t>(conflict.layer) < pending_.size()) {
+            pending_[static_cast<size_t>(conflict.layer)].erase({ conflict.x, conflict.y });
+        }
+    }
+    conflicts_.insert(conflicts_.end(), conflicts.begin(), conflicts.end());
+    for (EditMap& edits : inflight_) edits.clear();
+    retryAt_ = Clock::time_point();
+}
+
+void TileEditor::RestoreInflight() {
+    if (pending_.size() < inflight_.size()) pending_.resize(inflight_.size());
+    if (CountCells(pending_) == 0) firstEdit_ = lastEdit_ = Clock::now();
+    for (size_t layer = 0; layer < inflight_.size(); ++layer) {
+        for (const auto& kv : inflight_[layer]) {
+            auto [it, inserted] = pending_[layer].try_emplace(kv.first, kv.second);
+            if (inserted) continue;
+            it->second.before = kv.second.before;
+            if (it->second.before == it->second.after) pending_[layer].erase(it);
+        }
+        inflight_[layer].clear();
+    }
+}
+
+void TileEditor::LoadPending() {
+    if (pendingPath_.empty()) return;
+    std::ifstream file(pendingPath_);
+    if (!file) return;
+    json j = json::parse(file, nullptr, false);
+    if (!j.is_object() || !j.contains("edits") || !j["edits"].is_array()) return;
+    // 各要素: [レイヤー, x, y, 編集前, 編集後]。形の違う要素は読み飛ばす
+    for (const auto& edit : j["edits"]) {
+        if (!edit.is_array() || edit.size() != 5) continue;
+        if (!std::all_of(edit.begin(), edit.end(), [](const json& v) { return v.is_number_integer(); })) continue;
+        int layer = edit[0].get<int>();
+        if (layer < 0 || layer > kMaxPendingLayer) continue;
+        // ファイルの値はそのままシートへ送られるので、タイル番号の範囲に収める
+        int before = std::clamp(edit[3].get<int>(), 0, kMaxTileId);
+        int after = std::clamp(edit[4].get<int>(), 0, kMaxTileId);
+        if (before == after) continue;
+        if (pending_.size() <= static_cast<size_t>(layer)) pending_.resize(static_cast<size_t>(layer) + 1);
+        pending_[static_cast<size_t>(layer)][{ edit[1].get<int>(), edit[2].get<int>() }] = { before, after };
+    }
+    firstEdit_ = lastEdit_ = Clock::now();
+}
+
+void TileEditor::SavePending() const {
+    // 書き戻せない起動では、前回の起動から残ったファイルをそのままにする
+    if (pendingPath_.empty() || !loader_.CanWriteCells()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::error_code ec;
+    if (CountCells(pending_) == 0) {
+        std::filesystem::remove(pendingPath_, ec);
+        return;
+    }
+    json edits = json::array();
+    for (size_t layer = 0; layer < pending_.size(); ++layer) {
+        for (const auto& kv : pending_[layer]) {
+            edits.push_back({ static_cast<int>(layer), kv.first.first, kv.first.second, kv.second.before, kv.second.after });
+        }
+    }
+    std::filesystem::create_directories(pendingPath_.parent_path(), ec);
+    std::ofstream file(pendingPath_);
+    file << json{ { "edits", std::move(edits) } }.dump();
+}
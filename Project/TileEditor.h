@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include "ChunkLoader.h"
+
+// 書き戻しでシートの値を優先したセル（他の人が同じセルを同時に編集していた）
+struct TileEditConflict {
+    int layer = 0;
+    int x = 0;
+    int y = 0;
+    int remote = 0; // シートの今の値（ゲーム側のタイルもこの値に戻す）
+};
+
+// ゲーム内で編集したタイルをシートへ書き戻す
+// 編集はすぐに記録し、最後の編集から kFlushDelay 経ったとき（編集が続いても最初の編集から kMaxFlushWait まで）か
+// Flush を呼んだときに、作業スレッドがまとめて送る
+// 1回の書き戻しでは、編集したセルを矩形にまとめ、今の値を1回読み（競合の確認）、1回の values:batchUpdate で書く
+// 読んだ値が編集前の値とも編集後の値とも違うセルは書かず、シートの値を TakeConflicts で返す
+// （読んでから書くまでの間の編集は検出できない）
+// 書き戻せない間（ChunkLoader::CanWriteCells が false）は編集を記録せず、送りも保存もしない
+class TileEditor {
+public:
+    struct Stats {
+        uint64_t flushes = 0;      // 書き終えた書き戻し
+        uint64_t requests = 0;     // 読み直しと書き込みのリクエスト（再試行は ChunkLoader の統計に出る）
+        uint64_t cellsWritten = 0;
+        uint64_t blocksWritten = 0;
+        uint64_t conflicts = 0;
+        uint64_t failures = 0;     // 再試行しても送れなかった書き戻し（編集は次の書き戻しに残る）
+        uint64_t rejected = 0;     // 書き戻せないので記録しなかった編集（ゲームの中にだけ残る）
+        double lastFlushMs = 0.0;  // 直近の書き戻しにかかった時間（読み直し＋書き込み）
+        size_t pendingCells = 0;   // 送り終えていないセル
+        bool writable = true;      // 書き戻せる（OAuth トークンがあるか、接続先を変えている）
+    };
+
+    // pendingPath: 終了時に送れなかった編集を保存し、次の起動で読み込むファイル（空なら保存しない）
+    TileEditor(ChunkLoader& loader, std::filesystem::path pendingPath);
+    ~TileEditor();
+    TileEditor(const TileEditor&) = delete;
+    TileEditor& operator=(const TileEditor&) = delete;
+
+    // (x, y) のタイルを before から after に変えた。送る前に同じセルを何度編集しても送るのは最後の値だけ
+    // 書き戻せないときは記録せずに false を返す（Stats::rejected に数える）
+    bool Record(int layer, int x, int y, int before, int after);
+    // 待たずに書き戻しを始める
+    void Flush();
+    // オフラインの間は送らずに溜める（オンラインに戻ったら送る）
+    void SetOnline(bool online);
+    // 書き戻せるようになった（アクセストークンを設定した）ので、溜まっている編集を送る
+    void NotifyWritable() { Flush(); }
+    // 残りの編集を送ってから作業スレッドを止める（送れなかった編集は pendingPath に保存する）
+    void Shutdown();
+    // 送り終えていない編集を (cx, cy) のタイルに重ねる（解放して読み込み直したチャンクに編集を残す）
+    // overlayCount: 追加レイヤーの数
+    void ApplyPending(int cx, int cy, size_t overlayCount, ChunkTiles& tiles) const;
+    // 競合したセルを受け取る
+    std::vector<TileEditConflict> TakeConflicts();
+    // 送るものがなくなるまで待つ。期限までに終わらなければ false
+    bool WaitIdle(std::chrono::milliseconds timeout);
+    Stats GetStats() const;
+
+    // セルの集まりを矩形に分ける（左上から、右へ延ばせるだけ延ばしてから下へ延ばす）
+    static std::vector<CellBlock> Coalesce(int layer, std::vector<std::pair<int, int>> cells);
+
+private:
+    struct Edit {
+        int before = 0; // シートにあるはずの値（最初に編集したときのタイル）
+        int after = 0;
+    };
+    using EditMap = std::unordered_map<std::pair<int, int>, Edit, PairHash>;
+    using Clock = std::chrono::steady_clock;
+
+    void WorkerLoop();
+    // inflight_ を送る。送れなかった編集は pending_ に戻す
+    void FlushInflight();
+    // 送れなかった編集を戻す（その後の編集があれば、編集前の値だけを引き継ぐ）
+    void RestoreInflight();
+    static std::vector<CellBlock> CoalesceEdits(const std::vector<EditMap>& edits, bool withValues);
+    void LoadPending();
+    void SavePending() const;
+
+    ChunkLoader& loader_;
+    std::filesystem::path pendingPath_;
+    std::shared_ptr<LoadTicket> ticket_ = std::make_shared<LoadTicket>();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    // レイヤーごとの編集（pending_ は次に送るもの、inflight_ は送っている最中のもの）
+    std::vector<EditMap> pending_;
+    std::vector<EditMap> inflight_;
+    std::vector<TileEditConflict> conflicts_;
+    Clock::time_point firstEdit_;
+    Clock::time_point lastEdit_;
+    Clock::time_point retryAt_;
+    bool flushRequested_ = false;
+    bool online_ = true;
+    bool stop_ = false;
+    bool busy_ = false;
+    bool finished_ = false; // 作業スレッドが抜けた
+    Stats stats_;
+    std::thread worker_;
+
+    // 編集が止まってから送るまでの時間と、編集が続いていても送るまでの時間
+    static constexpr std::chrono::milliseconds kFlushDelay{ 500 };
+    static constexpr std::chrono::milliseconds kMaxFlushWait{ 2000 };
+    // 書き戻しに失敗したら、次に試すまで待つ時間
+    static constexpr std::chrono::milliseconds kRetryDelay{ 5000 };
+    // 1回で送るセルの上限（Sheets API のリクエストの大きさに収める）
+    static constexpr size_t kMaxFlushCells = 20000;
+    // 保存された編集を読み直すときのタイル番号の上限（キャッシュの1バイト詰めに収まる範囲）
+    static constexpr int kMaxTileId = 0xFF;
+    // 保存された編集を読み直すときのレイヤー番号の上限（壊れた番号で巨大な配列を作らない）
+    static constexpr int kMaxPendingLayer = 255;
+};
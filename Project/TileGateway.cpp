@@ -0,0 +1,312 @@
+#include "TileGateway.h"
+#include <algorithm>
+#include <chrono>
+
+TileGateway::TileGateway(ChunkLoader& loader, const TileGatewayOptions& options)
+    : loader_(loader)
+    , options_(options)
+    , server_(HttpServerOptions{ options.port, options.maxConnections, options.idleTimeoutSec },
+        [this](const std::string& method, const std::string& target, const std::string&) {
+            return HandleRequest(method, target);
+        }) {
+}
+
+TileGateway::~TileGateway() {
+    Stop();
+}
+
+bool TileGateway::Start() {
+    started_ = true;
+    stopping_ = false;
+    // 最初のリビジョンが分かるまでは受け付けない（分からなければ全チャンクを取り直す）
+    RefreshUpstream();
+    if (!server_.Start()) {
+        Stop();
+        return false;
+    }
+    revisionThread_ = std::thread([this]() { RevisionLoop(); });
+    return true;
+}
+
+void TileGateway::Stop() {
+    if (!started_) return;
+    started_ = false;
+    stopping_ = true;
+    {
+        // 待機に入る直前の通知を取りこぼさないよう、ロックを取ってから起こす
+        std::lock_guard<std::mutex> lock(revisionMutex_);
+    }
+    revisionCv_.notify_all();
+    if (revisionThread_.joinable()) revisionThread_.join();
+    {
+        // 変更フィードで待っている接続を起こす（この後に来たリクエストは stopping_ を見て待たない）
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    changeCv_.notify_all();
+    server_.Stop();
+}
+
+void TileGateway::RevisionLoop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(revisionMutex_);
+            if (revisionCv_.wait_for(lock, std::chrono::seconds(options_.revisionCheckIntervalSec),
+                [this]() { return stopping_.load(); })) {
+                return;
+            }
+        }
+        RefreshUpstream();
+    }
+}
+
+void TileGateway::RefreshUpstream() {
+    RevisionChange change;
+    bool online = loader_.RefreshRevision(&change);
+    upstreamOnline_ = online;
+    if (!online) return;
+    std::string revision = loader_.GetSheetRevision();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!change.changed) {
+            changeRevision_ = revision;
+            return;
+        }
+        ChangeLogEntry entry;
+        entry.sequence = ++generation_;
+        entry.reset = change.allChunks;
+        if (change.allChunks) {
+            hotList_.clear();
+            hotIndex_.clear();
+        } else {
+            for (const ChunkKey& key : change.chunks) {
+                auto found = hotIndex_.find(key);
+                if (found == hotIndex_.end()) continue;
+                hotList_.erase(found->second);
+                hotIndex_.erase(found);
+            }
+            entry.chunks = std::move(change.chunks);
+        }
+        changeLog_.push_back(std::move(entry));
+        if (changeLog_.size() > kChangeLogCapacity) changeLog_.pop_front();
+        changeRevision_ = revision;
+    }
+    changeCv_.notify_all();
+}
+
+TileGateway::Response TileGateway::HandleRequest(const std::string& method, const std::string& target) {
+    ++requests_;
+    if (method != "GET") return HttpServer::ErrorResponse(405, "only GET is supported");
+    // クエリ（key= など）は見ない。上流へのキーはゲートウェイが持つ
+    std::string path;
+    if (!HttpServer::PercentDecode(target.substr(0, target.find('?')), path)) {
+        return HttpServer::ErrorResponse(400, "bad percent-encoding");
+    }
+
+    if (path == "/stats") return { 200, std::make_shared<const std::string>(StatsJson().dump()) };
+    if (path == "/changes") return HandleChanges(target);
+
+    const std::string& spreadsheetId = loader_.GetSpreadsheetId();
+    const std::string drivePrefix = "/drive/v3/files/";
+    if (path.rfind(drivePrefix, 0) == 0) {
+        if (path.compare(drivePrefix.size(), std::string::npos, spreadsheetId) != 0) {
+            return HttpServer::ErrorResponse(404, "unknown spreadsheet");
+        }
+        std::string revision = loader_.GetSheetRevision();
+        if (revision.empty()) return HttpServer::ErrorResponse(503, "revision unknown");
+        return { 200, std::make_shared<const std::string>(json{ { "version", revision } }.dump()) };
+    }
+    const std::string valuesPrefix = "/v4/spreadsheets/" + spreadsheetId + "/values/";
+    if (path.rfind(valuesPrefix, 0) == 0) return HandleChunk(path.substr(valuesPrefix.size()));
+    return HttpServer::ErrorResponse(404, "not found");
+}
+
+TileGateway::Response TileGateway::HandleChanges(const std::string& target) {
+    ++changeRequests_;
+    // since が無ければ今の番号だけを返す（クライアントが待ち始める位置）
+    int64_t since = HttpServer::QueryInt(target, "since", -1);
+    int64_t waitSec = std::clamp<int64_t>(HttpServer::QueryInt(target, "wait", 0), 0, kMaxChangeWaitSec);
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (since >= 0 && static_cast<uint64_t>(since) == generation_ && waitSec > 0) {
+        changeCv_.wait_for(lock, std::chrono::seconds(waitSec),
+            [this, since]() { return stopping_.load() || generation_ != static_cast<uint64_t>(since); });
+    }
+    bool reset = false;
+    std::unordered_set<ChunkKey, PairHash> chunks;
+    if (since >= 0 && static_cast<uint64_t>(since) < generation_) {
+        // since の次からの記録が残っていなければ、どのチャンクが変わったか分からない
+        reset = changeLog_.empty() || changeLog_.front().sequence > static_cast<uint64_t>(since) + 1;
+        for (const ChangeLogEntry& entry : changeLog_) {
+            if (entry.sequence <= static_cast<uint64_t>(since)) continue;
+            reset = reset || entry.reset;
+            chunks.insert(entry.chunks.begin(), entry.chunks.end());
+        }
+    } else if (since >= 0 && static_cast<uint64_t>(since) > generation_) {
+        // ゲートウェイが再起動して番号が戻った
+        reset = true;
+    }
+    json list = json::array();
+    if (!reset) {
+        for (const ChunkKey& key : chunks) list.push_back({ key.first, key.second });
+    }
+    json j = { { "sequence", generation_ }, { "revision", changeRevision_ }, { "reset", reset }, { "chunks", std::move(list) } };
+    lock.unlock();
+    return { 200, std::make_shared<const std::string>(j.dump()) };
+}
+
+TileGateway::Response TileGateway::HandleChunk(const std::string& range) {
+    size_t bang = range.rfind('!');
+    size_t colon = range.find(':', bang == std::string::npos ? 0 : bang);
+    if (bang == std::string::npos || colon == std::string::npos) return HttpServer::ErrorResponse(400, "bad range");
+    if (range.compare(0, bang, loader_.GetSheetName()) != 0) return HttpServer::ErrorResponse(404, "unknown sheet");
+    int startCol = 0, startRow = 0, endCol = 0, endRow = 0;
+    if (!ChunkLoader::ParseCellName(range.substr(bang + 1, colon - bang - 1), startCol, startRow)
+        || !ChunkLoader::ParseCellName(range.substr(colon + 1), endCol, endRow)) {
+        return HttpServer::ErrorResponse(400, "bad range");
+    }
+    // チャンク境界に揃った1チャンク分の範囲だけ受ける（ホットセットとキャッシュの単位）
+    constexpr int kWidth = ChunkLoader::kChunkWidth;
+    constexpr int kHeight = ChunkLoader::kChunkHeight;
+    if (startCol % kWidth != 0 || (startRow - 1) % kHeight != 0
+        || endCol != startCol + kWidth - 1 || endRow != startRow + kHeight - 1) {
+        return HttpServer::ErrorResponse(400, "range must cover exactly one chunk");
+    }
+    Body body = GetChunkBody(startCol / kWidth, (startRow - 1) / kHeight);
+    if (!body) return HttpServer::ErrorResponse(502, "chunk unavailable");
+    return { 200, body };
+}
+
+TileGateway::Body TileGateway::GetChunkBody(int cx, int cy) {
+    ChunkKey key(cx, cy);
+    std::promise<Body> promise;
+    std::shared_future<Body> pending;
+    uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (Body hot = FindHot(key)) {
+            ++hotHits_;
+            return hot;
+        }
+        auto found = inFlight_.find(key);
+        if (found != inFlight_.end()) {
+            pending = found->second;
+        } else {
+            inFlight_.emplace(key, promise.get_future().share());
+            generation = generation_;
+        }
+    }
+    if (pending.valid()) {
+        // 同じチャンクを取得中のリクエストに相乗りする
+        ++coalesced_;
+        return pending.get();
+    }
+
+    Body body;
+    try {
+        body = FetchChunkBody(cx, cy);
+    } catch (...) {
+        // 待っている相乗り側には nullptr（502）を返す
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        inFlight_.erase(key);
+        if (body && generation == generation_) PutHot(key, body);
+    }
+    promise.set_value(body);
+    return body;
+}
+
+TileGateway::Body TileGateway::FetchChunkBody(int cx, int cy) {
+    ++fetches_;
+    PipelineStats& stats = loader_.GetPipelineStats();
+    bool fresh = loader_.IsChunkFresh(cx, cy);
+    // 検証済みでもキャッシュが壊れていれば上流から取り直す
+    ChunkTiles cached;
+    bool hit = fresh && loader_.LoadChunkCache(cx, cy, cached);
+    if (!hit && upstreamOnline_) {
+        auto ticket = std::make_shared<LoadTicket>();
+        std::optional<TileData> data = loader_.LoadFromSheet(cx, cy, ticket);
+        if (data) {
+            ++upstreamLoads_;
+            stats.AddCacheMiss();
+            ChunkTiles tiles;
+            tiles.Assign(*data);
+            loader_.CommitChunk(cx, cy, tiles);
+            return MakeChunkBody(cx, cy, tiles.ToTileData());
+        }
+    }
+    // 上流から取得できなければ古いディスクキャッシュを返す
+    if (!hit && !fresh) hit = loader_.LoadChunkCache(cx, cy, cached);
+    if (!hit) return nullptr;
+    stats.AddCacheHit();
+    return MakeChunkBody(cx, cy, cached.ToTileData());
+}
+
+TileGateway::Body TileGateway::MakeChunkBody(int cx, int cy, const TileData& data) const {
+    constexpr int kWidth = ChunkLoader::kChunkWidth;
+    constexpr int kHeight = ChunkLoader::kChunkHeight;
+    std::string range = loader_.GetSheetName() + "!"
+        + ChunkLoader::ColIndexToName(cx * kWidth) + std::to_string(cy * kHeight + 1) + ":"
+        + ChunkLoader::ColIndexToName(cx * kWidth + kWidth - 1) + std::to_string(cy * kHeight + kHeight);
+    json j = { { "range", range }, { "majorDimension", "ROWS" } };
+    // Sheets API と同じく、空の範囲では values を省き、値は文字列で返す
+    if (!data.empty()) {
+        json values = json::array();
+        for (const auto& row : data) {
+            json cells = json::array();
+            for (int value : row) cells.push_back(std::to_string(value));
+            values.push_back(std::move(cells));
+        }
+        j["values"] = std::move(values);
+    }
+    return std::make_shared<const std::string>(j.dump());
+}
+
+TileGateway::Body TileGateway::FindHot(const ChunkKey& key) {
+    auto found = hotIndex_.find(key);
+    if (found == hotIndex_.end()) return nullptr;
+    hotList_.splice(hotList_.begin(), hotList_, found->second);
+    return found->second->second;
+}
+
+void TileGateway::PutHot(const ChunkKey& key, const Body& body) {
+    auto found = hotIndex_.find(key);
+    if (found != hotIndex_.end()) {
+        found->second->second = body;
+        hotList_.splice(hotList_.begin(), hotList_, found->second);
+        return;
+    }
+    hotList_.emplace_front(key, body);
+    hotIndex_[key] = hotList_.begin();
+    if (hotList_.size() > options_.hotSetCapacity) {
+        hotIndex_.erase(hotList_.back().first);
+        hotList_.pop_back();
+    }
+}
+
+nlohmann::json TileGateway::StatsJson() const {
+    size_t hotSetSize = 0;
+    size_t inFlight = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        hotSetSize = hotList_.size();
+        inFlight = inFlight_.size();
+    }
+    return {
+        { "requests", requests_.load() },
+        { "hot_hits", hotHits_.load() },
+        { "coalesced", coalesced_.load() },
+        { "fetches", fetches_.load() },
+        { "upstream_loads", upstreamLoads_.load() },
+        { "errors", server_.Errors() },
+        { "rejected_connections", server_.RejectedConnections() },
+        { "change_requests", changeRequests_.load() },
+        { "hot_set_size", hotSetSize },
+        { "in_flight", inFlight },
+        { "connections", server_.ConnectionCount() },
+        { "revision", loader_.GetSheetRevision() },
+        { "upstream_online", upstreamOnline_.load() },
+        { "request_latency", server_.Latency().ToJson() },
+        { "upstream_transfers", loader_.GetHttpStats().transfers },
+        { "pipeline", loader_.GetPipelineStats().ToJson() },
+    };
+}
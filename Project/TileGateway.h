@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <nlohmann/json.hpp>
+#include "ChunkLoader.h"
+#include "HttpServer.h"
+
+// タイルゲートウェイの設定
+struct TileGatewayOptions {
+    uint16_t port = 8700;              // 0 なら空いているポート
+    size_t hotSetCapacity = 4096;      // メモリに保持するチャンク数（シリアライズ済みのレスポンス）
+    int maxConnections = 1024;         // 同時接続数の上限（超えたら503で閉じる）
+    int idleTimeoutSec = 30;           // keep-alive 接続の無通信タイムアウト
+    int revisionCheckIntervalSec = 30; // 上流のリビジョン確認の間隔
+};
+
+// 多数のゲームクライアントの前に置くチャンク配信サーバー（ヘッドレス）
+// Sheets API と同じパスで受け、メモリ上のホットセット → ディスクキャッシュ → シートの順に探す
+// 同じチャンクへの同時リクエストは1回の上流取得にまとめる
+// クライアントは MapManager::UseGateway でこのサーバーに向ける
+//   GET /v4/spreadsheets/{id}/values/{sheet}!A1:F6   チャンク（Sheets API と同じJSON）
+//   GET /drive/v3/files/{id}                          {"version": リビジョン}
+//   GET /changes?since=番号&wait=秒                    変更フィード（since より後に変わったチャンク。なければ wait 秒まで待つ）
+//       {"sequence": 番号, "revision": リビジョン, "reset": 変わったチャンクが分からない, "chunks": [[cx, cy], ...]}
+//   GET /stats                                        配信統計と読み込みパイプラインの統計
+class TileGateway {
+public:
+    // loader は Initialize 済みのものを渡す（Stop まで生存していること）
+    explicit TileGateway(ChunkLoader& loader, const TileGatewayOptions& options = {});
+    ~TileGateway();
+    TileGateway(const TileGateway&) = delete;
+    TileGateway& operator=(const TileGateway&) = delete;
+
+    // 待ち受けを開始する。ポートを開けなければfalse
+    bool Start();
+    // 新しい接続の受け付けを止め、処理中の接続を閉じて終わるまで待つ
+    // クォータ待ちの取得があると戻らないので、先に ChunkLoader::Shutdown を呼んでおく
+    void Stop();
+    // 待ち受けているポート（options.port が 0 なら空いていたポート）
+    uint16_t Port() const { return server_.Port(); }
+
+    nlohmann::json StatsJson() const;
+
+private:
+    // シリアライズ済みのレスポンスボディ（ホットセットと合流中のリクエストで共有する）
+    using Body = std::shared_ptr<const std::string>;
+    using ChunkKey = std::pair<int, int>;
+    using Response = HttpServerResponse;
+
+    void RevisionLoop();
+    // 上流のリビジョンを確認し、変わっていたら変わったチャンクをホットセットから捨てて変更フィードに記録する
+    // （上流がチェックサムRange でなく、どれが変わったか分からなければホットセットをすべて捨てる）
+    void RefreshUpstream();
+    Response HandleRequest(const std::string& method, const std::string& target);
+    Response HandleChanges(const std::string& target);
+    Response HandleChunk(const std::string& range);
+
+    // ホットセット → 合流 → 取得の順に探す。取得できなければ nullptr
+    Body GetChunkBody(int cx, int cy);
+    // ディスクキャッシュかシートから読み、Sheets API 形式のJSONにする
+    Body FetchChunkBody(int cx, int cy);
+    Body MakeChunkBody(int cx, int cy, const TileData& data) const;
+
+    // ホットセット（LRU。mutex_ を取った状態で呼ぶ）
+    Body FindHot(const ChunkKey& key);
+    void PutHot(const ChunkKey& key, const Body& body);
+
+    ChunkLoader& loader_;
+    TileGatewayOptions options_;
+    bool started_ = false;
+    std::thread revisionThread_;
+    std::atomic<bool> stopping_ = false;
+    std::atomic<bool> upstreamOnline_ = false;
+
+    // ホットセットと合流中の取得
+    mutable std::mutex mutex_;
+    std::list<std::pair<ChunkKey, Body>> hotList_; // 先頭が最近使ったもの
+    std::unordered_map<ChunkKey, std::list<std::pair<ChunkKey, Body>>::iterator, PairHash> hotIndex_;
+    std::unordered_map<ChunkKey, std::shared_future<Body>, PairHash> inFlight_;
+    // リビジョンが変わるたびに進める（古いリビジョンで取得した内容をホットセットに入れない。変更フィードの番号）
+    uint64_t generation_ = 0;
+
+    // 変更フィード（mutex_ で守る）。古い記録から捨て、残っていない番号から聞かれたら reset を返す
+    struct ChangeLogEntry {
+        uint64_t sequence = 0;
+        bool reset = false;
+        std::vector<ChunkKey> chunks;
+    };
+    std::deque<ChangeLogEntry> changeLog_;
+    std::string changeRevision_; // generation_ の時点のリビジョン
+    std::condition_variable changeCv_;
+
+    // リビジョン確認の待機（Stop で起こす）
+    std::mutex revisionMutex_;
+    std::condition_variable revisionCv_;
+
+    // 配信統計
+    std::atomic<uint64_t> requests_ = 0;
+    std::atomic<uint64_t> hotHits_ = 0;
+    std::atomic<uint64_t> coalesced_ = 0;
+    std::atomic<uint64_t> fetches_ = 0;
+    std::atomic<uint64_t> upstreamLoads_ = 0;
+    std::atomic<uint64_t> changeRequests_ = 0;
+
+    // 接続の受け付けとリクエストの読み書き（接続スレッドが HandleRequest を呼ぶので、他のメンバーより先に壊れるよう最後に置く）
+    HttpServer server_;
+
+    static constexpr size_t kChangeLogCapacity = 1024;
+    // 変更フィードで待つ時間の上限（秒）
+    static constexpr int64_t kMaxChangeWaitSec = 30;
+};
@@ -0,0 +1,408 @@
+#include "TileLight.h"
+#include <chrono>
+
+namespace {
+
+constexpr int kW = ChunkTiles::kWidth;
+constexpr int kH = ChunkTiles::kHeight;
+constexpr int kTiles = kW * kH;
+
+// 負の座標でも小さい方へ丸める割り算
+int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+int FloorDiv64(int64_t a, int64_t b) {
+    return static_cast<int>(a >= 0 ? a / b : -((-a + b - 1) / b));
+}
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 縁の添字（上・下・左・右の辺を6つずつ）と、その辺のタイル
+constexpr int kTop = 0;
+constexpr int kBottom = 1;
+constexpr int kLeft = 2;
+constexpr int kRight = 3;
+int EdgeTile(int side, int i) {
+    switch (side) {
+    case kTop: return i;
+    case kBottom: return (kH - 1) * kW + i;
+    case kLeft: return i * kW;
+    default: return i * kW + kW - 1;
+    }
+}
+
+} // namespace
+
+LightMap::LightMap() {
+    for (int i = 0; i < kWorkerThreads; ++i) workers_.emplace_back([this]() { WorkerLoop(); });
+}
+
+LightMap::~LightMap() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex_);
+        stop_ = true;
+    }
+    jobCv_.notify_all();
+    for (std::thread& worker : workers_) worker.join();
+}
+
+void LightMap::WorkerLoop() {
+    for (;;) {
+        bool light = false;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex_);
+            jobCv_.wait(lock, [this]() { return stop_ || lightQueued_ || fovQueued_; });
+            if (stop_) return;
+            light = lightQueued_;
+            (light ? lightQueued_ : fovQueued_) = false;
+        }
+        if (light) {
+            ComputeLight(lightJob_, lightResult_);
+        } else {
+            ComputeFov(fovJob_, fovResult_);
+        }
+        std::lock_guard<std::mutex> lock(jobMutex_);
+        (light ? lightDone_ : fovDone_) = true;
+    }
+}
+
+void LightMap::Set(int cx, int cy, uint64_t opaque, const ChunkTiles& tiles) {
+    Light emission{};
+    for (int y = 0; y < tiles.rowCount; ++y) {
+        for (int x = 0; x < tiles.Width(y); ++x) {
+            auto it = emission_.find(tiles.At(x, y));
+            if (it != emission_.end()) emission[y * kW + x] = it->second;
+        }
+    }
+    auto [it, inserted] = chunks_.try_emplace({ cx, cy });
+    Chunk& chunk = it->second;
+    // タイルの種類を変えただけで光り方も通し方も同じなら計算し直さない
+    if (!inserted && chunk.opaque == opaque && chunk.emission == emission) return;
+    chunk.opaque = opaque;
+    chunk.emission = emission;
+    dirtyChunks_.insert({ cx, cy });
+    if (viewerRadius_ > 0) {
+        int left = FloorDiv(viewerX_ - viewerRadius_, kW);
+        int top = FloorDiv(viewerY_ - viewerRadius_, kH);
+        int right = FloorDiv(viewerX_ + viewerRadius_, kW);
+        int bottom = FloorDiv(viewerY_ + viewerRadius_, kH);
+        if (cx >= left && cx <= right && cy >= top && cy <= bottom) fovDirty_ = true;
+    }
+}
+
+void LightMap::Erase(int cx, int cy) {
+    if (chunks_.erase({ cx, cy }) == 0) return;
+    // 消えたチャンクを通っていた光を、まわりのチャンクから消す
+    dirtyChunks_.insert({ cx, cy });
+    if (viewerRadius_ > 0) {
+        int left = FloorDiv(viewerX_ - viewerRadius_, kW);
+        int top = FloorDiv(viewerY_ - viewerRadius_, kH);
+        int right = FloorDiv(viewerX_ + viewerRadius_, kW);
+        int bottom = FloorDiv(viewerY_ + viewerRadius_, kH);
+        if (cx >= left && cx <= right && cy >= top && cy <= bottom) fovDirty_ = true;
+    }
+}
+
+void LightMap::Clear() {
+    chunks_.clear();
+    dirtyChunks_.clear();
+    fovDirty_ = viewerRadius_ > 0;
+    // 計算中の結果は Update で受け取るが、もう常駐していないチャンクの分は捨てられる
+}
+
+void LightMap::SetViewer(int tileX, int tileY, int radius) {
+    if (tileX == viewerX_ && tileY == viewerY_ && radius == viewerRadius_) return;
+    viewerX_ = tileX;
+    viewerY_ = tileY;
+    viewerRadius_ = std::max(radius, 0);
+    fovDirty_ = viewerRadius_ > 0;
+    if (viewerRadius_ == 0) fov_ = FovResult{};
+}
+
+void LightMap::Update() {
+    bool lightDone = false;
+    bool fovDone = false;
+    {
+        std::lock_guard<std::mutex> lock(jobMutex_);
+        std::swap(lightDone, lightDone_);
+        std::swap(fovDone, fovDone_);
+    }
+    if (lightDone) {
+        lightBusy_ = false;
+        const LightResult& result = lightResult_;
+        for (size_t i = 0; i < result.region.size(); ++i) {
+            auto it = chunks_.find(result.region[i]);
+            // 計算中に解放されたチャンクは捨てる（書き換わったものは次の計算でもう一度直す）
+            if (it == chunks_.end()) continue;
+            it->second.light = result.light[i];
+            it->second.border = BorderOf(it->second);
+        }
+        stats_.lightMs = result.ms;
+        stats_.lightChunks = result.region.size();
+        ++stats_.lightJobs;
+    }
+    if (fovDone) {
+        fovBusy_ = false;
+        std::swap(fov_, fovResult_);
+        stats_.fovMs = fov_.ms;
+        ++stats_.fovJobs;
+        // 計算中に視点が動いていれば、その結果は捨てずに使いながら次を計算する
+    }
+    if (!lightBusy_ && !dirtyChunks_.empty()) StartLightJob();
+    if (!fovBusy_ && fovDirty_ && viewerRadius_ > 0) StartFovJob();
+}
+
+LightMap::Border LightMap::BorderOf(const Chunk& chunk) {
+    Border border{};
+    for (int side = 0; side < 4; ++side) {
+        for (int i = 0; i < kW; ++i) {
+            int t = EdgeTile(side, i);
+            // 光を通さないタイルは照らされても先へは広げない（光源なら広げる）
+            bool spreads = !(chunk.opaque >> t & 1) || chunk.emission[t] > 0;
+            border[side * kW + i] = spreads ? chunk.light[t] : 0;
+        }
+    }
+    return border;
+}
+
+void LightMap::StartLightJob() {
+    // 変わったチャンクから光が届く範囲の常駐チャンクを計算し直す（並べて重複を除く）
+    LightJob& job = lightJob_;
+    job.region.clear();
+    for (const auto& dirty : dirtyChunks_) {
+        for (int dy = -kLightReachChunks; dy <= kLightReachChunks; ++dy) {
+            for (int dx = -kLightReachChunks; dx <= kLightReachChunks; ++dx) {
+                std::pair<int, int> key{ dirty.first + dx, dirty.second + dy };
+                if (chunks_.count(key)) job.region.push_back(key);
+            }
+        }
+    }
+    dirtyChunks_.clear();
+    std::sort(job.region.begin(), job.region.end());
+    job.region.erase(std::unique(job.region.begin(), job.region.end()), job.region.end());
+    if (job.region.empty()) return;
+
+    job.opaque.clear();
+    job.emission.clear();
+    job.neighbors.clear();
+    for (const auto& key : job.region) {
+        const Chunk& chunk = chunks_.at(key);
+        job.opaque.push_back(chunk.opaque);
+        job.emission.push_back(chunk.emission);
+        const std::pair<int, int> around[4] = {
+            { key.first, key.second - 1 }, { key.first, key.second + 1 },
+            { key.first - 1, key.second }, { key.first + 1, key.second } };
+        for (const auto& n : around) {
+            if (!std::binary_search(job.region.begin(), job.region.end(), n) && chunks_.count(n)) {
+                job.neighbors.emplace_back(n, Border{});
+            }
+        }
+    }
+    // 範囲のすぐ外のチャンクは計算し直さず、公開済みの縁の明るさを入力にする
+    auto byKey = [](const auto& a, const auto& b) { return a.first < b.first; };
+    auto sameKey = [](const auto& a, const auto& b) { return a.first == b.first; };
+    std::sort(job.neighbors.begin(), job.neighbors.end(), byKey);
+    job.neighbors.erase(std::unique(job.neighbors.begin(), job.neighbors.end(), sameKey), job.neighbors.end());
+    for (auto& [key, border] : job.neighbors) border = chunks_.at(key).border;
+
+    lightBusy_ = true;
+    {
+        std::lock_guard<std::mutex> lock(jobMutex_);
+        lightQueued_ = true;
+    }
+    jobCv_.notify_one();
+}
+
+void LightMap::ComputeLight(LightJob& job, LightResult& result) {
+    auto start = std::chrono::steady_clock::now();
+    size_t count = job.region.size();
+    // 範囲内のチャンクの添字（範囲外なら -1）
+    auto indexOf = [&job](const std::pair<int, int>& key) {
+        auto it = std::lower_bound(job.region.begin(), job.region.end(), key);
+        return it != job.region.end() && *it == key ? static_cast<int>(it - job.region.begin()) : -1;
+    };
+    // 範囲内のチャンクの上下左右
+    std::vector<std::array<int, 4>>& adjacent = job.adjacent;
+    adjacent.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto [cx, cy] = job.region[i];
+        const std::pair<int, int> around[4] = { { cx, cy - 1 }, { cx, cy + 1 }, { cx - 1, cy }, { cx + 1, cy } };
+        for (int side = 0; side < 4; ++side) adjacent[i][side] = indexOf(around[side]);
+    }
+
+    result.region = job.region;
+    result.light.assign(count, Light{});
+    // 明るさごとのバケツ（明るい方から広げるので、どのタイルも一度確定したら下がらない）
+    std::array<std::vector<int>, kMaxLight + 1>& buckets = job.buckets;
+    for (std::vector<int>& bucket : buckets) bucket.clear();
+    auto raise = [&](int chunk, int tile, int level) {
+        uint8_t& value = result.light[chunk][tile];
+        if (level <= value) return;
+        value = static_cast<uint8_t>(level);
+        buckets[level].push_back(chunk * kTiles + tile);
+    };
+    for (size_t i = 0; i < count; ++i) {
+        int chunk = static_cast<int>(i);
+        for (int t = 0; t < kTiles; ++t) {
+            if (job.emission[i][t] > 0) raise(chunk, t, job.emission[i][t]);
+        }
+    }
+    // 範囲外の隣の縁から入ってくる光
+    for (const auto& [key, border] : job.neighbors) {
+        auto [nx, ny] = key;
+        // 隣のどの辺が、範囲内のどのチャンクのどの辺に接するか
+        const struct { std::pair<int, int> chunk; int from; int to; } contacts[4] = {
+            { { nx, ny + 1 }, kBottom, kTop }, { { nx, ny - 1 }, kTop, kBottom },
+            { { nx + 1, ny }, kRight, kLeft }, { { nx - 1, ny }, kLeft, kRight } };
+        for (const auto& contact : contacts) {
+            int index = indexOf(contact.chunk);
+            if (index < 0) continue;
+            for (int i = 0; i < kW; ++i) {
+                int level = border[contact.from * kW + i] - 1;
+                if (level > 0) raise(index, EdgeTile(contact.to, i), level);
+            }
+        }
+    }
+    for (int level = kMaxLight; level > 1; --level) {
+        // 同じ明るさのタイルを広げている間に、このバケツへは積まれない（積むのは1つ下）
+        std::vector<int>& bucket = buckets[level];
+        for (int id : bucket) {
+            int chunk = id / kTiles;
+            int tile = id % kTiles;
+            if (result.light[chunk][tile] != level) continue;
+            if ((job.opaque[chunk] >> tile & 1) && job.emission[chunk][tile] == 0) continue;
+            int x = tile % kW;
+            int y = tile / kW;
+            int next = level - 1;
+            if (y > 0) raise(chunk, tile - kW, next);
+            else if (adjacent[chunk][kTop] >= 0) raise(adjacent[chunk][kTop], EdgeTile(kBottom, x), next);
+            if (y < kH - 1) raise(chunk, tile + kW, next);
+            else if (adjacent[chunk][kBottom] >= 0) raise(adjacent[chunk][kBottom], EdgeTile(kTop, x), next);
+            if (x > 0) raise(chunk, tile - 1, next);
+            else if (adjacent[chunk][kLeft] >= 0) raise(adjacent[chunk][kLeft], EdgeTile(kRight, y), next);
+            if (x < kW - 1) raise(chunk, tile + 1, next);
+            else if (adjacent[chunk][kRight] >= 0) raise(adjacent[chunk][kRight], EdgeTile(kLeft, y), next);
+        }
+        bucket.clear();
+    }
+    result.ms = MsSince(start);
+}
+
+void LightMap::StartFovJob() {
+    fovDirty_ = false;
+    FovJob& job = fovJob_;
+    job.radius = viewerRadius_;
+    job.size = viewerRadius_ * 2 + 1;
+    job.originX = viewerX_ - viewerRadius_;
+    job.originY = viewerY_ - viewerRadius_;
+    // 読み込み前のチャンクは見通せない
+    job.opaque.assign(static_cast<size_t>(job.size) * job.size, 1);
+    int left = FloorDiv(job.originX, kW);
+    int top = FloorDiv(job.originY, kH);
+    int right = FloorDiv(job.originX + job.size - 1, kW);
+    int bottom = FloorDiv(job.originY + job.size - 1, kH);
+    for (int cy = top; cy <= bottom; ++cy) {
+        for (int cx = left; cx <= right; ++cx) {
+            auto it = chunks_.find({ cx, cy });
+            if (it == chunks_.end()) continue;
+            int x0 = std::max(cx * kW, job.originX);
+            int x1 = std::min(cx * kW + kW, job.originX + job.size);
+            int y0 = std::max(cy * kH, job.originY);
+            int y1 = std::min(cy * kH + kH, job.originY + job.size);
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    int t = (y - cy * kH) * kW + (x - cx * kW);
+                    job.opaque[static_cast<size_t>(y - job.originY) * job.size + (x - job.originX)] =
+                        static_cast<uint8_t>(it->second.opaque >> t & 1);
+                }
+            }
+        }
+    }
+    fovBusy_ = true;
+    {
+        std::lock_guard<std::mutex> lock(jobMutex_);
+        fovQueued_ = true;
+    }
+    jobCv_.notify_one();
+}
+
+void LightMap::ComputeFov(FovJob& job, FovResult& result) {
+    // 対称なシャドウキャスティング（A から B が見えれば B から A も見える）
+    // 4つの象限ごとに、中心から1行ずつ外へ、見通せる傾きの範囲を狭めながら進む
+    auto start = std::chrono::steady_clock::now();
+    result.originX = job.originX;
+    result.originY = job.originY;
+    result.size = job.size;
+    result.visible.assign(static_cast<size_t>(job.size) * job.size, 0);
+    int r = job.radius;
+    int radiusSq = r * r + r; // 円の縁が欠けないよう半タイル分広げる
+    result.visible[static_cast<size_t>(r) * job.size + r] = 1;
+
+    // 象限内の (depth, col) を窓の添字にする
+    auto index = [&](int quadrant, int depth, int col) {
+        int x = r;
+        int y = r;
+        switch (quadrant) {
+        case 0: x += col; y -= depth; break; // 上
+        case 1: x += col; y += depth; break; // 下
+        case 2: x += depth; y += col; break; // 右
+        default: x -= depth; y += col; break; // 左
+        }
+        return static_cast<size_t>(y) * job.size + x;
+    };
+    // depth * slope を、ちょうど半分のときは大きい方／小さい方へ丸める
+    auto roundTiesUp = [](int depth, Slope s) { return FloorDiv64(int64_t{ 2 } * depth * s.num + s.den, int64_t{ 2 } * s.den); };
+    auto roundTiesDown = [](int depth, Slope s) { return -FloorDiv64(-(int64_t{ 2 } * depth * s.num - s.den), int64_t{ 2 } * s.den); };
+
+    std::vector<FovRow>& stack = job.stack;
+    stack.clear();
+    for (int quadrant = 0; quadrant < 4; ++quadrant) {
+        stack.push_back({ 1, { -1, 1 }, { 1, 1 } });
+        while (!stack.empty()) {
+            FovRow row = stack.back();
+            stack.pop_back();
+            if (row.depth > r) continue;
+            int minCol = roundTiesUp(row.depth, row.start);
+            int maxCol = roundTiesDown(row.depth, row.end);
+            // 前のタイル（-1: なし、0: 床、1: 壁）
+            int prev = -1;
+            for (int col = minCol; col <= maxCol; ++col) {
+                size_t i = index(quadrant, row.depth, col);
+                int wall = job.opaque[i];
+                bool inRange = row.depth * row.depth + col * col <= radiusSq;
+                // 床は中心線が傾きの範囲に入っているときだけ見える（対称になる）
+                bool symmetric = int64_t{ col } * row.start.den >= int64_t{ row.depth } * row.start.num &&
+                    int64_t{ col } * row.end.den <= int64_t{ row.depth } * row.end.num;
+                if (inRange && (wall || symmetric)) result.visible[i] = 1;
+                Slope tileSlope{ 2 * col - 1, 2 * row.depth };
+                if (prev == 1 && !wall) row.start = tileSlope;
+                if (prev == 0 && wall) stack.push_back({ row.depth + 1, row.start, tileSlope });
+                prev = wall;
+            }
+            if (prev == 0) stack.push_back({ row.depth + 1, row.start, row.end });
+        }
+    }
+    result.ms = MsSince(start);
+}
+
+int LightMap::LightAt(int x, int y) const {
+    const Light* light = ChunkLight(FloorDiv(x, kW), FloorDiv(y, kH));
+    if (!light) return 0;
+    return (*light)[(y - FloorDiv(y, kH) * kH) * kW + (x - FloorDiv(x, kW) * kW)];
+}
+
+const LightMap::Light* LightMap::ChunkLight(int cx, int cy) const {
+    auto it = chunks_.find({ cx, cy });
+    return it != chunks_.end() ? &it->second.light : nullptr;
+}
+
+bool LightMap::Visible(int x, int y) const {
+    if (fov_.size == 0) return true;
+    int lx = x - fov_.originX;
+    int ly = y - fov_.originY;
+    if (lx < 0 || ly < 0 || lx >= fov_.size || ly >= fov_.size) return false;
+    return fov_.visible[static_cast<size_t>(ly) * fov_.size + lx] != 0;
+}
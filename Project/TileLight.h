@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ChunkLoader.h"
+
+// 常駐チャンクの明るさ（光源からの塗りつぶし）と、見ている位置からの視界（シャドウキャスティング）
+// 計算は作業スレッドで行い、結果は Update で公開する（Draw は公開済みの値だけを読むので待たない）
+// 計算の入力・結果・作業領域は使い回し、常駐チャンクの表はプールから確保する（読み込みのたびに確保しない）
+// 明るさはチャンクが読み込まれた・解放された・書き換わったときに、光が届きうる範囲（kLightReachChunks）だけを計算し直す
+class LightMap {
+public:
+    static constexpr int kMaxLight = 15;
+    // 光は1タイル進むごとに1暗くなるので、変化の影響はこのチャンク数の範囲に収まる
+    static constexpr int kLightReachChunks = (kMaxLight + ChunkTiles::kWidth - 1) / ChunkTiles::kWidth;
+
+    LightMap();
+    ~LightMap();
+    LightMap(const LightMap&) = delete;
+    LightMap& operator=(const LightMap&) = delete;
+
+    // タイル番号ごとの光源の明るさ（0 なら光らない）。変えたら読み込み済みのチャンクを Set し直す
+    void SetEmission(int tile, int level) { emission_[tile] = static_cast<uint8_t>(std::clamp(level, 0, kMaxLight)); }
+    // チャンクの内容（opaque は光と視線を通さないタイル。ビット y * 6 + x）
+    void Set(int cx, int cy, uint64_t opaque, const ChunkTiles& tiles);
+    void Erase(int cx, int cy);
+    void Clear();
+
+    // 視界の中心と半径（タイル）。動いたら作り直す
+    void SetViewer(int tileX, int tileY, int radius);
+
+    // 終わった計算を公開し、たまった変更の計算を始める（毎フレーム呼ぶ）
+    void Update();
+
+    using Light = std::array<uint8_t, ChunkTiles::kWidth * ChunkTiles::kHeight>;
+    // 公開済みの明るさ（0 - kMaxLight。読み込み前や計算前のチャンクは 0）
+    int LightAt(int x, int y) const;
+    // チャンクの公開済みの明るさ（タイル y * 6 + x。常駐していなければ nullptr）。描画でタイルごとに引かないため
+    const Light* ChunkLight(int cx, int cy) const;
+    // 公開済みの視界に入っているか（視界を計算していなければすべて見える）
+    bool Visible(int x, int y) const;
+
+    struct Stats {
+        double lightMs = 0.0;      // 最後の明るさの計算（作業スレッドでの時間）
+        size_t lightChunks = 0;    // 最後に計算し直したチャンク数
+        size_t lightJobs = 0;      // 公開した明るさの計算の回数
+        double fovMs = 0.0;        // 最後の視界の計算
+        size_t fovJobs = 0;
+    };
+    const Stats& GetStats() const { return stats_; }
+
+private:
+    using Border = std::array<uint8_t, 4 * ChunkTiles::kWidth>;
+    struct Chunk {
+        uint64_t opaque = 0;
+        Light emission{};
+        Light light{}; // 公開済み
+        // 縁から外へ出ていく明るさ（上・下・左・右の辺を6つずつ）。隣のチャンクを計算し直すときの入力になる
+        Border border{};
+    };
+
+    // 作業スレッドに渡す明るさの計算（チャンクの内容と、範囲のすぐ外のチャンクの縁を写して渡す）
+    struct LightJob {
+        std::vector<std::pair<int, int>> region; // 並べてある（二分探索で引く）
+        std::vector<uint64_t> opaque;
+        std::vector<Light> emission;
+        std::vector<std::pair<std::pair<int, int>, Border>> neighbors;
+        // 作業領域（範囲内のチャンクの上下左右と、明るさごとのバケツ）
+        std::vector<std::array<int, 4>> adjacent;
+        std::array<std::vector<int>, kMaxLight + 1> buckets;
+    };
+    struct LightResult {
+        std::vector<std::pair<int, int>> region;
+        std::vector<Light> light;
+        double ms = 0.0;
+    };
+    // 視界の傾き（分数 num / den。den は正）
+    struct Slope {
+        int num;
+        int den;
+    };
+    // 視界の1行（中心からの距離 depth の行のうち、傾き start から end の間）
+    struct FovRow {
+        int depth;
+        Slope start;
+        Slope end;
+    };
+    // 視界の計算（中心のまわり (2r+1) 四方の通さないタイルを写して渡す）
+    struct FovJob {
+        int originX = 0;
+        int originY = 0;
+        int size = 0;
+        int radius = 0;
+        std::vector<uint8_t> opaque;
+        std::vector<FovRow> stack; // 作業領域
+    };
+    struct FovResult {
+        int originX = 0;
+        int originY = 0;
+        int size = 0;
+        std::vector<uint8_t> visible;
+        double ms = 0.0;
+    };
+
+    static void ComputeLight(LightJob& job, LightResult& result);
+    static void ComputeFov(FovJob& job, FovResult& result);
+    static Border BorderOf(const Chunk& chunk);
+    void StartLightJob();
+    void StartFovJob();
+    void WorkerLoop();
+
+    std::unordered_map<int, uint8_t> emission_;
+    // 常駐チャンクの表の節はこのプールから確保する（ゲームループのスレッドだけが使う）
+    std::pmr::unsynchronized_pool_resource pool_;
+    std::pmr::unordered_map<std::pair<int, int>, Chunk, PairHash> chunks_{ &pool_ };
+    std::pmr::unordered_set<std::pair<int, int>, PairHash> dirtyChunks_{ &pool_ };
+
+    int viewerX_ = 0;
+    int viewerY_ = 0;
+    int viewerRadius_ = 0;
+    bool fovDirty_ = false;
+    FovResult fov_; // 公開済み（受け取った結果と入れ替え、前の結果の置き場を次の計算に使う）
+
+    Stats stats_;
+
+    // 計算の入力と結果。計算中（*Busy_）は作業スレッドだけが触る
+    LightJob lightJob_;
+    LightResult lightResult_;
+    FovJob fovJob_;
+    FovResult fovResult_;
+    bool lightBusy_ = false;
+    bool fovBusy_ = false;
+
+    std::vector<std::thread> workers_;
+    std::mutex jobMutex_;
+    std::condition_variable jobCv_;
+    // 以下は jobMutex_ で守る（Queued: 作業スレッドへ渡した、Done: 計算が終わった）
+    bool lightQueued_ = false;
+    bool fovQueued_ = false;
+    bool lightDone_ = false;
+    bool fovDone_ = false;
+    bool stop_ = false;
+
+    // 明るさと視界を同時に計算できるよう2本
+    static constexpr int kWorkerThreads = 2;
+};
@@ -0,0 +1,109 @@
+#include "TileLod.h"
+#include <fstream>
+
+int LodReducer::Priority(int tile) const {
+    auto found = priorities_.find(tile);
+    return found != priorities_.end() ? found->second : tile;
+}
+
+int LodReducer::Reduce(const int* values, int count) const {
+    int best = values[0];
+    if (mode_ == LodReduce::Priority) {
+        for (int i = 1; i < count; ++i) {
+            if (Priority(values[i]) > Priority(best)) best = values[i];
+        }
+        return best;
+    }
+    // ブロックは最大36タイルなので、値ごとに数え直しても十分速い
+    int bestCount = 0;
+    for (int i = 0; i < count; ++i) {
+        int n = 0;
+        for (int j = 0; j < count; ++j) n += values[j] == values[i];
+        if (n > bestCount || (n == bestCount && Priority(values[i]) > Priority(best))) {
+            best = values[i];
+            bestCount = n;
+        }
+    }
+    return best;
+}
+
+ChunkLod LodReducer::Build(const ChunkTiles& tiles) const {
+    ChunkLod lod;
+    // 行の幅より右は空タイル（cells は 0 のまま）
+    for (int y = 0; y < TileLod::kLevel1Height; ++y) {
+        for (int x = 0; x < TileLod::kLevel1Width; ++x) {
+            int block[4] = {
+                tiles.At(x * 2, y * 2), tiles.At(x * 2 + 1, y * 2),
+                tiles.At(x * 2, y * 2 + 1), tiles.At(x * 2 + 1, y * 2 + 1),
+            };
+            lod.level1[y * TileLod::kLevel1Width + x] = Reduce(block, 4);
+        }
+    }
+    lod.level2 = Reduce(tiles.cells.data(), static_cast<int>(tiles.cells.size()));
+    return lod;
+}
+
+void OverviewMap::Set(int cx, int cy, int value) {
+    auto [it, inserted] = levels_[0].try_emplace({ cx, cy }, value);
+    if (!inserted) {
+        if (it->second == value) return;
+        it->second = value;
+    }
+    // 祖先のブロックは負の座標でも床除算になるよう算術シフトで求める
+    for (int level = TileLod::kChunkLevel + 1; level <= TileLod::kMaxLevel; ++level) {
+        int shift = level - TileLod::kChunkLevel;
+        Rebuild(level, cx >> shift, cy >> shift);
+    }
+}
+
+void OverviewMap::Rebuild(int level, int bx, int by) {
+    const auto& children = levels_[level - 1 - TileLod::kChunkLevel];
+    int values[4];
+    int count = 0;
+    for (int dy = 0; dy < 2; ++dy) {
+        for (int dx = 0; dx < 2; ++dx) {
+            auto found = children.find({ bx * 2 + dx, by * 2 + dy });
+            if (found != children.end()) values[count++] = found->second;
+        }
+    }
+    auto& blocks = levels_[level - TileLod::kChunkLevel];
+    if (count == 0) {
+        blocks.erase({ bx, by });
+    } else {
+        blocks[{ bx, by }] = reducer_.Reduce(values, count);
+    }
+}
+
+std::optional<int> OverviewMap::At(int level, int bx, int by) const {
+    if (level < TileLod::kChunkLevel || level > TileLod::kMaxLevel) return std::nullopt;
+    const auto& blocks = levels_[level - TileLod::kChunkLevel];
+    auto found = blocks.find({ bx, by });
+    if (found == blocks.end()) return std::nullopt;
+    return found->second;
+}
+
+void OverviewMap::Clear() {
+    for (auto& blocks : levels_) blocks.clear();
+}
+
+bool OverviewMap::Save(const std::filesystem::path& path) const {
+    json chunks = json::array();
+    for (const auto& [key, value] : levels_[0]) chunks.push_back({ key.first, key.second, value });
+    std::ofstream ofs(path);
+    if (!ofs) return false;
+    ofs << json{ { "chunks", chunks } }.dump();
+    return static_cast<bool>(ofs);
+}
+
+bool OverviewMap::Load(const std::filesystem::path& path) {
+    std::ifstream ifs(path);
+    if (!ifs) return false;
+    json j = json::parse(ifs, nullptr, false);
+    if (!j.is_object() || !j.contains("chunks")) return false;
+    Clear();
+    for (const auto& entry : j["chunks"]) {
+        if (!entry.is_array() || entry.size() != 3) continue;
+        Set(entry[0].get<int>(), entry[1].get<int>(), entry[2].get<int>());
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <memory_resource>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include "ChunkLoader.h"
+
+// 縮小表示でブロック内のタイルを1つにまとめる方法
+enum class LodReduce {
+    Majority, // 最も多いタイル（同数なら優先度の高い方）
+    Priority, // 優先度の最も高いタイル（細い壁や点在するアイテムも消えない）
+};
+
+// 縮小表示のレベル。1ブロックが何タイル四方か
+//   0: 1タイル, 1: 2タイル（チャンク内 3x3）, 2: 6タイル（チャンクに1つ）
+//   3 以上: レベル-1 の 2x2 ブロック（2^(level-2) チャンク四方）
+struct TileLod {
+    static constexpr int kChunkLevel = 2;
+    static constexpr int kMaxLevel = 8;
+    static constexpr int kLevel1Width = ChunkTiles::kWidth / 2;
+    static constexpr int kLevel1Height = ChunkTiles::kHeight / 2;
+
+    static int BlockTiles(int level) {
+        if (level <= 0) return 1;
+        if (level == 1) return 2;
+        return ChunkTiles::kWidth << (level - kChunkLevel);
+    }
+};
+
+// チャンク内の縮小レベル（読み込み時に1回だけ作る）
+struct ChunkLod {
+    std::array<int, TileLod::kLevel1Width * TileLod::kLevel1Height> level1{};
+    int level2 = 0;
+
+    int Level1At(int x, int y) const { return level1[y * TileLod::kLevel1Width + x]; }
+};
+
+// タイルのまとめ方と優先度（既定の優先度はタイル番号そのもの。0 の空タイルが最も低い）
+class LodReducer {
+public:
+    void SetMode(LodReduce mode) { mode_ = mode; }
+    void SetPriority(int tile, int priority) { priorities_[tile] = priority; }
+
+    ChunkLod Build(const ChunkTiles& tiles) const;
+    // count 個の値を1つにまとめる（count は 36 以下）
+    int Reduce(const int* values, int count) const;
+
+private:
+    int Priority(int tile) const;
+
+    LodReduce mode_ = LodReduce::Priority;
+    std::unordered_map<int, int> priorities_;
+};
+
+// チャンクより粗いレベル（2 以上）の縮小地図
+// チャンクを解放しても値を残すので、常駐範囲の外の遠くの地域も描ける
+// 1チャンクの更新では、そのチャンクを含む上位のブロックだけを計算し直す
+class OverviewMap {
+public:
+    explicit OverviewMap(const LodReducer& reducer)
+        : reducer_(reducer), levels_(MakeLevels(&pool_, std::make_index_sequence<kLevelCount>())) {}
+    OverviewMap(const OverviewMap&) = delete;
+    OverviewMap& operator=(const OverviewMap&) = delete;
+
+    // レベル2（チャンク1つ）の値を設定し、上位のレベルへ反映する
+    void Set(int cx, int cy, int value);
+    // ブロック座標 (bx, by) の値。まだ何も分かっていなければ nullopt
+    std::optional<int> At(int level, int bx, int by) const;
+    bool Contains(int cx, int cy) const { return levels_[0].count({ cx, cy }) > 0; }
+    size_t ChunkCount() const { return levels_[0].size(); }
+    void Clear();
+
+    // レベル2の値だけを保存し、読み込み時に上位を作り直す
+    bool Save(const std::filesystem::path& path) const;
+    bool Load(const std::filesystem::path& path);
+
+private:
+    static constexpr size_t kLevelCount = TileLod::kMaxLevel - TileLod::kChunkLevel + 1;
+    using Blocks = std::pmr::unordered_map<std::pair<int, int>, int, PairHash>;
+    using Levels = std::array<Blocks, kLevelCount>;
+
+    template <size_t... I>
+    static Levels MakeLevels(std::pmr::memory_resource* resource, std::index_sequence<I...>) {
+        return { ((void)I, Blocks(resource))... };
+    }
+    void Rebuild(int level, int bx, int by);
+
+    const LodReducer& reducer_;
+    // 探索するほど増えていくブロックの節は、まとめて確保するプールから取る
+    std::pmr::unsynchronized_pool_resource pool_;
+    // levels_[i] がレベル kChunkLevel + i
+    Levels levels_;
+};
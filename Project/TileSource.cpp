@@ -0,0 +1,224 @@
+#include "TileSource.h"
+#include <algorithm>
+#include <fstream>
+#include "CsvTileParser.h"
+
+bool TileSource::Load(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles) {
+    auto start = std::chrono::steady_clock::now();
+    bool hit = DoLoad(cx, cy, ticket, tiles);
+    Record(hit, start);
+    return hit;
+}
+
+void TileSource::Record(bool hit, std::chrono::steady_clock::time_point start) {
+    (hit ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+    latency_.Record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+double TileSource::HitRate() const {
+    uint64_t hits = Hits();
+    uint64_t total = hits + Misses();
+    return total ? static_cast<double>(hits) / static_cast<double>(total) : 0.0;
+}
+
+nlohmann::json TileSource::StatsJson() const {
+    return {
+        { "name", Name() },
+        { "hits", Hits() },
+        { "misses", Misses() },
+        { "hit_rate", HitRate() },
+        { "latency", latency_.ToJson() },
+    };
+}
+
+bool SheetsSource::DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles) {
+    if (!online_) return false;
+    // 追加レイヤーがあれば全レイヤーを1リクエストで取得する
+    std::optional<std::vector<TileData>> layers = loader_.LoadLayersFromSheet(cx, cy, ticket);
+    if (!layers) return false;
+    tiles.Assign(layers->front());
+    tiles.overlays.resize(layers->size() - 1);
+    for (size_t i = 1; i < layers->size(); ++i) tiles.overlays[i - 1].Assign((*layers)[i]);
+    return true;
+}
+
+void DiskCacheSource::Store(int cx, int cy, const ChunkTiles& tiles) {
+    // 内容が変わっていなければマニフェストの更新だけで、キャッシュの書き込みは省かれる
+    if (requireFresh_) loader_.CommitChunk(cx, cy, tiles);
+}
+
+bool DiskCacheSource::DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>&, ChunkTiles& tiles) {
+    if (requireFresh_ ? !loader_.IsChunkFresh(cx, cy) : !loader_.HasChunkCache(cx, cy)) return false;
+    size_t overlayCount = loader_.GetLayers().size();
+    // 追加レイヤーの定義を変えた後など、レイヤーのファイルが揃っていなければシートから取り直す
+    if (requireFresh_) {
+        for (size_t i = 1; i <= overlayCount; ++i) {
+            if (!loader_.HasLayerCache(cx, cy, static_cast<int>(i))) return false;
+        }
+    }
+    // 壊れたファイルがあれば答えず、次の層（シート）に任せる
+    // ファイルは tiles へ直接読む（途中の TileData を作らない）
+    if (!loader_.LoadChunkCache(cx, cy, tiles)) return false;
+    tiles.overlays.resize(overlayCount);
+    for (size_t i = 1; i <= overlayCount; ++i) {
+        ChunkTiles& overlay = tiles.overlays[i - 1];
+        if (loader_.LoadChunkCache(cx, cy, overlay, static_cast<int>(i))) continue;
+        if (loader_.HasLayerCache(cx, cy, static_cast<int>(i))) return false;
+        overlay.Clear();
+    }
+    return true;
+}
+
+FileSource::FileSource(const std::filesystem::path& path) {
+    if (path.extension() == WorldPackFormat::kExtension) {
+        open_ = pack_.Open(path);
+        return;
+    }
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return;
+    CsvTileParser parser([this](int cx, int cy, ChunkTiles&& tiles) {
+        // 空のチャンクは持たなくても同じ答えになる
+        if (!tiles.Empty()) chunks_.emplace(std::make_pair(cx, cy), std::move(tiles));
+    }, path.extension() == ".tsv" ? '\t' : ',');
+    std::vector<char> buffer(1 << 20);
+    while (ifs.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || ifs.gcount() > 0) {
+        parser.Feed(buffer.data(), static_cast<size_t>(ifs.gcount()));
+    }
+    parser.Finish();
+    open_ = true;
+}
+
+bool FileSource::DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>&, ChunkTiles& tiles) {
+    if (!open_) return false;
+    if (pack_.IsOpen()) {
+        // 索引にない（範囲外の）チャンクは空。記録が壊れていれば答えない
+        if (!pack_.Contains(cx, cy)) {
+            tiles.Clear();
+            return true;
+        }
+        std::optional<ChunkTiles> read = pack_.Read(cx, cy);
+        if (!read) return false;
+        tiles = std::move(*read);
+        return true;
+    }
+    auto found = chunks_.find({ cx, cy });
+    if (found != chunks_.end()) {
+        tiles = found->second;
+    } else {
+        tiles.Clear();
+    }
+    return true;
+}
+
+bool GeneratorSource::DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>&, ChunkTiles& tiles) {
+    tiles.Clear();
+    int originX = cx * ChunkTiles::kWidth;
+    int originY = cy * ChunkTiles::kHeight;
+    if (cx < 0 || cy < 0 || originX >= widthTiles_ || originY >= heightTiles_) return true;
+    int width = std::min(ChunkTiles::kWidth, widthTiles_ - originX);
+    tiles.rowCount = std::min(ChunkTiles::kHeight, heightTiles_ - originY);
+    for (int y = 0; y < tiles.rowCount; ++y) {
+        tiles.rowWidths[y] = static_cast<uint8_t>(width);
+        for (int x = 0; x < width; ++x) {
+            tiles.cells[y * ChunkTiles::kWidth + x] = generator_(originX + x, originY + y);
+        }
+    }
+    return true;
+}
+
+void MemorySource::Store(int cx, int cy, const ChunkTiles& tiles) {
+    if (capacity_ == 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto key = std::make_pair(cx, cy);
+    auto found = entries_.find(key);
+    if (found != entries_.end()) {
+        found->second->second = tiles;
+        lru_.splice(lru_.begin(), lru_, found->second);
+        return;
+    }
+    if (lru_.size() >= capacity_) {
+        // 一番古い項目を上書きして先頭へ移す（節と追加レイヤーの確保を使い回す）
+        auto oldest = std::prev(lru_.end());
+        entries_.erase(oldest->first);
+        oldest->first = key;
+        oldest->second = tiles;
+        lru_.splice(lru_.begin(), lru_, oldest);
+    } else {
+        lru_.emplace_front(key, tiles);
+    }
+    entries_[key] = lru_.begin();
+}
+
+void MemorySource::Invalidate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    entries_.clear();
+}
+
+void MemorySource::InvalidateChunk(int cx, int cy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find({ cx, cy });
+    if (found == entries_.end()) return;
+    lru_.erase(found->second);
+    entries_.erase(found);
+}
+
+bool MemorySource::DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>&, ChunkTiles& tiles) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find({ cx, cy });
+    if (found == entries_.end()) return false;
+    lru_.splice(lru_.begin(), lru_, found->second);
+    tiles = found->second->second;
+    return true;
+}
+
+bool CachedSource::Resolve(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles,
+    const TileSource** answeredBy) {
+    auto start = std::chrono::steady_clock::now();
+    bool hit = ResolveLayers(cx, cy, ticket, tiles, answeredBy);
+    Record(hit, start);
+    return hit;
+}
+
+bool CachedSource::ResolveLayers(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles,
+    const TileSource** answeredBy) {
+    if (answeredBy) *answeredBy = nullptr;
+    for (size_t i = 0; i < layers_.size(); ++i) {
+        // 待っている間に範囲外へ出たチャンクは、下の（遅い）層まで問い合わせない
+        if (ticket && ticket->cancelled) return false;
+        if (!layers_[i]->Load(cx, cy, ticket, tiles)) continue;
+        for (size_t upper = 0; upper < i; ++upper) layers_[upper]->Store(cx, cy, tiles);
+        if (answeredBy) *answeredBy = layers_[i].get();
+        return true;
+    }
+    if (!fallback_) return false;
+    bool hit = fallback_->Load(cx, cy, ticket, tiles);
+    if (hit && answeredBy) *answeredBy = fallback_.get();
+    return hit;
+}
+
+void CachedSource::Invalidate() {
+    for (const auto& layer : layers_) layer->Invalidate();
+    if (fallback_) fallback_->Invalidate();
+}
+
+void CachedSource::InvalidateChunk(int cx, int cy) {
+    for (const auto& layer : layers_) layer->InvalidateChunk(cx, cy);
+    if (fallback_) fallback_->InvalidateChunk(cx, cy);
+}
+
+bool CachedSource::IsRemote() const {
+    return std::any_of(layers_.begin(), layers_.end(), [](const auto& layer) { return layer->IsRemote(); });
+}
+
+std::vector<const TileSource*> CachedSource::Layers() const {
+    std::vector<const TileSource*> layers;
+    ForEachLayer([&layers](const TileSource& layer) { layers.push_back(&layer); });
+    return layers;
+}
+
+nlohmann::json CachedSource::LayersJson() const {
+    nlohmann::json layers = nlohmann::json::array();
+    for (const TileSource* layer : Layers()) layers.push_back(layer->StatsJson());
+    return layers;
+}
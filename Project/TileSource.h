@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "ChunkLoader.h"
+#include "PipelineStats.h"
+#include "WorldPack.h"
+
+// チャンクの取得元。Load は複数の読み込みスレッドから同時に呼ばれる
+// 取得元ごとに、答えられた割合（ヒット率）と答えるまでの時間を記録する
+class TileSource {
+public:
+    virtual ~TileSource() = default;
+
+    // 答えられたら tiles に書いて true。答えられなければ false（持っていない、未検証、オフライン、通信失敗、取り消しなど）
+    // tiles は呼び出し側が用意する。追加レイヤーは tiles のメモリリソースから確保され、写さずに呼び出し側へ渡る
+    // false のときの tiles の中身は決まっていない
+    bool Load(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles);
+    // 下の層から得た内容を受け取る（キャッシュとして働く取得元だけが保存する）
+    virtual void Store(int, int, const ChunkTiles&) {}
+    // シートのリビジョンが変わったときに呼ぶ（保持している内容を捨てる）
+    virtual void Invalidate() {}
+    // (cx, cy) の内容だけがシートで変わったときに呼ぶ
+    virtual void InvalidateChunk(int, int) {}
+
+    virtual const char* Name() const = 0;
+    // 通信を伴う取得元か（キャッシュヒット率の集計と、起動時のオンライン確認の要否に使う）
+    virtual bool IsRemote() const { return false; }
+
+    uint64_t Hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t Misses() const { return misses_.load(std::memory_order_relaxed); }
+    double HitRate() const;
+    const LatencyHistogram& Latency() const { return latency_; }
+    nlohmann::json StatsJson() const;
+
+protected:
+    virtual bool DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles) = 0;
+    // 1回の問い合わせの結果を記録する
+    void Record(bool hit, std::chrono::steady_clock::time_point start);
+
+private:
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    LatencyHistogram latency_;
+};
+
+// Sheets API から1チャンクずつ取得する
+class SheetsSource : public TileSource {
+public:
+    explicit SheetsSource(ChunkLoader& loader) : loader_(loader) {}
+
+    // オフラインの間は通信せずに nullopt を返す
+    void SetOnline(bool online) { online_ = online; }
+
+    const char* Name() const override { return "sheets"; }
+    bool IsRemote() const override { return true; }
+
+protected:
+    bool DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles) override;
+
+private:
+    ChunkLoader& loader_;
+    std::atomic<bool> online_ = true;
+};
+
+// ディスクキャッシュ（ChunkLoader のキャッシュディレクトリ）
+class DiskCacheSource : public TileSource {
+public:
+    // requireFresh: 現在のリビジョンで検証済みのチャンクだけ答え、受け取った内容を保存する
+    //               false なら古いキャッシュでも答え、保存はしない（オフライン時や通信失敗時の代わり）
+    DiskCacheSource(ChunkLoader& loader, bool requireFresh) : loader_(loader), requireFresh_(requireFresh) {}
+
+    void Store(int cx, int cy, const ChunkTiles& tiles) override;
+    const char* Name() const override { return requireFresh_ ? "disk" : "disk-stale"; }
+
+protected:
+    bool DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles) override;
+
+private:
+    ChunkLoader& loader_;
+    bool requireFresh_;
+};
+
+// 手元のファイル（シートの CSV/TSV エクスポート、または事前に焼いた .trwp）
+// ファイルが世界全体を表すので、ファイルにないチャンクは空として答える
+class FileSource : public TileSource {
+public:
+    explicit FileSource(const std::filesystem::path& path);
+
+    // 読み込めなかったファイルは何も答えない
+    bool IsOpen() const { return open_; }
+    size_t ChunkCount() const { return pack_.IsOpen() ? pack_.Count() : chunks_.size(); }
+
+    const char* Name() const override { return "file"; }
+
+protected:
+    bool DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles) override;
+
+private:
+    bool open_ = false;
+    // .trwp は索引だけ読み、チャンクは必要なときにファイルから読む
+    WorldPackReader pack_;
+    // CSV/TSV は開くときに全体を解析しておく
+    std::unordered_map<std::pair<int, int>, ChunkTiles, PairHash> chunks_;
+};
+
+// 関数からタイルを作る（手続き生成の地形、負荷試験、シートなしでの動作確認）
+class GeneratorSource : public TileSource {
+public:
+    using Generator = std::function<int(int tileX, int tileY)>;
+
+    // (0, 0) から widthTiles × heightTiles の範囲を生成する（範囲外は空のチャンク）
+    GeneratorSource(Generator generator, int widthTiles, int heightTiles)
+        : generator_(std::move(generator)), widthTiles_(widthTiles), heightTiles_(heightTiles) {}
+
+    const char* Name() const override { return "generator"; }
+
+protected:
+    bool DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles) override;
+
+private:
+    Generator generator_;
+    int widthTiles_;
+    int heightTiles_;
+};
+
+// 最近使ったチャンクをメモリに置く（範囲外に出て解放されたチャンクへ戻ったときに使う）
+class MemorySource : public TileSource {
+public:
+    explicit MemorySource(size_t capacity) : capacity_(capacity) { entries_.reserve(capacity); }
+
+    void Store(int cx, int cy, const ChunkTiles& tiles) override;
+    void Invalidate() override;
+    void InvalidateChunk(int cx, int cy) override;
+    const char* Name() const override { return "memory"; }
+
+protected:
+    bool DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles) override;
+
+private:
+    using Entry = std::pair<std::pair<int, int>, ChunkTiles>;
+
+    size_t capacity_;
+    std::mutex mutex_;
+    // 項目（リストの節と追加レイヤー）と索引はこのプールから確保する（mutex_ の中でだけ使う）
+    // 容量に達した後は、追い出す項目の節と追加レイヤーを次の項目に使い回す
+    std::pmr::unsynchronized_pool_resource pool_;
+    // 先頭が最近使ったもの
+    std::pmr::list<Entry> lru_{ &pool_ };
+    std::pmr::unordered_map<std::pair<int, int>, std::pmr::list<Entry>::iterator, PairHash> entries_{ &pool_ };
+};
+
+// 取得元を速い順に重ねたもの（メモリ → ディスク → ネットワークなど）
+// 上の層から順に問い合わせ、最初に答えた層の内容をそれより上の層へ保存する
+// fallback はどの層も答えられなかったときだけ問い合わせ、上の層へは保存しない（古いキャッシュなど）
+class CachedSource : public TileSource {
+public:
+    explicit CachedSource(std::vector<std::shared_ptr<TileSource>> layers, std::shared_ptr<TileSource> fallback = nullptr)
+        : layers_(std::move(layers)), fallback_(std::move(fallback)) {}
+
+    // answeredBy には答えた層が入る（どれも答えなければ nullptr）
+    bool Resolve(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles,
+        const TileSource** answeredBy);
+
+    void Invalidate() override;
+    void InvalidateChunk(int cx, int cy) override;
+    const char* Name() const override { return "cached"; }
+    bool IsRemote() const override;
+
+    // 上の層から順に、fallback は最後
+    std::vector<const TileSource*> Layers() const;
+    // Layers と同じ順に f(const TileSource&) を呼ぶ（毎フレームの表示で一覧を作らない）
+    template <typename F>
+    void ForEachLayer(F&& f) const {
+        for (const auto& layer : layers_) f(static_cast<const TileSource&>(*layer));
+        if (fallback_) f(static_cast<const TileSource&>(*fallback_));
+    }
+    // 層ごとの統計
+    nlohmann::json LayersJson() const;
+
+protected:
+    bool DoLoad(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles) override {
+        return ResolveLayers(cx, cy, ticket, tiles, nullptr);
+    }
+
+private:
+    bool ResolveLayers(int cx, int cy, const std::shared_ptr<LoadTicket>& ticket, ChunkTiles& tiles,
+        const TileSource** answeredBy);
+
+    std::vector<std::shared_ptr<TileSource>> layers_;
+    std::shared_ptr<TileSource> fallback_;
+};
@@ -0,0 +1,89 @@
+#include "TraceRecorder.h"
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+TraceRecorder::TraceRecorder(size_t capacity)
+    : origin_(Clock::now())
+    , capacity_(capacity) {
+}
+
+void TraceRecorder::SetEnabled(bool enabled) {
+    if (enabled) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.clear();
+        events_.reserve(capacity_);
+        next_ = 0;
+    }
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void TraceRecorder::Record(const char* name, Clock::time_point start, Clock::time_point end,
+    bool hasChunk, int chunkX, int chunkY) {
+    if (!IsEnabled()) return;
+    Event event{
+        name,
+        std::chrono::duration_cast<std::chrono::microseconds>(start - origin_).count(),
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(),
+        CurrentThreadId(),
+        hasChunk,
+        chunkX,
+        chunkY,
+    };
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (events_.size() < capacity_) {
+        events_.push_back(event);
+    } else {
+        events_[next_] = event;
+        next_ = (next_ + 1) % capacity_;
+    }
+}
+
+bool TraceRecorder::SaveJson(const std::filesystem::path& path) const {
+    nlohmann::json events = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // リングバッファを古い順に並べる
+        for (size_t i = 0; i < events_.size(); ++i) {
+            const Event& e = events_[(next_ + i) % events_.size()];
+            nlohmann::json event = {
+                { "name", e.name },
+                { "cat", "chunk" },
+                { "ph", "X" },
+                { "ts", e.startUs },
+                { "dur", e.durationUs },
+                { "pid", 1 },
+                { "tid", e.threadId },
+            };
+            if (e.hasChunk) event["args"] = { { "cx", e.chunkX }, { "cy", e.chunkY } };
+            events.push_back(std::move(event));
+        }
+    }
+    std::ofstream ofs(path);
+    if (!ofs) return false;
+    ofs << nlohmann::json{ { "traceEvents", events }, { "displayTimeUnit", "ms" } }.dump();
+    return static_cast<bool>(ofs);
+}
+
+uint32_t TraceRecorder::CurrentThreadId() {
+    static std::atomic<uint32_t> nextId = 1;
+    thread_local uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+TraceSpan::TraceSpan(TraceRecorder& recorder, const char* name)
+    : name_(name) {
+    if (!recorder.IsEnabled()) return;
+    recorder_ = &recorder;
+    start_ = TraceRecorder::Clock::now();
+}
+
+TraceSpan::TraceSpan(TraceRecorder& recorder, const char* name, int chunkX, int chunkY)
+    : TraceSpan(recorder, name) {
+    hasChunk_ = true;
+    chunkX_ = chunkX;
+    chunkY_ = chunkY;
+}
+
+TraceSpan::~TraceSpan() {
+    if (recorder_) recorder_->Record(name_, start_, TraceRecorder::Clock::now(), hasChunk_, chunkX_, chunkY_);
+}
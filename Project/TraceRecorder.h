@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+// Chrome の trace_event 形式（Perfetto で表示できる）で区間を記録する
+// 記録は固定容量のリングバッファに入り、古いものから上書きされる
+class TraceRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TraceRecorder(size_t capacity = kDefaultCapacity);
+
+    // 有効にした時点でバッファを空にする
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // name は文字列リテラルなど寿命の長いものを渡す。chunkX/chunkY はチャンクに紐づかない区間では省く
+    void Record(const char* name, Clock::time_point start, Clock::time_point end,
+        bool hasChunk = false, int chunkX = 0, int chunkY = 0);
+    // 記録済みの区間を "traceEvents" 形式で書き出す
+    bool SaveJson(const std::filesystem::path& path) const;
+
+    static constexpr size_t kDefaultCapacity = 1 << 16;
+
+private:
+    struct Event {
+        const char* name;
+        int64_t startUs;
+        int64_t durationUs;
+        uint32_t threadId;
+        bool hasChunk;
+        int chunkX;
+        int chunkY;
+    };
+
+    // スレッドごとの小さな通し番号（trace の tid 用）
+    static uint32_t CurrentThreadId();
+
+    std::atomic<bool> enabled_ = false;
+    Clock::time_point origin_;
+    mutable std::mutex mutex_;
+    std::vector<Event> events_;
+    size_t capacity_;
+    size_t next_ = 0;
+};
+
+// スコープの開始から終了までを1区間として記録する。無効なときは時刻も取らない
+class TraceSpan {
+public:
+    TraceSpan(TraceRecorder& recorder, const char* name);
+    TraceSpan(TraceRecorder& recorder, const char* name, int chunkX, int chunkY);
+    ~TraceSpan();
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    TraceRecorder* recorder_ = nullptr;
+    const char* name_;
+    bool hasChunk_ = false;
+    int chunkX_ = 0;
+    int chunkY_ = 0;
+    TraceRecorder::Clock::time_point start_;
+};
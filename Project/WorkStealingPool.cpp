@@ -0,0 +1,114 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// プールのスレッドが自分の列を知るため（複数のプールがあっても取り違えない）
+thread_local const WorkStealingPool* tCurrentPool = nullptr;
+thread_local size_t tCurrentQueue = 0;
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(int threads) {
+    if (threads <= 0) threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    for (int i = 0; i <= threads; ++i) queues_.push_back(std::make_unique<Queue>());
+    for (int i = 1; i <= threads; ++i) {
+        threads_.emplace_back([this, i]() { WorkerLoop(static_cast<size_t>(i)); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) thread.join();
+}
+
+size_t WorkStealingPool::CurrentQueue() const {
+    return tCurrentPool == this ? tCurrentQueue : 0;
+}
+
+void WorkStealingPool::Submit(Task task) {
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    {
+        // 列に入れる前に数を増やす（先に入れると、盗んだスレッドが増やす前の数から引いて 0 を下回る）
+        // 眠りに入る直前のスレッドが通知を取りこぼさないよう、同じ mutex の下で増やす
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        queued_.fetch_add(1, std::memory_order_relaxed);
+    }
+    Queue& queue = *queues_[CurrentQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    wake_.notify_all();
+}
+
+bool WorkStealingPool::TryRunOne(size_t self) {
+    Task task;
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; !task && i < queues_.size(); ++i) {
+        Queue& victim = *queues_[(self + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) continue;
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        steals_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!task) return false;
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    // 例外で抜けても pending_ は必ず減らす（減らさないと Wait が終わらない）
+    try {
+        task();
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        if (!error_) error_ = std::current_exception();
+    }
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Wait で眠っているスレッドを起こす
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        wake_.notify_all();
+    }
+    return true;
+}
+
+void WorkStealingPool::WorkerLoop(size_t self) {
+    tCurrentPool = this;
+    tCurrentQueue = self;
+    for (;;) {
+        if (TryRunOne(self)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this]() { return stop_ || queued_.load(std::memory_order_relaxed) > 0; });
+        if (stop_) return;
+    }
+}
+
+void WorkStealingPool::Wait() {
+    size_t self = CurrentQueue();
+    for (;;) {
+        if (TryRunOne(self)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        if (pending_.load(std::memory_order_acquire) == 0) break;
+        // 実行中のタスクが新しいタスクを積むか、すべて終わるまで待つ
+        wake_.wait(lock, [this]() {
+            return queued_.load(std::memory_order_relaxed) > 0 || pending_.load(std::memory_order_acquire) == 0;
+        });
+    }
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        error = std::exchange(error_, nullptr);
+    }
+    if (error) std::rethrow_exception(error);
+}
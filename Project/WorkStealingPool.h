@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 細かいタスクを並列に回すスレッドプール（流れ場のブロック計算など）
+// スレッドごとに列を持ち、自分の列は後ろから（直前に積んだものから）取り、空になったら他の列の前から盗む
+// タスクの中から積んだタスクはそのスレッドの列に入るので、隣接するブロックの計算が同じスレッドに残りやすい
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // threads: 作るスレッド数（0 ならコア数 - 1。Wait を呼ぶスレッドも手伝う）
+    explicit WorkStealingPool(int threads = 0);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void Submit(Task task);
+    // 積んだタスク（タスクが積んだものを含む）がすべて終わるまで、呼び出したスレッドも手伝いながら待つ
+    // タスクが例外を投げても残りのタスクは走らせ、すべて終わってから最初の例外を投げ直す
+    void Wait();
+
+    // Wait を呼ぶスレッドを含めた並列数
+    int Concurrency() const { return static_cast<int>(threads_.size()) + 1; }
+    uint64_t StealCount() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // 今のスレッドの列（プールの外のスレッドは Wait を呼ぶスレッド用の列 0）
+    size_t CurrentQueue() const;
+    bool TryRunOne(size_t self);
+    void WorkerLoop(size_t self);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_ = 0;  // 列に入っているタスク
+    std::atomic<size_t> pending_ = 0; // 積まれてまだ終わっていないタスク
+    std::atomic<uint64_t> steals_ = 0;
+    std::mutex errorMutex_;
+    std::exception_ptr error_; // タスクが最初に投げた例外（Wait が投げ直す）
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+};
@@ -0,0 +1,287 @@
+#include "WorldPack.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+uint32_t GetU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+        static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+uint16_t GetU16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+uint64_t GetU64(const uint8_t* p) {
+    return static_cast<uint64_t>(GetU32(p)) | static_cast<uint64_t>(GetU32(p + 4)) << 32;
+}
+
+int32_t GetI32(const uint8_t* p) {
+    return static_cast<int32_t>(GetU32(p));
+}
+
+void PutU32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(value >> (i * 8));
+}
+
+void PutU16(uint8_t* p, uint16_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void PutU64(uint8_t* p, uint64_t value) {
+    PutU32(p, static_cast<uint32_t>(value));
+    PutU32(p + 4, static_cast<uint32_t>(value >> 32));
+}
+
+void PutI32(uint8_t* p, int32_t value) {
+    PutU32(p, static_cast<uint32_t>(value));
+}
+
+uint32_t Fnv1a32(const uint8_t* data, size_t size) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+bool IndexLess(int ax, int ay, int bx, int by) {
+    return ay != by ? ay < by : ax < bx;
+}
+
+using Header = uint8_t[WorldPackFormat::kHeaderSize];
+using Record = uint8_t[WorldPackFormat::kRecordSize];
+
+// ヘッダを読む。形式が違えば false
+bool DecodeHeader(const Header header, uint64_t& recordCount, uint64_t& indexOffset, std::string& revision) {
+    if (std::memcmp(header, WorldPackFormat::kMagic, sizeof(WorldPackFormat::kMagic)) != 0 ||
+        GetU32(header + 4) != WorldPackFormat::kVersion ||
+        GetU16(header + 8) != ChunkTiles::kWidth || GetU16(header + 10) != ChunkTiles::kHeight ||
+        GetU32(header + 12) != WorldPackFormat::kRecordSize) {
+        return false;
+    }
+    recordCount = GetU64(header + 16);
+    indexOffset = GetU64(header + 24);
+    const char* text = reinterpret_cast<const char*>(header + 32);
+    revision.assign(text, strnlen(text, WorldPackFormat::kMaxRevisionLength));
+    return true;
+}
+
+void EncodeRecord(int cx, int cy, const ChunkTiles& tiles, Record record) {
+    std::memset(record, 0, WorldPackFormat::kRecordSize);
+    PutI32(record, cx);
+    PutI32(record + 4, cy);
+    record[8] = static_cast<uint8_t>(tiles.rowCount);
+    for (int y = 0; y < ChunkTiles::kHeight; ++y) record[9 + y] = tiles.rowWidths[y];
+    uint8_t* cells = record + 10 + ChunkTiles::kHeight;
+    for (size_t i = 0; i < tiles.cells.size(); ++i) PutI32(cells + i * 4, tiles.cells[i]);
+    const size_t checked = WorldPackFormat::kRecordSize - 4;
+    PutU32(record + checked, Fnv1a32(record, checked));
+}
+
+// 記録を読む。チェックサムが合わなければ false
+bool DecodeRecord(const Record record, int& cx, int& cy, ChunkTiles& tiles) {
+    const size_t checked = WorldPackFormat::kRecordSize - 4;
+    if (Fnv1a32(record, checked) != GetU32(record + checked)) return false;
+    cx = GetI32(record);
+    cy = GetI32(record + 4);
+    tiles.rowCount = std::min<int>(record[8], ChunkTiles::kHeight);
+    for (int y = 0; y < ChunkTiles::kHeight; ++y) {
+        tiles.rowWidths[y] = std::min<uint8_t>(record[9 + y], static_cast<uint8_t>(ChunkTiles::kWidth));
+    }
+    const uint8_t* cells = record + 10 + ChunkTiles::kHeight;
+    for (size_t i = 0; i < tiles.cells.size(); ++i) tiles.cells[i] = GetI32(cells + i * 4);
+    return true;
+}
+
+} // namespace
+
+bool WorldPackReader::Open(const std::filesystem::path& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_.close();
+    index_.clear();
+    revision_.clear();
+    in_.open(path, std::ios::binary);
+    if (!in_) return false;
+
+    Header header;
+    uint64_t recordCount = 0;
+    uint64_t indexOffset = 0;
+    bool valid = in_.read(reinterpret_cast<char*>(header), sizeof(header)) &&
+        DecodeHeader(header, recordCount, indexOffset, revision_);
+    // 索引は記録のすぐ後ろにある（0 は書きかけのファイル）
+    if (!valid || indexOffset != WorldPackFormat::kHeaderSize + recordCount * WorldPackFormat::kRecordSize) {
+        in_.close();
+        return false;
+    }
+
+    std::vector<uint8_t> bytes(static_cast<size_t>(recordCount) * WorldPackFormat::kIndexEntrySize);
+    in_.seekg(static_cast<std::streamoff>(indexOffset));
+    if (!in_.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+        in_.close();
+        return false;
+    }
+    index_.reserve(static_cast<size_t>(recordCount));
+    for (size_t i = 0; i < recordCount; ++i) {
+        const uint8_t* p = bytes.data() + i * WorldPackFormat::kIndexEntrySize;
+        IndexEntry entry{ GetI32(p), GetI32(p + 4), GetU32(p + 8) };
+        if (entry.record >= recordCount ||
+            (!index_.empty() && !IndexLess(index_.back().chunkX, index_.back().chunkY, entry.chunkX, entry.chunkY))) {
+            in_.close();
+            index_.clear();
+            return false;
+        }
+        index_.push_back(entry);
+    }
+    return true;
+}
+
+const WorldPackReader::IndexEntry* WorldPackReader::Find(int cx, int cy) const {
+    auto it = std::lower_bound(index_.begin(), index_.end(), std::make_pair(cx, cy),
+        [](const IndexEntry& entry, const std::pair<int, int>& key) {
+            return IndexLess(entry.chunkX, entry.chunkY, key.first, key.second);
+        });
+    if (it == index_.end() || it->chunkX != cx || it->chunkY != cy) return nullptr;
+    return &*it;
+}
+
+std::optional<ChunkTiles> WorldPackReader::Read(int cx, int cy) const {
+    const IndexEntry* entry = Find(cx, cy);
+    if (!entry) return std::nullopt;
+    Record record;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_.clear();
+        in_.seekg(static_cast<std::streamoff>(WorldPackFormat::kHeaderSize + entry->record * WorldPackFormat::kRecordSize));
+        if (!in_.read(reinterpret_cast<char*>(record), sizeof(record))) return std::nullopt;
+    }
+    ChunkTiles tiles;
+    int recordX = 0;
+    int recordY = 0;
+    if (!DecodeRecord(record, recordX, recordY, tiles) || recordX != cx || recordY != cy) return std::nullopt;
+    return tiles;
+}
+
+WorldPackWriter::~WorldPackWriter() {
+    // Finish していなければ書きかけのまま閉じる（Resume で続きから書ける）
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_.close();
+}
+
+bool WorldPackWriter::Create(const std::filesystem::path& path, const std::string& revision) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_.close();
+    index_.clear();
+    written_.clear();
+    revision_ = revision.substr(0, WorldPackFormat::kMaxRevisionLength);
+    file_.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    return file_.is_open() && WriteHeader(0, 0);
+}
+
+bool WorldPackWriter::Resume(const std::filesystem::path& path, const std::string& revision) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_.close();
+    index_.clear();
+    written_.clear();
+    revision_ = revision.substr(0, WorldPackFormat::kMaxRevisionLength);
+
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec || size < WorldPackFormat::kHeaderSize) return false;
+    uint64_t complete = 0;
+    {
+        std::ifstream in(path, std::ios::binary);
+        Header header;
+        uint64_t recordCount = 0;
+        uint64_t indexOffset = 0;
+        std::string fileRevision;
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+            !DecodeHeader(header, recordCount, indexOffset, fileRevision) ||
+            indexOffset != 0 || fileRevision != revision_) {
+            return false;
+        }
+        // チェックサムが合う記録までを使う
+        Record record;
+        ChunkTiles tiles;
+        while (in.read(reinterpret_cast<char*>(record), sizeof(record))) {
+            int cx = 0;
+            int cy = 0;
+            if (!DecodeRecord(record, cx, cy, tiles)) break;
+            if (written_.insert({ cx, cy }).second) index_.push_back({ cx, cy, static_cast<uint32_t>(complete) });
+            ++complete;
+        }
+    }
+    std::filesystem::resize_file(path, WorldPackFormat::kHeaderSize + complete * WorldPackFormat::kRecordSize, ec);
+    if (ec) return false;
+    file_.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    file_.seekp(0, std::ios::end);
+    return file_.good();
+}
+
+bool WorldPackWriter::Append(int cx, int cy, const ChunkTiles& tiles) {
+    Record record;
+    EncodeRecord(cx, cy, tiles, record);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_.is_open()) return false;
+    if (!written_.insert({ cx, cy }).second) return true;
+    uint64_t position = static_cast<uint64_t>(file_.tellp());
+    uint32_t number = static_cast<uint32_t>((position - WorldPackFormat::kHeaderSize) / WorldPackFormat::kRecordSize);
+    file_.write(reinterpret_cast<const char*>(record), sizeof(record));
+    // 中断されても書いた記録が残るよう、1件ごとにOSへ渡す
+    file_.flush();
+    index_.push_back({ cx, cy, number });
+    return file_.good();
+}
+
+bool WorldPackWriter::Contains(int cx, int cy) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_.count({ cx, cy }) > 0;
+}
+
+size_t WorldPackWriter::Count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
+
+bool WorldPackWriter::Finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_.is_open()) return false;
+    file_.seekp(0, std::ios::end);
+    uint64_t indexOffset = static_cast<uint64_t>(file_.tellp());
+    uint64_t recordCount = (indexOffset - WorldPackFormat::kHeaderSize) / WorldPackFormat::kRecordSize;
+    // 重複を除いた索引は記録数と一致する（Append と Resume が同じチャンクを二度書かない）
+    if (recordCount != index_.size()) return false;
+    std::sort(index_.begin(), index_.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        return IndexLess(a.chunkX, a.chunkY, b.chunkX, b.chunkY);
+    });
+    std::vector<uint8_t> bytes(index_.size() * WorldPackFormat::kIndexEntrySize);
+    for (size_t i = 0; i < index_.size(); ++i) {
+        uint8_t* p = bytes.data() + i * WorldPackFormat::kIndexEntrySize;
+        PutI32(p, index_[i].chunkX);
+        PutI32(p + 4, index_[i].chunkY);
+        PutU32(p + 8, index_[i].record);
+    }
+    file_.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    bool ok = file_.good() && WriteHeader(recordCount, indexOffset);
+    file_.close();
+    return ok;
+}
+
+bool WorldPackWriter::WriteHeader(uint64_t recordCount, uint64_t indexOffset) {
+    Header header = {};
+    std::memcpy(header, WorldPackFormat::kMagic, sizeof(WorldPackFormat::kMagic));
+    PutU32(header + 4, WorldPackFormat::kVersion);
+    PutU16(header + 8, static_cast<uint16_t>(ChunkTiles::kWidth));
+    PutU16(header + 10, static_cast<uint16_t>(ChunkTiles::kHeight));
+    PutU32(header + 12, static_cast<uint32_t>(WorldPackFormat::kRecordSize));
+    PutU64(header + 16, recordCount);
+    PutU64(header + 24, indexOffset);
+    std::memcpy(header + 32, revision_.data(), revision_.size());
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file_.flush();
+    return file_.good();
+}
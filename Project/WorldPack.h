@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "ChunkLoader.h"
+
+// 事前に焼いたワールドファイル（.trwp）。ビルドに同梱して、起動時にシートへ問い合わせずに使う
+// [ヘッダ 64バイト][チャンク記録 164バイト × N][索引 12バイト × N]（すべてリトルエンディアン）
+//   ヘッダ: "TRWP", 版, チャンク幅・高さ, 記録の大きさ, 記録数, 索引の位置（0なら書きかけ）, リビジョン（32バイト）
+//   記録:   cx, cy, 行数, 行ごとの幅 ×6, 予備, タイル ×36, それまでの内容の FNV-1a
+//   索引:   cx, cy, 記録番号（cy, cx の順に並べる）
+struct WorldPackFormat {
+    static constexpr char kMagic[4] = { 'T', 'R', 'W', 'P' };
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kHeaderSize = 64;
+    static constexpr size_t kRecordSize =
+        4 + 4 + 1 + ChunkTiles::kHeight + 1 + ChunkTiles::kWidth * ChunkTiles::kHeight * 4 + 4;
+    static constexpr size_t kIndexEntrySize = 12;
+    static constexpr size_t kMaxRevisionLength = 32;
+    static constexpr const char* kExtension = ".trwp";
+
+    struct IndexEntry {
+        int chunkX;
+        int chunkY;
+        uint32_t record;
+    };
+};
+
+// ワールドファイルの読み込み。開くときに索引だけを読み、チャンクは必要になったときに読む
+// Read は複数スレッドから呼べる
+class WorldPackReader {
+public:
+    // 索引まで書き終えたファイルだけ開ける
+    bool Open(const std::filesystem::path& path);
+    bool IsOpen() const { return in_.is_open(); }
+
+    // ファイルに記録がなければ nullopt（記録が壊れている場合も）
+    std::optional<ChunkTiles> Read(int cx, int cy) const;
+    bool Contains(int cx, int cy) const { return Find(cx, cy) != nullptr; }
+
+    size_t Count() const { return index_.size(); }
+    const std::string& Revision() const { return revision_; }
+
+private:
+    using IndexEntry = WorldPackFormat::IndexEntry;
+    const IndexEntry* Find(int cx, int cy) const;
+
+    mutable std::mutex mutex_;
+    mutable std::ifstream in_;
+    std::vector<IndexEntry> index_;
+    std::string revision_;
+};
+
+// ワールドファイルの書き込み。記録を追記していき、Finish で索引とヘッダを書いて完成させる
+// 記録は1件ごとにファイルへ書き出すので、中断した書きかけのファイルは Resume で続きから書ける
+// Append は複数スレッドから呼べる
+class WorldPackWriter {
+public:
+    ~WorldPackWriter();
+
+    // 新しく書き始める（既存のファイルは上書き）
+    bool Create(const std::filesystem::path& path, const std::string& revision);
+    // 書きかけのファイルを開き直す。形式やリビジョンが違う・完成済みなら false
+    // 途中で切れた末尾の記録は捨てる
+    bool Resume(const std::filesystem::path& path, const std::string& revision);
+
+    // すでに書いたチャンクは何もしない
+    bool Append(int cx, int cy, const ChunkTiles& tiles);
+    bool Contains(int cx, int cy) const;
+    size_t Count() const;
+
+    // 索引を書いてヘッダを確定し、ファイルを閉じる
+    bool Finish();
+
+private:
+    using IndexEntry = WorldPackFormat::IndexEntry;
+    bool WriteHeader(uint64_t recordCount, uint64_t indexOffset);
+
+    mutable std::mutex mutex_;
+    std::fstream file_;
+    std::string revision_;
+    // 書いた順（Finish で並べ替える）
+    std::vector<IndexEntry> index_;
+    std::unordered_set<std::pair<int, int>, PairHash> written_;
+};
@@ -6,10 +6,14 @@ const int kWindowWidth = 1280;
 const int kWindowHeight = 720;
 
 #include "MapManager.h"
+#include "AllocationCheck.h"
+#include <cmath>
+#include <fstream>
+#include <memory>
 #include <string>
 
 // Windowsアプリでのエントリーポイント(main関数)
-int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
+int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR lpCmdLine, int) {
 
     // ライブラリの初期化
     Novice::Initialize(kWindowTitle, kWindowWidth, kWindowHeight);
@@ -20,6 +24,8 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
 
     int posX = 20;
     int posY = 7;
+    // 壁との当たり判定（既定では切っておく。C キーで切り替える）
+    bool collisionEnabled = false;
 
     const std::string spreadsheetId = "1fL9it6HK4IsAzmViTchDWWG5koE7nbxEfSYKjx6VFM8";
     const std::string sheetNameRange = "TR1_02";
@@ -33,8 +39,32 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
         30   // Yオフセット
     );
 
+    // 事前に焼いたワールドファイル（Prebake で作る）があれば、シートへ問い合わせずにそれだけを読む
+    if (std::filesystem::exists("world.trwp")) {
+        mapMgr.UseWorldFile("world.trwp");
+    }
+
+    mapMgr.SetViewportSize(kWindowWidth, kWindowHeight);
+    // 緑のタイル（3）を光源にする（Lキーで明るさと視界を表示）
+    mapMgr.SetTileLight(3, LightMap::kMaxLight);
     mapMgr.Initialize(posX, posY);
 
+    // --edit: B キーでタイルを編集できるようにする（既定では編集しない）
+    // シートへ書き戻すには sheets_token.txt に OAuth アクセストークンを置く（なければ編集はゲームの中だけ）
+    const std::string commandLine = lpCmdLine;
+    bool editMode = commandLine.find("--edit") != std::string::npos;
+    if (editMode) {
+        std::ifstream tokenFile("sheets_token.txt");
+        std::string token;
+        if (tokenFile >> token) mapMgr.SetAccessToken(token);
+    }
+
+    // --alloc-check: 自動で歩いてチャンクの読み込みごとの確保の回数を測り、cache/alloc_check.json に書いて終わる
+    std::unique_ptr<AllocationCheck> allocCheck;
+    if (commandLine.find("--alloc-check") != std::string::npos) {
+        allocCheck = std::make_unique<AllocationCheck>(mapMgr);
+    }
+
     // タイルサイズ（MapManager作成時と同じ値）
     int tileSize = 20;
 
@@ -60,21 +90,53 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
         /// ↓更新処理ここから
         ///
 
+        int moveX = 0;
+        int moveY = 0;
         if (preKeys[DIK_A] == 0 && keys[DIK_A] != 0) {
-            posX--;
+            moveX = -1;
         }
         else if (preKeys[DIK_D] == 0 && keys[DIK_D] != 0) {
-            posX++;
+            moveX = 1;
         }
 
         if (preKeys[DIK_W] == 0 && keys[DIK_W] != 0) {
-            posY--;
+            moveY = -1;
         } else if (preKeys[DIK_S] == 0 && keys[DIK_S] != 0) {
-            posY++;
+            moveY = 1;
+        }
+
+        // Cキーで壁との当たり判定を切り替える
+        if (preKeys[DIK_C] == 0 && keys[DIK_C] != 0) {
+            collisionEnabled = !collisionEnabled;
+            mapMgr.SetCollisionOverlayEnabled(collisionEnabled);
+        }
+
+        // 編集モードでは B キーでプレイヤーの右隣の壁（1）を置く・消す（シートへは少し後にまとめて書き戻される）
+        if (editMode && preKeys[DIK_B] == 0 && keys[DIK_B] != 0) {
+            std::optional<int> tile = mapMgr.GetTile(posX + 1, posY);
+            if (tile) mapMgr.SetTile(posX + 1, posY, *tile == 1 ? 0 : 1);
         }
 
+        // 当たり判定が有効なら壁（Solid のタイル）の手前で止まる。読み込み中のチャンクでは止めない
+        if (collisionEnabled && (moveX != 0 || moveY != 0)) {
+            TileBox player{ static_cast<float>(posX), static_cast<float>(posY), 1.0f, 1.0f };
+            TileMove move = mapMgr.GetCollision().Move(player, static_cast<float>(moveX), static_cast<float>(moveY), TileClass::Solid);
+            moveX = static_cast<int>(std::lround(move.dx));
+            moveY = static_cast<int>(std::lround(move.dy));
+        }
+        // 自動で歩くときは壁を通り抜ける
+        if (allocCheck) {
+            moveX = allocCheck->NextMove(posX);
+            moveY = 0;
+        }
+        posX += moveX;
+        posY += moveY;
+
         mapMgr.Update(keys, preKeys,posX,posY);
 
+        // Q/E キーで拡大率が変わるので、描画に使うタイルの大きさを毎フレーム取り直す
+        tileSize = mapMgr.GetScaledTileSize();
+
         offSetX = posX * tileSize - screenCenterX + tileSize / 2;
         offSetY = posY * tileSize - screenCenterY + tileSize / 2;
 
@@ -88,7 +150,10 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
 
         mapMgr.Draw(offSetX, offSetY);
 
-        Novice::ScreenPrintf(10, 30, "%d,%d", posX, posY);
+        const char* editLabel = "";
+        if (editMode) editLabel = mapMgr.GetEditStats().writable ? " (edit)" : " (edit: no OAuth token, not saved to sheet)";
+        Novice::ScreenPrintf(10, 30, "%d,%d%s%s%s", posX, posY, collisionEnabled ? " (collision)" : "", editLabel,
+            allocCheck ? " (alloc check)" : "");
 
         // プレイヤーは常に画面中央に描画
         Novice::DrawBox(screenCenterX, screenCenterY, tileSize, tileSize, 0, 0xFFFFFFFF, kFillModeSolid);
@@ -104,9 +169,17 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
         if (preKeys[DIK_ESCAPE] == 0 && keys[DIK_ESCAPE] != 0) {
             break;
         }
+
+        // 自動で歩き終えたら結果を書いて終わる
+        if (allocCheck && allocCheck->Finished()) {
+            break;
+        }
     }
 
+    int exitCode = 0;
+    if (allocCheck && !allocCheck->Save(std::filesystem::path("cache") / "alloc_check.json")) exitCode = 1;
+
     // ライブラリの終了
     Novice::Finalize();
-    return 0;
+    return exitCode;
 }